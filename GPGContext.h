@@ -30,6 +30,7 @@
 
 #include <MacGPGME/GPGObject.h>
 #include <MacGPGME/GPGEngine.h>
+#include <MacGPGME/GPGKeyDefines.h>
 #include <MacGPGME/GPGSignatureNotation.h>
 
 #ifdef __cplusplus
@@ -47,6 +48,7 @@ extern "C" {
 @class NSMutableSet;
 @class GPGData;
 @class GPGKey;
+@class GPGKeyEnumerator;
 @class GPGOptions;
 
 
@@ -127,6 +129,41 @@ typedef unsigned int GPGKeyListMode;
 #define GPGKeyListModeValidate            256
 
 
+/*!
+ *  @typedef    GPGKeyFilterMask
+ *  @abstract   Restricts the keys returned by a key enumerator; combination of
+ *              bit values.
+ *  @discussion Keys are tested against the filter before any 
+ *              <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code> is 
+ *              created for them.
+ *  @constant   GPGKeyFilterCanEncryptMask      Key can be used for encryption
+ *  @constant   GPGKeyFilterCanSignMask         Key can be used for signing
+ *  @constant   GPGKeyFilterCanCertifyMask      Key can be used for 
+ *                                              certification
+ *  @constant   GPGKeyFilterCanAuthenticateMask Key can be used for
+ *                                              authentication
+ *  @constant   GPGKeyFilterExcludeRevokedMask  Key has not been revoked
+ *  @constant   GPGKeyFilterExcludeExpiredMask  Key has not expired
+ *  @constant   GPGKeyFilterExcludeDisabledMask Key has not been disabled
+ *  @constant   GPGKeyFilterExcludeInvalidMask  Key is not invalid
+ *  @constant   GPGKeyFilterUsableMask          Key has not been revoked, has
+ *                                              not expired, has not been
+ *                                              disabled, and is not invalid
+ *  @seealso    //macgpg/occ/instm/GPGContext(GPGKeyManagement)/keyEnumeratorForSearchPatterns:secretKeysOnly:filterMask:minimumValidity: keyEnumeratorForSearchPatterns:secretKeysOnly:filterMask:minimumValidity: (GPGContext)
+ */
+typedef unsigned int GPGKeyFilterMask;
+
+#define GPGKeyFilterCanEncryptMask          1
+#define GPGKeyFilterCanSignMask             2
+#define GPGKeyFilterCanCertifyMask          4
+#define GPGKeyFilterCanAuthenticateMask     8
+#define GPGKeyFilterExcludeRevokedMask     16
+#define GPGKeyFilterExcludeExpiredMask     32
+#define GPGKeyFilterExcludeDisabledMask    64
+#define GPGKeyFilterExcludeInvalidMask    128
+#define GPGKeyFilterUsableMask            240
+
+
 /*!
  *  @typedef    GPGCertificatesInclusion
  *  @abstract   Certificates inclusion (S/MIME only).
@@ -214,7 +251,13 @@ typedef unsigned int GPGImportStatus;
  *               (as <code>@link //apple_ref/occ/cl/NSNumber NSNumber@/link</code>).
  *               For distributed notifications, <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
  *               objects are replaced by <code>@link //apple_ref/occ/cl/NSString NSString@/link</code>
- *               objects representing the key fingerprints.</dd></dl>
+ *               objects representing the key fingerprints.</dd>
+ *              <dt><code>@link GPGDeletedKeyFingerprintsKey GPGDeletedKeyFingerprintsKey@/link</code></dt>
+ *              <dd>After a key deletion, an array of strings representing the
+ *               fingerprints of the deleted keys. Not available in distributed
+ *               notifications, where deleted keys are in
+ *               <code>@link GPGChangesKey GPGChangesKey@/link</code>, with
+ *               status <code>@link GPGImportDeletedKeyMask GPGImportDeletedKeyMask@/link</code>.</dd></dl>
  *  @seealso     //macgpg/occ/instm/GPGContext(GPGSynchronousOperations)/generateKeyFromDictionary:secretKey:publicKey: generateKeyFromDictionary:secretKey:publicKey: (GPGContext)
  *  @seealso     //macgpg/occ/instm/GPGContext(GPGSynchronousOperations)/importKeyData: importKeyData: (GPGContext)
  *  @seealso     //macgpg/occ/instm/GPGContext(GPGExtendedKeyManagement)/asyncDownloadKeys:serverOptions: asyncDownloadKeys:serverOptions: (GPGContext)
@@ -238,6 +281,15 @@ GPG_EXPORT NSString	* const GPGContextKey;
  */
 GPG_EXPORT NSString	* const GPGChangesKey;
 
+/*!
+ *  @const      GPGDeletedKeyFingerprintsKey
+ *  @abstract   Key of a <i>userInfo</i> entry in a
+ *              <code>@link GPGKeyringChangedNotification GPGKeyringChangedNotification@/link</code>
+ *              local notification and in <code>@link operationResults operationResults@/link</code>
+ *              (GPGContext), after a key deletion.
+ */
+GPG_EXPORT NSString	* const GPGDeletedKeyFingerprintsKey;
+
 
 /*!
  *  @const      GPGProgressNotification
@@ -346,6 +398,7 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
     id					_userInfo; // Object set by user; not used by GPGContext itself.
     NSMutableSet		*_signerKeys;
     NSArray             *_engines;
+    BOOL                _usesSecureMemory;
 }
 
 /*!
@@ -426,6 +479,34 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
 - (BOOL) usesTextMode;
 
 
+/*!
+ * @methodgroup Secure memory
+ */
+/*!
+ *  @method     setUsesSecureMemoryForDecryptedData:
+ *  @abstract   Enables or disables the use of locked memory for plaintext 
+ *              returned by operations.
+ *  @discussion When enabled, data objects returned by 
+ *              <code>@link //macgpg/occ/instm/GPGContext(GPGSynchronousOperations)/decryptedData: decryptedData:@/link</code>,
+ *              <code>@link //macgpg/occ/instm/GPGContext(GPGSynchronousOperations)/decryptedData:signatures: decryptedData:signatures:@/link</code>
+ *              and <code>@link //macgpg/occ/instm/GPGContext(GPGSynchronousOperations)/verifySignedData:originalData: verifySignedData:originalData:@/link</code>
+ *              are created with <code>@link //macgpg/occ/instm/GPGData/initWithSecureMemory initWithSecureMemory@/link</code>:
+ *              their bytes are never swapped to disk, and are wiped when data
+ *              objects are deallocated.
+ *
+ *              Default value is <code>NO</code>.
+ *  @param      flag <code>YES</code> or <code>NO</code>.
+ */
+- (void) setUsesSecureMemoryForDecryptedData:(BOOL)flag;
+
+/*!
+ *  @method     usesSecureMemoryForDecryptedData
+ *  @abstract   Returns whether context uses locked memory for plaintext or not.
+ *  @discussion Default value is <code>NO</code>.
+ */
+- (BOOL) usesSecureMemoryForDecryptedData;
+
+
 /*!
  * @methodgroup Key listing mode
  */
@@ -714,7 +795,7 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  *
  *              If last operation was a <b>key deletion</b> operation, 
  *              dictionary can contain:<dl>
- *              <dt><code>\@"deletedKeyFingerprints"</code></dt>
+ *              <dt><code>@link GPGDeletedKeyFingerprintsKey GPGDeletedKeyFingerprintsKey@/link</code></dt>
  *              <dd>An array of strings representing the fingerprints of the 
  *               deleted keys.</dd></dl>
  *
@@ -973,6 +1054,26 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  */
 - (GPGData *) decryptedData:(GPGData *)inputData;
 
+/*!
+ *  @method     decryptData:toData:
+ *  @abstract   Decrypts the ciphertext in the <i>inputData</i> data and writes
+ *              the plain data into <i>outputData</i>.
+ *  @discussion Same as <code>@link decryptedData: decryptedData:@/link</code>,
+ *              but plain data is written into a data object provided by the
+ *              caller, instead of being accumulated in memory. This allows,
+ *              for example, to stream it to a file, or to pass it to another
+ *              operation running concurrently, using a 
+ *              <code>@link //macgpg/occ/cl/GPGDataPipe GPGDataPipe@/link</code>.
+ *              <i>outputData</i>'s filename is set automatically, when 
+ *              available. On error, <i>outputData</i> might contain partial
+ *              plain data.
+ *  @param      inputData Encrypted data.
+ *  @param      outputData Data receiving the plain data. May not be nil.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exceptions, like <code>@link decryptedData: decryptedData:@/link</code>.
+ */
+- (void) decryptData:(GPGData *)inputData toData:(GPGData *)outputData;
+
 
 /*!
  * @methodgroup Verify
@@ -1022,6 +1123,25 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  */
 - (NSArray *) verifySignedData:(GPGData *)signedData originalData:(GPGData **)originalDataPtr;
 
+/*!
+ *  @method     verifySignedData:toData:
+ *  @abstract   Performs a signature check on <i>signedData</i>, writing the
+ *              data that has been signed into <i>outputData</i>.
+ *  @discussion Same as <code>@link verifySignedData:originalData: verifySignedData:originalData:@/link</code>,
+ *              but the data that has been signed is written into a data object
+ *              provided by the caller, instead of being accumulated in memory.
+ *              Returns an array of <code>@link //macgpg/occ/cl/GPGSignature GPGSignature@/link</code>
+ *              objects.
+ *  @param      signedData Signed data
+ *  @param      outputData Data receiving the data without signature. May not
+ *              be nil.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              (<code>@link //macgpg/c/econst/GPGErrorNoData GPGErrorNoData@/link</code>)
+ *              exception when <i>signedData</i> does not contain any data to
+ *              verify. Other exceptions could be raised too.
+ */
+- (NSArray *) verifySignedData:(GPGData *)signedData toData:(GPGData *)outputData;
+
 /*!
  *  @method     signatures
  *  @abstract   Returns an array of <code>@link //macgpg/occ/cl/GPGSignature GPGSignature@/link</code> 
@@ -1129,6 +1249,22 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  */
 - (GPGData *) signedData:(GPGData *)inputData signatureMode:(GPGSignatureMode)mode;
 
+/*!
+ *  @method     signData:signatureMode:toData:
+ *  @abstract   Creates a signature for the text in <i>inputData</i> and writes
+ *              either the signed data or a detached signature, depending on
+ *              <i>mode</i>, into <i>outputData</i>.
+ *  @discussion Same as <code>@link signedData:signatureMode: signedData:signatureMode:@/link</code>,
+ *              but result is written into a data object provided by the 
+ *              caller, instead of being accumulated in memory.
+ *  @param      inputData Data to sign
+ *  @param      mode Signature mode
+ *  @param      outputData Data receiving the result. May not be nil.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exceptions, like <code>@link signedData:signatureMode: signedData:signatureMode:@/link</code>.
+ */
+- (void) signData:(GPGData *)inputData signatureMode:(GPGSignatureMode)mode toData:(GPGData *)outputData;
+
 
 /*!
  * @methodgroup Encrypt
@@ -1179,6 +1315,25 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  */
 - (GPGData *) encryptedData:(GPGData *)inputData withKeys:(NSArray *)recipientKeys trustAllKeys:(BOOL)trustAllKeys;
 
+/*!
+ *  @method     encryptData:withKeys:trustAllKeys:toData:
+ *  @abstract   Encrypts the plaintext in <i>inputData</i> with the keys and
+ *              writes the ciphertext into <i>outputData</i>.
+ *  @discussion Same as <code>@link encryptedData:withKeys:trustAllKeys: encryptedData:withKeys:trustAllKeys:@/link</code>,
+ *              but ciphertext is written into a data object provided by the
+ *              caller, instead of being accumulated in memory. 
+ *              <i>outputData</i> is also available in 
+ *              <code>@link operationResults operationResults@/link</code>, 
+ *              for key <code>\@"cipher"</code>.
+ *  @param      inputData Data to encrypt
+ *  @param      recipientKeys Keys and key groups to use for encryption
+ *  @param      trustAllKeys Ignore <i>key ring</i> trust validities when <code>YES</code>
+ *  @param      outputData Data receiving the ciphertext. May not be nil.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exceptions, like <code>@link encryptedData:withKeys:trustAllKeys: encryptedData:withKeys:trustAllKeys:@/link</code>.
+ */
+- (void) encryptData:(GPGData *)inputData withKeys:(NSArray *)recipientKeys trustAllKeys:(BOOL)trustAllKeys toData:(GPGData *)outputData;
+
 
 /*!
  * @methodgroup Encrypt and Sign
@@ -1465,6 +1620,72 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  */
 - (GPGKey *) refreshKey:(GPGKey *)key;
 
+
+/*!
+ * @methodgroup File operations
+ */
+
+/*!
+ *  @method     encryptFileAtPath:toPath:withKeys:
+ *  @abstract   Encrypts the file at <i>inputPath</i> with the keys and writes
+ *              the ciphertext into the file at <i>outputPath</i>.
+ *  @discussion Same as <code>@link encryptData:withKeys:trustAllKeys:toData: encryptData:withKeys:trustAllKeys:toData:@/link</code>,
+ *              with <i>trustAllKeys</i> set to <code>NO</code>, using file
+ *              descriptor based data objects: file contents are never loaded
+ *              in memory. Depending on the crypto engine, GPGME passes the
+ *              file descriptors directly to the engine (CMS), or copies bytes
+ *              through pipes using a fixed-size buffer (OpenPGP).
+ *
+ *              Output is written into a new temporary file, in the same
+ *              directory, which replaces the file at <i>outputPath</i> only
+ *              when operation succeeds; on failure, temporary file is
+ *              removed and an existing output file is left untouched. Name
+ *              of input file is stored in ciphertext.
+ *  @param      inputPath Path of file to encrypt
+ *  @param      outputPath Path of encrypted file
+ *  @param      recipientKeys Keys and key groups to use for encryption
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exceptions, like <code>@link encryptedData:withKeys:trustAllKeys: encryptedData:withKeys:trustAllKeys:@/link</code>,
+ *              or when a file cannot be opened.
+ */
+- (void) encryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath withKeys:(NSArray *)recipientKeys;
+
+/*!
+ *  @method     decryptFileAtPath:toPath:
+ *  @abstract   Decrypts the file at <i>inputPath</i> and writes the plain data
+ *              into the file at <i>outputPath</i>.
+ *  @discussion Same as <code>@link decryptData:toData: decryptData:toData:@/link</code>,
+ *              using file descriptor based data objects; see
+ *              <code>@link encryptFileAtPath:toPath:withKeys: encryptFileAtPath:toPath:withKeys:@/link</code>.
+ *              Output file has read/write permissions for the user only,
+ *              even when it replaces an existing file; on failure, an
+ *              existing output file is left untouched.
+ *  @param      inputPath Path of encrypted file
+ *  @param      outputPath Path of decrypted file
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exceptions, like <code>@link decryptedData: decryptedData:@/link</code>,
+ *              or when a file cannot be opened.
+ */
+- (void) decryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath;
+
+/*!
+ *  @method     signFileAtPath:toPath:mode:
+ *  @abstract   Signs the file at <i>inputPath</i> and writes either the signed
+ *              data or a detached signature, depending on <i>mode</i>, into
+ *              the file at <i>outputPath</i>.
+ *  @discussion Same as <code>@link signData:signatureMode:toData: signData:signatureMode:toData:@/link</code>,
+ *              using file descriptor based data objects; see
+ *              <code>@link encryptFileAtPath:toPath:withKeys: encryptFileAtPath:toPath:withKeys:@/link</code>.
+ *              On failure, an existing output file is left untouched.
+ *  @param      inputPath Path of file to sign
+ *  @param      outputPath Path of signed file, or of detached signature
+ *  @param      mode Signature mode
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exceptions, like <code>@link signedData:signatureMode: signedData:signatureMode:@/link</code>,
+ *              or when a file cannot be opened.
+ */
+- (void) signFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath mode:(GPGSignatureMode)mode;
+
 @end
 
 
@@ -1486,7 +1707,7 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  *  @param      secretKey Searches secret keys only
  *  @seealso    keyEnumeratorForSearchPatterns:secretKeysOnly:
  */
-- (NSEnumerator *) keyEnumeratorForSearchPattern:(NSString *)searchPattern secretKeysOnly:(BOOL)secretKeysOnly;
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPattern:(NSString *)searchPattern secretKeysOnly:(BOOL)secretKeysOnly;
 
 /*!
  *  @method     keyEnumeratorForSearchPatterns:secretKeysOnly:
@@ -1499,8 +1720,8 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  *
  *              <i>searchPatterns</i> is an array containing engine specific
  *              expressions that are used to limit the list to all keys matching
- *              at least one pattern. <i>searchPatterns</i> can be empty; in
- *              this case all keys are returned. Note that the total length of
+ *              at least one pattern. <i>searchPatterns</i> can be nil or 
+ *              empty; in this case all keys are returned. Note that the total length of
  *              the pattern string (i.e. the length of all patterns, sometimes
  *              quoted, separated by a space character) is restricted to an 
  *              engine-specific maximum (a couple of hundred characters are
@@ -1527,8 +1748,100 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
  *              (i.e. when invoking <code>@link //apple_ref/occ/instm/NSEnumerator/nextObject nextObject@/link</code>
  *              on the enumerator) if the crypto back-end had to truncate the
  *              result, and less than the desired keys could be listed.
+ *  @seealso    //macgpg/occ/cl/GPGKeyEnumerator GPGKeyEnumerator
+ */
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly;
+
+/*!
+ *  @method     keyEnumeratorForSearchPatterns:secretKeysOnly:filterMask:minimumValidity:
+ *  @abstract   Returns an enumerator of <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
+ *              objects matching <i>filterMask</i> and <i>minimumValidity</i>.
+ *  @discussion Same as <code>@link keyEnumeratorForSearchPatterns:secretKeysOnly: keyEnumeratorForSearchPatterns:secretKeysOnly:@/link</code>,
+ *              but keys which do not have all capabilities and properties
+ *              requested by <i>filterMask</i>, or whose primary user ID's
+ *              validity is lower than <i>minimumValidity</i>, are skipped
+ *              without creating a <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
+ *              for them. Pass <code>@link //macgpg/c/econst/GPGValidityUnknown GPGValidityUnknown@/link</code>
+ *              to ignore validity; keys without user ID have an unknown 
+ *              validity.
+ *
+ *              Expiration is checked against the current date too, like
+ *              <code>@link //macgpg/occ/instm/GPGKey/hasKeyExpired hasKeyExpired@/link</code>
+ *              (GPGKey) does. Keys are always of the context's protocol.
+ *
+ *              Note that secret keys fetched in batch have no capabilities
+ *              (see <code>@link keyEnumeratorForSearchPatterns:secretKeysOnly: keyEnumeratorForSearchPatterns:secretKeysOnly:@/link</code>);
+ *              filter on public keys instead.
+ *  @param      searchPatterns Array of pattern strings
+ *  @param      secretKeysOnly Searches secret keys only
+ *  @param      filterMask Requested capabilities and properties
+ *  @param      minimumValidity Minimum validity of primary user ID
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception, like <code>@link keyEnumeratorForSearchPatterns:secretKeysOnly: keyEnumeratorForSearchPatterns:secretKeysOnly:@/link</code>.
+ */
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly filterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity;
+
+/*!
+ *  @method     fastKeyMetadataEnumeratorForSearchPatterns:secretKeysOnly:
+ *  @abstract   Returns an enumerator of key metadata dictionaries, listed
+ *              without computing validity.
+ *  @discussion Meant for inventory and synchronization of large key rings,
+ *              where validity is not needed: computing it through the trust
+ *              database is the most expensive part of a normal key listing.
+ *              The OpenPGP engine is launched in <code>fast-list-mode</code>,
+ *              and its colon output is parsed while being read; the receiver
+ *              itself is not busy during enumeration.
+ *
+ *              Dictionaries have the same keys as the ones returned by
+ *              <code>@link //macgpg/occ/instm/GPGKeyMetadataCache/metadataForKeyWithFingerprint: metadataForKeyWithFingerprint:@/link</code>
+ *              (GPGKeyMetadataCache), but <code>validity</code> and 
+ *              <code>ownertrust</code> values, of the key and of its user IDs,
+ *              are always <code>@link //macgpg/c/econst/GPGValidityUnknown GPGValidityUnknown@/link</code>.
+ *
+ *              Patterns matching no key are ignored; other engine errors
+ *              are raised by <code>nextObject</code> when end of output is
+ *              reached. Deallocating the enumerator before end terminates
+ *              the engine.
+ *  @param      searchPatterns Array of pattern strings; nil or empty array
+ *              returns all keys
+ *  @param      secretKeysOnly Searches secret keys only
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception (<code>@link //macgpg/c/econst/GPGErrorUnsupportedProtocol GPGErrorUnsupportedProtocol@/link</code>)
+ *              when protocol is not OpenPGP, or GPGException exception
+ *              during enumeration, when engine failed.
+ */
+- (NSEnumerator *) fastKeyMetadataEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly;
+
+/*!
+ *  @method     keyEnumeratorForSearchPatterns:secretKeysOnly:contextCount:ordered:
+ *  @abstract   Returns an enumerator of <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
+ *              objects, listed in parallel by several contexts.
+ *  @discussion Meant for long lists of patterns, like fingerprints. 
+ *              <i>searchPatterns</i> is split into shards of 64 patterns, and
+ *              shards are listed concurrently by <i>contextCount</i> copies of
+ *              the receiver, each one running its own key listing operation.
+ *              Pass 0 to use as many contexts as there are active processors.
+ *              The receiver itself is not used, and is not busy during 
+ *              enumeration.
+ *
+ *              If <i>ordered</i> is <code>YES</code>, keys are returned in
+ *              the order of the shards, else keys of a shard are returned as
+ *              soon as it has been listed. A key matched by patterns of 
+ *              several shards is returned only once.
+ *
+ *              Shards are listed ahead of the consumer, keeping at most 2 
+ *              listed shards per context. Deallocating the enumerator stops
+ *              listing.
+ *  @param      searchPatterns Array of pattern strings; nil or empty array
+ *              returns all keys
+ *  @param      secretKeysOnly Searches secret keys only
+ *  @param      contextCount Number of concurrent key listing operations
+ *  @param      ordered Keys are returned in order of the shards
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception during enumeration, raised after listing of other
+ *              shards has been stopped.
  */
-- (NSEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly;
+- (NSEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly contextCount:(unsigned)contextCount ordered:(BOOL)ordered;
 
 /*!
  *  @method     stopKeyEnumeration
@@ -1825,6 +2138,50 @@ GPG_EXPORT NSString	* const GPGNextTrustItemKey;
 @end
 
 
+/*!
+ *  @class      GPGKeyEnumerator
+ *  @abstract   Enumerator of <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
+ *              objects, returned by <code>@link //macgpg/occ/instm/GPGContext(GPGKeyManagement)/keyEnumeratorForSearchPatterns:secretKeysOnly: keyEnumeratorForSearchPatterns:secretKeysOnly:@/link</code>.
+ *  @discussion Besides <code>@link //apple_ref/occ/instm/NSEnumerator/nextObject nextObject@/link</code>,
+ *              keys can be fetched in batches, using <code>@link nextObjects: nextObjects:@/link</code>
+ *              or fast enumeration (<code>for(aKey in anEnumerator)</code>).
+ *              Both start a background thread which lists keys ahead of the
+ *              consumer, keeping at most 256 keys in a queue; once it has
+ *              been started, all keys are taken from that queue, whatever
+ *              method is used. Fast enumeration returns the keys already
+ *              listed, without waiting for more keys than the first one.
+ *
+ *              Until enumeration is finished, or the enumerator has been
+ *              deallocated, or <code>@link //macgpg/occ/instm/GPGContext(GPGKeyManagement)/stopKeyEnumeration stopKeyEnumeration@/link</code>
+ *              has been invoked, the context must not be used, from any
+ *              thread.
+ *
+ *              Errors are raised once all keys listed before the error have
+ *              been returned.
+ */
+@interface GPGKeyEnumerator : NSEnumerator
+{
+    GPGContext          *context;
+    id                  _prefetcher;
+    GPGKeyFilterMask    _filterMask;
+    GPGValidity         _minimumValidity;
+}
+
+/*!
+ *  @method     nextObjects:
+ *  @abstract   Returns an array of at most <i>count</i> next keys.
+ *  @discussion Waits until <i>count</i> keys have been listed, or listing is
+ *              finished. Returns an empty array once all keys have been
+ *              returned.
+ *  @param      count Maximum number of keys to return
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception, like <code>@link //apple_ref/occ/instm/NSEnumerator/nextObject nextObject@/link</code>.
+ */
+- (NSArray *) nextObjects:(unsigned)count;
+
+@end
+
+
 /*!
  *  @category   NSObject(GPGContextDelegate)
  *  @abstract   Informal protocol implemented by <code>@link GPGContext GPGContext@/link</code>'s
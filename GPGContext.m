@@ -34,17 +34,67 @@
 #include <MacGPGME/GPGOptions.h>
 #include <MacGPGME/GPGSignature.h>
 #include <MacGPGME/GPGTrustItem.h>
+#include "GPGEngineHelper.h"
 #include <Foundation/Foundation.h>
 #include <time.h> /* Needed for GNUstep */
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <gpgme.h>
 
 
 #define _context	((gpgme_ctx_t)_internalRepresentation)
 
+// Maximum number of keys listed ahead of the consumer
+#define KEY_PREFETCH_QUEUE_CAPACITY 256
+
+// Default number of patterns passed to each gpg invocation by parallel key
+// listing, and number of listed shards kept ahead of the consumer, per context
+#define PARALLEL_KEY_LISTING_SHARD_SIZE 64
+#define PARALLEL_KEY_LISTING_WINDOW     2
+
 
 NSString	* const GPGKeyringChangedNotification = @"GPGKeyringChangedNotification";
 NSString	* const GPGContextKey = @"GPGContextKey";
 NSString	* const GPGChangesKey = @"GPGChangesKey";
+NSString	* const GPGDeletedKeyFingerprintsKey = @"deletedKeyFingerprints";
+
+// Distributed notifications carry the identifier of the posting process,
+// so that its own observers can ignore them; see
+// GPGNotificationIsFromCurrentProcess().
+static NSString	* const GPGProcessIdentifierKey = @"GPGProcessIdentifier";
+
+BOOL GPGNotificationIsFromCurrentProcess(NSNotification *notification)
+{
+    // Local notifications never carry process identifier
+    NSNumber    *aProcessIdentifier = [[notification userInfo] objectForKey:GPGProcessIdentifierKey];
+    
+    return aProcessIdentifier != nil && [aProcessIdentifier intValue] == [[NSProcessInfo processInfo] processIdentifier];
+}
+
+NSArray *GPGChangedKeyFingerprints(NSNotification *notification)
+{
+    // Changed keys are GPGKey objects in local notifications, and fingerprints
+    // in distributed notifications. Deletions are notified locally with
+    // fingerprints only.
+    NSDictionary    *changes = [[notification userInfo] objectForKey:GPGChangesKey];
+    NSArray         *deletedKeyFingerprints = [[notification userInfo] objectForKey:GPGDeletedKeyFingerprintsKey];
+    NSMutableSet    *fingerprints = [NSMutableSet set];
+    NSEnumerator    *anEnum = [changes keyEnumerator];
+    id              aChangedKey;
+    
+    while((aChangedKey = [anEnum nextObject]) != nil){
+        if([aChangedKey isKindOfClass:[GPGKey class]])
+            aChangedKey = [aChangedKey fingerprint];
+        if(aChangedKey != nil)
+            [fingerprints addObject:GPGNormalizedHexString(aChangedKey, 0)];
+    }
+    anEnum = [deletedKeyFingerprints objectEnumerator];
+    while((aChangedKey = [anEnum nextObject]) != nil)
+        [fingerprints addObject:GPGNormalizedHexString(aChangedKey, 0)];
+    
+    return [fingerprints allObjects];
+}
 
 NSString	* const GPGProgressNotification = @"GPGProgressNotification";
 
@@ -92,16 +142,145 @@ enum {
 @end
 
 
-@interface GPGKeyEnumerator : NSEnumerator
-{
-    GPGContext	*context;
-}
+@interface GPGKeyEnumerator(Private)
 
 - (id) initForContext:(GPGContext *)context searchPattern:(NSString *)searchPattern secretKeysOnly:(BOOL)secretKeysOnly;
 - (id) initForContext:(GPGContext *)context searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly;
 // Designated initializers
 // Can raise a GPGException; in this case, a release is sent to self
 
+- (void) _setFilterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity;
+// Must be invoked before enumeration starts
+- (void) _startPrefetching;
+- (unsigned) _takeKeys:(id *)keys maxCount:(unsigned)maxCount;
+
+@end
+
+
+static int GPGValidityRank(GPGValidity validity)
+{
+    // Do not rely on GPGValidity values order: unknown and undefined
+    // validities rank lowest, below never.
+    switch(validity){
+        case GPGValidityNever:
+            return 1;
+        case GPGValidityMarginal:
+            return 2;
+        case GPGValidityFull:
+            return 3;
+        case GPGValidityUltimate:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static BOOL GPGKeyMatchesFilter(gpgme_key_t aKey, GPGKeyFilterMask filterMask, GPGValidity minimumValidity)
+{
+    // Evaluated on raw key, before any GPGKey is created for it
+    if((filterMask & GPGKeyFilterCanEncryptMask) && !aKey->can_encrypt)
+        return NO;
+    if((filterMask & GPGKeyFilterCanSignMask) && !aKey->can_sign)
+        return NO;
+    if((filterMask & GPGKeyFilterCanCertifyMask) && !aKey->can_certify)
+        return NO;
+    if((filterMask & GPGKeyFilterCanAuthenticateMask) && !aKey->can_authenticate)
+        return NO;
+    if((filterMask & GPGKeyFilterExcludeRevokedMask) && aKey->revoked)
+        return NO;
+    if((filterMask & GPGKeyFilterExcludeDisabledMask) && aKey->disabled)
+        return NO;
+    if((filterMask & GPGKeyFilterExcludeInvalidMask) && aKey->invalid)
+        return NO;
+    if(filterMask & GPGKeyFilterExcludeExpiredMask){
+        // Same workaround as -[GPGKey hasKeyExpired]: expired flag can be wrong
+        if(aKey->expired || (aKey->subkeys != NULL && aKey->subkeys->expires > 0 && aKey->subkeys->expires < time(NULL)))
+            return NO;
+    }
+    if(minimumValidity != GPGValidityUnknown){
+        if(aKey->uids == NULL || GPGValidityRank((GPGValidity)aKey->uids->validity) < GPGValidityRank(minimumValidity))
+            return NO;
+    }
+    
+    return YES;
+}
+
+
+@interface _GPGKeyPrefetcher : NSObject
+{
+    // Runs gpgme_op_keylist_next() in its own thread, and keeps keys in a
+    // bounded queue; the context must not be used by another thread until
+    // prefetcher has finished or been cancelled.
+    gpgme_ctx_t         _context;
+    pthread_mutex_t     _mutex;
+    pthread_cond_t      _condition;
+    GPGKey              *_keys[KEY_PREFETCH_QUEUE_CAPACITY]; // Ring buffer; keys are retained
+    unsigned            _head;
+    unsigned            _count;
+    BOOL                _isCancelled;
+    BOOL                _isFinished;
+    BOOL                _isTruncated;
+    gpgme_error_t       _error;
+    GPGKeyFilterMask    _filterMask;
+    GPGValidity         _minimumValidity;
+}
+
+- (id) initWithContext:(gpgme_ctx_t)context filterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity;
+- (void) run:(id)unused;
+- (unsigned) takeKeys:(id *)keys maxCount:(unsigned)maxCount;
+// Blocks until at least one key is available, or listing is finished. 
+// Returned keys are retained.
+- (gpgme_error_t) error;
+// Valid once takeKeys:maxCount: returned 0
+- (BOOL) isTruncated;
+// Valid once takeKeys:maxCount: returned 0
+- (void) cancel;
+// Waits until prefetching thread no longer uses context
+
+@end
+
+
+@interface _GPGParallelKeyListing : NSObject
+{
+    // Shared by worker threads, each one listing shards with its own context
+    NSArray             *_shards;
+    BOOL                _secretKeysOnly;
+    BOOL                _isOrdered;
+    unsigned            _windowSize;
+    pthread_mutex_t     _mutex;
+    pthread_cond_t      _condition;
+    unsigned            _nextShardIndex; // Next shard to be listed
+    unsigned            _unconsumedShardCount; // Shards taken by workers, not yet by consumer
+    unsigned            _runningWorkerCount;
+    NSMutableArray      *_shardResults; // NSNull until listed
+    NSMutableIndexSet   *_listedShardIndexes; // Listed, not yet consumed
+    unsigned            _nextOrderedShardIndex;
+    NSException         *_exception;
+    BOOL                _isCancelled;
+}
+
+- (id) initWithSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly ordered:(BOOL)ordered shardSize:(unsigned)shardSize contexts:(NSArray *)contexts;
+// Starts one worker thread per context
+- (void) runWithContext:(GPGContext *)context;
+- (NSArray *) nextListedShard;
+// Blocks until a shard has been listed; returns nil when all shards have
+// been consumed. Raises worker's exception, if any.
+- (void) cancel;
+// Waits until workers no longer use contexts
+
+@end
+
+
+@interface _GPGParallelKeyEnumerator : NSEnumerator
+{
+    _GPGParallelKeyListing  *_listing;
+    NSArray                 *_currentKeys;
+    unsigned                _currentKeyIndex;
+    NSMapTable              *_returnedFingerprints; // Owned GPGFingerprint copies
+}
+
+- (id) initWithListing:(_GPGParallelKeyListing *)listing;
+
 @end
 
 
@@ -121,6 +300,9 @@ enum {
 - (NSDictionary *) _invalidKeysReasons:(gpgme_invalid_key_t)invalidKeys keys:(NSArray *)keys;
 - (GPGKey *) _keyWithFpr:(const char *)fpr isSecret:(BOOL)isSecret;
 - (GPGError) _importKeyDataFromServerOutput:(NSData *)result;
+- (NSFileHandle *) _fileHandleForReadingAtPath:(NSString *)path;
+- (NSFileHandle *) _fileHandleForWritingAtPath:(NSString *)path mode:(mode_t)mode temporaryPath:(NSString **)temporaryPathPtr;
+- (void) _moveTemporaryPath:(NSString *)temporaryPath toPath:(NSString *)path;
 @end
 
 
@@ -241,6 +423,7 @@ static NSLock   *_waitOperationLock = nil;
     
     [contextCopy setUsesArmor:[self usesArmor]];
     [contextCopy setUsesTextMode:[self usesTextMode]];
+    [contextCopy setUsesSecureMemoryForDecryptedData:[self usesSecureMemoryForDecryptedData]];
     [contextCopy setKeyListMode:[self keyListMode]];
     [contextCopy setProtocol:[self protocol]];
     [contextCopy setCertificatesInclusion:[self certificatesInclusion]];
@@ -281,6 +464,16 @@ static NSLock   *_waitOperationLock = nil;
     return gpgme_get_textmode(_context) != 0;
 }
 
+- (void) setUsesSecureMemoryForDecryptedData:(BOOL)flag
+{
+    _usesSecureMemory = flag;
+}
+
+- (BOOL) usesSecureMemoryForDecryptedData
+{
+    return _usesSecureMemory;
+}
+
 - (void) setKeyListMode:(GPGKeyListMode)mask
 {
     gpgme_error_t	anError = gpgme_set_keylist_mode(_context, mask);
@@ -313,12 +506,33 @@ static NSLock   *_waitOperationLock = nil;
     return protocol;
 }
 
+static gpgme_error_t writeAllBytes(int fd, const char *bytes, size_t length)
+{
+    size_t  writtenLength = 0;
+    
+    while(writtenLength < length){
+        ssize_t aLength = write(fd, bytes + writtenLength, length - writtenLength);
+        
+        if(aLength < 0){
+            if(errno == EINTR)
+                continue;
+            return gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno);
+        }
+        writtenLength += aLength;
+    }
+    
+    return GPG_ERR_NO_ERROR;
+}
+
 static gpgme_error_t passphraseCallback(void *object, const char *uid_hint, const char *passphrase_info, int prev_was_bad, int fd)
 {
     NSString		*aPassphrase = nil;
     NSArray			*keys = nil;
     gpgme_error_t	error = GPG_ERR_NO_ERROR;
-    NSFileHandle	*resultFileHandle;
+    gpgme_error_t	writeError;
+    char			*passphraseBuffer;
+    NSUInteger		passphraseLength = 0;
+    NSRange			remainingRange;
 
     // With a PGP key we have:
     // passphrase_info = "keyID (sub?)keyID algo 0"
@@ -368,9 +582,41 @@ static gpgme_error_t passphraseCallback(void *object, const char *uid_hint, cons
         error = gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPG_ERR_CANCELED);
     }
 
-    resultFileHandle = [[NSFileHandle alloc] initWithFileDescriptor:fd];
-    [resultFileHandle writeData:[[aPassphrase stringByAppendingString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding]];
-    [resultFileHandle release];
+    // Passphrase is encoded into a block of secure memory, which is wiped
+    // right after, rather than into autoreleased data objects. A passphrase
+    // longer than a block is encoded and written block after block; it is
+    // never copied out of secure memory.
+    passphraseBuffer = GPGSecureBlockAllocate();
+    if(passphraseBuffer == NULL){
+        if(error == GPG_ERR_NO_ERROR)
+            error = gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPG_ERR_ENOMEM);
+        // Terminate passphrase anyway, so that engine does not wait for it
+        (void)writeAllBytes(fd, "\n", 1);
+        
+        return error;
+    }
+    
+    // An empty passphrase (also used on cancel and failure) is written as a
+    // lone newline; -getBytes:... would convert nothing and return NO.
+    remainingRange = NSMakeRange(0, [aPassphrase length]);
+    while(remainingRange.length > 0){
+        passphraseLength = 0;
+        if(![aPassphrase getBytes:passphraseBuffer maxLength:GPGSecureBlockSize() usedLength:&passphraseLength encoding:NSUTF8StringEncoding options:0 range:remainingRange remainingRange:&remainingRange] || passphraseLength == 0){
+            if(error == GPG_ERR_NO_ERROR)
+                error = gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPG_ERR_INV_VALUE);
+            break;
+        }
+        writeError = writeAllBytes(fd, passphraseBuffer, passphraseLength);
+        if(writeError != GPG_ERR_NO_ERROR){
+            if(error == GPG_ERR_NO_ERROR)
+                error = writeError;
+            break;
+        }
+    }
+    GPGSecureBlockFree(passphraseBuffer); // Wipes block
+    writeError = writeAllBytes(fd, "\n", 1);
+    if(error == GPG_ERR_NO_ERROR)
+        error = writeError;
 
     return error;
 }
@@ -630,10 +876,10 @@ static void progressCallback(void *object, const char *description, int type, in
     }
 
     if(_operationMask & KeyDeletionOperation){
-        NSArray *deletedKeyFingerprints = [_operationData objectForKey:@"deletedKeyFingerprints"];
+        NSArray *deletedKeyFingerprints = [_operationData objectForKey:GPGDeletedKeyFingerprintsKey];
         
         if(deletedKeyFingerprints)
-            [operationResults setObject:deletedKeyFingerprints forKey:@"deletedKeyFingerprints"];
+            [operationResults setObject:deletedKeyFingerprints forKey:GPGDeletedKeyFingerprintsKey];
     }
     
     if(_operationMask & KeyListingOperation){
@@ -930,6 +1176,8 @@ static void progressCallback(void *object, const char *description, int type, in
     gpgme_decrypt_result_t	aResult;
     
     returnedData = [[[GPGData alloc] initWithInternalRepresentation:gpgme_data] autorelease];
+    if(_usesSecureMemory)
+        [returnedData setBackingType:GPGDataSecureMemoryBacking];
     aResult = gpgme_op_decrypt_result(_context);
     NSAssert(aResult != NULL, @"### No decryption result after successful decryption!?");
     if(aResult->file_name != NULL)
@@ -943,7 +1191,7 @@ static void progressCallback(void *object, const char *description, int type, in
     gpgme_data_t    outputData;
     gpgme_error_t   anError;
     
-    anError = gpgme_data_new(&outputData);
+    anError = (_usesSecureMemory ? GPGSecureDataNew(&outputData) : gpgme_data_new(&outputData));
     if(anError != GPG_ERR_NO_ERROR)
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
 
@@ -960,6 +1208,28 @@ static void progressCallback(void *object, const char *description, int type, in
     return [self _decryptedData:outputData];
 }
 
+- (void) decryptData:(GPGData *)inputData toData:(GPGData *)outputData
+{
+    gpgme_error_t           anError;
+    gpgme_decrypt_result_t  aResult;
+    
+    NSParameterAssert(outputData != nil);
+
+    anError = gpgme_op_decrypt(_context, [inputData gpgmeData], [outputData gpgmeData]);
+    [self setOperationMask:DecryptOperation];
+    [_operationData setObject:[NSNumber numberWithUnsignedInt:anError] forKey:GPGErrorKey];
+    if(anError != GPG_ERR_NO_ERROR){
+        NSDictionary	*aUserInfo = [NSDictionary dictionaryWithObject:self forKey:GPGContextKey];
+        
+        [[NSException exceptionWithGPGError:anError userInfo:aUserInfo] raise];
+    }
+
+    aResult = gpgme_op_decrypt_result(_context);
+    NSAssert(aResult != NULL, @"### No decryption result after successful decryption!?");
+    if(aResult->file_name != NULL)
+        [outputData setFilename:GPGStringFromChars(aResult->file_name)];
+}
+
 - (NSArray *) verifySignatureData:(GPGData *)signatureData againstData:(GPGData *)inputData
 {
     gpgme_error_t	anError = gpgme_op_verify(_context, [signatureData gpgmeData], [inputData gpgmeData], NULL);
@@ -985,7 +1255,10 @@ static void progressCallback(void *object, const char *description, int type, in
     gpgme_data_t	uninitializedData;
     gpgme_error_t	anError;
     
-    anError = gpgme_data_new(&uninitializedData);
+    if(originalDataPtr != NULL && _usesSecureMemory)
+        anError = GPGSecureDataNew(&uninitializedData);
+    else
+        anError = gpgme_data_new(&uninitializedData);
     if(anError != GPG_ERR_NO_ERROR)
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     anError = gpgme_op_verify(_context, [signedData gpgmeData], NULL, uninitializedData);
@@ -1004,6 +1277,8 @@ static void progressCallback(void *object, const char *description, int type, in
         gpgme_verify_result_t	aResult;
         
         *originalDataPtr = [[[GPGData alloc] initWithInternalRepresentation:uninitializedData] autorelease];
+        if(_usesSecureMemory)
+            [*originalDataPtr setBackingType:GPGDataSecureMemoryBacking];
         aResult = gpgme_op_verify_result(_context);
         NSAssert(aResult != NULL, @"### No verification result after successful verification!?");
         if(aResult->file_name != NULL)
@@ -1013,6 +1288,24 @@ static void progressCallback(void *object, const char *description, int type, in
     return [self signatures];
 }
 
+- (NSArray *) verifySignedData:(GPGData *)signedData toData:(GPGData *)outputData
+{
+    gpgme_error_t	anError;
+    
+    NSParameterAssert(outputData != nil);
+
+    anError = gpgme_op_verify(_context, [signedData gpgmeData], NULL, [outputData gpgmeData]);
+    [self setOperationMask:VerifyOperation | ImportOperation];
+    [_operationData setObject:[NSNumber numberWithUnsignedInt:anError] forKey:GPGErrorKey];
+    if(anError != GPG_ERR_NO_ERROR){
+        NSDictionary	*aUserInfo = [NSDictionary dictionaryWithObject:self forKey:GPGContextKey];
+
+        [[NSException exceptionWithGPGError:anError userInfo:aUserInfo] raise];
+    }
+
+    return [self signatures];
+}
+
 - (NSArray *) signatures
 {
     gpgme_verify_result_t	aResult;
@@ -1041,7 +1334,7 @@ static void progressCallback(void *object, const char *description, int type, in
     gpgme_data_t    outputData;
     gpgme_error_t   anError;
 
-    anError = gpgme_data_new(&outputData);
+    anError = (_usesSecureMemory ? GPGSecureDataNew(&outputData) : gpgme_data_new(&outputData));
     if(anError != GPG_ERR_NO_ERROR)
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
 
@@ -1129,6 +1422,23 @@ static void progressCallback(void *object, const char *description, int type, in
     return [signedData autorelease];
 }
 
+- (void) signData:(GPGData *)inputData signatureMode:(GPGSignatureMode)mode toData:(GPGData *)outputData
+{
+    gpgme_error_t	anError;
+
+    NSParameterAssert(outputData != nil);
+
+    anError = gpgme_op_sign(_context, [inputData gpgmeData], [outputData gpgmeData], mode);
+    [self setOperationMask:SignOperation];
+    [_operationData setObject:outputData forKey:@"signedData"];
+    [_operationData setObject:[NSNumber numberWithUnsignedInt:anError] forKey:GPGErrorKey];
+    if(anError != GPG_ERR_NO_ERROR){
+        NSDictionary	*userInfo = [NSDictionary dictionaryWithObject:self forKey:GPGContextKey];
+        
+        [[NSException exceptionWithGPGError:anError userInfo:userInfo] raise];
+    }
+}
+
 - (NSArray *) _flattenedKeys:(NSArray *)keysAndKeyGroups
 {
     int             itemCount = [keysAndKeyGroups count];
@@ -1188,6 +1498,38 @@ static void progressCallback(void *object, const char *description, int type, in
     return [cipher autorelease];
 }
 
+- (void) encryptData:(GPGData *)inputData withKeys:(NSArray *)keys trustAllKeys:(BOOL)trustAllKeys toData:(GPGData *)outputData
+{
+    gpgme_error_t	anError;
+    gpgme_key_t		*encryptionKeys;
+    int				i = 0, keyCount;
+
+    NSParameterAssert(keys != nil); // Would mean symmetric encryption
+    NSParameterAssert(outputData != nil);
+    
+    keys = [self _flattenedKeys:keys];
+    keyCount = [keys count];
+    NSAssert(keyCount > 0, @"### No keys or group(s) expand to no keys!"); // Would mean symmetric encryption
+
+    encryptionKeys = NSZoneMalloc(NSDefaultMallocZone(), sizeof(gpgme_key_t) * (keyCount + 1));
+    for(i = 0; i < keyCount; i++)
+        encryptionKeys[i] = [[keys objectAtIndex:i] gpgmeKey];
+    encryptionKeys[i] = NULL;
+
+    anError = gpgme_op_encrypt(_context, encryptionKeys, (trustAllKeys ? GPGME_ENCRYPT_ALWAYS_TRUST:0), [inputData gpgmeData], [outputData gpgmeData]);
+    [self setOperationMask:EncryptOperation];
+    NSZoneFree(NSDefaultMallocZone(), encryptionKeys);
+
+    [_operationData setObject:[NSNumber numberWithUnsignedInt:anError] forKey:GPGErrorKey];
+    [_operationData setObject:outputData forKey:@"cipher"];
+
+    if(anError != GPG_ERR_NO_ERROR){
+        [_operationData setObject:keys forKey:@"keys"];
+        
+        [[NSException exceptionWithGPGError:anError userInfo:[NSDictionary dictionaryWithObject:self forKey:GPGContextKey]] raise];
+    }
+}
+
 - (GPGData *) encryptedData:(GPGData *)inputData
 {
     gpgme_data_t	outputData;
@@ -1360,7 +1702,7 @@ static void progressCallback(void *object, const char *description, int type, in
     // Posts notif only if key ring changed
     if([changedKeys count] > 0){
         [[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:self, GPGContextKey, changedKeys, GPGChangesKey, nil]];
-        [[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:[self convertedChangesDictionaryForDistributedNotification:changedKeys], GPGChangesKey, nil]];
+        [[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:[self convertedChangesDictionaryForDistributedNotification:changedKeys], GPGChangesKey, [NSNumber numberWithInt:[[NSProcessInfo processInfo] processIdentifier]], GPGProcessIdentifierKey, nil]];
     }
 
     return [self operationResults];
@@ -1441,7 +1783,7 @@ static void progressCallback(void *object, const char *description, int type, in
     keyChangesDict = [operationResults objectForKey:GPGChangesKey];
     
     [[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:self, GPGContextKey, keyChangesDict, GPGChangesKey, nil]];
-    [[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:[self convertedChangesDictionaryForDistributedNotification:keyChangesDict], GPGChangesKey, nil]];
+    [[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:[self convertedChangesDictionaryForDistributedNotification:keyChangesDict], GPGChangesKey, [NSNumber numberWithInt:[[NSProcessInfo processInfo] processIdentifier]], GPGProcessIdentifierKey, nil]];
 
     return keyChangesDict;
 }
@@ -1460,10 +1802,10 @@ static void progressCallback(void *object, const char *description, int type, in
     if(anError != GPG_ERR_NO_ERROR)
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     deletedKeyFingerprints = [NSArray arrayWithObject:aFingerprint];
-    [_operationData setObject:deletedKeyFingerprints forKey:@"deletedKeyFingerprints"];
+    [_operationData setObject:deletedKeyFingerprints forKey:GPGDeletedKeyFingerprintsKey];
     // TODO: We should mark GPGKey as deleted, and it would raise an exception on any method invocation
-    [[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:self, GPGContextKey, deletedKeyFingerprints, @"deletedKeyFingerprints", nil]];
-    [[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObject:[NSDictionary dictionaryWithObject:[NSNumber numberWithInt:GPGImportDeletedKeyMask] forKey:aFingerprint] forKey:GPGChangesKey]]; // FIXME: No difference between secret and public keys
+    [[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:self, GPGContextKey, deletedKeyFingerprints, GPGDeletedKeyFingerprintsKey, nil]];
+    [[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:[NSDictionary dictionaryWithObject:[NSNumber numberWithInt:GPGImportDeletedKeyMask] forKey:aFingerprint], GPGChangesKey, [NSNumber numberWithInt:[[NSProcessInfo processInfo] processIdentifier]], GPGProcessIdentifierKey, nil]]; // FIXME: No difference between secret and public keys
     [aFingerprint release];
 }
 
@@ -1507,24 +1849,170 @@ static void progressCallback(void *object, const char *description, int type, in
     return [self keyFromFingerprint:aString secretKey:[key isSecret]];
 }
 
+- (NSFileHandle *) _fileHandleForReadingAtPath:(NSString *)path
+{
+    NSFileHandle    *aFileHandle = [NSFileHandle fileHandleForReadingAtPath:path];
+    
+    if(aFileHandle == nil)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, (errno != 0 ? errno : ENOENT)) userInfo:nil] raise];
+    
+    return aFileHandle;
+}
+
+- (NSFileHandle *) _fileHandleForWritingAtPath:(NSString *)path mode:(mode_t)mode temporaryPath:(NSString **)temporaryPathPtr
+{
+    // Output is written into a new temporary file, in the same directory as
+    // path, created exclusively (O_EXCL) with mode: mode applies even when
+    // path already exists, and no other process can have opened the file
+    // before. Temporary file is then renamed to path.
+    NSString    *aDirectory = [path stringByDeletingLastPathComponent];
+    NSString    *aTemporaryPath;
+    int         aFileDescriptor;
+    
+    do{
+        aTemporaryPath = [aDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@".%@.%@", [path lastPathComponent], [[NSProcessInfo processInfo] globallyUniqueString]]];
+        do{
+            aFileDescriptor = open([aTemporaryPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_EXCL, mode);
+        }while(aFileDescriptor < 0 && errno == EINTR);
+    }while(aFileDescriptor < 0 && errno == EEXIST);
+    if(aFileDescriptor < 0)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+    *temporaryPathPtr = aTemporaryPath;
+    
+    return [[[NSFileHandle alloc] initWithFileDescriptor:aFileDescriptor closeOnDealloc:YES] autorelease];
+}
+
+- (void) _moveTemporaryPath:(NSString *)temporaryPath toPath:(NSString *)path
+{
+    if(rename([temporaryPath fileSystemRepresentation], [path fileSystemRepresentation]) != 0){
+        int anErrno = errno;
+        
+        (void)unlink([temporaryPath fileSystemRepresentation]);
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, anErrno) userInfo:nil] raise];
+    }
+}
+
+// File operations use file descriptor based data objects: bytes are never
+// accumulated in memory. Output is written to a temporary file which
+// replaces output file when operation succeeds, and is removed on failure;
+// an existing output file is left untouched on failure.
+
+- (void) encryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath withKeys:(NSArray *)recipientKeys
+{
+    NSFileHandle    *inputFileHandle = [self _fileHandleForReadingAtPath:inputPath];
+    NSString        *temporaryPath;
+    NSFileHandle    *outputFileHandle = [self _fileHandleForWritingAtPath:outputPath mode:0666 temporaryPath:&temporaryPath];
+    GPGData         *inputData = [[GPGData alloc] initWithFileHandle:inputFileHandle];
+    GPGData         *outputData = [[GPGData alloc] initWithFileHandle:outputFileHandle];
+    
+    [inputData setFilename:[inputPath lastPathComponent]];
+    NS_DURING
+        [self encryptData:inputData withKeys:recipientKeys trustAllKeys:NO toData:outputData];
+    NS_HANDLER
+        [inputData release];
+        [outputData release];
+        [outputFileHandle closeFile];
+        (void)unlink([temporaryPath fileSystemRepresentation]);
+        [localException raise];
+    NS_ENDHANDLER
+    [inputData release];
+    [outputData release];
+    [outputFileHandle closeFile];
+    [self _moveTemporaryPath:temporaryPath toPath:outputPath];
+}
+
+- (void) decryptFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath
+{
+    // Plaintext file is readable only by the user
+    NSFileHandle    *inputFileHandle = [self _fileHandleForReadingAtPath:inputPath];
+    NSString        *temporaryPath;
+    NSFileHandle    *outputFileHandle = [self _fileHandleForWritingAtPath:outputPath mode:0600 temporaryPath:&temporaryPath];
+    GPGData         *inputData = [[GPGData alloc] initWithFileHandle:inputFileHandle];
+    GPGData         *outputData = [[GPGData alloc] initWithFileHandle:outputFileHandle];
+    
+    NS_DURING
+        [self decryptData:inputData toData:outputData];
+    NS_HANDLER
+        [inputData release];
+        [outputData release];
+        [outputFileHandle closeFile];
+        (void)unlink([temporaryPath fileSystemRepresentation]);
+        [localException raise];
+    NS_ENDHANDLER
+    [inputData release];
+    [outputData release];
+    [outputFileHandle closeFile];
+    [self _moveTemporaryPath:temporaryPath toPath:outputPath];
+}
+
+- (void) signFileAtPath:(NSString *)inputPath toPath:(NSString *)outputPath mode:(GPGSignatureMode)mode
+{
+    NSFileHandle    *inputFileHandle = [self _fileHandleForReadingAtPath:inputPath];
+    NSString        *temporaryPath;
+    NSFileHandle    *outputFileHandle = [self _fileHandleForWritingAtPath:outputPath mode:0666 temporaryPath:&temporaryPath];
+    GPGData         *inputData = [[GPGData alloc] initWithFileHandle:inputFileHandle];
+    GPGData         *outputData = [[GPGData alloc] initWithFileHandle:outputFileHandle];
+    
+    [inputData setFilename:[inputPath lastPathComponent]];
+    NS_DURING
+        [self signData:inputData signatureMode:mode toData:outputData];
+    NS_HANDLER
+        [inputData release];
+        [outputData release];
+        [outputFileHandle closeFile];
+        (void)unlink([temporaryPath fileSystemRepresentation]);
+        [localException raise];
+    NS_ENDHANDLER
+    [inputData release];
+    [outputData release];
+    [outputFileHandle closeFile];
+    [self _moveTemporaryPath:temporaryPath toPath:outputPath];
+}
+
 @end
 
 
 @implementation GPGContext(GPGKeyManagement)
 
-- (NSEnumerator *) keyEnumeratorForSearchPattern:(NSString *)searchPattern secretKeysOnly:(BOOL)secretKeysOnly
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPattern:(NSString *)searchPattern secretKeysOnly:(BOOL)secretKeysOnly
 {
     return [[[GPGKeyEnumerator alloc] initForContext:self searchPattern:searchPattern secretKeysOnly:secretKeysOnly] autorelease];
 }
 
-- (NSEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
 {
     return [[[GPGKeyEnumerator alloc] initForContext:self searchPatterns:searchPatterns secretKeysOnly:secretKeysOnly] autorelease];
 }
 
+- (NSEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly contextCount:(unsigned)contextCount ordered:(BOOL)ordered
+{
+    return [self keyEnumeratorForSearchPatterns:searchPatterns secretKeysOnly:secretKeysOnly contextCount:contextCount ordered:ordered shardSize:PARALLEL_KEY_LISTING_SHARD_SIZE];
+}
+
+- (NSEnumerator *) fastKeyMetadataEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
+{
+    if([self protocol] != GPGOpenPGPProtocol)
+        [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorUnsupportedProtocol) userInfo:nil] raise];
+    
+    return [[[GPGColonKeyListingEnumerator alloc] initWithEngine:[self engine] searchPatterns:searchPatterns secretKeysOnly:secretKeysOnly] autorelease];
+}
+
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly filterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity
+{
+    GPGKeyEnumerator    *anEnumerator = [self keyEnumeratorForSearchPatterns:searchPatterns secretKeysOnly:secretKeysOnly];
+    
+    [anEnumerator _setFilterMask:filterMask minimumValidity:minimumValidity];
+    
+    return anEnumerator;
+}
+
 - (void) stopKeyEnumeration
 {
-    gpgme_error_t	anError = gpgme_op_keylist_end(_context);
+    gpgme_error_t	anError;
+    
+    // Prefetching thread, if any, must stop using context first
+    [(_GPGKeyPrefetcher *)[_operationData objectForKey:@"keyPrefetcher"] cancel];
+    anError = gpgme_op_keylist_end(_context);
 
     if(anError != GPG_ERR_NO_ERROR)
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
@@ -2429,6 +2917,37 @@ enum {
         return [NSDictionary dictionaryWithObjectsAndKeys:[NSArray array], @"keys", aName, @"name", nil];
 }
 
+- (NSEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly contextCount:(unsigned)contextCount ordered:(BOOL)ordered shardSize:(unsigned)shardSize
+{
+    NSMutableArray          *contexts;
+    _GPGParallelKeyListing  *aListing;
+    NSEnumerator            *anEnumerator;
+    unsigned                i, shardCount;
+    
+    if(contextCount == 0){
+        long    processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+        
+        contextCount = (processorCount > 0 ? (unsigned)processorCount : 1);
+    }
+    if(shardSize == 0)
+        shardSize = PARALLEL_KEY_LISTING_SHARD_SIZE;
+    shardCount = ([searchPatterns count] + shardSize - 1) / shardSize;
+    contextCount = MAX(1U, MIN(contextCount, shardCount)); // No patterns: a single shard lists all keys
+    contexts = [NSMutableArray arrayWithCapacity:contextCount];
+    for(i = 0; i < contextCount; i++){
+        GPGContext  *aContext = [self copy];
+        
+        [contexts addObject:aContext];
+        [aContext release];
+    }
+    
+    aListing = [[_GPGParallelKeyListing alloc] initWithSearchPatterns:searchPatterns secretKeysOnly:secretKeysOnly ordered:ordered shardSize:shardSize contexts:contexts];
+    anEnumerator = [[_GPGParallelKeyEnumerator alloc] initWithListing:aListing];
+    [aListing release];
+    
+    return [anEnumerator autorelease];
+}
+
 @end
 
 
@@ -2497,8 +3016,7 @@ enum {
 
 - (id) initForContext:(GPGContext *)newContext searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
 {
-    NSParameterAssert(searchPatterns != nil);
-    
+    // nil searchPatterns, like an empty array, lists all keys
     if(self = [self init]){
         gpgme_error_t	anError;
         int				i, patternCount = [searchPatterns count];
@@ -2530,6 +3048,9 @@ enum {
 {
     gpgme_error_t	anError = GPG_ERR_NO_ERROR;
     
+    // Prefetching thread must stop using context before listing ends
+    [_prefetcher cancel];
+    [_prefetcher release];
     if(context != nil){
         anError = gpgme_op_keylist_end([context gpgmeContext]);
         // We don't care about the key listing operation result
@@ -2549,7 +3070,18 @@ enum {
     GPGKey          *returnedKey;
     
     NSAssert(context != nil, @"### Enumerator is invalid now, because an exception was raised during enumeration.");
-    anError = gpgme_op_keylist_next([context gpgmeContext], &aKey); // Returned key has one reference
+    if(_prefetcher != nil){
+        // Once prefetching started, all keys come from its queue
+        id  aKeyObject;
+        
+        return ([self _takeKeys:&aKeyObject maxCount:1] == 1 ? aKeyObject : nil);
+    }
+    while(YES){
+        anError = gpgme_op_keylist_next([context gpgmeContext], &aKey); // Returned key has one reference
+        if(anError != GPG_ERR_NO_ERROR || GPGKeyMatchesFilter(aKey, _filterMask, _minimumValidity))
+            break;
+        gpgme_key_unref(aKey);
+    }
     if(gpg_err_code(anError) == GPG_ERR_EOF){
         gpgme_keylist_result_t	result = gpgme_op_keylist_result([context gpgmeContext]);
 
@@ -2576,6 +3108,459 @@ enum {
     return returnedKey;
 }
 
+- (NSArray *) nextObjects:(unsigned)count
+{
+    id          *someKeys;
+    unsigned    aKeyCount = 0;
+    NSArray     *anArray;
+    
+    NSAssert(context != nil, @"### Enumerator is invalid now, because an exception was raised during enumeration.");
+    if(count == 0)
+        return [NSArray array];
+    [self _startPrefetching];
+    someKeys = NSZoneMalloc(NSDefaultMallocZone(), count * sizeof(id));
+    NS_DURING
+        while(aKeyCount < count){
+            unsigned    aTakenCount = [self _takeKeys:someKeys + aKeyCount maxCount:count - aKeyCount];
+            
+            if(aTakenCount == 0)
+                break;
+            aKeyCount += aTakenCount;
+        }
+    NS_HANDLER
+        NSZoneFree(NSDefaultMallocZone(), someKeys);
+        [localException raise];
+    NS_ENDHANDLER
+    anArray = [NSArray arrayWithObjects:someKeys count:aKeyCount];
+    NSZoneFree(NSDefaultMallocZone(), someKeys);
+    
+    return anArray;
+}
+
+#if defined(MAC_OS_X_VERSION_10_5) && (MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_5)
+- (NSUInteger) countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len
+{
+    // Returns the keys which are already prefetched, without waiting for
+    // more, so that caller processes them while gpg lists next ones.
+    if(state->state == 0){
+        state->state = 1;
+        state->mutationsPtr = &state->extra[0];
+    }
+    if(context == nil || len == 0)
+        return 0;
+    [self _startPrefetching];
+    state->itemsPtr = stackbuf;
+    
+    return [self _takeKeys:stackbuf maxCount:len];
+}
+#endif
+
+@end
+
+
+@implementation GPGKeyEnumerator(Private)
+
+- (void) _setFilterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity
+{
+    NSAssert(_prefetcher == nil, @"### Enumeration already started");
+    _filterMask = filterMask;
+    _minimumValidity = minimumValidity;
+}
+
+- (void) _startPrefetching
+{
+    if(_prefetcher == nil && context != nil){
+        _prefetcher = [[_GPGKeyPrefetcher alloc] initWithContext:[context gpgmeContext] filterMask:_filterMask minimumValidity:_minimumValidity];
+        // Context needs it to stop prefetching in -stopKeyEnumeration
+        [[context operationData] setObject:_prefetcher forKey:@"keyPrefetcher"];
+        [NSThread detachNewThreadSelector:@selector(run:) toTarget:_prefetcher withObject:nil];
+    }
+}
+
+- (unsigned) _takeKeys:(id *)keys maxCount:(unsigned)maxCount
+{
+    // Returned keys are autoreleased. Errors are raised once all prefetched
+    // keys have been taken, like in -nextObject.
+    unsigned    aCount = [_prefetcher takeKeys:keys maxCount:maxCount];
+    unsigned    i;
+    
+    for(i = 0; i < aCount; i++)
+        [keys[i] autorelease];
+    
+    if(aCount == 0){
+        gpgme_error_t   anError = [_prefetcher error];
+        
+        if(anError != GPG_ERR_NO_ERROR){
+            GPGContext	*aContext = context;
+            
+            context = nil;
+            [aContext autorelease]; // Do not release it: we need it for exception
+            [[NSException exceptionWithGPGError:anError userInfo:[NSDictionary dictionaryWithObject:aContext forKey:GPGContextKey]] raise];
+        }
+        if([_prefetcher isTruncated])
+            [[NSException exceptionWithGPGError:GPGMakeError(GPG_MacGPGMEFrameworkErrorSource, GPGErrorTruncatedKeyListing) userInfo:[NSDictionary dictionaryWithObject:context forKey:GPGContextKey]] raise];
+    }
+    
+    return aCount;
+}
+
+@end
+
+
+@implementation _GPGKeyPrefetcher
+
+- (id) initWithContext:(gpgme_ctx_t)context filterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity
+{
+    if(self = [super init]){
+        _context = context;
+        _filterMask = filterMask;
+        _minimumValidity = minimumValidity;
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_condition, NULL);
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    while(_count > 0){
+        [_keys[_head] release];
+        _head = (_head + 1) % KEY_PREFETCH_QUEUE_CAPACITY;
+        _count--;
+    }
+    pthread_cond_destroy(&_condition);
+    pthread_mutex_destroy(&_mutex);
+    
+    [super dealloc];
+}
+
+- (void) run:(id)unused
+{
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    gpgme_error_t       anError = GPG_ERR_NO_ERROR;
+    BOOL                isTruncated = NO;
+    
+    while(YES){
+        NSAutoreleasePool   *keyAP;
+        gpgme_key_t         aKey;
+        GPGKey              *newKey;
+        BOOL                isCancelled;
+        
+        pthread_mutex_lock(&_mutex);
+        while(_count == KEY_PREFETCH_QUEUE_CAPACITY && !_isCancelled)
+            pthread_cond_wait(&_condition, &_mutex);
+        isCancelled = _isCancelled;
+        pthread_mutex_unlock(&_mutex);
+        if(isCancelled)
+            break;
+        
+        anError = gpgme_op_keylist_next(_context, &aKey); // Returned key has one reference
+        if(gpg_err_code(anError) == GPG_ERR_EOF){
+            anError = GPG_ERR_NO_ERROR;
+            isTruncated = !!gpgme_op_keylist_result(_context)->truncated;
+            break;
+        }
+        if(anError != GPG_ERR_NO_ERROR)
+            break;
+        if(!GPGKeyMatchesFilter(aKey, _filterMask, _minimumValidity)){
+            gpgme_key_unref(aKey);
+            continue;
+        }
+        
+        keyAP = [[NSAutoreleasePool alloc] init];
+        newKey = [[GPGKey alloc] initWithInternalRepresentation:aKey];
+        gpgme_key_unref(aKey);
+        [keyAP release];
+        
+        pthread_mutex_lock(&_mutex);
+        _keys[(_head + _count) % KEY_PREFETCH_QUEUE_CAPACITY] = newKey;
+        _count++;
+        pthread_cond_broadcast(&_condition);
+        pthread_mutex_unlock(&_mutex);
+    }
+    
+    pthread_mutex_lock(&_mutex);
+    _error = anError;
+    _isTruncated = isTruncated;
+    _isFinished = YES;
+    pthread_cond_broadcast(&_condition);
+    pthread_mutex_unlock(&_mutex);
+    [localAP release];
+}
+
+- (unsigned) takeKeys:(id *)keys maxCount:(unsigned)maxCount
+{
+    unsigned    aCount, i;
+    
+    pthread_mutex_lock(&_mutex);
+    while(_count == 0 && !_isFinished)
+        pthread_cond_wait(&_condition, &_mutex);
+    aCount = MIN(maxCount, _count);
+    for(i = 0; i < aCount; i++){
+        keys[i] = _keys[_head];
+        _head = (_head + 1) % KEY_PREFETCH_QUEUE_CAPACITY;
+    }
+    _count -= aCount;
+    if(aCount > 0)
+        pthread_cond_broadcast(&_condition);
+    pthread_mutex_unlock(&_mutex);
+    
+    return aCount;
+}
+
+- (gpgme_error_t) error
+{
+    gpgme_error_t   anError;
+    
+    pthread_mutex_lock(&_mutex);
+    anError = _error;
+    pthread_mutex_unlock(&_mutex);
+    
+    return anError;
+}
+
+- (BOOL) isTruncated
+{
+    BOOL    isTruncated;
+    
+    pthread_mutex_lock(&_mutex);
+    isTruncated = _isTruncated;
+    pthread_mutex_unlock(&_mutex);
+    
+    return isTruncated;
+}
+
+- (void) cancel
+{
+    pthread_mutex_lock(&_mutex);
+    _isCancelled = YES;
+    pthread_cond_broadcast(&_condition);
+    while(!_isFinished)
+        pthread_cond_wait(&_condition, &_mutex);
+    pthread_mutex_unlock(&_mutex);
+}
+
+@end
+
+
+@implementation _GPGParallelKeyListing
+
+- (id) initWithSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly ordered:(BOOL)ordered shardSize:(unsigned)shardSize contexts:(NSArray *)contexts
+{
+    if(self = [self init]){
+        NSMutableArray  *someShards = [NSMutableArray array];
+        unsigned        aCount = [searchPatterns count];
+        unsigned        i;
+        
+        for(i = 0; i < aCount; i += shardSize)
+            [someShards addObject:[searchPatterns subarrayWithRange:NSMakeRange(i, MIN(shardSize, aCount - i))]];
+        if(aCount == 0)
+            // Like an empty pattern array, lists all keys
+            [someShards addObject:[NSArray array]];
+        _shards = [someShards copy];
+        _secretKeysOnly = secretKeysOnly;
+        _isOrdered = ordered;
+        _windowSize = PARALLEL_KEY_LISTING_WINDOW * [contexts count];
+        _shardResults = [[NSMutableArray alloc] initWithCapacity:[_shards count]];
+        for(i = 0; i < [_shards count]; i++)
+            [_shardResults addObject:[NSNull null]];
+        _listedShardIndexes = [[NSMutableIndexSet alloc] init];
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_condition, NULL);
+        
+        _runningWorkerCount = [contexts count];
+        for(i = 0; i < [contexts count]; i++)
+            [NSThread detachNewThreadSelector:@selector(runWithContext:) toTarget:self withObject:[contexts objectAtIndex:i]];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [_shards release];
+    [_shardResults release];
+    [_listedShardIndexes release];
+    [_exception release];
+    pthread_cond_destroy(&_condition);
+    pthread_mutex_destroy(&_mutex);
+    
+    [super dealloc];
+}
+
+- (void) runWithContext:(GPGContext *)context
+{
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    
+    while(YES){
+        NSAutoreleasePool   *shardAP;
+        unsigned            aShardIndex;
+        NSArray             *someKeys = nil;
+        NSException         *anException = nil;
+        
+        pthread_mutex_lock(&_mutex);
+        while(_unconsumedShardCount >= _windowSize && !_isCancelled)
+            pthread_cond_wait(&_condition, &_mutex);
+        if(_isCancelled || _nextShardIndex >= [_shards count]){
+            pthread_mutex_unlock(&_mutex);
+            break;
+        }
+        // Shards are taken in order: next shard of ordered consumer is
+        // always being listed, or listed, when window is full.
+        aShardIndex = _nextShardIndex++;
+        _unconsumedShardCount++;
+        pthread_mutex_unlock(&_mutex);
+        
+        shardAP = [[NSAutoreleasePool alloc] init];
+        NS_DURING
+            someKeys = [[[context keyEnumeratorForSearchPatterns:[_shards objectAtIndex:aShardIndex] secretKeysOnly:_secretKeysOnly] allObjects] retain];
+        NS_HANDLER
+            anException = [localException retain];
+        NS_ENDHANDLER
+        NS_DURING
+            // Releasing pool deallocates shard enumerator, whose -dealloc
+            // ends listing and can raise; nothing must escape the thread.
+            [shardAP release];
+        NS_HANDLER
+            if(anException == nil)
+                anException = [localException retain];
+        NS_ENDHANDLER
+        
+        pthread_mutex_lock(&_mutex);
+        if(anException != nil){
+            if(_exception == nil)
+                _exception = anException;
+            else
+                [anException release];
+            [someKeys release];
+            _isCancelled = YES;
+        }
+        else{
+            [_shardResults replaceObjectAtIndex:aShardIndex withObject:someKeys];
+            [_listedShardIndexes addIndex:aShardIndex];
+            [someKeys release];
+        }
+        pthread_cond_broadcast(&_condition);
+        pthread_mutex_unlock(&_mutex);
+    }
+    
+    pthread_mutex_lock(&_mutex);
+    _runningWorkerCount--;
+    pthread_cond_broadcast(&_condition);
+    pthread_mutex_unlock(&_mutex);
+    [localAP release];
+}
+
+- (NSArray *) nextListedShard
+{
+    NSArray     *someKeys = nil;
+    NSException *anException = nil;
+    
+    pthread_mutex_lock(&_mutex);
+    while(YES){
+        unsigned    aShardIndex;
+        
+        if(_exception != nil){
+            anException = [[_exception retain] autorelease];
+            break;
+        }
+        if(_isOrdered)
+            aShardIndex = ([_listedShardIndexes containsIndex:_nextOrderedShardIndex] ? _nextOrderedShardIndex : NSNotFound);
+        else
+            aShardIndex = [_listedShardIndexes firstIndex];
+        if(aShardIndex != NSNotFound){
+            someKeys = [[[_shardResults objectAtIndex:aShardIndex] retain] autorelease];
+            [_shardResults replaceObjectAtIndex:aShardIndex withObject:[NSNull null]];
+            [_listedShardIndexes removeIndex:aShardIndex];
+            if(_isOrdered)
+                _nextOrderedShardIndex++;
+            _unconsumedShardCount--;
+            pthread_cond_broadcast(&_condition);
+            break;
+        }
+        if(_runningWorkerCount == 0)
+            break;
+        pthread_cond_wait(&_condition, &_mutex);
+    }
+    pthread_mutex_unlock(&_mutex);
+    
+    if(anException != nil){
+        [self cancel];
+        [anException raise];
+    }
+    
+    return someKeys;
+}
+
+- (void) cancel
+{
+    pthread_mutex_lock(&_mutex);
+    _isCancelled = YES;
+    pthread_cond_broadcast(&_condition);
+    while(_runningWorkerCount > 0)
+        pthread_cond_wait(&_condition, &_mutex);
+    pthread_mutex_unlock(&_mutex);
+}
+
+@end
+
+
+@implementation _GPGParallelKeyEnumerator
+
+- (id) initWithListing:(_GPGParallelKeyListing *)listing
+{
+    if(self = [self init]){
+        _listing = [listing retain];
+        _returnedFingerprints = NSCreateMapTable(GPGOwnedFingerprintMapKeyCallBacks, NSNonOwnedPointerMapValueCallBacks, 256);
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    // Workers retain listing; they must stop before it can be deallocated
+    [_listing cancel];
+    [_listing release];
+    [_currentKeys release];
+    NSFreeMapTable(_returnedFingerprints);
+    
+    [super dealloc];
+}
+
+- (id) nextObject
+{
+    while(_listing != nil){
+        while(_currentKeyIndex < [_currentKeys count]){
+            GPGKey                  *aKey = [_currentKeys objectAtIndex:_currentKeyIndex++];
+            const GPGFingerprint    *aFingerprint = [aKey packedFingerprint];
+            
+            // Patterns of different shards can match the same key
+            if(!NSMapMember(_returnedFingerprints, aFingerprint, NULL, NULL)){
+                NSMapInsertKnownAbsent(_returnedFingerprints, GPGFingerprintCopy(aFingerprint), NULL);
+                return [[aKey retain] autorelease];
+            }
+        }
+        [_currentKeys release];
+        _currentKeys = nil;
+        _currentKeyIndex = 0;
+        NS_DURING
+            _currentKeys = [[_listing nextListedShard] retain];
+        NS_HANDLER
+            [_listing release];
+            _listing = nil;
+            [localException raise];
+        NS_ENDHANDLER
+        if(_currentKeys == nil){
+            [_listing release];
+            _listing = nil;
+        }
+    }
+    
+    return nil;
+}
+
 @end
 
 
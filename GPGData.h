@@ -29,6 +29,7 @@
 #define GPGDATA_H
 
 #include <MacGPGME/GPGObject.h>
+#include <MacGPGME/GPGDefines.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,7 +41,9 @@ extern "C" {
 
 @class NSData;
 @class NSFileHandle;
+@class NSInputStream;
 @class NSMutableData;
+@class NSOutputStream;
 @class NSString;
 
 
@@ -101,6 +104,36 @@ typedef enum {
     GPGDataEndPosition      = 2
 } GPGDataOffsetType;
 
+
+/*!
+ *  @const      GPGDataSegmentPathKey
+ *  @abstract   Key of a file segment description, passed to
+ *              <code>@link //macgpg/occ/instm/GPGData/initWithSegments: initWithSegments:@/link</code>
+ *              (GPGData). Value is an absolute path
+ *              (<code>@link //apple_ref/occ/cl/NSString NSString@/link</code>).
+ */
+GPG_EXPORT NSString	* const GPGDataSegmentPathKey;
+
+/*!
+ *  @const      GPGDataSegmentOffsetKey
+ *  @abstract   Key of a file segment description, passed to
+ *              <code>@link //macgpg/occ/instm/GPGData/initWithSegments: initWithSegments:@/link</code>
+ *              (GPGData). Value is the offset in file, in bytes 
+ *              (<code>@link //apple_ref/occ/cl/NSNumber NSNumber@/link</code>).
+ *              Optional; defaults to 0.
+ */
+GPG_EXPORT NSString	* const GPGDataSegmentOffsetKey;
+
+/*!
+ *  @const      GPGDataSegmentLengthKey
+ *  @abstract   Key of a file segment description, passed to
+ *              <code>@link //macgpg/occ/instm/GPGData/initWithSegments: initWithSegments:@/link</code>
+ *              (GPGData). Value is the length of the segment, in bytes 
+ *              (<code>@link //apple_ref/occ/cl/NSNumber NSNumber@/link</code>).
+ *              Optional; defaults to the remaining length of the file.
+ */
+GPG_EXPORT NSString	* const GPGDataSegmentLengthKey;
+
 /*!
  *  @class      GPGData
  *  @abstract   Encapsulates data exchanged with MacGPGME crypto engines.
@@ -129,14 +162,42 @@ typedef enum {
  *              <li><code>@link initWithData: initWithData:@/link</code></li>
  *              <li><code>@link initWithDataNoCopy: initWithDataNoCopy:@/link</code></li>
  *              <li><code>@link initWithContentsOfFile: initWithContentsOfFile:@/link</code></li>
+ *              <li><code>@link initWithContentsOfFileNoCopy: initWithContentsOfFileNoCopy:@/link</code></li>
  *              <li><code>@link initWithContentsOfFile:atOffset:length: initWithContentsOfFile:atOffset:length:@/link</code></li></ul>
+ *              <h2>Secure Memory Based Data Buffers</h2>
+ *              Secure memory based data objects store their bytes in locked
+ *              memory, which cannot be swapped to disk, and wipe them when
+ *              deallocated. Use them to receive plaintext or other sensitive
+ *              data; see also <code>@link //macgpg/occ/instm/GPGContext/setUsesSecureMemoryForDecryptedData: setUsesSecureMemoryForDecryptedData:@/link</code>
+ *              (GPGContext). Note that methods returning
+ *              <code>@link //apple_ref/occ/cl/NSData NSData@/link</code> or
+ *              <code>@link //apple_ref/occ/cl/NSString NSString@/link</code>
+ *              objects, like <code>@link data data@/link</code>, copy bytes
+ *              into ordinary memory.
+ *
+ *              Here is the method to initialize secure memory based data
+ *              buffers:<ul>
+ *              <li><code>@link initWithSecureMemory initWithSecureMemory@/link</code></li></ul>
  *              <h2>File Based Data Buffers</h2>
  *              File based data objects operate directly on file descriptors
  *              or streams. Only a small amount of data is stored in core at any
  *              time, so the size of the data objects is not limited by GPGME.
  *
  *              Here are the methods to initialize file based data buffers:<ul>
- *              <li><code>@link initWithFileHandle: initWithFileHandle:@/link</code></li></ul>
+ *              <li><code>@link initWithFileHandle: initWithFileHandle:@/link</code></li>
+ *              <li><code>@link initWithSegments: initWithSegments:@/link</code></li></ul>
+ *              <h2>Stream Based Data Buffers</h2>
+ *              Stream based data objects read from an
+ *              <code>@link //apple_ref/occ/cl/NSInputStream NSInputStream@/link</code>
+ *              or write to an <code>@link //apple_ref/occ/cl/NSOutputStream NSOutputStream@/link</code>.
+ *              Bytes are exchanged directly between the stream and the 
+ *              fixed-size transfer buffer of GPGME; they are never accumulated
+ *              in memory, whatever the size of the payload.
+ *
+ *              Here are the methods to initialize stream based data buffers:
+ *              <ul>
+ *              <li><code>@link initWithInputStream: initWithInputStream:@/link</code></li>
+ *              <li><code>@link initWithOutputStream: initWithOutputStream:@/link</code></li></ul>
  *              <h2>Callback Based Data Buffers</h2>
  *              If neither memory nor file based data objects are a good fit for
  *              your application, you can provide a data source implementing
@@ -148,12 +209,45 @@ typedef enum {
  *              <li><code>@link initWithDataSource: initWithDataSource:@/link</code></li>
  *              </ul>
  */
-@interface GPGData : GPGObject
+@interface GPGData : GPGObject <NSCopying>
 {
     id		_objectReference;
     void	*_callbacks;
+    int		_backingType;
 }
 
+/*!
+ *  @method     copyWithZone:
+ *  @abstract   <code>@link //apple_ref/occ/intf/NSCopying NSCopying@/link</code>
+ *              protocol implementation.
+ *  @discussion Returns a new data object with the same contents, filename and
+ *              encoding, positioned at the same offset as the receiver, but
+ *              with its own position afterwards: reading, writing or 
+ *              repositioning the copy does not affect the receiver, and
+ *              vice versa. Copying is cheap, which allows to pass the same
+ *              input to several operations:<ul>
+ *              <li>memory based data objects share their bytes with their
+ *               copies; bytes are copied only once one of them is written to.
+ *               Data objects created with <code>@link initWithData: initWithData:@/link</code>,
+ *               <code>@link initWithDataNoCopy: initWithDataNoCopy:@/link</code>
+ *               or <code>@link initWithContentsOfFileNoCopy: initWithContentsOfFileNoCopy:@/link</code>
+ *               are shared from the start; other memory based data objects
+ *               (e.g. results of operations) have their bytes read into a
+ *               new buffer, owned by the copy, which is then shared by copies
+ *               of the copy. The receiver itself is never modified.</li>
+ *              <li>file based data objects share the file descriptor; copies 
+ *               read and write at their own position, without moving the file
+ *               descriptor offset.</li>
+ *              <li>secure memory based data objects are copied into new secure
+ *               memory.</li></ul>
+ *              Data objects based on a data source, or on a stream, and pipe
+ *              data objects cannot be copied: an <code>NSInternalInconsistencyException</code>
+ *              is raised.
+ *  @param      zone Memory zone.
+ *  @result     A new retained data object.
+ */
+- (id) copyWithZone:(NSZone *)zone;
+
 /*!
  *  @methodgroup Creating memory based data buffers
  */
@@ -180,6 +274,10 @@ typedef enum {
 /*!
  *  @method     initWithDataNoCopy:
  *  @abstract   Returns data referencing (retaining) <i>someData</i>.
+ *  @discussion Bytes of <i>someData</i> are never modified: they are copied
+ *              on first write. If <i>someData</i> is mutable, modifications 
+ *              done to it later are visible to the receiver, until the 
+ *              receiver is copied.
  *  @param      someData Data which is retained
  *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
  *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
@@ -187,6 +285,24 @@ typedef enum {
  */
 - (id) initWithDataNoCopy:(NSData *)someData;
 
+/*!
+ *  @method     initWithSecureMemory
+ *  @abstract   Returns data without content, whose bytes will be stored in
+ *              locked memory.
+ *  @discussion Bytes are stored in fixed-size blocks taken from a pool of
+ *              locked memory pages; each block is isolated by guard pages, so
+ *              that overrunning a block faults. Blocks are wiped
+ *              as soon as the data object is deallocated, and put back into
+ *              the pool. Allocating blocks does not involve any system call,
+ *              unless the pool needs to grow. If memory cannot be locked 
+ *              (e.g. because of resource limits), data is stored in unlocked
+ *              memory, but is still wiped.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithSecureMemory;
+
 /*!
  *  @method     initWithContentsOfFile:
  *  @abstract   Returns data initialized with content of file <i>filename</i>.
@@ -203,6 +319,21 @@ typedef enum {
 
 //- (id) initWithContentsOfFileNoCopy:(NSString *)filename;
 
+/*!
+ *  @method     initWithContentsOfFileNoCopy:
+ *  @abstract   Returns data with the contents of file <i>filename</i>, mapped
+ *              in memory.
+ *  @discussion File is not read, but mapped in memory; pages are read on
+ *              demand. The file must not be modified as long as the data is
+ *              used. Data's filename is set to the last path component of
+ *              <i>filename</i>. Copies of the data share the mapping.
+ *  @param      filename Path of the file to map
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithContentsOfFileNoCopy:(NSString *)filename;
+
 /*!
  *  @method     initWithContentsOfFile:atOffset:length:
  *  @abstract   Returns data initialized with partial content of file 
@@ -219,6 +350,31 @@ typedef enum {
  */
 - (id) initWithContentsOfFile:(NSString *)filename atOffset:(off_t)offset length:(size_t)length;
 
+/*!
+ *  @method     initWithSegments:
+ *  @abstract   Returns read-only data presenting the concatenation of 
+ *              <i>segments</i> as a single stream.
+ *  @discussion Each segment is either an <code>@link //apple_ref/occ/cl/NSData NSData@/link</code>
+ *              object, or a dictionary describing a file range, using
+ *              <code>@link GPGDataSegmentPathKey GPGDataSegmentPathKey@/link</code>,
+ *              <code>@link GPGDataSegmentOffsetKey GPGDataSegmentOffsetKey@/link</code>
+ *              and <code>@link GPGDataSegmentLengthKey GPGDataSegmentLengthKey@/link</code>.
+ *
+ *              Nothing is copied up front: bytes are copied directly from
+ *              segments into the transfer buffer of GPGME, when read. Files
+ *              are opened immediately, once per path, and read on demand;
+ *              they must not be modified as long as the data is used.
+ *              Immutable <code>@link //apple_ref/occ/cl/NSData NSData@/link</code>
+ *              segments are retained; mutable ones are copied. Data can be
+ *              sought, and copies share the segments.
+ *  @param      segments Array of <code>@link //apple_ref/occ/cl/NSData NSData@/link</code>
+ *              or file segment descriptions
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithSegments:(NSArray *)segments;
+
 
 /*!
  *  @methodgroup Creating file based data buffers
@@ -243,6 +399,55 @@ typedef enum {
 - (id) initWithFileHandle:(NSFileHandle *)fileHandle;
 
 
+/*!
+ *  @methodgroup Creating stream based data buffers
+ */
+
+/*!
+ *  @method     initWithInputStream:
+ *  @abstract   Returns data that will read from <i>inputStream</i>.
+ *  @discussion Returned data can only be used as an input data object.
+ *              <i>inputStream</i> is retained, and opened if it is not yet
+ *              open; it is not closed by the data object.
+ *
+ *              Each read request of the crypto engine is passed directly to
+ *              <i>inputStream</i>, with the engine's own buffer; no other
+ *              buffer is allocated. Reading blocks until <i>inputStream</i>
+ *              has bytes available, or reaches its end.
+ *
+ *              Repositioning is supported only if <i>inputStream</i> supports
+ *              the <code>NSStreamFileCurrentOffsetKey</code> property, e.g.
+ *              for file-based streams; this means that
+ *              <code>@link //macgpg/occ/instm/GPGData(GPGExtensions)/data data@/link</code>,
+ *              <code>@link //macgpg/occ/instm/GPGData(GPGExtensions)/length length@/link</code>
+ *              and <code>@link //macgpg/occ/instm/GPGData(GPGExtensions)/rewind rewind@/link</code>
+ *              cannot be used with other streams.
+ *  @param      inputStream Retained input stream
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithInputStream:(NSInputStream *)inputStream;
+
+/*!
+ *  @method     initWithOutputStream:
+ *  @abstract   Returns data that will write to <i>outputStream</i>.
+ *  @discussion Returned data can only be used as an output data object.
+ *              <i>outputStream</i> is retained, and opened if it is not yet
+ *              open; it is not closed by the data object: once the operation
+ *              is finished, you are responsible for closing it.
+ *
+ *              Bytes produced by the crypto engine are written directly from
+ *              the engine's own buffer; no other buffer is allocated. Writing
+ *              blocks until <i>outputStream</i> accepted all bytes.
+ *  @param      outputStream Retained output stream
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithOutputStream:(NSOutputStream *)outputStream;
+
+
 /*!
  *  @methodgroup Creating callback based data buffers
  */
@@ -461,6 +666,62 @@ typedef enum {
  */
 - (void) rewind;
 
+
+/*!
+ *  @methodgroup ASCII armor
+ */
+
+/*!
+ *  @method     armoredData
+ *  @abstract   Returns a new data object containing all data of the receiver,
+ *              in OpenPGP ASCII armor (radix-64 with CRC-24 checksum).
+ *  @discussion Convenience method. Armor label is guessed from the first
+ *              OpenPGP packet of the data: <code>PGP SIGNATURE</code>, 
+ *              <code>PGP PUBLIC KEY BLOCK</code>, 
+ *              <code>PGP PRIVATE KEY BLOCK</code> or <code>PGP MESSAGE</code>;
+ *              <code>PGP ARMORED FILE</code> is used when data is not OpenPGP
+ *              data, like <code>gpg --enarmor</code> does.
+ *
+ *              Armoring is performed in-process, without invoking the
+ *              crypto engine; receiver is read entirely, like with 
+ *              <code>@link data data@/link</code>. Returned data's encoding is
+ *              <code>@link GPGDataEncodingArmor GPGDataEncodingArmor@/link</code>.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception.
+ */
+- (GPGData *) armoredData;
+
+/*!
+ *  @method     armoredDataWithLabel:
+ *  @abstract   Returns a new data object containing all data of the receiver,
+ *              in OpenPGP ASCII armor, using <i>label</i> in the 
+ *              <code>-----BEGIN</code> and <code>-----END</code> lines.
+ *  @discussion See <code>@link armoredData armoredData@/link</code>.
+ *  @param      label Armor label, e.g. <code>PGP MESSAGE</code>
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception.
+ */
+- (GPGData *) armoredDataWithLabel:(NSString *)label;
+
+/*!
+ *  @method     dearmoredData
+ *  @abstract   Returns a new data object containing binary data decoded from
+ *              the OpenPGP ASCII armor of the receiver.
+ *  @discussion Convenience method. Text before the <code>-----BEGIN</code> 
+ *              line is ignored, as well as armor headers. When the armor has
+ *              a checksum line, checksum is verified. Cleartext signatures
+ *              are not supported.
+ *
+ *              Dearmoring is performed in-process, without invoking the
+ *              crypto engine. Returned data's encoding is
+ *              <code>@link GPGDataEncodingBinary GPGDataEncodingBinary@/link</code>.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              (<code>@link //macgpg/c/econst/GPGErrorInvalidArmor GPGErrorInvalidArmor@/link</code>
+ *              or <code>@link //macgpg/c/econst/GPGErrorChecksumError GPGErrorChecksumError@/link</code>)
+ *              exception.
+ */
+- (GPGData *) dearmoredData;
+
 @end
 
 
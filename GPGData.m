@@ -30,11 +30,388 @@
 #include <MacGPGME/GPGInternals.h>
 #include <Foundation/Foundation.h>
 #include <gpgme.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 
 #define _data		((gpgme_data_t)_internalRepresentation)
 
 
+NSString	* const GPGDataSegmentPathKey = @"GPGDataSegmentPathKey";
+NSString	* const GPGDataSegmentOffsetKey = @"GPGDataSegmentOffsetKey";
+NSString	* const GPGDataSegmentLengthKey = @"GPGDataSegmentLengthKey";
+
+
+// Shared memory data objects read bytes from an immutable NSData, which can
+// be shared with copies without copying bytes. Bytes are copied into a private
+// mutable buffer on first write only (copy-on-write). When copying a data
+// object which has a private buffer, that buffer is frozen, i.e. it becomes
+// the shared data, and it will be copied again on next write.
+// Buffer is the callback handle, and is retained by the GPGData as
+// _objectReference; as it is released before gpgme data, there is no release
+// callback.
+@interface _GPGSharedBuffer : NSObject
+{
+    @public
+    NSData          *sharedData;
+    NSMutableData   *privateData;
+    off_t           position;
+}
+- (NSData *) frozenData;
+@end
+
+@implementation _GPGSharedBuffer
+
+- (void) dealloc
+{
+    [sharedData release];
+    [privateData release];
+    
+    [super dealloc];
+}
+
+- (NSData *) frozenData
+{
+    if(privateData != nil){
+        sharedData = privateData;
+        privateData = nil;
+    }
+    
+    return sharedData;
+}
+
+@end
+
+
+static ssize_t sharedBufferReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    // Returns the number of bytes read, or 0 on EOF.
+    _GPGSharedBuffer    *aBuffer = (_GPGSharedBuffer *)object;
+    NSData              *someData = (aBuffer->privateData != nil ? aBuffer->privateData : aBuffer->sharedData);
+    off_t               aLength = [someData length];
+    
+    if(aBuffer->position >= aLength)
+        return 0;
+    if((off_t)destinationBufferSize > aLength - aBuffer->position)
+        destinationBufferSize = (size_t)(aLength - aBuffer->position);
+    memcpy(destinationBuffer, (const char *)[someData bytes] + aBuffer->position, destinationBufferSize);
+    aBuffer->position += destinationBufferSize;
+    
+    return destinationBufferSize;
+}
+
+static ssize_t sharedBufferWriteCallback(void *object, const void *buffer, size_t size)
+{
+    // Returns the number of bytes written.
+    _GPGSharedBuffer    *aBuffer = (_GPGSharedBuffer *)object;
+    
+    if(aBuffer->privateData == nil){
+        aBuffer->privateData = (aBuffer->sharedData != nil ? [aBuffer->sharedData mutableCopy] : [[NSMutableData alloc] init]);
+        [aBuffer->sharedData release];
+        aBuffer->sharedData = nil;
+    }
+    if(aBuffer->position + (off_t)size > (off_t)[aBuffer->privateData length])
+        [aBuffer->privateData setLength:aBuffer->position + size]; // Zero-fills gap, if any
+    memcpy((char *)[aBuffer->privateData mutableBytes] + aBuffer->position, buffer, size);
+    aBuffer->position += size;
+    
+    return size;
+}
+
+static off_t sharedBufferSeekCallback(void *object, off_t offset, int whence)
+{
+    // Returns the new position, or -1 on error. Sets errno in case of error.
+    _GPGSharedBuffer    *aBuffer = (_GPGSharedBuffer *)object;
+    off_t               newPosition;
+    
+    switch(whence){
+        case SEEK_SET:
+            newPosition = offset;
+            break;
+        case SEEK_CUR:
+            newPosition = aBuffer->position + offset;
+            break;
+        case SEEK_END:
+            newPosition = (off_t)[(aBuffer->privateData != nil ? aBuffer->privateData : aBuffer->sharedData) length] + offset;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if(newPosition < 0){
+        errno = EINVAL;
+        return -1;
+    }
+    aBuffer->position = newPosition;
+    
+    return newPosition;
+}
+
+static struct gpgme_data_cbs	sharedBufferCallbacks = {sharedBufferReadCallback, sharedBufferWriteCallback, sharedBufferSeekCallback, NULL};
+
+
+// Copies of file descriptor based data objects read and write with pread()
+// and pwrite(), so that they have their own position, independent from the
+// file descriptor offset. Cursor is the callback handle, and is retained by
+// the GPGData as _objectReference.
+@interface _GPGFileCursor : NSObject
+{
+    @public
+    NSFileHandle    *fileHandle;
+    off_t           position;
+}
+@end
+
+@implementation _GPGFileCursor
+
+- (void) dealloc
+{
+    [fileHandle release];
+    
+    [super dealloc];
+}
+
+@end
+
+
+static ssize_t fileCursorReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    // Returns the number of bytes read, or -1 on error. Sets errno in case of error.
+    _GPGFileCursor  *aCursor = (_GPGFileCursor *)object;
+    ssize_t         readLength;
+    
+    do{
+        readLength = pread([aCursor->fileHandle fileDescriptor], destinationBuffer, destinationBufferSize, aCursor->position);
+    }while(readLength < 0 && errno == EINTR);
+    if(readLength > 0)
+        aCursor->position += readLength;
+    
+    return readLength;
+}
+
+static ssize_t fileCursorWriteCallback(void *object, const void *buffer, size_t size)
+{
+    // Returns the number of bytes written, or -1 on error. Sets errno in case of error.
+    _GPGFileCursor  *aCursor = (_GPGFileCursor *)object;
+    ssize_t         writtenLength;
+    
+    do{
+        writtenLength = pwrite([aCursor->fileHandle fileDescriptor], buffer, size, aCursor->position);
+    }while(writtenLength < 0 && errno == EINTR);
+    if(writtenLength > 0)
+        aCursor->position += writtenLength;
+    
+    return writtenLength;
+}
+
+static off_t fileCursorSeekCallback(void *object, off_t offset, int whence)
+{
+    // Returns the new position, or -1 on error. Sets errno in case of error.
+    _GPGFileCursor  *aCursor = (_GPGFileCursor *)object;
+    off_t           newPosition;
+    struct stat     fileStat;
+    
+    switch(whence){
+        case SEEK_SET:
+            newPosition = offset;
+            break;
+        case SEEK_CUR:
+            newPosition = aCursor->position + offset;
+            break;
+        case SEEK_END:
+            if(fstat([aCursor->fileHandle fileDescriptor], &fileStat) != 0)
+                return -1;
+            newPosition = fileStat.st_size + offset;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if(newPosition < 0){
+        errno = EINVAL;
+        return -1;
+    }
+    aCursor->position = newPosition;
+    
+    return newPosition;
+}
+
+static struct gpgme_data_cbs	fileCursorCallbacks = {fileCursorReadCallback, fileCursorWriteCallback, fileCursorSeekCallback, NULL};
+
+
+// Segmented data objects present an ordered list of NSData objects and file
+// ranges as a single read-only stream. Segment list is immutable and shared
+// by copies; each data object has its own cursor, which is the callback
+// handle, and is retained by the GPGData as _objectReference.
+typedef struct {
+    off_t           end;            // Logical offset of the end of segment
+    NSData          *data;          // nil for file ranges
+    NSFileHandle    *fileHandle;    // nil for NSData segments
+    off_t           fileOffset;
+} GPGDataSegment;
+
+@interface _GPGSegmentList : NSObject
+{
+    @public
+    GPGDataSegment  *segments;      // Empty segments are skipped
+    unsigned        count;
+}
+@end
+
+@implementation _GPGSegmentList
+
+- (void) dealloc
+{
+    unsigned    i;
+    
+    for(i = 0; i < count; i++){
+        [segments[i].data release];
+        [segments[i].fileHandle release];
+    }
+    if(segments != NULL)
+        NSZoneFree([self zone], segments);
+    
+    [super dealloc];
+}
+
+@end
+
+@interface _GPGSegmentCursor : NSObject
+{
+    @public
+    _GPGSegmentList *segmentList;
+    off_t           position;
+    unsigned        segmentIndex;   // Hint: segment containing position
+}
+@end
+
+@implementation _GPGSegmentCursor
+
+- (void) dealloc
+{
+    [segmentList release];
+    
+    [super dealloc];
+}
+
+@end
+
+
+static unsigned segmentIndexForPosition(_GPGSegmentList *segmentList, off_t position, unsigned hint)
+{
+    // Returns count if position is at or past end. Sequential reads always
+    // hit the hint; seeks need a binary search.
+    GPGDataSegment  *segments = segmentList->segments;
+    unsigned        lowIndex = 0, highIndex = segmentList->count;
+    
+    if(hint < highIndex && position < segments[hint].end && (hint == 0 || position >= segments[hint - 1].end))
+        return hint;
+    while(lowIndex < highIndex){
+        unsigned    middleIndex = lowIndex + (highIndex - lowIndex) / 2;
+        
+        if(segments[middleIndex].end <= position)
+            lowIndex = middleIndex + 1;
+        else
+            highIndex = middleIndex;
+    }
+    
+    return lowIndex;
+}
+
+static ssize_t segmentCursorReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    // Returns the number of bytes read, or -1 on error. Sets errno in case of error.
+    // Bytes are copied from segments directly into gpgme's buffer.
+    _GPGSegmentCursor   *aCursor = (_GPGSegmentCursor *)object;
+    _GPGSegmentList     *aList = aCursor->segmentList;
+    char                *aPtr = (char *)destinationBuffer;
+    size_t              remainingLength = destinationBufferSize;
+    unsigned            anIndex = segmentIndexForPosition(aList, aCursor->position, aCursor->segmentIndex);
+    
+    while(remainingLength > 0 && anIndex < aList->count){
+        GPGDataSegment  *aSegment = &aList->segments[anIndex];
+        off_t           segmentPosition = aCursor->position - (anIndex == 0 ? 0 : aList->segments[anIndex - 1].end);
+        size_t          aLength = (size_t)MIN((off_t)remainingLength, aSegment->end - aCursor->position);
+        
+        if(aSegment->fileHandle == nil)
+            memcpy(aPtr, (const char *)[aSegment->data bytes] + segmentPosition, aLength);
+        else{
+            ssize_t readLength;
+            
+            do{
+                readLength = pread([aSegment->fileHandle fileDescriptor], aPtr, aLength, aSegment->fileOffset + segmentPosition);
+            }while(readLength < 0 && errno == EINTR);
+            if(readLength <= 0){
+                if(aPtr != (char *)destinationBuffer)
+                    break; // Return what has been read; error will be reported on next read
+                if(readLength == 0)
+                    errno = EIO; // File has been truncated
+                return -1;
+            }
+            if((size_t)readLength < aLength){
+                aPtr += readLength;
+                aCursor->position += readLength;
+                break;
+            }
+        }
+        aPtr += aLength;
+        remainingLength -= aLength;
+        aCursor->position += aLength;
+        if(aCursor->position == aSegment->end)
+            anIndex++;
+    }
+    aCursor->segmentIndex = anIndex;
+    
+    return aPtr - (char *)destinationBuffer;
+}
+
+static off_t segmentCursorSeekCallback(void *object, off_t offset, int whence)
+{
+    // Returns the new position, or -1 on error. Sets errno in case of error.
+    _GPGSegmentCursor   *aCursor = (_GPGSegmentCursor *)object;
+    _GPGSegmentList     *aList = aCursor->segmentList;
+    off_t               newPosition;
+    
+    switch(whence){
+        case SEEK_SET:
+            newPosition = offset;
+            break;
+        case SEEK_CUR:
+            newPosition = aCursor->position + offset;
+            break;
+        case SEEK_END:
+            newPosition = (aList->count > 0 ? aList->segments[aList->count - 1].end : 0) + offset;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if(newPosition < 0){
+        errno = EINVAL;
+        return -1;
+    }
+    aCursor->position = newPosition;
+    
+    return newPosition;
+}
+
+static struct gpgme_data_cbs	segmentCursorCallbacks = {segmentCursorReadCallback, NULL, segmentCursorSeekCallback, NULL};
+
+
+@interface GPGData(Private)
+- (id) initWithSharedData:(NSData *)someData position:(off_t)position;
+- (id) initWithFileHandle:(NSFileHandle *)fileHandle position:(off_t)position;
+- (id) initWithSegmentList:(_GPGSegmentList *)segmentList position:(off_t)position;
+- (NSData *) copyMemoryBytes;
+- (void) copySecureBytesToData:(GPGData *)aCopy;
+@end
+
+
 @implementation GPGData
 
 - (id) init
@@ -51,16 +428,39 @@
     return self;
 }
 
-- (id) initWithData:(NSData *)someData
+- (id) initWithSharedData:(NSData *)someData position:(off_t)position
 {
-    gpgme_data_t	aData;
-    gpgme_error_t	anError = gpgme_data_new_from_mem(&aData, [someData bytes], [someData length], 1);
-
+    // someData must be immutable; it is retained.
+    _GPGSharedBuffer    *aBuffer = [[_GPGSharedBuffer alloc] init];
+    gpgme_data_t        aData;
+    gpgme_error_t       anError = gpgme_data_new_from_cbs(&aData, &sharedBufferCallbacks, aBuffer);
+    
     if(anError != GPG_ERR_NO_ERROR){
+        [aBuffer release];
         [self release];
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     }
+    aBuffer->sharedData = [someData retain];
+    aBuffer->position = position;
     self = [self initWithInternalRepresentation:aData];
+    ((GPGData *)self)->_objectReference = aBuffer;
+    ((GPGData *)self)->_backingType = GPGDataSharedMemoryBacking;
+    
+    return self;
+}
+
+- (id) initWithData:(NSData *)someData
+{
+    // Copying an immutable NSData does not copy bytes
+    NSData  *copiedData = [someData copy];
+    
+    NS_DURING
+        self = [self initWithSharedData:copiedData position:0];
+    NS_HANDLER
+        [copiedData release];
+        [localException raise];
+    NS_ENDHANDLER
+    [copiedData release];
 
     return self;
 }
@@ -68,7 +468,13 @@
 - (id) initWithDataNoCopy:(NSData *)someData
 {
     gpgme_data_t	aData;
-    gpgme_error_t	anError = gpgme_data_new_from_mem(&aData, ([someData respondsToSelector:@selector(mutableBytes)] ? [(NSMutableData *)someData mutableBytes]:[someData bytes]), [someData length], 0);
+    gpgme_error_t	anError;
+    
+    if(![someData isKindOfClass:[NSMutableData class]])
+        // Immutable data can be shared by copies
+        return [self initWithSharedData:someData position:0];
+    
+    anError = gpgme_data_new_from_mem(&aData, ([someData respondsToSelector:@selector(mutableBytes)] ? [(NSMutableData *)someData mutableBytes]:[someData bytes]), [someData length], 0);
 
     if(anError != GPG_ERR_NO_ERROR){
         [self release];
@@ -167,118 +573,516 @@ static off_t seekCallback(void *object, off_t offset, int whence)
 
             return -1;
         }
-        else
-            [localException raise];
-    NS_ENDHANDLER
-
-    return newPosition;
+        else
+            [localException raise];
+    NS_ENDHANDLER
+
+    return newPosition;
+}
+
+static void releaseCallback(void *object)
+{
+    [((GPGData *)object)->_objectReference dataRelease:((GPGData *)object)];
+}
+
+- (id) initWithDataSource:(id)dataSource
+{
+    gpgme_data_t		aData;
+    gpgme_error_t		anError;
+    gpgme_data_cbs_t	callbacks;
+
+    NSParameterAssert(dataSource != nil);
+
+    callbacks = (gpgme_data_cbs_t)NSZoneCalloc([self zone], 1, sizeof(struct gpgme_data_cbs));
+    if([dataSource respondsToSelector:@selector(data:readDataOfLength:)])
+        callbacks->read = readCallback;
+    if([dataSource respondsToSelector:@selector(data:writeData:)])
+        callbacks->write = writeCallback;
+    if([dataSource respondsToSelector:@selector(data:seekToFileOffset:offsetType:)])
+        callbacks->seek = seekCallback;
+    if([dataSource respondsToSelector:@selector(data:dataRelease:)])
+        callbacks->release = releaseCallback;
+    
+    NSParameterAssert(callbacks->read != NULL || callbacks->write != NULL);
+
+    anError = gpgme_data_new_from_cbs(&aData, callbacks, self);
+
+    if(anError != GPG_ERR_NO_ERROR){
+        NSZoneFree([self zone], callbacks);
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    NSAssert(self == [self initWithInternalRepresentation:aData], @"Tried to change self! Impossible due to callback registration.");
+    _objectReference = dataSource; // We don't retain dataSource
+    _callbacks = callbacks;
+    _backingType = GPGDataUncopyableBacking;
+    
+    return self;
+}
+
+- (id) initWithContentsOfFile:(NSString *)filename
+{
+    gpgme_data_t	aData;
+    gpgme_error_t	anError = gpgme_data_new_from_file(&aData, [filename fileSystemRepresentation], 1);
+
+    if(anError != GPG_ERR_NO_ERROR){
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    self = [self initWithInternalRepresentation:aData];
+    [self setFilename:[filename lastPathComponent]];
+    
+    return self;
+}
+
+- (id) initWithContentsOfFileNoCopy:(NSString *)filename
+{
+    // gpgme does not support it (GPG_ERR_NOT_IMPLEMENTED), thus we map the
+    // file ourself; the mapping is shared by copies.
+    NSData  *mappedData = [[NSData alloc] initWithContentsOfMappedFile:filename];
+    
+    if(mappedData == nil){
+        [self release];
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, (errno != 0 ? errno : ENOENT)) userInfo:nil] raise];
+    }
+    NS_DURING
+        self = [self initWithSharedData:mappedData position:0];
+    NS_HANDLER
+        [mappedData release];
+        [localException raise];
+    NS_ENDHANDLER
+    [mappedData release];
+    [self setFilename:[filename lastPathComponent]];
+    
+    return self;
+}
+
+- (id) initWithContentsOfFile:(NSString *)filename atOffset:(off_t)offset length:(size_t)length
+{
+    // We don't provide a method to match the case where filename is NULL
+    // and filePtr (FILE *) is not NULL (both arguments are exclusive),
+    // because we generally don't manipulate FILE * types in Cocoa.
+    gpgme_data_t	aData;
+    gpgme_error_t	anError = gpgme_data_new_from_filepart(&aData, [filename fileSystemRepresentation], NULL, offset, length);
+
+    if(anError != GPG_ERR_NO_ERROR){
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    self = [self initWithInternalRepresentation:aData];
+    [self setFilename:[filename lastPathComponent]];
+
+    return self;
+}
+
+- (id) initWithSegments:(NSArray *)segments
+{
+    // Unlike gpgme_data_new_from_filepart(), file ranges are not read up
+    // front, but with pread() on demand; a file is opened only once.
+    _GPGSegmentList     *aList = [[_GPGSegmentList alloc] init];
+    NSMutableDictionary *fileHandlesByPath = [NSMutableDictionary dictionary];
+    NSEnumerator        *segmentEnum = [segments objectEnumerator];
+    id                  aSegment;
+    off_t               anEnd = 0;
+    
+    aList->segments = NSZoneMalloc([aList zone], ([segments count] > 0 ? [segments count] : 1) * sizeof(GPGDataSegment));
+    NS_DURING
+        while((aSegment = [segmentEnum nextObject]) != nil){
+            GPGDataSegment  *aDataSegment = &aList->segments[aList->count];
+            off_t           aLength;
+            
+            if([aSegment isKindOfClass:[NSData class]]){
+                aLength = [aSegment length];
+                if(aLength == 0)
+                    continue;
+                aDataSegment->data = [aSegment copy]; // Immutable data is not copied
+                aDataSegment->fileHandle = nil;
+                aDataSegment->fileOffset = 0;
+            }
+            else if([aSegment isKindOfClass:[NSDictionary class]] && [aSegment objectForKey:GPGDataSegmentPathKey] != nil){
+                NSString        *aPath = [aSegment objectForKey:GPGDataSegmentPathKey];
+                NSFileHandle    *aFileHandle = [fileHandlesByPath objectForKey:aPath];
+                NSNumber        *aNumber;
+                off_t           anOffset = 0;
+                struct stat     fileStat;
+                
+                if(aFileHandle == nil){
+                    aFileHandle = [NSFileHandle fileHandleForReadingAtPath:aPath];
+                    if(aFileHandle == nil)
+                        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, (errno != 0 ? errno : ENOENT)) userInfo:nil] raise];
+                    [fileHandlesByPath setObject:aFileHandle forKey:aPath];
+                }
+                if(fstat([aFileHandle fileDescriptor], &fileStat) != 0)
+                    [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+                aNumber = [aSegment objectForKey:GPGDataSegmentOffsetKey];
+                if(aNumber != nil)
+                    anOffset = [aNumber longLongValue];
+                aNumber = [aSegment objectForKey:GPGDataSegmentLengthKey];
+                aLength = (aNumber != nil ? [aNumber longLongValue] : fileStat.st_size - anOffset);
+                if(anOffset < 0 || aLength < 0 || anOffset + aLength > fileStat.st_size)
+                    [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorInvalidValue) userInfo:[NSDictionary dictionaryWithObject:@"Segment is out of file bounds" forKey:GPGAdditionalReasonKey]] raise];
+                if(aLength == 0)
+                    continue;
+                aDataSegment->data = nil;
+                aDataSegment->fileHandle = [aFileHandle retain];
+                aDataSegment->fileOffset = anOffset;
+            }
+            else
+                [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorInvalidValue) userInfo:[NSDictionary dictionaryWithObject:@"Invalid segment" forKey:GPGAdditionalReasonKey]] raise];
+            anEnd += aLength;
+            aDataSegment->end = anEnd;
+            aList->count++;
+        }
+    NS_HANDLER
+        [aList release];
+        [self release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    NS_DURING
+        self = [self initWithSegmentList:aList position:0];
+    NS_HANDLER
+        [aList release];
+        [localException raise];
+    NS_ENDHANDLER
+    [aList release];
+    
+    return self;
+}
+
+// We don't support gpgme_data_new_from_stream(), because it takes a FILE *,
+// and we generally don't manipulate FILE * types in Cocoa. NSStream instances
+// are supported through callbacks instead; the stream itself is passed as
+// callback handle, and gpgme's own transfer buffer is passed directly to the
+// stream, thus no intermediate buffer is needed.
+
+static int errnoFromStream(NSStream *stream)
+{
+    NSError	*anError = [stream streamError];
+
+    if(anError != nil && [[anError domain] isEqualToString:NSPOSIXErrorDomain] && [anError code] != 0)
+        return [anError code];
+    else
+        return EIO;
+}
+
+static ssize_t inputStreamReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    // Returns the number of bytes read, or -1 on error. Sets errno in case of error.
+    NSInteger	readLength = [(NSInputStream *)object read:destinationBuffer maxLength:destinationBufferSize];
+    
+    if(readLength < 0){
+        errno = errnoFromStream((NSStream *)object);
+        return -1;
+    }
+    
+    return readLength;
+}
+
+static ssize_t outputStreamWriteCallback(void *object, const void *buffer, size_t size)
+{
+    // Returns the number of bytes written, or -1 on error. Sets errno in case of error.
+    // NSOutputStream may accept less bytes than given; we loop until all bytes
+    // have been written, because gpgme expects it.
+    size_t	writtenLength = 0;
+    
+    while(writtenLength < size){
+        NSInteger	aLength = [(NSOutputStream *)object write:((const uint8_t *)buffer) + writtenLength maxLength:size - writtenLength];
+        
+        if(aLength <= 0){
+            if(writtenLength > 0)
+                break;
+            errno = (aLength == 0 ? ENOSPC : errnoFromStream((NSStream *)object));
+            return -1;
+        }
+        writtenLength += aLength;
+    }
+    
+    return writtenLength;
+}
+
+static off_t streamSeekCallback(void *object, off_t offset, int whence)
+{
+    // Returns the new position, or -1 on error. Sets errno in case of error.
+    // Only streams supporting the NSStreamFileCurrentOffsetKey property can be
+    // repositioned; end of stream is never known in advance.
+    NSNumber	*currentOffset = [(NSStream *)object propertyForKey:NSStreamFileCurrentOffsetKey];
+    off_t		newOffset;
+    
+    if(currentOffset == nil){
+        errno = ESPIPE;
+        return -1;
+    }
+    
+    switch(whence){
+        case SEEK_SET:
+            newOffset = offset;
+            break;
+        case SEEK_CUR:
+            newOffset = [currentOffset longLongValue] + offset;
+            break;
+        default:
+            errno = ESPIPE;
+            return -1;
+    }
+    if(newOffset < 0){
+        errno = EINVAL;
+        return -1;
+    }
+    if(newOffset != [currentOffset longLongValue] && ![(NSStream *)object setProperty:[NSNumber numberWithLongLong:newOffset] forKey:NSStreamFileCurrentOffsetKey]){
+        errno = ESPIPE;
+        return -1;
+    }
+    
+    return newOffset;
+}
+
+static struct gpgme_data_cbs	inputStreamCallbacks = {inputStreamReadCallback, NULL, streamSeekCallback, NULL};
+static struct gpgme_data_cbs	outputStreamCallbacks = {NULL, outputStreamWriteCallback, streamSeekCallback, NULL};
+
+- (id) initWithInputStream:(NSInputStream *)inputStream
+{
+    gpgme_data_t	aData;
+    gpgme_error_t	anError;
+    
+    NSParameterAssert(inputStream != nil);
+    
+    if([inputStream streamStatus] == NSStreamStatusNotOpen)
+        [inputStream open];
+    anError = gpgme_data_new_from_cbs(&aData, &inputStreamCallbacks, inputStream);
+
+    if(anError != GPG_ERR_NO_ERROR){
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    self = [self initWithInternalRepresentation:aData];
+    ((GPGData *)self)->_objectReference = [inputStream retain];
+    ((GPGData *)self)->_backingType = GPGDataUncopyableBacking;
+    
+    return self;
+}
+
+- (id) initWithOutputStream:(NSOutputStream *)outputStream
+{
+    gpgme_data_t	aData;
+    gpgme_error_t	anError;
+    
+    NSParameterAssert(outputStream != nil);
+    
+    if([outputStream streamStatus] == NSStreamStatusNotOpen)
+        [outputStream open];
+    anError = gpgme_data_new_from_cbs(&aData, &outputStreamCallbacks, outputStream);
+    
+    if(anError != GPG_ERR_NO_ERROR){
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    self = [self initWithInternalRepresentation:aData];
+    ((GPGData *)self)->_objectReference = [outputStream retain];
+    ((GPGData *)self)->_backingType = GPGDataUncopyableBacking;
+    
+    return self;
+}
+
+// Secure data objects keep their bytes in fixed-size blocks allocated by
+// GPGSecureBlockAllocate(), i.e. in locked memory, wiped when freed. As blocks
+// are never reallocated, growing the data never leaves copies of the bytes
+// behind. Blocks are zeroed on allocation, so unwritten bytes read as 0.
+
+typedef struct {
+    void    **blocks;
+    size_t  blockCount;
+    size_t  blockCapacity;
+    off_t   length;
+    off_t   position;
+} GPGSecureBuffer;
+
+static ssize_t secureBufferReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    // Returns the number of bytes read, or 0 on EOF.
+    GPGSecureBuffer *aBuffer = (GPGSecureBuffer *)object;
+    size_t          blockSize = GPGSecureBlockSize();
+    size_t          readLength = 0;
+    
+    if(aBuffer->position >= aBuffer->length)
+        return 0;
+    if((off_t)destinationBufferSize > aBuffer->length - aBuffer->position)
+        destinationBufferSize = (size_t)(aBuffer->length - aBuffer->position);
+    
+    while(readLength < destinationBufferSize){
+        size_t  blockIndex = (size_t)(aBuffer->position / blockSize);
+        size_t  blockOffset = (size_t)(aBuffer->position % blockSize);
+        size_t  aLength = MIN(blockSize - blockOffset, destinationBufferSize - readLength);
+        
+        memcpy((char *)destinationBuffer + readLength, (char *)aBuffer->blocks[blockIndex] + blockOffset, aLength);
+        readLength += aLength;
+        aBuffer->position += aLength;
+    }
+    
+    return readLength;
+}
+
+static ssize_t secureBufferWriteCallback(void *object, const void *buffer, size_t size)
+{
+    // Returns the number of bytes written, or -1 on error. Sets errno in case of error.
+    GPGSecureBuffer *aBuffer = (GPGSecureBuffer *)object;
+    size_t          blockSize = GPGSecureBlockSize();
+    size_t          neededBlockCount = (size_t)((aBuffer->position + size + blockSize - 1) / blockSize);
+    size_t          writtenLength = 0;
+    
+    if(neededBlockCount > aBuffer->blockCapacity){
+        size_t  newCapacity = MAX(neededBlockCount, aBuffer->blockCapacity * 2);
+        
+        aBuffer->blocks = NSZoneRealloc(NSDefaultMallocZone(), aBuffer->blocks, newCapacity * sizeof(void *));
+        aBuffer->blockCapacity = newCapacity;
+    }
+    while(aBuffer->blockCount < neededBlockCount){
+        void    *aBlock = GPGSecureBlockAllocate();
+        
+        if(aBlock == NULL){
+            errno = ENOMEM;
+            return -1;
+        }
+        aBuffer->blocks[aBuffer->blockCount++] = aBlock;
+    }
+    
+    while(writtenLength < size){
+        size_t  blockIndex = (size_t)(aBuffer->position / blockSize);
+        size_t  blockOffset = (size_t)(aBuffer->position % blockSize);
+        size_t  aLength = MIN(blockSize - blockOffset, size - writtenLength);
+        
+        memcpy((char *)aBuffer->blocks[blockIndex] + blockOffset, (const char *)buffer + writtenLength, aLength);
+        writtenLength += aLength;
+        aBuffer->position += aLength;
+    }
+    if(aBuffer->position > aBuffer->length)
+        aBuffer->length = aBuffer->position;
+    
+    return writtenLength;
 }
 
-static void releaseCallback(void *object)
+static off_t secureBufferSeekCallback(void *object, off_t offset, int whence)
 {
-    [((GPGData *)object)->_objectReference dataRelease:((GPGData *)object)];
+    // Returns the new position, or -1 on error. Sets errno in case of error.
+    GPGSecureBuffer *aBuffer = (GPGSecureBuffer *)object;
+    off_t           newPosition;
+    
+    switch(whence){
+        case SEEK_SET:
+            newPosition = offset;
+            break;
+        case SEEK_CUR:
+            newPosition = aBuffer->position + offset;
+            break;
+        case SEEK_END:
+            newPosition = aBuffer->length + offset;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+    if(newPosition < 0){
+        errno = EINVAL;
+        return -1;
+    }
+    aBuffer->position = newPosition;
+    
+    return newPosition;
 }
 
-- (id) initWithDataSource:(id)dataSource
+static void secureBufferReleaseCallback(void *object)
 {
-    gpgme_data_t		aData;
-    gpgme_error_t		anError;
-    gpgme_data_cbs_t	callbacks;
-
-    NSParameterAssert(dataSource != nil);
-
-    callbacks = (gpgme_data_cbs_t)NSZoneCalloc([self zone], 1, sizeof(struct gpgme_data_cbs));
-    if([dataSource respondsToSelector:@selector(data:readDataOfLength:)])
-        callbacks->read = readCallback;
-    if([dataSource respondsToSelector:@selector(data:writeData:)])
-        callbacks->write = writeCallback;
-    if([dataSource respondsToSelector:@selector(data:seekToFileOffset:offsetType:)])
-        callbacks->seek = seekCallback;
-    if([dataSource respondsToSelector:@selector(data:dataRelease:)])
-        callbacks->release = releaseCallback;
+    GPGSecureBuffer *aBuffer = (GPGSecureBuffer *)object;
+    size_t          i;
     
-    NSParameterAssert(callbacks->read != NULL || callbacks->write != NULL);
+    for(i = 0; i < aBuffer->blockCount; i++)
+        GPGSecureBlockFree(aBuffer->blocks[i]);
+    if(aBuffer->blocks != NULL)
+        NSZoneFree(NSDefaultMallocZone(), aBuffer->blocks);
+    NSZoneFree(NSDefaultMallocZone(), aBuffer);
+}
 
-    anError = gpgme_data_new_from_cbs(&aData, callbacks, self);
+static struct gpgme_data_cbs	secureBufferCallbacks = {secureBufferReadCallback, secureBufferWriteCallback, secureBufferSeekCallback, secureBufferReleaseCallback};
 
-    if(anError != GPG_ERR_NO_ERROR){
-        NSZoneFree([self zone], callbacks);
-        [self release];
-        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
-    }
-    NSAssert(self == [self initWithInternalRepresentation:aData], @"Tried to change self! Impossible due to callback registration.");
-    _objectReference = dataSource; // We don't retain dataSource
-    _callbacks = callbacks;
+gpgme_error_t GPGSecureDataNew(gpgme_data_t *dataPtr)
+{
+    GPGSecureBuffer *aBuffer = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(GPGSecureBuffer));
+    gpgme_error_t   anError = gpgme_data_new_from_cbs(dataPtr, &secureBufferCallbacks, aBuffer);
     
-    return self;
+    if(anError != GPG_ERR_NO_ERROR)
+        NSZoneFree(NSDefaultMallocZone(), aBuffer);
+    
+    return anError;
 }
 
-- (id) initWithContentsOfFile:(NSString *)filename
+- (id) initWithSecureMemory
 {
     gpgme_data_t	aData;
-    gpgme_error_t	anError = gpgme_data_new_from_file(&aData, [filename fileSystemRepresentation], 1);
-
+    gpgme_error_t	anError = GPGSecureDataNew(&aData);
+    
     if(anError != GPG_ERR_NO_ERROR){
         [self release];
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     }
     self = [self initWithInternalRepresentation:aData];
-    [self setFilename:[filename lastPathComponent]];
+    ((GPGData *)self)->_backingType = GPGDataSecureMemoryBacking;
     
     return self;
 }
 
-- (id) initWithContentsOfFileNoCopy:(NSString *)filename
-#warning Not yet supported as of 1.1.x
-// Can raise a GPGException; in this case, a release is sent to self
+- (id) initWithFileHandle:(NSFileHandle *)fileHandle
 {
     gpgme_data_t	aData;
-    gpgme_error_t	anError = gpgme_data_new_from_file(&aData, [filename fileSystemRepresentation], 0);
+    gpgme_error_t	anError = gpgme_data_new_from_fd(&aData, [fileHandle fileDescriptor]);
 
     if(anError != GPG_ERR_NO_ERROR){
         [self release];
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     }
     self = [self initWithInternalRepresentation:aData];
-    [self setFilename:[filename lastPathComponent]];
-    
+    ((GPGData *)self)->_objectReference = [fileHandle retain];
+    ((GPGData *)self)->_backingType = GPGDataFileDescriptorBacking;
+
     return self;
 }
 
-- (id) initWithContentsOfFile:(NSString *)filename atOffset:(off_t)offset length:(size_t)length
+- (id) initWithFileHandle:(NSFileHandle *)fileHandle position:(off_t)position
 {
-    // We don't provide a method to match the case where filename is NULL
-    // and filePtr (FILE *) is not NULL (both arguments are exclusive),
-    // because we generally don't manipulate FILE * types in Cocoa.
+    _GPGFileCursor  *aCursor = [[_GPGFileCursor alloc] init];
     gpgme_data_t	aData;
-    gpgme_error_t	anError = gpgme_data_new_from_filepart(&aData, [filename fileSystemRepresentation], NULL, offset, length);
-
+    gpgme_error_t	anError = gpgme_data_new_from_cbs(&aData, &fileCursorCallbacks, aCursor);
+    
     if(anError != GPG_ERR_NO_ERROR){
+        [aCursor release];
         [self release];
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     }
+    aCursor->fileHandle = [fileHandle retain];
+    aCursor->position = position;
     self = [self initWithInternalRepresentation:aData];
-    [self setFilename:[filename lastPathComponent]];
-
+    ((GPGData *)self)->_objectReference = aCursor;
+    ((GPGData *)self)->_backingType = GPGDataFileDescriptorBacking;
+    
     return self;
 }
 
-// We don't support gpgme_data_new_from_stream(), because there is
-// no STREAM handling in Cocoa, yet(?).
-// Maybe in Panther with NSStream?
-
-- (id) initWithFileHandle:(NSFileHandle *)fileHandle
+- (id) initWithSegmentList:(_GPGSegmentList *)segmentList position:(off_t)position
 {
-    gpgme_data_t	aData;
-    gpgme_error_t	anError = gpgme_data_new_from_fd(&aData, [fileHandle fileDescriptor]);
-
+    _GPGSegmentCursor   *aCursor = [[_GPGSegmentCursor alloc] init];
+    gpgme_data_t        aData;
+    gpgme_error_t       anError = gpgme_data_new_from_cbs(&aData, &segmentCursorCallbacks, aCursor);
+    
     if(anError != GPG_ERR_NO_ERROR){
+        [aCursor release];
         [self release];
         [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
     }
+    aCursor->segmentList = [segmentList retain];
+    aCursor->position = position;
     self = [self initWithInternalRepresentation:aData];
-    ((GPGData *)self)->_objectReference = [fileHandle retain];
-
+    ((GPGData *)self)->_objectReference = aCursor;
+    ((GPGData *)self)->_backingType = GPGDataSegmentsBacking;
+    
     return self;
 }
 
@@ -300,44 +1104,124 @@ static void releaseCallback(void *object)
         gpgme_data_release(cachedData);
 }
 
-#if 0
+- (NSData *) copyMemoryBytes
+{
+    // Bytes of memory data are read into a new buffer, without modifying
+    // the receiver: its gpgme data and position are left untouched.
+    // Returned data is retained.
+    off_t           aPosition = gpgme_data_seek(_data, 0, GPGDataCurrentPosition);
+    NSMutableData   *readData;
+    char            aBuffer[4096];
+    ssize_t         aLength;
+    int             anErrno = 0;
+    
+    if(aPosition < 0 || gpgme_data_seek(_data, 0, GPGDataStartPosition) < 0)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+    readData = [[NSMutableData alloc] init];
+    while((aLength = gpgme_data_read(_data, aBuffer, sizeof(aBuffer))) > 0)
+        [readData appendBytes:aBuffer length:aLength];
+    if(aLength < 0)
+        anErrno = errno;
+    (void)gpgme_data_seek(_data, aPosition, GPGDataStartPosition);
+    if(anErrno != 0){
+        [readData release];
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, anErrno) userInfo:nil] raise];
+    }
+    
+    return readData;
+}
+
+- (void) copySecureBytesToData:(GPGData *)aCopy
+{
+    // Bytes are transferred through a block of secure memory
+    gpgme_data_t    copiedData = [aCopy gpgmeData];
+    off_t           aPosition = gpgme_data_seek(_data, 0, GPGDataCurrentPosition);
+    size_t          blockSize = GPGSecureBlockSize();
+    char            *aBlock;
+    ssize_t         aLength;
+    int             anErrno = 0;
+    
+    if(aPosition < 0 || gpgme_data_seek(_data, 0, GPGDataStartPosition) < 0)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+    aBlock = GPGSecureBlockAllocate();
+    if(aBlock == NULL)
+        anErrno = ENOMEM;
+    else{
+        while((aLength = gpgme_data_read(_data, aBlock, blockSize)) > 0){
+            if(gpgme_data_write(copiedData, aBlock, aLength) != aLength){
+                anErrno = errno;
+                break;
+            }
+        }
+        if(aLength < 0)
+            anErrno = errno;
+        GPGSecureBlockFree(aBlock);
+    }
+    (void)gpgme_data_seek(_data, aPosition, GPGDataStartPosition);
+    (void)gpgme_data_seek(copiedData, aPosition, GPGDataStartPosition);
+    if(anErrno != 0)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, anErrno) userInfo:nil] raise];
+}
+
 - (id) copyWithZone:(NSZone *)zone
 {
     GPGData	*aCopy = nil;
     
-    switch([self type]){
-        case GPGDataTypeNone:
-            aCopy = [[[self class] allocWithZone:zone] init];
+    switch(_backingType){
+        case GPGDataMemoryBacking:{
+            // Copy gets its own buffer; receiver is not modified
+            NSData  *readData = [self copyMemoryBytes];
+            off_t   aPosition = gpgme_data_seek(_data, 0, GPGDataCurrentPosition);
+            
+            NS_DURING
+                aCopy = [[[self class] allocWithZone:zone] initWithSharedData:readData position:aPosition];
+            NS_HANDLER
+                [readData release];
+                [localException raise];
+            NS_ENDHANDLER
+            [readData release];
             break;
-        case GPGDataTypeData:
-            if(_retainedData != nil){
-                NSMutableData	*copiedData = [_retainedData mutableCopyWithZone:zone];
-                
-                aCopy = [[[self class] allocWithZone:zone] initWithDataNoCopy:copiedData];
-                [copiedData release];
-            }
-            else
-                aCopy = [[[self class] allocWithZone:zone] initWithData:[self data]]; // WARNING: this rewinds myself and reads until EOF!
+        }
+        case GPGDataSharedMemoryBacking:{
+            _GPGSharedBuffer    *aBuffer = (_GPGSharedBuffer *)_objectReference;
+            
+            aCopy = [[[self class] allocWithZone:zone] initWithSharedData:[aBuffer frozenData] position:aBuffer->position];
             break;
-        case GPGDataTypeFileHandle:
-            // We don't provide a way in GPGME to create such data types
-            [NSException raise:NSInternalInconsistencyException format:@"### Unsupported GPGData type %d", [self type]];
+        }
+        case GPGDataFileDescriptorBacking:{
+            off_t   aPosition = gpgme_data_seek(_data, 0, GPGDataCurrentPosition);
+            
+            if(aPosition < 0)
+                [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+            if([_objectReference isKindOfClass:[NSFileHandle class]])
+                aCopy = [[[self class] allocWithZone:zone] initWithFileHandle:_objectReference position:aPosition];
+            else
+                aCopy = [[[self class] allocWithZone:zone] initWithFileHandle:((_GPGFileCursor *)_objectReference)->fileHandle position:aPosition];
             break;
-        case GPGDataTypeFile:
-            // There is no way to know which inititializer was called!
-            [NSException raise:NSInternalInconsistencyException format:@"### Unsupported GPGData type %d", [self type]];
+        }
+        case GPGDataSegmentsBacking:{
+            _GPGSegmentCursor   *aCursor = (_GPGSegmentCursor *)_objectReference;
+            
+            aCopy = [[[self class] allocWithZone:zone] initWithSegmentList:aCursor->segmentList position:aCursor->position];
             break;
-        case GPGDataTypeDataSource:
-            aCopy = [[[self class] allocWithZone:zone] initWithDataSource:_dataSource];
-            [aCopy rewind]; // This also rewinds myself!
+        }
+        case GPGDataSecureMemoryBacking:
+            aCopy = [[[self class] allocWithZone:zone] initWithSecureMemory];
+            NS_DURING
+                [self copySecureBytesToData:aCopy];
+            NS_HANDLER
+                [aCopy release];
+                [localException raise];
+            NS_ENDHANDLER
             break;
         default:
-            [NSException raise:NSInternalInconsistencyException format:@"### Unknown GPGData type %d", [self type]];
+            [NSException raise:NSInternalInconsistencyException format:@"### Data based on a data source, a stream or a pipe cannot be copied"];
     }
+    [aCopy setFilename:[self filename]];
+    [aCopy setEncoding:[self encoding]];
     
     return aCopy;
 }
-#endif
 
 - (GPGDataEncoding) encoding
 {
@@ -407,6 +1291,354 @@ static void releaseCallback(void *object)
 @end
 
 
+// Radix-64 (base64) and CRC-24 kernels used by armoring (RFC 4880, 6.).
+// Scalar code is table driven; when compiled with SSSE3 (default for x86_64),
+// 12 bytes are encoded into 16 characters, and 16 characters decoded into 12
+// bytes, per iteration, using PSHUFB as a 16-entry lookup table.
+
+#define GPGArmorLineLength          64 // Characters; 48 bytes
+#define GPGArmorCRC24Init           0xB704CEL
+#define GPGArmorCRC24Polynomial     0x1864CFBL
+
+static const char   radix64Alphabet[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static uint8_t      radix64Values[256];     // 0xFF for invalid characters
+static uint32_t     crc24Tables[8][256];   // Slicing-by-8; CRC is kept in upper 24 bits
+static pthread_once_t   armorTablesOnce = PTHREAD_ONCE_INIT;
+
+static void initArmorTables(void)
+{
+    int i;
+    
+    memset(radix64Values, 0xFF, sizeof(radix64Values));
+    for(i = 0; i < 64; i++)
+        radix64Values[(uint8_t)radix64Alphabet[i]] = i;
+    
+    for(i = 0; i < 256; i++){
+        uint32_t    aCRC = (uint32_t)i << 24;
+        int         j;
+        
+        for(j = 0; j < 8; j++)
+            aCRC = (aCRC << 1) ^ ((aCRC & 0x80000000) ? (GPGArmorCRC24Polynomial << 8) : 0);
+        crc24Tables[0][i] = aCRC;
+    }
+    for(i = 0; i < 256; i++){
+        int j;
+        
+        for(j = 1; j < 8; j++)
+            crc24Tables[j][i] = (crc24Tables[j - 1][i] << 8) ^ crc24Tables[0][crc24Tables[j - 1][i] >> 24];
+    }
+}
+
+static uint32_t updateCRC24(uint32_t aCRC, const uint8_t *bytes, size_t length)
+{
+    // Processes 8 bytes per iteration (slicing-by-8)
+    uint32_t    aRegister = aCRC << 8;
+    
+    while(length >= 8){
+        uint32_t    firstWord = aRegister ^ (((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3]);
+        
+        aRegister = crc24Tables[7][firstWord >> 24] ^ crc24Tables[6][(firstWord >> 16) & 0xFF] ^ crc24Tables[5][(firstWord >> 8) & 0xFF] ^ crc24Tables[4][firstWord & 0xFF]
+                  ^ crc24Tables[3][bytes[4]] ^ crc24Tables[2][bytes[5]] ^ crc24Tables[1][bytes[6]] ^ crc24Tables[0][bytes[7]];
+        bytes += 8;
+        length -= 8;
+    }
+    while(length-- > 0)
+        aRegister = (aRegister << 8) ^ crc24Tables[0][(aRegister >> 24) ^ *bytes++];
+    
+    return aRegister >> 8;
+}
+
+#ifdef __SSSE3__
+static inline __m128i encodeRadix64Vector(const uint8_t *source)
+{
+    // Loads 16 bytes, but uses only the first 12 ones
+    __m128i input = _mm_loadu_si128((const __m128i *)source);
+    __m128i indices, result, less;
+    
+    // Splits 3 bytes into 4 sextets, in 4 lanes of 32 bits
+    input = _mm_shuffle_epi8(input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    indices = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040)),
+                           _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010)));
+    
+    // Maps sextets to characters, by adding an offset which depends on range:
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    result = _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0), result);
+    
+    return _mm_add_epi8(result, indices);
+}
+
+static inline int decodeRadix64Vector(const char *source, uint8_t *destination)
+{
+    // Decodes 16 characters into 12 bytes, but stores 16 bytes.
+    // Returns 0 if some characters are invalid; nothing is stored then.
+    __m128i input = _mm_loadu_si128((const __m128i *)source);
+    __m128i higherNibbles = _mm_and_si128(_mm_srli_epi32(input, 4), _mm_set1_epi8(0x0F));
+    __m128i lowerNibbles = _mm_and_si128(input, _mm_set1_epi8(0x0F));
+    // For each lower nibble, bit set for each valid higher nibble
+    __m128i validHigherNibbles = _mm_shuffle_epi8(_mm_setr_epi8(0xA8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF0, 0x54, 0x50, 0x50, 0x50, 0x54), lowerNibbles);
+    __m128i higherNibbleBits = _mm_shuffle_epi8(_mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0, 0, 0, 0, 0, 0, 0, 0), higherNibbles);
+    __m128i shift, values;
+    
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(validHigherNibbles, higherNibbleBits), _mm_setzero_si128())) != 0)
+        return 0;
+    
+    // Offset to add depends on higher nibble, except for '/'
+    shift = _mm_shuffle_epi8(_mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0), higherNibbles);
+    shift = _mm_add_epi8(shift, _mm_and_si128(_mm_cmpeq_epi8(input, _mm_set1_epi8('/')), _mm_set1_epi8(-3)));
+    values = _mm_add_epi8(input, shift);
+    
+    // Packs 4 sextets into 3 bytes, in each lane of 32 bits
+    values = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    values = _mm_madd_epi16(values, _mm_set1_epi32(0x00011000));
+    values = _mm_shuffle_epi8(values, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i *)destination, values);
+    
+    return 1;
+}
+#endif
+
+static char *encodeRadix64Line(const uint8_t *source, size_t length, const uint8_t *sourceEnd, char *destination)
+{
+    // Encodes length bytes (a multiple of 3, but for last line) and returns
+    // end of encoded characters, padding included. sourceEnd tells how many
+    // bytes can be read past length.
+#ifdef __SSSE3__
+    while(length >= 12 && source + 16 <= sourceEnd){
+        _mm_storeu_si128((__m128i *)destination, encodeRadix64Vector(source));
+        source += 12;
+        length -= 12;
+        destination += 16;
+    }
+#endif
+    while(length >= 3){
+        uint32_t    aTriplet = (source[0] << 16) | (source[1] << 8) | source[2];
+        
+        destination[0] = radix64Alphabet[aTriplet >> 18];
+        destination[1] = radix64Alphabet[(aTriplet >> 12) & 0x3F];
+        destination[2] = radix64Alphabet[(aTriplet >> 6) & 0x3F];
+        destination[3] = radix64Alphabet[aTriplet & 0x3F];
+        source += 3;
+        length -= 3;
+        destination += 4;
+    }
+    if(length > 0){
+        uint32_t    aTriplet = (source[0] << 16) | (length > 1 ? source[1] << 8 : 0);
+        
+        destination[0] = radix64Alphabet[aTriplet >> 18];
+        destination[1] = radix64Alphabet[(aTriplet >> 12) & 0x3F];
+        destination[2] = (length > 1 ? radix64Alphabet[(aTriplet >> 6) & 0x3F] : '=');
+        destination[3] = '=';
+        destination += 4;
+    }
+    
+    return destination;
+}
+
+typedef struct {
+    uint32_t    accumulator;
+    int         sextetCount;
+} GPGRadix64Decoder;
+
+static uint8_t *decodeRadix64Characters(GPGRadix64Decoder *aDecoder, const char *source, size_t length, uint8_t *destination)
+{
+    // Decodes characters, without padding; returns end of decoded bytes,
+    // or NULL if a character is invalid. Destination must have 4 more bytes
+    // than needed.
+#ifdef __SSSE3__
+    if(aDecoder->sextetCount == 0){
+        while(length >= 16 && decodeRadix64Vector(source, destination)){
+            source += 16;
+            length -= 16;
+            destination += 12;
+        }
+    }
+#endif
+    while(length-- > 0){
+        uint8_t aValue = radix64Values[(uint8_t)*source++];
+        
+        if(aValue == 0xFF)
+            return NULL;
+        aDecoder->accumulator = (aDecoder->accumulator << 6) | aValue;
+        if(++aDecoder->sextetCount == 4){
+            destination[0] = aDecoder->accumulator >> 16;
+            destination[1] = aDecoder->accumulator >> 8;
+            destination[2] = aDecoder->accumulator;
+            destination += 3;
+            aDecoder->accumulator = 0;
+            aDecoder->sextetCount = 0;
+        }
+    }
+    
+    return destination;
+}
+
+static uint8_t *finishRadix64Decoding(GPGRadix64Decoder *aDecoder, uint8_t *destination)
+{
+    // Flushes last incomplete quantum (padded with '='); returns NULL if invalid
+    switch(aDecoder->sextetCount){
+        case 0:
+            break;
+        case 2:
+            *destination++ = aDecoder->accumulator >> 4;
+            break;
+        case 3:
+            *destination++ = aDecoder->accumulator >> 10;
+            *destination++ = aDecoder->accumulator >> 2;
+            break;
+        default:
+            return NULL;
+    }
+    aDecoder->accumulator = 0;
+    aDecoder->sextetCount = 0;
+    
+    return destination;
+}
+
+static size_t armoredLengthUpperBound(size_t length, size_t labelLength)
+{
+    // BEGIN and END lines, empty line, body lines, checksum line, and 16 bytes
+    // for vector stores
+    return 2 * (labelLength + 16) + 1 + ((length + 47) / 48) * (GPGArmorLineLength + 1) + 6 + 16;
+}
+
+static size_t armorBytes(const uint8_t *bytes, size_t length, const char *label, char *destination)
+{
+    // Returns number of characters written
+    const uint8_t   *bytesEnd = bytes + length;
+    char            *aPtr = destination;
+    uint32_t        aCRC = GPGArmorCRC24Init;
+    uint8_t         crcBytes[3];
+    
+    aPtr += sprintf(aPtr, "-----BEGIN %s-----\n\n", label);
+    while(bytes < bytesEnd){
+        size_t  lineByteCount = MIN((size_t)(bytesEnd - bytes), (size_t)48);
+        
+        aCRC = updateCRC24(aCRC, bytes, lineByteCount);
+        aPtr = encodeRadix64Line(bytes, lineByteCount, bytesEnd, aPtr);
+        *aPtr++ = '\n';
+        bytes += lineByteCount;
+    }
+    crcBytes[0] = aCRC >> 16;
+    crcBytes[1] = aCRC >> 8;
+    crcBytes[2] = aCRC;
+    *aPtr++ = '=';
+    aPtr = encodeRadix64Line(crcBytes, 3, crcBytes + 3, aPtr);
+    aPtr += sprintf(aPtr, "\n-----END %s-----\n", label);
+    
+    return aPtr - destination;
+}
+
+static const char *nextArmorLine(const char *characters, const char *charactersEnd, size_t *lineLengthPtr, const char **nextLinePtr)
+{
+    // Returns NULL if there is no more line; trailing white spaces are ignored
+    const char  *lineEnd;
+    
+    if(characters >= charactersEnd)
+        return NULL;
+    lineEnd = memchr(characters, '\n', charactersEnd - characters);
+    if(lineEnd == NULL)
+        lineEnd = charactersEnd;
+    *nextLinePtr = (lineEnd < charactersEnd ? lineEnd + 1 : charactersEnd);
+    while(lineEnd > characters && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+        lineEnd--;
+    *lineLengthPtr = lineEnd - characters;
+    
+    return characters;
+}
+
+#define isArmorLine(line, lineLength, prefix)   ((lineLength) >= sizeof(prefix) - 1 && memcmp((line), (prefix), sizeof(prefix) - 1) == 0)
+
+static size_t dearmoredLengthUpperBound(size_t length)
+{
+    return (length / 4) * 3 + 16;
+}
+
+static GPGError dearmorCharacters(const char *characters, size_t length, uint8_t *destination, size_t *decodedLengthPtr)
+{
+    // Returns GPGErrorNoError, GPGErrorInvalidArmor or GPGErrorChecksumError.
+    // destination must be able to contain dearmoredLengthUpperBound(length) bytes.
+    const char          *charactersEnd = characters + length;
+    const char          *aLine, *nextLine = characters;
+    size_t              aLineLength;
+    uint8_t             *aPtr = destination;
+    GPGRadix64Decoder   aDecoder = {0, 0};
+    uint32_t            aCRC = GPGArmorCRC24Init;
+    int                 expectedCRC = -1;
+    int                 hasPadding = 0;     // Number of '=' padding characters seen in body
+    BOOL                hasChecksum = NO;
+    
+    // BEGIN line; cleartext signatures are not supported
+    do{
+        aLine = nextArmorLine(nextLine, charactersEnd, &aLineLength, &nextLine);
+        if(aLine == NULL)
+            return GPGErrorInvalidArmor;
+    }while(!isArmorLine(aLine, aLineLength, "-----BEGIN ") || aLineLength < 16 || memcmp(aLine + aLineLength - 5, "-----", 5) != 0);
+    if(isArmorLine(aLine, aLineLength, "-----BEGIN PGP SIGNED MESSAGE"))
+        return GPGErrorInvalidArmor;
+    
+    // Armor headers, ended by an empty line. Be lenient when empty line is
+    // missing, like gpg.
+    while((aLine = nextArmorLine(nextLine, charactersEnd, &aLineLength, &nextLine)) != NULL && aLineLength > 0 && memchr(aLine, ':', aLineLength) != NULL)
+        ;
+    if(aLine != NULL && aLineLength == 0)
+        aLine = nextArmorLine(nextLine, charactersEnd, &aLineLength, &nextLine);
+    
+    // Body, then optional checksum line, then END line
+    for(; aLine != NULL; aLine = nextArmorLine(nextLine, charactersEnd, &aLineLength, &nextLine)){
+        uint8_t *lineBytes = aPtr;
+        
+        if(isArmorLine(aLine, aLineLength, "-----"))
+            break;
+        if(aLine[0] == '=' || hasPadding || hasChecksum){
+            // Only the checksum line may follow a padded line, and nothing
+            // may follow the checksum line. Checksum does not imply that
+            // body was padded: last quantum is flushed after END line.
+            GPGRadix64Decoder   aCRCDecoder = {0, 0};
+            uint8_t             crcBytes[3 + 16];
+            
+            if(aLine[0] != '=' || aLineLength != 5 || hasChecksum || decodeRadix64Characters(&aCRCDecoder, aLine + 1, 4, crcBytes) == NULL)
+                return GPGErrorInvalidArmor;
+            expectedCRC = (crcBytes[0] << 16) | (crcBytes[1] << 8) | crcBytes[2];
+            hasChecksum = YES;
+            continue;
+        }
+        while(aLineLength > 0 && aLine[aLineLength - 1] == '='){
+            aLineLength--;
+            hasPadding++;
+        }
+        if(hasPadding > 2)
+            return GPGErrorInvalidArmor;
+        aPtr = decodeRadix64Characters(&aDecoder, aLine, aLineLength, aPtr);
+        if(aPtr == NULL)
+            return GPGErrorInvalidArmor;
+        if(hasPadding){
+            aPtr = finishRadix64Decoding(&aDecoder, aPtr);
+            if(aPtr == NULL)
+                return GPGErrorInvalidArmor;
+        }
+        aCRC = updateCRC24(aCRC, lineBytes, aPtr - lineBytes);
+    }
+    if(aLine == NULL || !isArmorLine(aLine, aLineLength, "-----END "))
+        return GPGErrorInvalidArmor;
+    if(!hasPadding){
+        uint8_t *lineBytes = aPtr;
+        
+        aPtr = finishRadix64Decoding(&aDecoder, aPtr);
+        if(aPtr == NULL)
+            return GPGErrorInvalidArmor;
+        aCRC = updateCRC24(aCRC, lineBytes, aPtr - lineBytes);
+    }
+    if(expectedCRC >= 0 && (uint32_t)expectedCRC != aCRC)
+        return GPGErrorChecksumError;
+    *decodedLengthPtr = aPtr - destination;
+    
+    return GPGErrorNoError;
+}
+
+
 @implementation GPGData(GPGExtensions)
 
 - (id) initWithString:(NSString *)string
@@ -502,6 +1734,18 @@ static void releaseCallback(void *object)
 
 - (NSData *) data
 {
+    if(_backingType == GPGDataSharedMemoryBacking){
+        // No need to copy bytes; they will be copied on next write
+        _GPGSharedBuffer    *aBuffer = (_GPGSharedBuffer *)_objectReference;
+        NSData              *someData = [aBuffer frozenData];
+        
+        if(someData == nil)
+            return [NSData data];
+        aBuffer->position = [someData length];
+        
+        return [[someData retain] autorelease];
+    }
+    
     [self rewind];
 
     return [self availableData];
@@ -515,6 +1759,95 @@ static void releaseCallback(void *object)
         [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
 }
 
+static GPGData *newArmoredData(NSData *someData, NSString *label)
+{
+    const char  *aLabel = [label UTF8String];
+    char        *aBuffer;
+    size_t      aLength;
+    NSData      *armoredBytes;
+    GPGData     *armoredData;
+    
+    pthread_once(&armorTablesOnce, initArmorTables);
+    aBuffer = malloc(armoredLengthUpperBound([someData length], strlen(aLabel)));
+    if(aBuffer == NULL)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+    aLength = armorBytes([someData bytes], [someData length], aLabel, aBuffer);
+    armoredBytes = [[NSData alloc] initWithBytesNoCopy:aBuffer length:aLength freeWhenDone:YES];
+    NS_DURING
+        armoredData = [[GPGData alloc] initWithSharedData:armoredBytes position:0];
+    NS_HANDLER
+        [armoredBytes release];
+        [localException raise];
+    NS_ENDHANDLER
+    [armoredBytes release];
+    [armoredData setEncoding:GPGDataEncodingArmor];
+    
+    return armoredData;
+}
+
+- (GPGData *) armoredData
+{
+    // Label depends on the tag of the first packet (RFC 4880, 4.2.)
+    NSData      *someData = [self data];
+    NSString    *aLabel = @"PGP ARMORED FILE";
+    
+    if([someData length] > 0 && (((const uint8_t *)[someData bytes])[0] & 0x80)){
+        uint8_t aHeader = ((const uint8_t *)[someData bytes])[0];
+        int     aTag = ((aHeader & 0x40) ? (aHeader & 0x3F) : ((aHeader >> 2) & 0x0F));
+        
+        switch(aTag){
+            case 2:
+                aLabel = @"PGP SIGNATURE"; break;
+            case 5:
+                aLabel = @"PGP PRIVATE KEY BLOCK"; break;
+            case 6:
+                aLabel = @"PGP PUBLIC KEY BLOCK"; break;
+            default:
+                aLabel = @"PGP MESSAGE";
+        }
+    }
+    
+    return [newArmoredData(someData, aLabel) autorelease];
+}
+
+- (GPGData *) armoredDataWithLabel:(NSString *)label
+{
+    NSParameterAssert(label != nil);
+    
+    return [newArmoredData([self data], label) autorelease];
+}
+
+- (GPGData *) dearmoredData
+{
+    NSData      *someData = [self data];
+    uint8_t     *aBuffer;
+    size_t      aLength = 0;
+    GPGError    anError;
+    NSData      *dearmoredBytes;
+    GPGData     *dearmoredData;
+    
+    pthread_once(&armorTablesOnce, initArmorTables);
+    aBuffer = malloc(dearmoredLengthUpperBound([someData length]));
+    if(aBuffer == NULL)
+        [[NSException exceptionWithGPGError:gpgme_err_make_from_errno(GPG_MacGPGMEFrameworkErrorSource, errno) userInfo:nil] raise];
+    anError = dearmorCharacters([someData bytes], [someData length], aBuffer, &aLength);
+    if(anError != GPGErrorNoError){
+        free(aBuffer);
+        [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, anError) userInfo:nil] raise];
+    }
+    dearmoredBytes = [[NSData alloc] initWithBytesNoCopy:aBuffer length:aLength freeWhenDone:YES];
+    NS_DURING
+        dearmoredData = [[GPGData alloc] initWithSharedData:dearmoredBytes position:0];
+    NS_HANDLER
+        [dearmoredBytes release];
+        [localException raise];
+    NS_ENDHANDLER
+    [dearmoredBytes release];
+    [dearmoredData setEncoding:GPGDataEncodingBinary];
+    
+    return [dearmoredData autorelease];
+}
+
 @end
 
 
@@ -525,4 +1858,9 @@ static void releaseCallback(void *object)
     return _data;
 }
 
+- (void) setBackingType:(GPGDataBackingType)backingType
+{
+    _backingType = backingType;
+}
+
 @end
@@ -0,0 +1,167 @@
+//
+//  GPGDataPipe.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGDATAPIPE_H
+#define GPGDATAPIPE_H
+
+#include <Foundation/Foundation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+@class GPGData;
+
+
+/*!
+ *  @class      GPGDataPipe
+ *  @abstract   One-way channel between two operations, with bounded memory.
+ *  @discussion A <code>GPGDataPipe</code> object provides a pair of
+ *              <code>@link //macgpg/occ/cl/GPGData GPGData@/link</code> objects:
+ *              bytes written by an operation into <code>@link dataForWriting dataForWriting@/link</code>
+ *              can be read by another operation from <code>@link dataForReading dataForReading@/link</code>.
+ *              Bytes go through a ring buffer of fixed capacity; a writer
+ *              blocks while the buffer is full, a reader blocks while it is
+ *              empty, thus the operations are meant to be run in two different
+ *              threads, using two different contexts. For example, to decrypt
+ *              some data and re-encrypt it for other recipients without ever
+ *              holding the whole plaintext in memory:
+ *
+ *<pre>
+ *  // In thread A
+ *  NS_DURING
+ *      [decryptionContext decryptData:cipher toData:[pipe dataForWriting]];
+ *  NS_HANDLER
+ *      // ...
+ *  NS_ENDHANDLER
+ *  [pipe closeDataForWriting];
+ *
+ *  // In thread B
+ *  NS_DURING
+ *      [encryptionContext encryptData:[pipe dataForReading] withKeys:keys trustAllKeys:NO toData:newCipher];
+ *  NS_HANDLER
+ *      // ...
+ *  NS_ENDHANDLER
+ *  [pipe closeDataForReading];
+ *</pre>
+ *
+ *              The producing side must always invoke
+ *              <code>@link closeDataForWriting closeDataForWriting@/link</code>
+ *              once it is done, successfully or not, else the consumer would
+ *              wait forever for more bytes; similarly, the consuming side
+ *              should invoke <code>@link closeDataForReading closeDataForReading@/link</code>
+ *              when it stops reading, so that the producer gets a write error
+ *              instead of blocking on a full buffer. Both sides are closed
+ *              automatically when their data objects are deallocated.
+ *
+ *              Pipe data objects cannot be repositioned: methods relying on
+ *              <code>@link //macgpg/occ/instm/GPGData/seekToFileOffset:offsetType: seekToFileOffset:offsetType:@/link</code>
+ *              or <code>@link //macgpg/occ/instm/GPGData/rewind rewind@/link</code>
+ *              raise an exception. There must be one single reader and one
+ *              single writer.
+ */
+@interface GPGDataPipe : NSObject
+{
+    void    *_ring;
+    GPGData *_dataForReading;
+    GPGData *_dataForWriting;
+}
+
+/*!
+ *  @method     pipe
+ *  @abstract   Returns a new autoreleased pipe, with the default capacity.
+ */
++ (id) pipe;
+
+/*!
+ *  @method     init
+ *  @abstract   Initializes a pipe with the default capacity (64 KB).
+ */
+- (id) init;
+
+/*!
+ *  @method     initWithCapacity:
+ *  @abstract   Designated initializer. Initializes a pipe which can buffer at
+ *              most <i>capacity</i> bytes.
+ *  @discussion Raises an <code>NSInvalidArgumentException</code> if 
+ *              <i>capacity</i> is 0.
+ *  @param      capacity Size of the ring buffer, in bytes
+ */
+- (id) initWithCapacity:(size_t)capacity;
+
+/*!
+ *  @method     capacity
+ *  @abstract   Returns the size of the ring buffer, in bytes.
+ */
+- (size_t) capacity;
+
+/*!
+ *  @method     dataForReading
+ *  @abstract   Returns the <code>@link //macgpg/occ/cl/GPGData GPGData@/link</code>
+ *              object from which bytes written to the pipe can be read.
+ *  @discussion Reading blocks until some bytes are available, or the writing
+ *              end has been closed, in which case end of data is reached.
+ */
+- (GPGData *) dataForReading;
+
+/*!
+ *  @method     dataForWriting
+ *  @abstract   Returns the <code>@link //macgpg/occ/cl/GPGData GPGData@/link</code>
+ *              object to which bytes can be written.
+ *  @discussion Writing blocks until all bytes have been put into the ring
+ *              buffer. Writing fails (with <code>EPIPE</code> error) once the
+ *              reading end has been closed.
+ */
+- (GPGData *) dataForWriting;
+
+/*!
+ *  @method     closeDataForWriting
+ *  @abstract   Signals end of data to the reader.
+ *  @discussion Bytes still in the ring buffer can be read; once they have all
+ *              been read, the reader gets end of data. Writing after having
+ *              closed the writing end fails.
+ */
+- (void) closeDataForWriting;
+
+/*!
+ *  @method     closeDataForReading
+ *  @abstract   Signals to the writer that no more bytes will be read.
+ *  @discussion Bytes still in the ring buffer are discarded; a blocked writer
+ *              is woken up and gets an <code>EPIPE</code> error.
+ */
+- (void) closeDataForReading;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGDATAPIPE_H */
@@ -0,0 +1,280 @@
+//
+//  GPGDataPipe.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGDataPipe.h>
+#include <MacGPGME/GPGData.h>
+#include <MacGPGME/GPGExceptions.h>
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <gpgme.h>
+#include <pthread.h>
+
+
+#define GPGDataPipeDefaultCapacity	(64 * 1024)
+
+
+// The ring is shared by the reading and the writing gpgme data objects; it is
+// passed as callback handle, and freed when both data objects have been
+// released. Counters are never wrapped: position in buffer is counter modulo
+// capacity, and the number of buffered bytes is writeCount - readCount.
+// As there is only one reader and one writer, bytes are copied without holding
+// the lock: the reader only touches bytes between readCount and writeCount,
+// the writer only touches the free space after writeCount.
+typedef struct {
+    pthread_mutex_t     lock;
+    pthread_cond_t      condition;
+    char                *buffer;
+    size_t              capacity;
+    unsigned long long  readCount;
+    unsigned long long  writeCount;
+    BOOL                readerClosed;
+    BOOL                writerClosed;
+    int                 refCount;
+} GPGDataPipeRing;
+
+
+static GPGDataPipeRing *newRing(size_t capacity)
+{
+    GPGDataPipeRing	*aRing = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(GPGDataPipeRing));
+    
+    aRing->buffer = NSZoneMalloc(NSDefaultMallocZone(), capacity);
+    aRing->capacity = capacity;
+    aRing->refCount = 2; // One for each end
+    pthread_mutex_init(&aRing->lock, NULL);
+    pthread_cond_init(&aRing->condition, NULL);
+    
+    return aRing;
+}
+
+static void releaseRing(GPGDataPipeRing *aRing)
+{
+    BOOL	isLastReference;
+    
+    pthread_mutex_lock(&aRing->lock);
+    isLastReference = (--aRing->refCount == 0);
+    pthread_mutex_unlock(&aRing->lock);
+    
+    if(isLastReference){
+        pthread_cond_destroy(&aRing->condition);
+        pthread_mutex_destroy(&aRing->lock);
+        NSZoneFree(NSDefaultMallocZone(), aRing->buffer);
+        NSZoneFree(NSDefaultMallocZone(), aRing);
+    }
+}
+
+static void closeRingEnd(GPGDataPipeRing *aRing, BOOL readingEnd)
+{
+    pthread_mutex_lock(&aRing->lock);
+    if(readingEnd)
+        aRing->readerClosed = YES;
+    else
+        aRing->writerClosed = YES;
+    pthread_cond_broadcast(&aRing->condition);
+    pthread_mutex_unlock(&aRing->lock);
+}
+
+static ssize_t pipeReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    // Returns the number of bytes read, 0 on EOF, or -1 on error. Sets errno in case of error.
+    GPGDataPipeRing	*aRing = (GPGDataPipeRing *)object;
+    size_t			readLength, offset, firstPartLength;
+    
+    if(destinationBufferSize == 0)
+        return 0;
+    
+    pthread_mutex_lock(&aRing->lock);
+    while(aRing->writeCount == aRing->readCount && !aRing->writerClosed && !aRing->readerClosed)
+        pthread_cond_wait(&aRing->condition, &aRing->lock);
+    if(aRing->readerClosed){
+        pthread_mutex_unlock(&aRing->lock);
+        errno = EBADF;
+        return -1;
+    }
+    readLength = (size_t)(aRing->writeCount - aRing->readCount);
+    offset = (size_t)(aRing->readCount % aRing->capacity);
+    pthread_mutex_unlock(&aRing->lock);
+    
+    if(readLength == 0)
+        return 0; // Writer closed and buffer is empty
+    if(readLength > destinationBufferSize)
+        readLength = destinationBufferSize;
+    
+    firstPartLength = MIN(readLength, aRing->capacity - offset);
+    memcpy(destinationBuffer, aRing->buffer + offset, firstPartLength);
+    if(firstPartLength < readLength)
+        memcpy((char *)destinationBuffer + firstPartLength, aRing->buffer, readLength - firstPartLength);
+    
+    pthread_mutex_lock(&aRing->lock);
+    aRing->readCount += readLength;
+    pthread_cond_broadcast(&aRing->condition);
+    pthread_mutex_unlock(&aRing->lock);
+    
+    return readLength;
+}
+
+static ssize_t pipeWriteCallback(void *object, const void *buffer, size_t size)
+{
+    // Returns the number of bytes written, or -1 on error. Sets errno in case of error.
+    // Blocks until all bytes have been put into the ring, because gpgme expects it.
+    GPGDataPipeRing	*aRing = (GPGDataPipeRing *)object;
+    size_t			writtenLength = 0;
+    
+    while(writtenLength < size){
+        size_t	aLength, offset, firstPartLength;
+        
+        pthread_mutex_lock(&aRing->lock);
+        while(aRing->writeCount - aRing->readCount == aRing->capacity && !aRing->readerClosed && !aRing->writerClosed)
+            pthread_cond_wait(&aRing->condition, &aRing->lock);
+        if(aRing->readerClosed || aRing->writerClosed){
+            int	anErrno = (aRing->readerClosed ? EPIPE : EBADF);
+            
+            pthread_mutex_unlock(&aRing->lock);
+            if(writtenLength > 0)
+                break;
+            errno = anErrno;
+            return -1;
+        }
+        aLength = aRing->capacity - (size_t)(aRing->writeCount - aRing->readCount);
+        offset = (size_t)(aRing->writeCount % aRing->capacity);
+        pthread_mutex_unlock(&aRing->lock);
+        
+        if(aLength > size - writtenLength)
+            aLength = size - writtenLength;
+        firstPartLength = MIN(aLength, aRing->capacity - offset);
+        memcpy(aRing->buffer + offset, (const char *)buffer + writtenLength, firstPartLength);
+        if(firstPartLength < aLength)
+            memcpy(aRing->buffer, (const char *)buffer + writtenLength + firstPartLength, aLength - firstPartLength);
+        
+        pthread_mutex_lock(&aRing->lock);
+        aRing->writeCount += aLength;
+        pthread_cond_broadcast(&aRing->condition);
+        pthread_mutex_unlock(&aRing->lock);
+        writtenLength += aLength;
+    }
+    
+    return writtenLength;
+}
+
+static void pipeReaderReleaseCallback(void *object)
+{
+    closeRingEnd((GPGDataPipeRing *)object, YES);
+    releaseRing((GPGDataPipeRing *)object);
+}
+
+static void pipeWriterReleaseCallback(void *object)
+{
+    closeRingEnd((GPGDataPipeRing *)object, NO);
+    releaseRing((GPGDataPipeRing *)object);
+}
+
+// No seek callback: gpgme will return ENOSYS when trying to reposition.
+static struct gpgme_data_cbs	pipeReaderCallbacks = {pipeReadCallback, NULL, NULL, pipeReaderReleaseCallback};
+static struct gpgme_data_cbs	pipeWriterCallbacks = {NULL, pipeWriteCallback, NULL, pipeWriterReleaseCallback};
+
+
+@implementation GPGDataPipe
+
++ (id) pipe
+{
+    return [[[self alloc] init] autorelease];
+}
+
+- (id) init
+{
+    return [self initWithCapacity:GPGDataPipeDefaultCapacity];
+}
+
+- (id) initWithCapacity:(size_t)capacity
+{
+    gpgme_data_t	readerData, writerData;
+    gpgme_error_t	anError;
+    
+    if(capacity == 0){
+        [self release];
+        [NSException raise:NSInvalidArgumentException format:@"### Pipe capacity cannot be 0"];
+    }
+    
+    if(self = [super init]){
+        _ring = newRing(capacity);
+        anError = gpgme_data_new_from_cbs(&readerData, &pipeReaderCallbacks, _ring);
+        if(anError != GPG_ERR_NO_ERROR)
+            releaseRing(_ring); // Reader's reference
+        else{
+            anError = gpgme_data_new_from_cbs(&writerData, &pipeWriterCallbacks, _ring);
+            if(anError != GPG_ERR_NO_ERROR)
+                gpgme_data_release(readerData); // Invokes pipeReaderReleaseCallback()
+        }
+        if(anError != GPG_ERR_NO_ERROR){
+            releaseRing(_ring); // Writer's reference; ring is freed
+            _ring = NULL;
+            [self release];
+            [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+        }
+        // From now on, ring is owned by the gpgme data objects
+        _dataForReading = [[GPGData alloc] initWithInternalRepresentation:readerData];
+        _dataForWriting = [[GPGData alloc] initWithInternalRepresentation:writerData];
+        [_dataForReading setBackingType:GPGDataUncopyableBacking];
+        [_dataForWriting setBackingType:GPGDataUncopyableBacking];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [_dataForReading release];
+    [_dataForWriting release];
+    
+    [super dealloc];
+}
+
+- (size_t) capacity
+{
+    return ((GPGDataPipeRing *)_ring)->capacity;
+}
+
+- (GPGData *) dataForReading
+{
+    return _dataForReading;
+}
+
+- (GPGData *) dataForWriting
+{
+    return _dataForWriting;
+}
+
+- (void) closeDataForWriting
+{
+    closeRingEnd((GPGDataPipeRing *)_ring, NO);
+}
+
+- (void) closeDataForReading
+{
+    closeRingEnd((GPGDataPipeRing *)_ring, YES);
+}
+
+@end
@@ -0,0 +1,119 @@
+//
+//  GPGDigestData.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGDIGESTDATA_H
+#define GPGDIGESTDATA_H
+
+#include <MacGPGME/GPGData.h>
+#include <MacGPGME/GPGKeyDefines.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+/*!
+ *  @class      GPGDigestData
+ *  @abstract   Data object computing digests of the bytes going through it.
+ *  @discussion A <code>GPGDigestData</code> object wraps another
+ *              <code>@link //macgpg/occ/cl/GPGData GPGData@/link</code> 
+ *              object, the <i>underlying data</i>: all reads, writes and
+ *              repositionings are forwarded to the underlying data, and bytes
+ *              read or written are hashed on the fly (SHA-256 and SHA-512),
+ *              directly from the transfer buffer of GPGME. This way you get
+ *              digests of both input and output of an operation without
+ *              another pass over the data. For example:
+ *
+ *<pre>
+ *  GPGDigestData   *input = [[GPGDigestData alloc] initWithUnderlyingData:plainData];
+ *  GPGDigestData   *output = [[GPGDigestData alloc] initWithUnderlyingData:cipherData];
+ *
+ *  [context encryptData:input withKeys:keys trustAllKeys:NO toData:output];
+ *  NSLog(@"%@ -> %@", [input digestForHashAlgorithm:GPG_SHA256HashAlgorithm], [output digestForHashAlgorithm:GPG_SHA256HashAlgorithm]);
+ *</pre>
+ *
+ *              Digests cover the bytes from the position of the underlying 
+ *              data at initialization time. Every byte is hashed only once,
+ *              the first time it is read or written, thus rewinding and reading
+ *              again (like GPGME sometimes does to identify data type) does not
+ *              change digests. Digests become unavailable (<code>nil</code>) if
+ *              some bytes are skipped, by repositioning past bytes which have
+ *              not been hashed yet, or if bytes already hashed are overwritten.
+ */
+@interface GPGDigestData : GPGData
+{
+    void    *_digestState;
+}
+
+/*!
+ *  @method     initWithUnderlyingData:
+ *  @abstract   Designated initializer. Returns data forwarding all operations
+ *              to <i>data</i>, which is retained.
+ *  @param      data Underlying data. May not be nil.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception; in this case, a <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithUnderlyingData:(GPGData *)data;
+
+/*!
+ *  @method     underlyingData
+ *  @abstract   Returns the wrapped data.
+ */
+- (GPGData *) underlyingData;
+
+/*!
+ *  @method     digestForHashAlgorithm:
+ *  @abstract   Returns the digest of all bytes read or written so far.
+ *  @discussion Digest can be asked at any time; it is not reset. Returns
+ *              <code>nil</code> if digest could not be computed because some
+ *              bytes were skipped or overwritten.
+ *
+ *              Raises an <code>NSInvalidArgumentException</code> if
+ *              <i>algorithm</i> is neither
+ *              <code>@link //macgpg/c/econst/GPG_SHA256HashAlgorithm GPG_SHA256HashAlgorithm@/link</code>
+ *              nor <code>@link //macgpg/c/econst/GPG_SHA512HashAlgorithm GPG_SHA512HashAlgorithm@/link</code>.
+ *  @param      algorithm <code>@link //macgpg/c/econst/GPG_SHA256HashAlgorithm GPG_SHA256HashAlgorithm@/link</code>
+ *              or <code>@link //macgpg/c/econst/GPG_SHA512HashAlgorithm GPG_SHA512HashAlgorithm@/link</code>
+ */
+- (NSData *) digestForHashAlgorithm:(GPGHashAlgorithm)algorithm;
+
+/*!
+ *  @method     digestedLength
+ *  @abstract   Returns the number of bytes hashed so far.
+ */
+- (unsigned long long) digestedLength;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGDIGESTDATA_H */
@@ -0,0 +1,301 @@
+//
+//  GPGDigestData.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGDigestData.h>
+#include <MacGPGME/GPGExceptions.h>
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <gpgme.h>
+#ifdef __APPLE__
+#include <CommonCrypto/CommonDigest.h>
+#else
+#include <gcrypt.h>
+#endif
+
+
+// The state is the callback handle; it is freed by the release callback,
+// i.e. when the gpgme data is released.
+// Bytes are hashed in the order of their position: digestedEnd is the
+// position up to which bytes have been hashed. Bytes read or written before
+// that position are not hashed again; reading or writing past that position
+// (leaving a gap) or overwriting hashed bytes invalidates digests.
+typedef struct {
+    GPGData         *underlyingData; // Not retained; retained by GPGData as _objectReference
+    off_t           position;
+    off_t           digestedStart;
+    off_t           digestedEnd;
+    BOOL            isValid;
+#ifdef __APPLE__
+    CC_SHA256_CTX   sha256Context;
+    CC_SHA512_CTX   sha512Context;
+#else
+    gcry_md_hd_t    digestHandle; // Both algorithms are enabled
+#endif
+} GPGDigestState;
+
+
+// On Mac OS X, digests are computed by CommonCrypto; elsewhere (GNUstep),
+// by libgcrypt, which is available wherever gpg is.
+#define GPGMaxDigestLength  64
+
+static gpgme_error_t initDigestContexts(GPGDigestState *aState)
+{
+#ifdef __APPLE__
+    CC_SHA256_Init(&aState->sha256Context);
+    CC_SHA512_Init(&aState->sha512Context);
+    
+    return GPG_ERR_NO_ERROR;
+#else
+    gcry_error_t    anError = gcry_md_open(&aState->digestHandle, GCRY_MD_SHA256, 0);
+    
+    if(anError == GPG_ERR_NO_ERROR){
+        anError = gcry_md_enable(aState->digestHandle, GCRY_MD_SHA512);
+        if(anError != GPG_ERR_NO_ERROR){
+            gcry_md_close(aState->digestHandle);
+            aState->digestHandle = NULL;
+        }
+    }
+    
+    return anError;
+#endif
+}
+
+static void updateDigestContexts(GPGDigestState *aState, const void *bytes, size_t length)
+{
+#ifdef __APPLE__
+    // GPGME transfer buffers are small, but CC_LONG is only 32 bits wide
+    while(length > 0){
+        CC_LONG	aLength = (CC_LONG)MIN(length, (size_t)0x40000000);
+        
+        CC_SHA256_Update(&aState->sha256Context, bytes, aLength);
+        CC_SHA512_Update(&aState->sha512Context, bytes, aLength);
+        bytes = (const char *)bytes + aLength;
+        length -= aLength;
+    }
+#else
+    gcry_md_write(aState->digestHandle, bytes, length);
+#endif
+}
+
+static size_t getCurrentDigest(GPGDigestState *aState, GPGHashAlgorithm algorithm, unsigned char digest[GPGMaxDigestLength])
+{
+    // Finalizes a copy of the context, so that hashing can go on.
+    // Returns 0 if algorithm is not supported.
+#ifdef __APPLE__
+    switch(algorithm){
+        case GPG_SHA256HashAlgorithm:{
+            CC_SHA256_CTX	aContext = aState->sha256Context;
+            
+            CC_SHA256_Final(digest, &aContext);
+            return CC_SHA256_DIGEST_LENGTH;
+        }
+        case GPG_SHA512HashAlgorithm:{
+            CC_SHA512_CTX	aContext = aState->sha512Context;
+            
+            CC_SHA512_Final(digest, &aContext);
+            return CC_SHA512_DIGEST_LENGTH;
+        }
+        default:
+            return 0;
+    }
+#else
+    int             anAlgorithm;
+    gcry_md_hd_t    aCopy;
+    size_t          aLength;
+    
+    switch(algorithm){
+        case GPG_SHA256HashAlgorithm:
+            anAlgorithm = GCRY_MD_SHA256; break;
+        case GPG_SHA512HashAlgorithm:
+            anAlgorithm = GCRY_MD_SHA512; break;
+        default:
+            return 0;
+    }
+    if(gcry_md_copy(&aCopy, aState->digestHandle) != GPG_ERR_NO_ERROR)
+        [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPG_ERR_ENOMEM) userInfo:nil] raise];
+    aLength = gcry_md_get_algo_dlen(anAlgorithm);
+    memcpy(digest, gcry_md_read(aCopy, anAlgorithm), aLength);
+    gcry_md_close(aCopy);
+    
+    return aLength;
+#endif
+}
+
+
+static void digestBytes(GPGDigestState *aState, const void *bytes, size_t length, BOOL isWriting)
+{
+    off_t   end = aState->position + length;
+    size_t  skippedLength;
+    
+    if(!aState->isValid || length == 0)
+        return;
+    if(aState->position > aState->digestedEnd || (isWriting && aState->position < aState->digestedEnd)){
+        aState->isValid = NO;
+        return;
+    }
+    if(end <= aState->digestedEnd)
+        return;
+    
+    skippedLength = (size_t)(aState->digestedEnd - aState->position);
+    bytes = (const char *)bytes + skippedLength;
+    length -= skippedLength;
+    updateDigestContexts(aState, bytes, length);
+    aState->digestedEnd = end;
+}
+
+static ssize_t digestReadCallback(void *object, void *destinationBuffer, size_t destinationBufferSize)
+{
+    GPGDigestState  *aState = (GPGDigestState *)object;
+    ssize_t         readLength = gpgme_data_read([aState->underlyingData gpgmeData], destinationBuffer, destinationBufferSize);
+    
+    if(readLength > 0){
+        digestBytes(aState, destinationBuffer, readLength, NO);
+        aState->position += readLength;
+    }
+    
+    return readLength;
+}
+
+static ssize_t digestWriteCallback(void *object, const void *buffer, size_t size)
+{
+    GPGDigestState  *aState = (GPGDigestState *)object;
+    ssize_t         writtenLength = gpgme_data_write([aState->underlyingData gpgmeData], buffer, size);
+    
+    if(writtenLength > 0){
+        digestBytes(aState, buffer, writtenLength, YES);
+        aState->position += writtenLength;
+    }
+    
+    return writtenLength;
+}
+
+static off_t digestSeekCallback(void *object, off_t offset, int whence)
+{
+    GPGDigestState  *aState = (GPGDigestState *)object;
+    off_t           newPosition = gpgme_data_seek([aState->underlyingData gpgmeData], offset, whence);
+    
+    if(newPosition >= 0)
+        aState->position = newPosition;
+    
+    return newPosition;
+}
+
+static void digestReleaseCallback(void *object)
+{
+    // Underlying data is released by GPGData (_objectReference)
+#ifndef __APPLE__
+    gcry_md_close(((GPGDigestState *)object)->digestHandle);
+#endif
+    NSZoneFree(NSDefaultMallocZone(), object);
+}
+
+static struct gpgme_data_cbs	digestCallbacks = {digestReadCallback, digestWriteCallback, digestSeekCallback, digestReleaseCallback};
+
+
+@implementation GPGDigestData
+
+#ifndef __APPLE__
++ (void) initialize
+{
+    // libgcrypt must be initialized before its first use. We don't need
+    // its secure memory: only digests are computed.
+    [super initialize];
+    if(self == [GPGDigestData class] && !gcry_control(GCRYCTL_INITIALIZATION_FINISHED_P)){
+        gcry_check_version(NULL);
+        gcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+        gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+    }
+}
+#endif
+
+- (id) initWithUnderlyingData:(GPGData *)data
+{
+    gpgme_data_t    aData;
+    gpgme_error_t   anError;
+    GPGDigestState  *aState;
+    off_t           aPosition;
+    
+    NSParameterAssert(data != nil);
+    
+    aPosition = gpgme_data_seek([data gpgmeData], 0, SEEK_CUR);
+    aState = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(GPGDigestState));
+    aState->underlyingData = data;
+    // Unseekable data (pipe, stream) starts at 0 for us
+    aState->position = aState->digestedStart = aState->digestedEnd = (aPosition < 0 ? 0 : aPosition);
+    aState->isValid = YES;
+    anError = initDigestContexts(aState);
+    if(anError != GPG_ERR_NO_ERROR){
+        NSZoneFree(NSDefaultMallocZone(), aState);
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    
+    anError = gpgme_data_new_from_cbs(&aData, &digestCallbacks, aState);
+    if(anError != GPG_ERR_NO_ERROR){
+#ifndef __APPLE__
+        gcry_md_close(aState->digestHandle);
+#endif
+        NSZoneFree(NSDefaultMallocZone(), aState);
+        [self release];
+        [[NSException exceptionWithGPGError:anError userInfo:nil] raise];
+    }
+    self = [self initWithInternalRepresentation:aData];
+    ((GPGDigestData *)self)->_objectReference = [data retain];
+    ((GPGDigestData *)self)->_digestState = aState;
+    ((GPGDigestData *)self)->_backingType = GPGDataUncopyableBacking;
+    
+    return self;
+}
+
+- (GPGData *) underlyingData
+{
+    return _objectReference;
+}
+
+- (NSData *) digestForHashAlgorithm:(GPGHashAlgorithm)algorithm
+{
+    GPGDigestState  *aState = (GPGDigestState *)_digestState;
+    unsigned char   digest[GPGMaxDigestLength];
+    size_t          aLength;
+    
+    if(algorithm != GPG_SHA256HashAlgorithm && algorithm != GPG_SHA512HashAlgorithm)
+        [NSException raise:NSInvalidArgumentException format:@"### Unsupported hash algorithm %d", algorithm];
+    if(!aState->isValid)
+        return nil;
+    aLength = getCurrentDigest(aState, algorithm, digest);
+    
+    return [NSData dataWithBytes:digest length:aLength];
+}
+
+- (unsigned long long) digestedLength
+{
+    GPGDigestState  *aState = (GPGDigestState *)_digestState;
+    
+    return aState->digestedEnd - aState->digestedStart;
+}
+
+@end
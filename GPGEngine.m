@@ -393,11 +393,9 @@
         anEngineInfo = anEngineInfo->next;
     }
     NSAssert1(anEngineInfo != NULL, @"### Unable to refresh engine for protocol %@", GPGProtocolDescription(myProtocol));
-    [[[self class] pointerUniquingTableLock] lock];
     [self unregisterUniquePointer];
     _internalRepresentation = anEngineInfo;
     [self registerUniquePointer];
-    [[[self class] pointerUniquingTableLock] unlock];
 }
 
 @end
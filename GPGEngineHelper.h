@@ -29,6 +29,7 @@
 #define GPGENGINEHELPER_H
 
 #include <Foundation/Foundation.h>
+#include <MacGPGME/GPGDefines.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,6 +42,27 @@ extern "C" {
 @class GPGEngine;
 
 
+// Fields of a colon listing record
+#define COLON_FIELD_COUNT       12
+#define COLON_TYPE_FIELD        0
+#define COLON_VALIDITY_FIELD    1
+#define COLON_LENGTH_FIELD      2
+#define COLON_ALGORITHM_FIELD   3
+#define COLON_KEYID_FIELD       4
+#define COLON_CREATED_FIELD     5
+#define COLON_EXPIRES_FIELD     6
+#define COLON_OWNERTRUST_FIELD  8
+#define COLON_USERID_FIELD      9
+#define COLON_CAPABILITIES_FIELD    11
+
+// Colon listing parsing functions, shared with GPGKeyTable. Records are
+// split in at most COLON_FIELD_COUNT fields; missing fields are empty.
+GPG_EXPORT unsigned GPGSplitColonRecord(const char *line, unsigned length, const char **fields, unsigned *lengths);
+GPG_EXPORT BOOL GPGColonFieldIs(const char *field, unsigned length, const char *value);
+GPG_EXPORT BOOL GPGColonFieldContains(const char *field, unsigned length, char aChar);
+GPG_EXPORT unsigned long GPGColonFieldNumber(const char *field, unsigned length);
+
+
 // This class is a private helper class for GPGEngine's executeWithArguments:localizedOutput:error: method.
 // It launches a NSTask, with some arguments, reads stdout/stderr, and returns stdout, all synchronously.
 @interface GPGEngineHelper : NSObject {
@@ -51,6 +73,30 @@ extern "C" {
 }
 
 + (NSString *) executeEngine:(GPGEngine *)engine withArguments:(NSArray *)arguments localizedOutput:(BOOL)localizedOutput error:(NSError **)errorPtr;
++ (NSTask *) launchedKeyListingTaskForEngine:(GPGEngine *)engine searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly fastListMode:(BOOL)fastListMode;
+// Launches a colon key listing; output is readable from task's standardOutput pipe
++ (void) raiseIfKeyListingTaskFailed:(NSTask *)task;
+// Raises a GPGException if key listing task, which has exited, failed for
+// another reason than patterns matching no key
+
+@end
+
+
+// This class is a private helper class for GPGContext's fastKeyMetadataEnumeratorForSearchPatterns:secretKeysOnly: method.
+// It launches the OpenPGP engine in fast-list-mode, and parses its colon
+// output while it is read, returning one metadata dictionary per key.
+@interface GPGColonKeyListingEnumerator : NSEnumerator {
+    NSTask              *task;
+    NSFileHandle        *outputHandle;
+    NSMutableData       *pendingData; // Output not yet parsed
+    unsigned            pendingOffset;
+    NSMutableDictionary *currentKey; // Key whose records are being parsed
+    NSMutableDictionary *currentSubkey;
+    BOOL                isAtEnd;
+    BOOL                secretKeys;
+}
+
+- (id) initWithEngine:(GPGEngine *)engine searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly;
 
 @end
 
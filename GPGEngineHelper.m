@@ -27,6 +27,12 @@
 
 #include "GPGEngineHelper.h"
 #include "GPGInternals.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
 
 
 #define NOTHING_READ	0
@@ -35,6 +41,29 @@
 #define READ_ALL		(READ_STDOUT | READ_STDERR)
 
 
+static NSFileHandle *unlinkedTemporaryFileHandle(void)
+{
+    // Engine can write as much as it wants, without being read while it runs
+    char    aPath[PATH_MAX];
+    int     aFileDescriptor;
+    
+    (void)snprintf(aPath, sizeof(aPath), "%s/MacGPGME.XXXXXX", [NSTemporaryDirectory() fileSystemRepresentation]);
+    aFileDescriptor = mkstemp(aPath);
+    if(aFileDescriptor < 0)
+        return [NSFileHandle fileHandleWithNullDevice];
+    (void)unlink(aPath);
+    
+    return [[[NSFileHandle alloc] initWithFileDescriptor:aFileDescriptor closeOnDealloc:YES] autorelease];
+}
+
+static BOOL isNoKeyMatchedMessage(NSString *line)
+{
+    // Messages of gpg 1.4, which has no status for them; output is not
+    // localized.
+    return [line hasPrefix:@"gpg: error reading key: "] && ([line hasSuffix:@"No public key"] || [line hasSuffix:@"No secret key"] || [line hasSuffix:@"public key not found"] || [line hasSuffix:@"secret key not available"]);
+}
+
+
 @implementation GPGEngineHelper
 
 - (void) dealloc
@@ -141,4 +170,379 @@
     return outputString;
 }
 
++ (NSTask *) launchedKeyListingTaskForEngine:(GPGEngine *)engine searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly fastListMode:(BOOL)fastListMode
+{
+    NSMutableArray      *arguments = [NSMutableArray arrayWithObjects:@"--utf8-strings", @"--charset", @"utf8", @"--no-verbose", @"--batch", @"--no-tty", @"--status-fd", @"2", @"--with-colons", @"--fixed-list-mode", @"--with-fingerprint", @"--with-fingerprint", nil]; // Twice, to get subkey fingerprints too
+    NSMutableDictionary *environment = [NSMutableDictionary dictionaryWithDictionary:[[NSProcessInfo processInfo] environment]];
+    NSTask              *aTask = [[NSTask alloc] init];
+    
+    // Error messages are parsed by +raiseIfKeyListingTaskFailed:
+    [environment setObject:@"en_US.UTF-8" forKey:@"LANG"];
+    [environment setObject:@"en_US.UTF-8" forKey:@"LANGUAGE"];
+    [environment setObject:@"en_US.UTF-8" forKey:@"LC_ALL"];
+    [environment setObject:@"en_US.UTF-8" forKey:@"LC_MESSAGE"];
+    
+    if(fastListMode)
+        [arguments addObject:@"--fast-list-mode"];
+    if([engine customHomeDirectory] != nil)
+        [arguments addObjectsFromArray:[NSArray arrayWithObjects:@"--homedir", [engine customHomeDirectory], nil]];
+    [arguments addObject:(secretKeysOnly ? @"--list-secret-keys" : @"--list-keys")];
+    [arguments addObject:@"--"];
+    if(searchPatterns != nil)
+        [arguments addObjectsFromArray:searchPatterns];
+    
+    [aTask setLaunchPath:[engine executablePath]];
+    [aTask setArguments:arguments];
+    [aTask setEnvironment:environment];
+    [aTask setStandardOutput:[NSPipe pipe]];
+    [aTask setStandardError:unlinkedTemporaryFileHandle()];
+    NS_DURING
+        [aTask launch];
+    NS_HANDLER
+        [aTask release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    return [aTask autorelease];
+}
+
++ (void) raiseIfKeyListingTaskFailed:(NSTask *)task
+{
+    // gpg exits with status 2 when a pattern matches no key, which is not an
+    // error for key listing. It is told apart from other errors by ERROR 
+    // status lines, written to stderr with the messages.
+    NSFileHandle    *errorHandle = [task standardError];
+    NSData          *errorData;
+    NSString        *errorString;
+    NSEnumerator    *lineEnum;
+    NSString        *aLine;
+    GPGError        anError = GPG_ERR_NO_ERROR;
+    BOOL            noKeyMatched = NO;
+    
+    if([task terminationStatus] == 0)
+        return;
+    
+    [errorHandle seekToFileOffset:0];
+    errorData = [errorHandle readDataToEndOfFile];
+    errorString = [[NSString alloc] initWithData:errorData encoding:NSUTF8StringEncoding];
+    if(errorString == nil)
+        errorString = [[NSString alloc] initWithData:errorData encoding:NSISOLatin1StringEncoding];
+    [errorString autorelease];
+    
+    lineEnum = [[errorString componentsSeparatedByString:@"\n"] objectEnumerator];
+    while((aLine = [lineEnum nextObject]) != nil){
+        if([aLine hasPrefix:@"[GNUPG:] ERROR "]){
+            // [GNUPG:] ERROR <location> <error>
+            NSArray     *someFields = [aLine componentsSeparatedByString:@" "];
+            GPGError    aStatusError;
+            
+            if([someFields count] < 4)
+                continue;
+            aStatusError = (GPGError)strtoul([[someFields objectAtIndex:3] UTF8String], NULL, 10);
+            if(gpgme_err_source(aStatusError) == GPG_ERR_SOURCE_UNKNOWN)
+                aStatusError = gpgme_err_make(GPG_ERR_SOURCE_GPG, gpgme_err_code(aStatusError));
+            if([[someFields objectAtIndex:2] isEqualToString:@"keylist.getkey"] && (gpgme_err_code(aStatusError) == GPG_ERR_NO_PUBKEY || gpgme_err_code(aStatusError) == GPG_ERR_NO_SECKEY))
+                noKeyMatched = YES;
+            else if(anError == GPG_ERR_NO_ERROR)
+                anError = aStatusError;
+        }
+        else if(isNoKeyMatchedMessage(aLine))
+            noKeyMatched = YES;
+    }
+    
+    if(noKeyMatched && anError == GPG_ERR_NO_ERROR)
+        return;
+    if(anError == GPG_ERR_NO_ERROR)
+        anError = gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorGeneralError);
+    [[NSException exceptionWithGPGError:anError userInfo:[NSDictionary dictionaryWithObject:[NSString stringWithFormat:@"Key listing failed (%d): %@", [task terminationStatus], errorString] forKey:GPGAdditionalReasonKey]] raise];
+}
+
+@end
+
+
+unsigned GPGSplitColonRecord(const char *line, unsigned length, const char **fields, unsigned *lengths)
+{
+    // Colons are escaped in values, so fields can be split on every colon
+    unsigned    aFieldCount = 0;
+    unsigned    aStart = 0, i;
+    
+    for(i = 0; i <= length && aFieldCount < COLON_FIELD_COUNT; i++){
+        if(i == length || line[i] == ':'){
+            fields[aFieldCount] = line + aStart;
+            lengths[aFieldCount] = i - aStart;
+            aFieldCount++;
+            aStart = i + 1;
+        }
+    }
+    for(i = aFieldCount; i < COLON_FIELD_COUNT; i++){
+        fields[i] = line + length;
+        lengths[i] = 0;
+    }
+    
+    return aFieldCount;
+}
+
+BOOL GPGColonFieldIs(const char *field, unsigned length, const char *value)
+{
+    return (length == strlen(value) && memcmp(field, value, length) == 0);
+}
+
+BOOL GPGColonFieldContains(const char *field, unsigned length, char aChar)
+{
+    return (memchr(field, aChar, length) != NULL);
+}
+
+unsigned long GPGColonFieldNumber(const char *field, unsigned length)
+{
+    unsigned long   aValue = 0;
+    unsigned        i;
+    
+    for(i = 0; i < length && field[i] >= '0' && field[i] <= '9'; i++)
+        aValue = aValue * 10 + (field[i] - '0');
+    
+    return aValue;
+}
+
+static NSString *colonFieldString(const char *field, unsigned length)
+{
+    // Replaces \xXX sequences; result is UTF-8, or Latin-1 for old user IDs
+    char        *aBuffer = NSZoneMalloc(NSDefaultMallocZone(), length + 1);
+    unsigned    aLength = 0, i;
+    NSString    *aString;
+    
+    for(i = 0; i < length; i++){
+        if(field[i] == '\\' && i + 3 < length && field[i + 1] == 'x' && isxdigit((unsigned char)field[i + 2]) && isxdigit((unsigned char)field[i + 3])){
+            char    hexCode[3] = { field[i + 2], field[i + 3], 0 };
+            
+            aBuffer[aLength++] = (char)strtol(hexCode, NULL, 16);
+            i += 3;
+        }
+        else
+            aBuffer[aLength++] = field[i];
+    }
+    aString = [[NSString alloc] initWithBytes:aBuffer length:aLength encoding:NSUTF8StringEncoding];
+    if(aString == nil)
+        aString = [[NSString alloc] initWithBytes:aBuffer length:aLength encoding:NSISOLatin1StringEncoding];
+    NSZoneFree(NSDefaultMallocZone(), aBuffer);
+    
+    return [aString autorelease];
+}
+
+static NSMutableDictionary *colonKeyMetadata(const char **fields, const unsigned *lengths, BOOL isPrimaryKey, BOOL isSecret)
+{
+    // Same keys as GPGKeyMetadataCache; primary key's capabilities are
+    // key-wide ones (uppercase letters). Validity is not computed in
+    // fast-list-mode.
+    NSMutableDictionary *aDict = [NSMutableDictionary dictionaryWithCapacity:20];
+    NSString            *aKeyID = colonFieldString(fields[COLON_KEYID_FIELD], lengths[COLON_KEYID_FIELD]);
+    const char          *someCapabilities = fields[COLON_CAPABILITIES_FIELD];
+    unsigned            aCapabilityLength = lengths[COLON_CAPABILITIES_FIELD];
+    unsigned long       aCreationTime = GPGColonFieldNumber(fields[COLON_CREATED_FIELD], lengths[COLON_CREATED_FIELD]);
+    unsigned long       anExpirationTime = GPGColonFieldNumber(fields[COLON_EXPIRES_FIELD], lengths[COLON_EXPIRES_FIELD]);
+    BOOL                hasExpired = GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'e') || (anExpirationTime != 0 && anExpirationTime < (unsigned long)time(NULL));
+    
+    [aDict setObject:@"" forKey:@"fpr"]; // Set by following fpr record
+    [aDict setObject:aKeyID forKey:@"keyid"];
+    [aDict setObject:([aKeyID length] > 8 ? [aKeyID substringFromIndex:[aKeyID length] - 8] : aKeyID) forKey:@"shortkeyid"];
+    [aDict setObject:[NSNumber numberWithInt:(int)GPGColonFieldNumber(fields[COLON_ALGORITHM_FIELD], lengths[COLON_ALGORITHM_FIELD])] forKey:@"algo"];
+    [aDict setObject:[NSNumber numberWithUnsignedInt:(unsigned)GPGColonFieldNumber(fields[COLON_LENGTH_FIELD], lengths[COLON_LENGTH_FIELD])] forKey:@"len"];
+    if(aCreationTime > 0)
+        [aDict setObject:[NSCalendarDate dateWithTimeIntervalSince1970:aCreationTime] forKey:@"created"];
+    if(anExpirationTime != 0)
+        [aDict setObject:[NSCalendarDate dateWithTimeIntervalSince1970:anExpirationTime] forKey:@"expire"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'r')] forKey:@"revoked"];
+    [aDict setObject:[NSNumber numberWithBool:hasExpired] forKey:@"expired"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(someCapabilities, aCapabilityLength, 'D')] forKey:@"disabled"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'i')] forKey:@"invalid"];
+    [aDict setObject:[NSNumber numberWithBool:isSecret] forKey:@"secret"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(someCapabilities, aCapabilityLength, (isPrimaryKey ? 'E' : 'e'))] forKey:@"canEncrypt"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(someCapabilities, aCapabilityLength, (isPrimaryKey ? 'S' : 's'))] forKey:@"canSign"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(someCapabilities, aCapabilityLength, (isPrimaryKey ? 'C' : 'c'))] forKey:@"canCertify"];
+    [aDict setObject:[NSNumber numberWithBool:GPGColonFieldContains(someCapabilities, aCapabilityLength, (isPrimaryKey ? 'A' : 'a'))] forKey:@"canAuthenticate"];
+    if(isPrimaryKey){
+        [aDict setObject:[NSNumber numberWithInt:GPGValidityUnknown] forKey:@"ownertrust"];
+        [aDict setObject:[NSNumber numberWithInt:GPGValidityUnknown] forKey:@"validity"];
+        [aDict setObject:[NSMutableArray array] forKey:@"subkeys"];
+        [aDict setObject:[NSMutableArray array] forKey:@"userids"];
+    }
+    
+    return aDict;
+}
+
+static NSDictionary *colonUserIDMetadata(const char **fields, const unsigned *lengths)
+{
+    // Splits "Name (Comment) <Email>", like gpgme does
+    NSString    *aUserID = colonFieldString(fields[COLON_USERID_FIELD], lengths[COLON_USERID_FIELD]);
+    NSString    *aName = aUserID;
+    NSString    *anEmail = @"";
+    NSString    *aComment = @"";
+    NSRange     aStartRange = [aName rangeOfString:@"<" options:NSBackwardsSearch];
+    NSRange     anEndRange;
+    
+    if(aStartRange.length > 0){
+        anEndRange = [aName rangeOfString:@">" options:0 range:NSMakeRange(aStartRange.location, [aName length] - aStartRange.location)];
+        if(anEndRange.length > 0){
+            anEmail = [aName substringWithRange:NSMakeRange(NSMaxRange(aStartRange), anEndRange.location - NSMaxRange(aStartRange))];
+            aName = [aName substringToIndex:aStartRange.location];
+        }
+    }
+    aStartRange = [aName rangeOfString:@"("];
+    if(aStartRange.length > 0){
+        anEndRange = [aName rangeOfString:@")" options:NSBackwardsSearch];
+        if(anEndRange.length > 0 && anEndRange.location > aStartRange.location){
+            aComment = [aName substringWithRange:NSMakeRange(NSMaxRange(aStartRange), anEndRange.location - NSMaxRange(aStartRange))];
+            aName = [aName substringToIndex:aStartRange.location];
+        }
+    }
+    aName = [aName stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+        aUserID, @"raw",
+        aName, @"name",
+        anEmail, @"email",
+        aComment, @"comment",
+        [NSNumber numberWithInt:GPGValidityUnknown], @"validity",
+        [NSNumber numberWithBool:GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'r')], @"revoked",
+        [NSNumber numberWithBool:GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'i')], @"invalid",
+        nil];
+}
+
+
+@interface GPGColonKeyListingEnumerator(Private)
+- (NSDictionary *) parseRecord:(const char *)line length:(unsigned)length;
+- (NSDictionary *) finishCurrentKey;
+@end
+
+@implementation GPGColonKeyListingEnumerator
+
+- (id) initWithEngine:(GPGEngine *)engine searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
+{
+    if(self = [self init]){
+        secretKeys = secretKeysOnly;
+        pendingData = [[NSMutableData alloc] init];
+        NS_DURING
+            task = [[GPGEngineHelper launchedKeyListingTaskForEngine:engine searchPatterns:searchPatterns secretKeysOnly:secretKeysOnly fastListMode:YES] retain];
+        NS_HANDLER
+            [self release];
+            [localException raise];
+        NS_ENDHANDLER
+        outputHandle = [[[task standardOutput] fileHandleForReading] retain];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    if([task isRunning]){
+        // Enumeration has been stopped before end
+        [task terminate];
+        [task waitUntilExit];
+    }
+    [task release];
+    [outputHandle closeFile];
+    [outputHandle release];
+    [pendingData release];
+    [currentKey release];
+    [currentSubkey release];
+    
+    [super dealloc];
+}
+
+- (id) nextObject
+{
+    // Patterns matching no key are ignored; other engine errors are raised
+    // at end of output, once all listed keys have been parsed.
+    while(YES){
+        const char      *someBytes = (const char *)[pendingData bytes];
+        unsigned        aLength = [pendingData length];
+        const char      *aLineEnd = memchr(someBytes + pendingOffset, '\n', aLength - pendingOffset);
+        NSDictionary    *aKey;
+        
+        if(aLineEnd == NULL && isAtEnd && pendingOffset < aLength)
+            // Last line, without newline
+            aLineEnd = someBytes + aLength;
+        if(aLineEnd != NULL){
+            unsigned    aLineLength = aLineEnd - (someBytes + pendingOffset);
+            
+            aKey = [self parseRecord:someBytes + pendingOffset length:aLineLength];
+            pendingOffset = MIN(aLength, pendingOffset + aLineLength + 1);
+            if(aKey != nil)
+                return aKey;
+        }
+        else if(isAtEnd){
+            return [self finishCurrentKey];
+        }
+        else{
+            NSData  *someData = [outputHandle availableData];
+            
+            // Drop parsed bytes before appending
+            [pendingData replaceBytesInRange:NSMakeRange(0, pendingOffset) withBytes:NULL length:0];
+            pendingOffset = 0;
+            if([someData length] == 0){
+                isAtEnd = YES;
+                [task waitUntilExit];
+                [GPGEngineHelper raiseIfKeyListingTaskFailed:task];
+            }
+            else
+                [pendingData appendData:someData];
+        }
+    }
+}
+
+@end
+
+
+@implementation GPGColonKeyListingEnumerator(Private)
+
+- (NSDictionary *) parseRecord:(const char *)line length:(unsigned)length
+{
+    // Returns previous key when a new key starts
+    const char      *fields[COLON_FIELD_COUNT];
+    unsigned        lengths[COLON_FIELD_COUNT];
+    NSDictionary    *aKey = nil;
+    
+    if(length > 0 && line[length - 1] == '\r')
+        length--;
+    (void)GPGSplitColonRecord(line, length, fields, lengths);
+    
+    if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "pub") || GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "sec")){
+        aKey = [self finishCurrentKey];
+        currentKey = [colonKeyMetadata(fields, lengths, YES, secretKeys) retain];
+        // Primary key is also first subkey
+        currentSubkey = [colonKeyMetadata(fields, lengths, NO, secretKeys) retain];
+        [[currentKey objectForKey:@"subkeys"] addObject:currentSubkey];
+    }
+    else if(currentKey != nil){
+        if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "sub") || GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "ssb")){
+            [currentSubkey release];
+            currentSubkey = [colonKeyMetadata(fields, lengths, NO, secretKeys) retain];
+            [[currentKey objectForKey:@"subkeys"] addObject:currentSubkey];
+        }
+        else if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "fpr")){
+            NSString    *aFingerprint = colonFieldString(fields[COLON_USERID_FIELD], lengths[COLON_USERID_FIELD]);
+            
+            [currentSubkey setObject:aFingerprint forKey:@"fpr"];
+            if([[currentKey objectForKey:@"subkeys"] count] == 1)
+                [currentKey setObject:aFingerprint forKey:@"fpr"];
+        }
+        else if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "uid"))
+            [[currentKey objectForKey:@"userids"] addObject:colonUserIDMetadata(fields, lengths)];
+        // Other records (tru, rvk, sig, grp, uat...) are ignored
+    }
+    
+    return aKey;
+}
+
+- (NSDictionary *) finishCurrentKey
+{
+    NSDictionary    *aKey = [currentKey autorelease];
+    
+    currentKey = nil;
+    [currentSubkey release];
+    currentSubkey = nil;
+    
+    return aKey;
+}
+
 @end
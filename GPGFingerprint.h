@@ -0,0 +1,149 @@
+//
+//  GPGFingerprint.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGFINGERPRINT_H
+#define GPGFINGERPRINT_H
+
+#include <Foundation/Foundation.h>
+#include <MacGPGME/GPGDefines.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+/*!
+ *  @defined    GPGFingerprintMaximumLength
+ *  @abstract   Length, in bytes, of the longest fingerprint.
+ */
+#define GPGFingerprintMaximumLength 32
+
+
+/*!
+ *  @typedef    GPGFingerprint
+ *  @abstract   Fingerprint in binary form.
+ *  @discussion A <code>GPGFingerprint</code> is a value type: it can be 
+ *              copied, and compared with 
+ *              <code>@link GPGFingerprintEqual GPGFingerprintEqual@/link</code>.
+ *              OpenPGP v3 fingerprints are 16 bytes long, v4 ones 20 bytes
+ *              long, and v5 ones 32 bytes long. Unused bytes are always zero.
+ *              Hash value is computed once, on creation.
+ *  @field      hash Hash value
+ *  @field      length Number of bytes of the fingerprint; 0 when invalid
+ *  @field      bytes Fingerprint bytes
+ */
+typedef struct {
+    unsigned        hash;
+    unsigned char   length;
+    unsigned char   bytes[GPGFingerprintMaximumLength];
+} GPGFingerprint;
+
+
+/*!
+ *  @function   GPGFingerprintFromHexChars
+ *  @abstract   Parses <i>length</i> hex digits, upper- or lowercase.
+ *  @discussion Returns <code>NO</code> if <i>hexChars</i> contains other
+ *              characters, or is not an even number of hex digits, up to 
+ *              2 * <code>GPGFingerprintMaximumLength</code>; in this case, 
+ *              <i>fingerprint</i> length is 0. Conversion has no branch 
+ *              per character.
+ *  @param      hexChars Hex digits, not necessarily NUL-terminated
+ *  @param      length Number of hex digits
+ *  @param      fingerprint On output, parsed fingerprint
+ */
+GPG_EXPORT BOOL GPGFingerprintFromHexChars(const char *hexChars, unsigned length, GPGFingerprint *fingerprint);
+
+/*!
+ *  @function   GPGFingerprintFromString
+ *  @abstract   Parses a fingerprint string, as returned by 
+ *              <code>@link //macgpg/occ/instm/GPGKey/fingerprint fingerprint@/link</code>
+ *              (GPGKey).
+ *  @discussion String may be prefixed with <code>0x</code>, and may contain
+ *              spaces, like the ones returned by 
+ *              <code>@link //macgpg/occ/clm/GPGKey/formattedFingerprint: formattedFingerprint:@/link</code>
+ *              (GPGKey). Returns <code>NO</code> if string is nil or is not a
+ *              fingerprint; in this case, <i>fingerprint</i> length is 0.
+ *  @param      string Fingerprint string
+ *  @param      fingerprint On output, parsed fingerprint
+ */
+GPG_EXPORT BOOL GPGFingerprintFromString(NSString *string, GPGFingerprint *fingerprint);
+
+/*!
+ *  @function   GPGFingerprintFromBytes
+ *  @abstract   Initializes <i>fingerprint</i> with <i>length</i> bytes.
+ *  @param      bytes Fingerprint bytes
+ *  @param      length Number of bytes; at most 
+ *              <code>GPGFingerprintMaximumLength</code>
+ *  @param      fingerprint On output, fingerprint
+ */
+GPG_EXPORT void GPGFingerprintFromBytes(const void *bytes, unsigned length, GPGFingerprint *fingerprint);
+
+/*!
+ *  @function   GPGFingerprintGetHexChars
+ *  @abstract   Writes uppercase hex digits of <i>fingerprint</i> into
+ *              <i>hexChars</i>.
+ *  @discussion Writes 2 * <i>fingerprint</i> length characters, without
+ *              terminating NUL.
+ *  @param      fingerprint Fingerprint
+ *  @param      hexChars Buffer of at least 2 * 
+ *              <code>GPGFingerprintMaximumLength</code> characters
+ */
+GPG_EXPORT void GPGFingerprintGetHexChars(const GPGFingerprint *fingerprint, char *hexChars);
+
+/*!
+ *  @function   GPGStringFromFingerprint
+ *  @abstract   Returns the uppercase hex digit form of <i>fingerprint</i>, or
+ *              nil if its length is 0.
+ *  @param      fingerprint Fingerprint
+ */
+GPG_EXPORT NSString *GPGStringFromFingerprint(const GPGFingerprint *fingerprint);
+
+/*!
+ *  @function   GPGFingerprintEqual
+ *  @abstract   Returns <code>YES</code> if both fingerprints have the same 
+ *              length and bytes.
+ *  @discussion Comparison takes the same time whatever the fingerprints are.
+ *  @param      fingerprint1 A fingerprint
+ *  @param      fingerprint2 Another fingerprint
+ */
+GPG_EXPORT BOOL GPGFingerprintEqual(const GPGFingerprint *fingerprint1, const GPGFingerprint *fingerprint2);
+
+/*!
+ *  @function   GPGFingerprintHash
+ *  @abstract   Returns the hash value of <i>fingerprint</i>, computed on 
+ *              creation.
+ *  @param      fingerprint Fingerprint
+ */
+GPG_EXPORT unsigned GPGFingerprintHash(const GPGFingerprint *fingerprint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGFINGERPRINT_H */
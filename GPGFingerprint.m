@@ -0,0 +1,190 @@
+//
+//  GPGFingerprint.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGFingerprint.h>
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <string.h>
+
+
+static void computeHash(GPGFingerprint *fingerprint)
+{
+    // Fingerprints are digests: their first bytes are evenly distributed
+    fingerprint->hash = ((unsigned)fingerprint->bytes[0] << 24 | (unsigned)fingerprint->bytes[1] << 16 | (unsigned)fingerprint->bytes[2] << 8 | (unsigned)fingerprint->bytes[3]) ^ fingerprint->length;
+}
+
+BOOL GPGFingerprintFromHexChars(const char *hexChars, unsigned length, GPGFingerprint *fingerprint)
+{
+    // Digit value is (c & 0x0F), plus 9 for letters; invalid characters are
+    // accumulated in a flag, checked once at the end.
+    unsigned    invalid = (length == 0) | (length % 2) | (length > 2 * GPGFingerprintMaximumLength);
+    unsigned    i;
+    
+    memset(fingerprint, 0, sizeof(GPGFingerprint));
+    if(invalid)
+        return NO;
+    for(i = 0; i < length; i++){
+        unsigned    c = (unsigned char)hexChars[i];
+        unsigned    isDigit = (c - '0') <= 9;
+        unsigned    isLetter = ((c | 0x20) - 'a') <= 5;
+        
+        invalid |= !(isDigit | isLetter);
+        fingerprint->bytes[i / 2] = (unsigned char)(fingerprint->bytes[i / 2] << 4 | ((c & 0x0F) + 9 * isLetter));
+    }
+    if(invalid){
+        memset(fingerprint, 0, sizeof(GPGFingerprint));
+        return NO;
+    }
+    fingerprint->length = (unsigned char)(length / 2);
+    computeHash(fingerprint);
+    
+    return YES;
+}
+
+BOOL GPGFingerprintFromString(NSString *string, GPGFingerprint *fingerprint)
+{
+    const char  *aString = [string UTF8String];
+    char        hexChars[2 * GPGFingerprintMaximumLength];
+    unsigned    aLength = 0;
+    
+    if(aString == NULL){
+        memset(fingerprint, 0, sizeof(GPGFingerprint));
+        return NO;
+    }
+    if(aString[0] == '0' && (aString[1] == 'x' || aString[1] == 'X'))
+        aString += 2;
+    for(; *aString != '\0'; aString++){
+        if(*aString == ' ')
+            continue;
+        if(aLength == sizeof(hexChars)){
+            memset(fingerprint, 0, sizeof(GPGFingerprint));
+            return NO;
+        }
+        hexChars[aLength++] = *aString;
+    }
+    
+    return GPGFingerprintFromHexChars(hexChars, aLength, fingerprint);
+}
+
+void GPGFingerprintFromBytes(const void *bytes, unsigned length, GPGFingerprint *fingerprint)
+{
+    NSCParameterAssert(length <= GPGFingerprintMaximumLength);
+    
+    memset(fingerprint, 0, sizeof(GPGFingerprint));
+    memcpy(fingerprint->bytes, bytes, length);
+    fingerprint->length = (unsigned char)length;
+    computeHash(fingerprint);
+}
+
+void GPGFingerprintGetHexChars(const GPGFingerprint *fingerprint, char *hexChars)
+{
+    static const char   hexDigits[] = "0123456789ABCDEF";
+    unsigned            i;
+    
+    for(i = 0; i < fingerprint->length; i++){
+        hexChars[2 * i] = hexDigits[fingerprint->bytes[i] >> 4];
+        hexChars[2 * i + 1] = hexDigits[fingerprint->bytes[i] & 0x0F];
+    }
+}
+
+NSString *GPGStringFromFingerprint(const GPGFingerprint *fingerprint)
+{
+    char    hexChars[2 * GPGFingerprintMaximumLength];
+    
+    if(fingerprint->length == 0)
+        return nil;
+    GPGFingerprintGetHexChars(fingerprint, hexChars);
+    
+    return [[[NSString alloc] initWithBytes:hexChars length:2 * fingerprint->length encoding:NSASCIIStringEncoding] autorelease];
+}
+
+BOOL GPGFingerprintEqual(const GPGFingerprint *fingerprint1, const GPGFingerprint *fingerprint2)
+{
+    // All bytes are compared, unused ones being zero
+    unsigned    difference = fingerprint1->length ^ fingerprint2->length;
+    unsigned    i;
+    
+    for(i = 0; i < GPGFingerprintMaximumLength; i++)
+        difference |= fingerprint1->bytes[i] ^ fingerprint2->bytes[i];
+    
+    return difference == 0;
+}
+
+unsigned GPGFingerprintHash(const GPGFingerprint *fingerprint)
+{
+    return fingerprint->hash;
+}
+
+#if defined(MAC_OS_X_VERSION_10_5) && (MAC_OS_X_VERSION_MIN_REQUIRED >= MAC_OS_X_VERSION_10_5)
+static NSUInteger fingerprintMapHash(NSMapTable *table, const void *fingerprint)
+#else
+static unsigned fingerprintMapHash(NSMapTable *table, const void *fingerprint)
+#endif
+{
+    return ((const GPGFingerprint *)fingerprint)->hash;
+}
+
+static BOOL fingerprintMapIsEqual(NSMapTable *table, const void *fingerprint1, const void *fingerprint2)
+{
+    return GPGFingerprintEqual(fingerprint1, fingerprint2);
+}
+
+static NSString *fingerprintMapDescribe(NSMapTable *table, const void *fingerprint)
+{
+    return GPGStringFromFingerprint(fingerprint);
+}
+
+static void fingerprintMapRelease(NSMapTable *table, void *fingerprint)
+{
+    NSZoneFree(NSDefaultMallocZone(), fingerprint);
+}
+
+const NSMapTableKeyCallBacks GPGFingerprintMapKeyCallBacks = {fingerprintMapHash, fingerprintMapIsEqual, NULL, NULL, fingerprintMapDescribe, NULL};
+const NSMapTableKeyCallBacks GPGOwnedFingerprintMapKeyCallBacks = {fingerprintMapHash, fingerprintMapIsEqual, NULL, fingerprintMapRelease, fingerprintMapDescribe, NULL};
+
+GPGFingerprint *GPGFingerprintCopy(const GPGFingerprint *fingerprint)
+{
+    GPGFingerprint  *aCopy = NSZoneMalloc(NSDefaultMallocZone(), sizeof(GPGFingerprint));
+    
+    *aCopy = *fingerprint;
+    
+    return aCopy;
+}
+
+NSString *GPGNormalizedHexString(NSString *string, unsigned maxLength)
+{
+    // Formatted fingerprints have spaces between digit groups
+    string = [[string uppercaseString] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+    if([string rangeOfString:@" "].location != NSNotFound)
+        string = [[string componentsSeparatedByString:@" "] componentsJoinedByString:@""];
+    if([string hasPrefix:@"0X"])
+        string = [string substringFromIndex:2];
+    if(maxLength > 0 && [string length] > maxLength)
+        string = [string substringFromIndex:[string length] - maxLength];
+    
+    return string;
+}
@@ -36,11 +36,17 @@
 #include <MacGPGME/GPGSubkey.h>
 #include <MacGPGME/GPGDefines.h>
 #include <MacGPGME/GPGKeyGroup.h>
+#include <MacGPGME/GPGKeyring.h>
 #include <MacGPGME/GPGOptions.h>
 #include <MacGPGME/GPGRemoteKey.h>
 #include <MacGPGME/GPGRemoteUserID.h>
+#include <MacGPGME/GPGSignatureGraph.h>
 #include <MacGPGME/GPGSignatureNotation.h>
 #include <gpgme.h>
+#include <stdint.h>
+#ifdef __APPLE__
+#include <libkern/OSAtomic.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -49,6 +55,36 @@ extern "C" {
 #endif
 #endif
 
+// Atomic operations, with full memory barrier: OSAtomic on Mac OS X, GCC
+// __sync builtins elsewhere (GNUstep), where libkern does not exist.
+static inline int32_t GPGAtomicIncrement32(volatile int32_t *valuePtr)
+{
+    // Returns new value
+#ifdef __APPLE__
+    return OSAtomicIncrement32Barrier(valuePtr);
+#else
+    return __sync_add_and_fetch(valuePtr, 1);
+#endif
+}
+
+static inline BOOL GPGAtomicCompareAndSwap32(int32_t oldValue, int32_t newValue, volatile int32_t *valuePtr)
+{
+#ifdef __APPLE__
+    return OSAtomicCompareAndSwap32Barrier(oldValue, newValue, valuePtr);
+#else
+    return __sync_bool_compare_and_swap(valuePtr, oldValue, newValue);
+#endif
+}
+
+static inline BOOL GPGAtomicCompareAndSwapPtr(void *oldValue, void *newValue, void * volatile *valuePtr)
+{
+#ifdef __APPLE__
+    return OSAtomicCompareAndSwapPtrBarrier(oldValue, newValue, valuePtr);
+#else
+    return __sync_bool_compare_and_swap(valuePtr, oldValue, newValue);
+#endif
+}
+
 @interface GPGRemoteUserID(GPGInternals)
 - (id) initWithKey:(GPGRemoteKey *)key index:(int)index;
 @end
@@ -67,11 +103,27 @@ extern "C" {
 - (void) setOperationMask:(int)flags;
 - (NSMutableDictionary *) operationData;
 + (NSDictionary *) parsedGroupDefinitionLine:(NSString *)groupDefLine;
+// Same as -keyEnumeratorForSearchPatterns:secretKeysOnly:contextCount:ordered:,
+// with shards of shardSize patterns; 0 uses the default size.
+- (NSEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly contextCount:(unsigned)contextCount ordered:(BOOL)ordered shardSize:(unsigned)shardSize;
 @end
 
 
+// How bytes of a GPGData are stored; determines how it can be copied.
+// Data created with -initWithInternalRepresentation: is considered as
+// gpgme memory data, unless told otherwise.
+typedef enum {
+    GPGDataMemoryBacking = 0,
+    GPGDataSharedMemoryBacking,
+    GPGDataSecureMemoryBacking,
+    GPGDataFileDescriptorBacking,
+    GPGDataSegmentsBacking,
+    GPGDataUncopyableBacking
+} GPGDataBackingType;
+
 @interface GPGData(GPGInternals)
 - (gpgme_data_t) gpgmeData;
+- (void) setBackingType:(GPGDataBackingType)backingType;
 @end
 
 
@@ -95,6 +147,7 @@ extern "C" {
 @interface GPGUserID(GPGInternals)
 - (id) initWithInternalRepresentation:(void *)aPtr key:(GPGKey *)key;
 - (NSDictionary *) dictionaryRepresentation;
+- (void) setLoadedSignatures:(NSArray *)signatures;
 @end
 
 
@@ -116,7 +169,6 @@ extern "C" {
 
 @interface GPGObject(GPGInternals)
 + (BOOL) needsPointerUniquing;
-+ (NSRecursiveLock *) pointerUniquingTableLock;
 - (void) registerUniquePointer;
 - (void) unregisterUniquePointer;
 @end
@@ -134,8 +186,73 @@ extern "C" {
 @end
 
 
+// Keyrings built from given keys, e.g. by tests and benchmarks: they are not
+// refreshed automatically.
+@interface GPGKeyring(GPGInternals)
+- (id) _initWithKeys:(NSArray *)keys secretKeys:(BOOL)secretKeys;
+- (void) _refreshKeysWithFingerprints:(NSArray *)fingerprints listedKeys:(NSArray *)keys;
+@end
+
+
+// Graphs built from given certifications: each one is an array with the long
+// key ID of a key, an array of the key IDs of its subkeys, and a set of the
+// long key IDs of its signers. They are not refreshed automatically.
+@interface GPGSignatureGraph(GPGInternals)
+- (id) _initWithCertifications:(NSArray *)certifications;
+- (void) _refreshKeysWithFingerprints:(NSArray *)fingerprints certifications:(NSArray *)certifications;
+@end
+
+
 GPG_EXPORT NSString *GPGStringFromChars(const char * chars);
 
+// Returns an immutable string reading chars in place, without copying them;
+// key, which owns chars, is referenced while string is alive. Returns nil
+// when chars is NULL.
+GPG_EXPORT NSString *GPGStringFromKeyChars(const char *chars, gpgme_key_t key);
+
+// Returns string cached at location, building it with GPGStringFromKeyChars()
+// and publishing it with GPGPublishLazyObject() on first call; location owns
+// the string. Returns nil when chars is NULL.
+GPG_EXPORT NSString *GPGCachedStringFromKeyChars(NSString **location, const char *chars, gpgme_key_t key);
+
+// Map table keys which are GPGFingerprint pointers. Non-owned keys must stay
+// valid while in table, e.g. point into the mapped GPGKey; owned keys are
+// copies made with GPGFingerprintCopy, freed when removed. As a key is not
+// replaced when inserting an equal one, remove it first.
+GPG_EXPORT const NSMapTableKeyCallBacks GPGFingerprintMapKeyCallBacks;
+GPG_EXPORT const NSMapTableKeyCallBacks GPGOwnedFingerprintMapKeyCallBacks;
+GPG_EXPORT GPGFingerprint *GPGFingerprintCopy(const GPGFingerprint *fingerprint);
+
+// Returns fingerprint or key ID string uppercased, without 0x prefix nor
+// spaces, like those of formatted fingerprints. When maxLength is not 0, only
+// the last maxLength digits are kept, e.g. 16 to get the long key ID of a
+// fingerprint.
+GPG_EXPORT NSString *GPGNormalizedHexString(NSString *string, unsigned maxLength);
+
+// Internal observers of GPGKeyringChangedNotification observe both the local
+// and the distributed notification centers; they must ignore distributed
+// notifications posted by the current process, which has already posted the
+// same change locally, else each change would be processed twice.
+GPG_EXPORT BOOL GPGNotificationIsFromCurrentProcess(NSNotification *notification);
+
+// Returns normalized fingerprints of keys changed or deleted, as notified by
+// a GPGKeyringChangedNotification, local or distributed. Returns an empty
+// array when notification does not tell which keys changed.
+GPG_EXPORT NSArray *GPGChangedKeyFingerprints(NSNotification *notification);
+
+// Lock-free one-time initialization of lazily built instance variables:
+// publishes newObject (retained) into *location, unless another thread
+// already published an object there, in which case newObject is released.
+// Returns the published object.
+GPG_EXPORT id GPGPublishLazyObject(id *location, id newObject);
+
+// Secure memory: fixed-size blocks of locked memory, wiped when freed
+GPG_EXPORT size_t GPGSecureBlockSize(void);
+GPG_EXPORT void *GPGSecureBlockAllocate(void);
+GPG_EXPORT void GPGSecureBlockFree(void *block);
+GPG_EXPORT void GPGSecureWipe(void *bytes, size_t length);
+GPG_EXPORT gpgme_error_t GPGSecureDataNew(gpgme_data_t *dataPtr);
+
 #ifdef __cplusplus
 }
 #endif
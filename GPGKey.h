@@ -32,6 +32,7 @@
 #include <MacGPGME/GPGEngine.h>
 #include <MacGPGME/GPGContext.h>
 #include <MacGPGME/GPGKeyDefines.h>
+#include <MacGPGME/GPGFingerprint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -76,13 +77,14 @@ extern "C" {
 {
     NSArray	*_subkeys; // Array containing GPGSubkey objects
     NSArray	*_userIDs; // Array containing GPGUserID objects
-    NSData	*_photoData;
-    BOOL	_checkedPhotoData;
+    id		_photoData; // NSData, or NSNull when key has no photo
+    GPGFingerprint  _packedFingerprint; // Set when key is wrapped
 }
 
 /*!
  *  @method     hash
  *  @abstract   Returns hash value based on <i>fingerprint</i>.
+ *  @discussion Hash value is computed once, when key is created.
  */
 - (unsigned) hash;
 
@@ -91,6 +93,8 @@ extern "C" {
  *  @abstract   Returns <code>YES</code> if both the receiver and <i>anObject</i>
  *              have the same <i>fingerprint</i>, are both subclasses of GPGKey,
  *              and are both public or secret keys.
+ *  @discussion Fingerprints are compared in binary form, without creating 
+ *              any string.
  *  @param      anObject An object to compare to
  */
 - (BOOL) isEqual:(id)anObject;
@@ -127,14 +131,20 @@ extern "C" {
 /*!
  *  @method     publicKey
  *  @abstract   If key is the public key, returns itself, else returns the 
- *              corresponding secret key if there is one, else nil.
+ *              corresponding public key if there is one, else nil.
+ *  @discussion Keys of the default keyring are paired once, using a single
+ *              key listing for public keys and one for secret keys; following
+ *              invocations return cached keys, without invoking the crypto
+ *              engine, until <code>@link //macgpg/c/data/GPGKeyringChangedNotification GPGKeyringChangedNotification@/link</code>
+ *              is posted.
  */
 - (GPGKey *) publicKey;
 
 /*!
  *  @method     secretKey
  *  @abstract   If key is the secret key, returns itself, else returns the
- *              corresponding public key if there is one, else nil.
+ *              corresponding secret key if there is one, else nil.
+ *  @discussion See <code>@link publicKey publicKey@/link</code>.
  */
 - (GPGKey *) secretKey;
 
@@ -280,6 +290,16 @@ extern "C" {
  */
 - (NSString *) fingerprint;
 
+/*!
+ *  @method     packedFingerprint
+ *  @abstract   Returns <i>main key fingerprint</i> in binary form.
+ *  @discussion Fingerprint is parsed once, when key is created; its length is
+ *              0 when key has no fingerprint. Returned pointer is valid as 
+ *              long as the receiver.
+ *  @seealso    //macgpg/occ/instm/GPGKey/fingerprint fingerprint
+ */
+- (const GPGFingerprint *) packedFingerprint;
+
 /*!
  *  @method     formattedFingerprint
  *  @abstract   Returns <i>main key fingerprint</i> in hex digit formatted form.
@@ -537,6 +557,43 @@ extern "C" {
  */
 - (GPGKeyListMode) keyListMode;
 
+
+/*!
+ *  @methodgroup Signatures
+ */
+
+/*!
+ *  @method     loadSignaturesOfKeys:
+ *  @abstract   Fetches signatures on the <i>user IDs</i> of <i>keys</i>, 
+ *              which have been listed without the 
+ *              <code>@link //macgpg/c/econst/GPGKeyListModeSignatures GPGKeyListModeSignatures@/link</code>
+ *              mode.
+ *  @discussion Keys are listed again with signatures, up to 64 keys per 
+ *              engine invocation, and signatures are then available from
+ *              <code>@link //macgpg/occ/instm/GPGUserID/signatures signatures@/link</code>
+ *              (GPGUserID) on the user IDs of <i>keys</i>. Listings can then
+ *              use the cheap mode, and fetch signatures only for the keys
+ *              which need them.
+ *
+ *              Keys whose signatures are already available are skipped. User
+ *              IDs which no longer exist in the keyring get no signatures.
+ *  @param      keys Array of <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
+ *              objects
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed.
+ */
++ (void) loadSignaturesOfKeys:(NSArray *)keys;
+
+/*!
+ *  @method     loadSignatures
+ *  @abstract   Fetches signatures on the <i>user IDs</i> of the key.
+ *  @discussion See 
+ *              <code>@link loadSignaturesOfKeys: loadSignaturesOfKeys:@/link</code>.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when key cannot be listed.
+ */
+- (void) loadSignatures;
+
 @end
 
 #ifdef __cplusplus
@@ -34,6 +34,9 @@
 
 #define _key	((gpgme_key_t)_internalRepresentation)
 
+// Maximum number of keys whose signatures are listed by one gpg invocation
+#define SIGNATURE_LOADING_BATCH_SIZE    64
+
 
 NSString *GPGStringFromChars(const char * chars)
 {
@@ -62,6 +65,123 @@ NSString *GPGStringFromChars(const char * chars)
 }
 
 
+// Immutable string reading bytes of a gpgme key in place; key is referenced
+// while string is alive. ASCII strings are never decoded; others are decoded
+// on first access, like GPGStringFromChars does.
+@interface _GPGKeyString : NSString
+{
+    const char  *_bytes;
+    unsigned    _byteCount;
+    BOOL        _isASCII;
+    gpgme_key_t _gpgmeKey;
+    NSString    *_decodedString;
+}
+
+- (id) initWithChars:(const char *)chars byteCount:(unsigned)byteCount isASCII:(BOOL)isASCII gpgmeKey:(gpgme_key_t)key;
+
+@end
+
+@implementation _GPGKeyString
+
+- (id) initWithChars:(const char *)chars byteCount:(unsigned)byteCount isASCII:(BOOL)isASCII gpgmeKey:(gpgme_key_t)key
+{
+    if(self = [self init]){
+        _bytes = chars;
+        _byteCount = byteCount;
+        _isASCII = isASCII;
+        _gpgmeKey = key;
+        gpgme_key_ref(key);
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [_decodedString release];
+    gpgme_key_unref(_gpgmeKey);
+    
+    [super dealloc];
+}
+
+- (NSString *) decodedString
+{
+    NSString    *decodedString = _decodedString;
+    
+    if(decodedString == nil)
+        decodedString = GPGPublishLazyObject(&_decodedString, [GPGStringFromChars(_bytes) retain]);
+    
+    return decodedString;
+}
+
+- (id) copyWithZone:(NSZone *)zone
+{
+    return [self retain];
+}
+
+- (unsigned) length
+{
+    return (_isASCII ? _byteCount : [[self decodedString] length]);
+}
+
+- (unichar) characterAtIndex:(unsigned)index
+{
+    if(!_isASCII)
+        return [[self decodedString] characterAtIndex:index];
+    if(index >= _byteCount)
+        [NSException raise:NSRangeException format:@"Index %u out of bounds (%u)", index, _byteCount];
+    
+    return (unsigned char)_bytes[index];
+}
+
+- (void) getCharacters:(unichar *)buffer range:(NSRange)aRange
+{
+    unsigned    i;
+    
+    if(!_isASCII){
+        [[self decodedString] getCharacters:buffer range:aRange];
+        return;
+    }
+    if(NSMaxRange(aRange) > _byteCount)
+        [NSException raise:NSRangeException format:@"Range %@ out of bounds (%u)", NSStringFromRange(aRange), _byteCount];
+    for(i = 0; i < aRange.length; i++)
+        buffer[i] = (unsigned char)_bytes[aRange.location + i];
+}
+
+- (const char *) UTF8String
+{
+    return (_isASCII ? _bytes : [[self decodedString] UTF8String]);
+}
+
+@end
+
+
+NSString *GPGStringFromKeyChars(const char *chars, gpgme_key_t key)
+{
+    // Bytes are scanned once, for their count and for non-ASCII characters
+    const char      *aByte;
+    unsigned char   highBits = 0;
+    
+    if(chars == NULL)
+        return nil;
+    if(key == NULL)
+        return GPGStringFromChars(chars);
+    for(aByte = chars; *aByte != '\0'; aByte++)
+        highBits |= (unsigned char)*aByte;
+    
+    return [[[_GPGKeyString alloc] initWithChars:chars byteCount:(unsigned)(aByte - chars) isASCII:!(highBits & 0x80) gpgmeKey:key] autorelease];
+}
+
+NSString *GPGCachedStringFromKeyChars(NSString **location, const char *chars, gpgme_key_t key)
+{
+    NSString    *aString = *location;
+    
+    if(aString == nil && chars != NULL)
+        aString = GPGPublishLazyObject(location, [GPGStringFromKeyChars(chars, key) retain]);
+    
+    return aString;
+}
+
 // Retain/release strategy
 // A GPGKey owns GPGUserID instances, as well as GPGSubkey instances, and
 // a GPGUserID instance owns GPGKeySignature instances. How to make sure
@@ -82,6 +202,132 @@ NSString *GPGStringFromChars(const char * chars)
 // ref counts.
 
 
+// Public and secret keys of the default keyring are paired by fingerprint.
+// Tables are filled in bulk, by one public key listing and one secret key
+// listing, on first lookup, and they are emptied when the keyring changes,
+// locally or in another process. Listings are run outside of the lock, so
+// that lookups of other threads, and invalidation, do not wait for the
+// engine; tables listed before a keyring change answer only the lookup which
+// listed them, and are not published.
+@interface _GPGKeyPairingCache : NSObject
++ (GPGKey *) keyWithFingerprint:(const GPGFingerprint *)fingerprint secret:(BOOL)secret;
+@end
+
+@implementation _GPGKeyPairingCache
+
+static NSLock       *keyPairingLock = nil;
+static NSMapTable   *publicKeysByFingerprint = NULL; // Fingerprints belong to keys
+static NSMapTable   *secretKeysByFingerprint = NULL;
+static unsigned     keyPairingGeneration = 0; // Incremented on each keyring change
+
++ (void) initialize
+{
+    if(keyPairingLock == nil){
+        keyPairingLock = [[NSLock alloc] init];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(keyringDidChange:) name:GPGKeyringChangedNotification object:nil];
+        [[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(keyringDidChange:) name:GPGKeyringChangedNotification object:nil];
+    }
+}
+
++ (NSMapTable *) newKeysByFingerprintForSecretKeys:(BOOL)secret
+{
+    GPGContext  *aContext = [[GPGContext alloc] init];
+    NSMapTable  *keysByFingerprint = NSCreateMapTable(GPGFingerprintMapKeyCallBacks, NSObjectMapValueCallBacks, 256);
+
+    NS_DURING
+        NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPattern:nil secretKeysOnly:secret];
+        GPGKey          *aKey;
+        
+        while((aKey = [keyEnum nextObject]) != nil){
+            const GPGFingerprint    *aFingerprint = [aKey packedFingerprint];
+            
+            if(aFingerprint->length > 0){
+                NSMapRemove(keysByFingerprint, aFingerprint);
+                NSMapInsert(keysByFingerprint, aFingerprint, aKey);
+            }
+        }
+        [aContext stopKeyEnumeration];
+        [aContext release];
+    NS_HANDLER
+        [aContext stopKeyEnumeration];
+        [aContext release];
+        NSFreeMapTable(keysByFingerprint);
+        [localException raise];
+    NS_ENDHANDLER
+    
+    return keysByFingerprint;
+}
+
++ (GPGKey *) keyWithFingerprint:(const GPGFingerprint *)fingerprint secret:(BOOL)secret
+{
+    GPGKey      *aKey = nil;
+    NSMapTable  *publicKeys;
+    NSMapTable  *secretKeys;
+    unsigned    aGeneration;
+    
+    [keyPairingLock lock];
+    if(publicKeysByFingerprint != NULL)
+        aKey = [(GPGKey *)NSMapGet((secret ? secretKeysByFingerprint : publicKeysByFingerprint), fingerprint) retain];
+    aGeneration = keyPairingGeneration;
+    publicKeys = publicKeysByFingerprint;
+    [keyPairingLock unlock];
+    if(publicKeys != NULL)
+        return [aKey autorelease];
+    
+    publicKeys = [self newKeysByFingerprintForSecretKeys:NO];
+    NS_DURING
+        secretKeys = [self newKeysByFingerprintForSecretKeys:YES];
+    NS_HANDLER
+        NSFreeMapTable(publicKeys);
+        [localException raise];
+    NS_ENDHANDLER
+    
+    [keyPairingLock lock];
+    if(publicKeysByFingerprint != NULL){
+        // Published by another thread in the meantime
+        aKey = [(GPGKey *)NSMapGet((secret ? secretKeysByFingerprint : publicKeysByFingerprint), fingerprint) retain];
+    }
+    else{
+        aKey = [(GPGKey *)NSMapGet((secret ? secretKeys : publicKeys), fingerprint) retain];
+        if(aGeneration == keyPairingGeneration){
+            publicKeysByFingerprint = publicKeys;
+            secretKeysByFingerprint = secretKeys;
+            publicKeys = secretKeys = NULL;
+        }
+    }
+    [keyPairingLock unlock];
+    if(publicKeys != NULL){
+        NSFreeMapTable(publicKeys);
+        NSFreeMapTable(secretKeys);
+    }
+    
+    return [aKey autorelease];
+}
+
++ (void) keyringDidChange:(NSNotification *)notification
+{
+    NSMapTable  *publicKeys;
+    NSMapTable  *secretKeys;
+    
+    if(GPGNotificationIsFromCurrentProcess(notification))
+        return; // Already notified locally
+    [keyPairingLock lock];
+    keyPairingGeneration++;
+    publicKeys = publicKeysByFingerprint;
+    secretKeys = secretKeysByFingerprint;
+    publicKeysByFingerprint = NULL;
+    secretKeysByFingerprint = NULL;
+    [keyPairingLock unlock];
+    // Keys are released outside of the lock
+    if(publicKeys != NULL){
+        NSFreeMapTable(publicKeys);
+        NSFreeMapTable(secretKeys);
+    }
+}
+
+@end
+
+
 @implementation GPGKey
 // BUG: with gpg <= 1.2.x, secret keys have wrong attributes
 // The following attributes are in fact always 0 for secret keys, because gpg
@@ -114,18 +360,19 @@ NSString *GPGStringFromChars(const char * chars)
 
 - (unsigned) hash
 {
-    NSString	*fingerprint = [self fingerprint];
-    
-    if(fingerprint != nil)
-        return [fingerprint hash];
+    if(_packedFingerprint.length > 0)
+        return GPGFingerprintHash(&_packedFingerprint);
     // We do not take in account if key is secret or not, and if it is a subkey or not.
     return [super hash];
 }
 
 - (BOOL) isEqual:(id)anObject
 {
-  if(anObject != nil && [anObject isKindOfClass:[GPGKey class]] && [self isSecret] == [anObject isSecret])
-	return [[self fingerprint] isEqualToString:[anObject fingerprint]];
+    if(anObject != nil && [anObject isKindOfClass:[GPGKey class]] && [self isSecret] == [anObject isSecret]){
+        if(_packedFingerprint.length > 0)
+            return GPGFingerprintEqual(&_packedFingerprint, [anObject packedFingerprint]);
+        return [[self fingerprint] isEqualToString:[anObject fingerprint]];
+    }
     return NO;
 }
 
@@ -144,47 +391,16 @@ NSString *GPGStringFromChars(const char * chars)
 {
     if(![self isSecret])
         return self;
-    else{
-        // TODO: Cache result
-        GPGContext	*aContext = [[GPGContext alloc] init];
-        GPGKey		*aKey = nil;
-
-		NS_DURING
-			aKey = [[aContext keyEnumeratorForSearchPattern:[@"0x" stringByAppendingString:[self fingerprint]] secretKeysOnly:NO] nextObject]; // We assume that there is only one key returned (with the same fingerprint)
-			[aKey retain];
-			[aContext stopKeyEnumeration];
-			[aContext release];
-		NS_HANDLER
-			[aContext stopKeyEnumeration];
-			[aContext release];
-			[localException raise];
-		NS_ENDHANDLER
-
-        return [aKey autorelease];
-    }
+    else
+        return [_GPGKeyPairingCache keyWithFingerprint:&_packedFingerprint secret:NO];
 }
 
 - (GPGKey *) secretKey
 {
     if([self isSecret])
         return self;
-    else{
-        GPGContext	*aContext = [[GPGContext alloc] init];
-        GPGKey		*aKey = nil;
-
-		NS_DURING
-			aKey = [[aContext keyEnumeratorForSearchPattern:[@"0x" stringByAppendingString:[self fingerprint]] secretKeysOnly:YES] nextObject]; // We assume that there is only one key returned (with the same fingerprint)
-			[aKey retain];
-			[aContext stopKeyEnumeration];
-			[aContext release];
-		NS_HANDLER
-			[aContext stopKeyEnumeration];
-			[aContext release];
-			[localException raise];
-		NS_ENDHANDLER
-
-        return [aKey autorelease];
-    }
+    else
+        return [_GPGKeyPairingCache keyWithFingerprint:&_packedFingerprint secret:YES];
 }
 
 - (NSDictionary *) dictionaryRepresentation
@@ -260,22 +476,26 @@ NSString *GPGStringFromChars(const char * chars)
 
 - (NSArray *) subkeys
 {
-    if(_subkeys == nil){
+    // Key can be shared by threads: array is built without lock, and
+    // published only once.
+    NSArray *subkeys = _subkeys;
+    
+    if(subkeys == nil){
         gpgme_subkey_t	aSubkey = _key->subkeys;
         NSZone			*aZone = [self zone];
-
-        _subkeys = [[NSMutableArray allocWithZone:aZone] init];
+        NSMutableArray  *newSubkeys = [[NSMutableArray allocWithZone:aZone] init];
 
         while(aSubkey != NULL){
             GPGSubkey	*newSubkey = [[GPGSubkey allocWithZone:aZone] initWithInternalRepresentation:aSubkey key:self];
 
-            [(NSMutableArray *)_subkeys addObject:newSubkey];
+            [newSubkeys addObject:newSubkey];
             [newSubkey release];
             aSubkey = aSubkey->next;
         }
+        subkeys = GPGPublishLazyObject(&_subkeys, newSubkeys);
     }
 
-    return _subkeys;
+    return subkeys;
 }
 
 - (NSString *) fingerprint
@@ -283,6 +503,11 @@ NSString *GPGStringFromChars(const char * chars)
     return [[[self subkeys] objectAtIndex:0] fingerprint];
 }
 
+- (const GPGFingerprint *) packedFingerprint
+{
+    return &_packedFingerprint;
+}
+
 + (NSString *) formattedFingerprint:(NSString *)fingerprint
 {
     if(fingerprint != nil && [fingerprint length] == 40){
@@ -353,22 +578,25 @@ NSString *GPGStringFromChars(const char * chars)
 
 - (NSArray *) userIDs
 {
-    if(_userIDs == nil){
+    // See -subkeys
+    NSArray *userIDs = _userIDs;
+    
+    if(userIDs == nil){
         gpgme_user_id_t	aUserID = _key->uids;
         NSZone			*aZone = [self zone];
-
-        _userIDs = [[NSMutableArray allocWithZone:aZone] init];
+        NSMutableArray  *newUserIDs = [[NSMutableArray allocWithZone:aZone] init];
 
         while(aUserID != NULL){
             GPGUserID	*newUserID = [[GPGUserID allocWithZone:aZone] initWithInternalRepresentation:aUserID key:self];
             
-            [(NSMutableArray *)_userIDs addObject:newUserID];
+            [newUserIDs addObject:newUserID];
             [newUserID release];
             aUserID = aUserID->next;
         }
+        userIDs = GPGPublishLazyObject(&_userIDs, newUserIDs);
     }
 
-    return _userIDs;
+    return userIDs;
 }
 
 - (NSString *) name
@@ -469,17 +697,17 @@ NSString *GPGStringFromChars(const char * chars)
 
 - (NSString *) issuerSerial
 {
-    return GPGStringFromChars(_key->issuer_serial);
+    return GPGStringFromKeyChars(_key->issuer_serial, _key);
 }
 
 - (NSString *) issuerName
 {
-    return GPGStringFromChars(_key->issuer_name);
+    return GPGStringFromKeyChars(_key->issuer_name, _key);
 }
 
 - (NSString *) chainID
 {
-    return GPGStringFromChars(_key->chain_id);
+    return GPGStringFromKeyChars(_key->chain_id, _key);
 }
 
 - (GPGProtocol) supportedProtocol
@@ -499,7 +727,10 @@ NSString *GPGStringFromChars(const char * chars)
     if([self supportedProtocol] != GPGOpenPGPProtocol)
         [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorNotImplemented) userInfo:nil] raise];
         
-    if(!_checkedPhotoData){
+    // When there is no photo, NSNull is published
+    id  photoData = _photoData;
+    
+    if(photoData == nil){
         NSTask	*aTask = [[NSTask alloc] init];
 
         NS_DURING
@@ -517,17 +748,19 @@ NSString *GPGStringFromChars(const char * chars)
             [aTask setStandardError:[NSFileHandle fileHandleWithNullDevice]];
             [aTask launch];
             [aTask waitUntilExit];
-            _photoData = [[NSData alloc] initWithContentsOfFile:aPath];
+            photoData = [[NSData alloc] initWithContentsOfFile:aPath];
             (void)[[NSFileManager defaultManager] removeFileAtPath:aPath handler:nil];
         NS_HANDLER
             NSLog(@"Something happened with the photo: %@", localException);
         NS_ENDHANDLER
 
         [aTask release];
-        _checkedPhotoData = YES;
+        if(photoData == nil)
+            photoData = [[NSNull null] retain];
+        photoData = GPGPublishLazyObject(&_photoData, photoData);
     }
 
-    return _photoData;
+    return (photoData == [NSNull null] ? nil : photoData);
 }
 
 - (GPGKeyListMode) keyListMode
@@ -535,6 +768,87 @@ NSString *GPGStringFromChars(const char * chars)
     return _key->keylist_mode;
 }
 
++ (void) loadSignaturesOfKeys:(NSArray *)keys
+{
+    // Keys are listed again in signature mode, by batches; signatures of the
+    // listed copies are attached to user IDs of the original keys, which
+    // keep their cheap gpgme structures.
+    NSMutableArray  *pendingKeys = [NSMutableArray arrayWithCapacity:[keys count]];
+    NSEnumerator    *keyEnum = [keys objectEnumerator];
+    GPGKey          *aKey;
+    unsigned        aBatchStart;
+    
+    while((aKey = [keyEnum nextObject]) != nil)
+        if(!([aKey keyListMode] & GPGKeyListModeSignatures) && [aKey fingerprint] != nil && [[aKey userIDs] count] > 0 && [[[aKey userIDs] lastObject] signatures] == nil)
+            [pendingKeys addObject:aKey];
+    
+    for(aBatchStart = 0; aBatchStart < [pendingKeys count]; aBatchStart += SIGNATURE_LOADING_BATCH_SIZE){
+        NSArray             *someKeys = [pendingKeys subarrayWithRange:NSMakeRange(aBatchStart, MIN(SIGNATURE_LOADING_BATCH_SIZE, [pendingKeys count] - aBatchStart))];
+        NSMutableArray      *patterns = [NSMutableArray arrayWithCapacity:[someKeys count]];
+        NSMapTable          *listedKeys = NSCreateMapTable(GPGFingerprintMapKeyCallBacks, NSObjectMapValueCallBacks, [someKeys count]);
+        GPGContext          *aContext = [[GPGContext alloc] init];
+        
+        keyEnum = [someKeys objectEnumerator];
+        while((aKey = [keyEnum nextObject]) != nil)
+            [patterns addObject:[@"0x" stringByAppendingString:[aKey fingerprint]]];
+        
+        NS_DURING
+            NSEnumerator    *listedKeyEnum;
+            GPGKey          *aListedKey;
+            
+            [aContext setKeyListMode:GPGKeyListModeLocal | GPGKeyListModeSignatures];
+            listedKeyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO];
+            while((aListedKey = [listedKeyEnum nextObject]) != nil){
+                NSMapRemove(listedKeys, [aListedKey packedFingerprint]);
+                NSMapInsert(listedKeys, [aListedKey packedFingerprint], aListedKey);
+            }
+            [aContext stopKeyEnumeration];
+            [aContext release];
+        NS_HANDLER
+            [aContext stopKeyEnumeration];
+            [aContext release];
+            NSFreeMapTable(listedKeys);
+            [localException raise];
+        NS_ENDHANDLER
+        
+        keyEnum = [someKeys objectEnumerator];
+        while((aKey = [keyEnum nextObject]) != nil){
+            GPGKey          *aListedKey = NSMapGet(listedKeys, [aKey packedFingerprint]);
+            NSEnumerator    *userIDEnum = [[aKey userIDs] objectEnumerator];
+            GPGUserID       *aUserID;
+            
+            // User IDs are matched by their string, in case key changed since
+            // it was listed; user IDs which are no longer there get no
+            // signatures.
+            while((aUserID = [userIDEnum nextObject]) != nil){
+                NSMutableArray  *someSignatures = [[NSMutableArray allocWithZone:[aUserID zone]] init];
+                gpgme_user_id_t aListedUserID = (aListedKey != nil ? [aListedKey gpgmeKey]->uids : NULL);
+                
+                while(aListedUserID != NULL && ![GPGStringFromChars(aListedUserID->uid) isEqualToString:[aUserID userID]])
+                    aListedUserID = aListedUserID->next;
+                if(aListedUserID != NULL){
+                    gpgme_key_sig_t aSignature;
+                    
+                    for(aSignature = aListedUserID->signatures; aSignature != NULL; aSignature = aSignature->next){
+                        GPGKeySignature *newSignature = [[GPGKeySignature allocWithZone:[aUserID zone]] initWithKeySignature:aSignature userID:aUserID];
+                        
+                        [someSignatures addObject:newSignature];
+                        [newSignature release];
+                    }
+                }
+                [aUserID setLoadedSignatures:someSignatures];
+                [someSignatures release];
+            }
+        }
+        NSFreeMapTable(listedKeys);
+    }
+}
+
+- (void) loadSignatures
+{
+    [[self class] loadSignaturesOfKeys:[NSArray arrayWithObject:self]];
+}
+
 @end
 
 
@@ -552,8 +866,14 @@ NSString *GPGStringFromChars(const char * chars)
     id	originalSelf = self;
 
     if(self = [super initWithInternalRepresentation:aPtr]){
-        if(originalSelf == self && [[self class] usesReferencesCount])
+        // Subclasses not using references count do not wrap a gpgme_key_t,
+        // and set their packed fingerprint themselves.
+        if(originalSelf == self && [[self class] usesReferencesCount]){
             gpgme_key_ref(_key);
+            // Primary key fingerprint is parsed once, for -hash and -isEqual:
+            if(_key->subkeys != NULL && _key->subkeys->fpr != NULL)
+                (void)GPGFingerprintFromHexChars(_key->subkeys->fpr, strlen(_key->subkeys->fpr), &_packedFingerprint);
+        }
     }
 
     return self;
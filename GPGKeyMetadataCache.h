@@ -0,0 +1,192 @@
+//
+//  GPGKeyMetadataCache.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGKEYMETADATACACHE_H
+#define GPGKEYMETADATACACHE_H
+
+#include <Foundation/Foundation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+/*!
+ *  @class      GPGKeyMetadataCache
+ *  @abstract   Persistent snapshot of key metadata, which can be mapped in
+ *              memory and queried without invoking the crypto engine.
+ *  @discussion A <code>GPGKeyMetadataCache</code> object stores, in a 
+ *              versioned binary file, the metadata of all public keys, or all
+ *              secret keys: fingerprints, key IDs, user IDs, capabilities,
+ *              validity and dates. File is mapped in memory, read lazily, and
+ *              lookups by fingerprint or key ID are binary searches in sorted
+ *              indexes: a process can answer metadata queries right after
+ *              launch, without listing the whole keyring first.
+ *
+ *              File records the size, modification date (with nanoseconds,
+ *              when file system has them) and inode of the keyring files 
+ *              (pubring.kbx, pubring.gpg, secring.gpg, trustdb.gpg and the 
+ *              private-keys-v1.d directory of gpg 2.1) of the engine home
+ *              directory at the time it was built, and a hash of the content
+ *              of trustdb.gpg, which is rewritten in place. When they no
+ *              longer match, the cache is stale: it is 
+ *              still used, and rebuilt in a background thread; once rebuilt,
+ *              new file replaces the old one atomically, and queries use it.
+ *
+ *              Only OpenPGP keys are supported. A cache can be used by 
+ *              multiple threads concurrently. Metadata is returned as 
+ *              dictionaries, using the same keys as 
+ *              <code>@link //macgpg/occ/instm/GPGKey/dictionaryRepresentation dictionaryRepresentation@/link</code>
+ *              (GPGKey), plus <code>validity</code>, <code>canEncrypt</code>,
+ *              <code>canSign</code>, <code>canCertify</code> and 
+ *              <code>canAuthenticate</code>; signatures are not stored.
+ */
+@interface GPGKeyMetadataCache : NSObject
+{
+    NSString    *_path;
+    NSString    *_homeDirectory;
+    BOOL        _containsSecretKeys;
+    BOOL        _isRebuilding;
+    NSData      *_data;     // Mapped file, replaced after rebuild
+    void        *_lock;     // Protects _data and _isRebuilding
+}
+
+/*!
+ *  @method     defaultCachePathForSecretKeys:
+ *  @abstract   Returns the default path of the cache file for the public keys,
+ *              or the secret keys, of the OpenPGP engine home directory.
+ *  @discussion File is located in the user's <code>Caches</code> directory.
+ *  @param      secretKeys Path for the secret keys cache
+ */
++ (NSString *) defaultCachePathForSecretKeys:(BOOL)secretKeys;
+
+/*!
+ *  @method     initWithPath:secretKeys:
+ *  @abstract   Designated initializer. Maps the cache file at <i>path</i>,
+ *              building it first when needed.
+ *  @discussion When file does not exist, cannot be read, or has been written
+ *              by another version of MacGPGME, cache is built synchronously,
+ *              by listing all keys. When file is stale, it is used as is, and
+ *              a background rebuild is started.
+ *  @param      path Path of cache file; if nil, 
+ *              <code>@link defaultCachePathForSecretKeys: defaultCachePathForSecretKeys:@/link</code>
+ *              is used
+ *  @param      secretKeys Caches secret keys instead of public keys
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; in this case, a
+ *              <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithPath:(NSString *)path secretKeys:(BOOL)secretKeys;
+
+/*!
+ *  @method     path
+ *  @abstract   Returns the path of the cache file.
+ */
+- (NSString *) path;
+
+/*!
+ *  @method     containsSecretKeys
+ *  @abstract   Returns <code>YES</code> if receiver caches secret keys.
+ */
+- (BOOL) containsSecretKeys;
+
+/*!
+ *  @method     isStale
+ *  @abstract   Returns <code>YES</code> when keyring files have been modified
+ *              since the cache was built.
+ */
+- (BOOL) isStale;
+
+/*!
+ *  @method     isRebuilding
+ *  @abstract   Returns <code>YES</code> while a background rebuild is running.
+ */
+- (BOOL) isRebuilding;
+
+/*!
+ *  @method     rebuild
+ *  @abstract   Lists all keys, writes a new cache file, and maps it.
+ *  @discussion If file cannot be written, new metadata is kept in memory only.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; cache is left unchanged
+ *              then.
+ */
+- (void) rebuild;
+
+/*!
+ *  @method     rebuildInBackground
+ *  @abstract   Invokes <code>@link rebuild rebuild@/link</code> in a new
+ *              thread, unless a background rebuild is already running.
+ *  @discussion Errors are logged.
+ */
+- (void) rebuildInBackground;
+
+/*!
+ *  @method     count
+ *  @abstract   Returns the number of keys in the cache.
+ */
+- (unsigned) count;
+
+/*!
+ *  @method     fingerprints
+ *  @abstract   Returns the fingerprints of all primary keys, in keyring order.
+ */
+- (NSArray *) fingerprints;
+
+/*!
+ *  @method     metadataForKeyWithFingerprint:
+ *  @abstract   Returns the metadata of the key whose fingerprint, or the 
+ *              fingerprint of one of its subkeys, is <i>fingerprint</i>, or
+ *              nil.
+ *  @discussion Lookup is case-insensitive; <i>fingerprint</i> may be prefixed
+ *              with <code>0x</code>.
+ *  @param      fingerprint Fingerprint of primary key or of a subkey
+ */
+- (NSDictionary *) metadataForKeyWithFingerprint:(NSString *)fingerprint;
+
+/*!
+ *  @method     metadataForKeysWithKeyID:
+ *  @abstract   Returns the metadata of the keys whose key ID, or the key ID
+ *              of one of their subkeys, is <i>keyID</i>.
+ *  @discussion <i>keyID</i> can be a long (16 hexadecimal digits) or short
+ *              (8 hexadecimal digits) key ID, optionally prefixed with 
+ *              <code>0x</code>. Lookup is case-insensitive. Returns an empty
+ *              array when there is no such key.
+ *  @param      keyID Long or short key ID
+ */
+- (NSArray *) metadataForKeysWithKeyID:(NSString *)keyID;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGKEYMETADATACACHE_H */
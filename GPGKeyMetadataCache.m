@@ -0,0 +1,938 @@
+//
+//  GPGKeyMetadataCache.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGKeyMetadataCache.h>
+#include <MacGPGME/GPGContext.h>
+#include <MacGPGME/GPGEngine.h>
+#include <MacGPGME/GPGKey.h>
+#include <MacGPGME/GPGSubkey.h>
+#include <MacGPGME/GPGUserID.h>
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+
+
+#define _mutex	((pthread_mutex_t *)_lock)
+
+
+/*
+ * Cache file format. All integers are in native byte order; file written on a
+ * machine with another byte order is rejected, and rebuilt. All offsets are
+ * relative to the beginning of the file; sections are 8-byte aligned. Strings
+ * are UTF-8, NUL-terminated, and referenced by their offset in the string
+ * table; offset 0 is the empty string. Fingerprints and key IDs are uppercase.
+ *
+ * Only the header is read when file is mapped; records are bound-checked when
+ * accessed, so a corrupted file can give wrong metadata, but no crash.
+ */
+#define CACHE_MAGIC             0x4B4D4347  // "GCMK"
+#define CACHE_VERSION           2
+#define CACHE_BYTE_ORDER_MARK   0x01020304
+#define STAMPED_FILE_COUNT      5
+#define TRUSTDB_FILE_INDEX      3
+
+typedef struct {
+    int64_t     size;               // -1 when file does not exist
+    int64_t     modificationTime;   // In nanoseconds since 1970
+    uint64_t    inode;
+    uint64_t    contentHash;        // Only for trustdb.gpg, else 0
+} _GPGFileStamp;
+
+typedef struct {
+    uint32_t        magic;
+    uint32_t        version;
+    uint32_t        byteOrderMark;
+    uint32_t        containsSecretKeys;
+    _GPGFileStamp   stamps[STAMPED_FILE_COUNT];
+    uint32_t        homeDirectory;
+    uint32_t        keyCount;
+    uint32_t        subkeyCount;
+    uint32_t        userIDCount;
+    uint32_t        fingerprintIndexCount;
+    uint32_t        keyIDIndexCount;
+    uint32_t        keysOffset;
+    uint32_t        subkeysOffset;
+    uint32_t        userIDsOffset;
+    uint32_t        fingerprintIndexOffset;
+    uint32_t        keyIDIndexOffset;
+    uint32_t        stringsOffset;
+    uint32_t        stringsLength;
+    uint32_t        reserved;
+} _GPGCacheHeader;
+
+typedef struct {
+    uint32_t    firstSubkey;        // First one is primary key
+    uint32_t    subkeyCount;
+    uint32_t    firstUserID;
+    uint32_t    userIDCount;
+    int32_t     ownerTrust;
+    int32_t     validity;
+    uint32_t    flags;
+    uint32_t    reserved;
+} _GPGKeyRecord;
+
+typedef struct {
+    uint32_t    fingerprint;
+    uint32_t    keyID;
+    int32_t     algorithm;
+    uint32_t    length;
+    int64_t     creationTime;       // 0 when unknown
+    int64_t     expirationTime;     // 0 when key does not expire
+    uint32_t    flags;
+    uint32_t    reserved;
+} _GPGSubkeyRecord;
+
+typedef struct {
+    uint32_t    userID;
+    uint32_t    name;
+    uint32_t    email;
+    uint32_t    comment;
+    int32_t     validity;
+    uint32_t    flags;
+} _GPGUserIDRecord;
+
+typedef struct {
+    uint32_t    string;             // Fingerprint or key ID
+    uint32_t    key;
+} _GPGIndexEntry;
+
+enum {
+    _GPGRevokedFlag         = 1 << 0,
+    _GPGExpiredFlag         = 1 << 1,
+    _GPGDisabledFlag        = 1 << 2,
+    _GPGInvalidFlag         = 1 << 3,
+    _GPGSecretFlag          = 1 << 4,
+    _GPGCanEncryptFlag      = 1 << 5,
+    _GPGCanSignFlag         = 1 << 6,
+    _GPGCanCertifyFlag      = 1 << 7,
+    _GPGCanAuthenticateFlag = 1 << 8
+};
+
+// Validated pointers into cache data
+typedef struct {
+    const _GPGCacheHeader   *header;
+    const _GPGKeyRecord     *keys;
+    const _GPGSubkeyRecord  *subkeys;
+    const _GPGUserIDRecord  *userIDs;
+    const _GPGIndexEntry    *fingerprintIndex;
+    const _GPGIndexEntry    *keyIDIndex;
+    const char              *strings;
+} _GPGCacheView;
+
+
+// Secret keys of gpg >= 2.1 are files in private-keys-v1.d, which are
+// replaced by renaming: directory is modified on each change.
+static NSString * const stampedFilenames[STAMPED_FILE_COUNT] = {@"pubring.kbx", @"pubring.gpg", @"secring.gpg", @"trustdb.gpg", @"private-keys-v1.d"};
+
+
+static uint64_t addBytesToHash(uint64_t hash, const void *bytes, size_t length)
+{
+    // 64-bit FNV-1a; start with hash 0
+    const unsigned char *aByte = bytes;
+    
+    if(hash == 0)
+        hash = 0xCBF29CE484222325ULL;
+    while(length-- > 0){
+        hash ^= *aByte++;
+        hash *= 0x100000001B3ULL;
+    }
+    
+    return hash;
+}
+
+static uint64_t fileContentHash(const char *path)
+{
+    // Returns 0 when file cannot be read
+    unsigned char   aBuffer[16384];
+    uint64_t        hash = 0;
+    ssize_t         aLength;
+    int             fd = open(path, O_RDONLY);
+    
+    if(fd < 0)
+        return 0;
+    while((aLength = read(fd, aBuffer, sizeof(aBuffer))) != 0){
+        if(aLength < 0){
+            if(errno == EINTR)
+                continue;
+            hash = 0;
+            break;
+        }
+        hash = addBytesToHash(hash, aBuffer, aLength);
+    }
+    close(fd);
+    
+    return hash;
+}
+
+static void getFileStamps(NSString *homeDirectory, _GPGFileStamp *stamps)
+{
+    int i;
+    
+    for(i = 0; i < STAMPED_FILE_COUNT; i++){
+        NSString    *aPath = [homeDirectory stringByAppendingPathComponent:stampedFilenames[i]];
+        struct stat aStat;
+        
+        memset(&stamps[i], 0, sizeof(_GPGFileStamp));
+        if(stat([aPath fileSystemRepresentation], &aStat) == 0){
+            stamps[i].size = aStat.st_size;
+#ifdef __APPLE__
+            stamps[i].modificationTime = (int64_t)aStat.st_mtimespec.tv_sec * 1000000000 + aStat.st_mtimespec.tv_nsec;
+#else
+            stamps[i].modificationTime = (int64_t)aStat.st_mtim.tv_sec * 1000000000 + aStat.st_mtim.tv_nsec;
+#endif
+            stamps[i].inode = aStat.st_ino;
+            // trustdb.gpg has fixed-size records, which are rewritten in
+            // place: size and inode do not change, and file systems with a
+            // one second resolution would not see a change in the same
+            // second.
+            if(i == TRUSTDB_FILE_INDEX)
+                stamps[i].contentHash = fileContentHash([aPath fileSystemRepresentation]);
+        }
+        else
+            stamps[i].size = -1;
+    }
+}
+
+static BOOL isValidSection(NSUInteger dataLength, uint32_t offset, uint32_t count, size_t recordSize)
+{
+    return (offset % 8) == 0 && (uint64_t)offset + (uint64_t)count * recordSize <= dataLength;
+}
+
+static BOOL getCacheView(NSData *data, _GPGCacheView *view)
+{
+    // Checks only header and section bounds, in constant time
+    NSUInteger              aLength = [data length];
+    const char              *bytes = [data bytes];
+    const _GPGCacheHeader   *aHeader = (const _GPGCacheHeader *)bytes;
+    
+    if(aLength < sizeof(_GPGCacheHeader) || ((uintptr_t)bytes % 8) != 0)
+        return NO;
+    if(aHeader->magic != CACHE_MAGIC || aHeader->version != CACHE_VERSION || aHeader->byteOrderMark != CACHE_BYTE_ORDER_MARK)
+        return NO;
+    if(!isValidSection(aLength, aHeader->keysOffset, aHeader->keyCount, sizeof(_GPGKeyRecord))
+       || !isValidSection(aLength, aHeader->subkeysOffset, aHeader->subkeyCount, sizeof(_GPGSubkeyRecord))
+       || !isValidSection(aLength, aHeader->userIDsOffset, aHeader->userIDCount, sizeof(_GPGUserIDRecord))
+       || !isValidSection(aLength, aHeader->fingerprintIndexOffset, aHeader->fingerprintIndexCount, sizeof(_GPGIndexEntry))
+       || !isValidSection(aLength, aHeader->keyIDIndexOffset, aHeader->keyIDIndexCount, sizeof(_GPGIndexEntry))
+       || !isValidSection(aLength, aHeader->stringsOffset, aHeader->stringsLength, 1))
+        return NO;
+    // String table must start with the empty string and end with a NUL, so that
+    // any offset within it gives a terminated string.
+    if(aHeader->stringsLength == 0 || bytes[aHeader->stringsOffset] != '\0' || bytes[aHeader->stringsOffset + aHeader->stringsLength - 1] != '\0')
+        return NO;
+    
+    view->header = aHeader;
+    view->keys = (const _GPGKeyRecord *)(bytes + aHeader->keysOffset);
+    view->subkeys = (const _GPGSubkeyRecord *)(bytes + aHeader->subkeysOffset);
+    view->userIDs = (const _GPGUserIDRecord *)(bytes + aHeader->userIDsOffset);
+    view->fingerprintIndex = (const _GPGIndexEntry *)(bytes + aHeader->fingerprintIndexOffset);
+    view->keyIDIndex = (const _GPGIndexEntry *)(bytes + aHeader->keyIDIndexOffset);
+    view->strings = bytes + aHeader->stringsOffset;
+    
+    return YES;
+}
+
+static const char *cachedString(const _GPGCacheView *view, uint32_t offset)
+{
+    return (offset < view->header->stringsLength ? view->strings + offset : "");
+}
+
+static NSString *cachedStringObject(const _GPGCacheView *view, uint32_t offset)
+{
+    NSString    *aString = [NSString stringWithUTF8String:cachedString(view, offset)];
+    
+    return (aString != nil ? aString : @"");
+}
+
+static const _GPGSubkeyRecord *primarySubkeyRecord(const _GPGCacheView *view, const _GPGKeyRecord *keyRecord)
+{
+    if(keyRecord->subkeyCount == 0 || (uint64_t)keyRecord->firstSubkey + keyRecord->subkeyCount > view->header->subkeyCount)
+        return NULL;
+    return view->subkeys + keyRecord->firstSubkey;
+}
+
+static const char *shortKeyIDSuffix(const char *keyID)
+{
+    size_t  aLength = strlen(keyID);
+    
+    return (aLength > 8 ? keyID + aLength - 8 : keyID);
+}
+
+static int compareKeyIDs(const char *keyID, const char *otherKeyID)
+{
+    // Key ID index is sorted by short key ID first, so that short key IDs can
+    // be looked up by binary search too.
+    int result = strcmp(shortKeyIDSuffix(keyID), shortKeyIDSuffix(otherKeyID));
+    
+    return (result != 0 ? result : strcmp(keyID, otherKeyID));
+}
+
+static int compareIndexEntryKeyIDs(const void *entry, const void *otherEntry)
+{
+    return compareKeyIDs(*(const char **)entry, *(const char **)otherEntry);
+}
+
+static int compareIndexEntryStrings(const void *entry, const void *otherEntry)
+{
+    return strcmp(*(const char **)entry, *(const char **)otherEntry);
+}
+
+static uint32_t appendString(NSMutableData *strings, NSString *string)
+{
+    uint32_t    anOffset;
+    const char  *aCString;
+    
+    if([string length] == 0)
+        return 0;
+    aCString = [string UTF8String];
+    anOffset = [strings length];
+    [strings appendBytes:aCString length:strlen(aCString) + 1];
+    
+    return anOffset;
+}
+
+static void appendPadding(NSMutableData *data)
+{
+    [data increaseLengthBy:(8 - [data length] % 8) % 8];
+}
+
+static int64_t timestampFromDate(NSDate *date)
+{
+    return (date != nil ? (int64_t)[date timeIntervalSince1970] : 0);
+}
+
+static uint32_t subkeyFlags(GPGSubkey *subkey)
+{
+    uint32_t    flags = 0;
+    
+    if([subkey isKeyRevoked]) flags |= _GPGRevokedFlag;
+    if([subkey hasKeyExpired]) flags |= _GPGExpiredFlag;
+    if([subkey isKeyDisabled]) flags |= _GPGDisabledFlag;
+    if([subkey isKeyInvalid]) flags |= _GPGInvalidFlag;
+    if([subkey isSecret]) flags |= _GPGSecretFlag;
+    if([subkey canEncrypt]) flags |= _GPGCanEncryptFlag;
+    if([subkey canSign]) flags |= _GPGCanSignFlag;
+    if([subkey canCertify]) flags |= _GPGCanCertifyFlag;
+    if([subkey canAuthenticate]) flags |= _GPGCanAuthenticateFlag;
+    
+    return flags;
+}
+
+static uint32_t keyFlags(GPGKey *key)
+{
+    uint32_t    flags = 0;
+    
+    if([key isKeyRevoked]) flags |= _GPGRevokedFlag;
+    if([key hasKeyExpired]) flags |= _GPGExpiredFlag;
+    if([key isKeyDisabled]) flags |= _GPGDisabledFlag;
+    if([key isKeyInvalid]) flags |= _GPGInvalidFlag;
+    if([key isSecret]) flags |= _GPGSecretFlag;
+    if([key canEncrypt]) flags |= _GPGCanEncryptFlag;
+    if([key canSign]) flags |= _GPGCanSignFlag;
+    if([key canCertify]) flags |= _GPGCanCertifyFlag;
+    if([key canAuthenticate]) flags |= _GPGCanAuthenticateFlag;
+    
+    return flags;
+}
+
+static NSData *sortedIndexData(NSData *entries, const char *strings, int (*compare)(const void *, const void *))
+{
+    // Entries are sorted by their string; strings are referenced by pointer
+    // while sorting, as qsort() takes no context.
+    typedef struct {
+        const char      *string;
+        _GPGIndexEntry  entry;
+    } _GPGSortedEntry;
+    
+    unsigned                anEntryCount = [entries length] / sizeof(_GPGIndexEntry);
+    const _GPGIndexEntry    *someEntries = [entries bytes];
+    _GPGSortedEntry         *sortedEntries = NSZoneMalloc(NSDefaultMallocZone(), (anEntryCount ? anEntryCount : 1) * sizeof(_GPGSortedEntry));
+    NSMutableData           *aData = [NSMutableData dataWithLength:anEntryCount * sizeof(_GPGIndexEntry)];
+    _GPGIndexEntry          *outputEntries = [aData mutableBytes];
+    unsigned                i;
+    
+    for(i = 0; i < anEntryCount; i++){
+        sortedEntries[i].string = strings + someEntries[i].string;
+        sortedEntries[i].entry = someEntries[i];
+    }
+    qsort(sortedEntries, anEntryCount, sizeof(_GPGSortedEntry), compare);
+    for(i = 0; i < anEntryCount; i++)
+        outputEntries[i] = sortedEntries[i].entry;
+    NSZoneFree(NSDefaultMallocZone(), sortedEntries);
+    
+    return aData;
+}
+
+static NSMutableDictionary *subkeyMetadata(const _GPGCacheView *view, const _GPGSubkeyRecord *record, time_t now)
+{
+    NSMutableDictionary *aDict = [NSMutableDictionary dictionaryWithCapacity:16];
+    NSString            *aKeyID = cachedStringObject(view, record->keyID);
+    uint32_t            flags = record->flags;
+    BOOL                hasExpired = (flags & _GPGExpiredFlag) || (record->expirationTime != 0 && record->expirationTime < now);
+    
+    [aDict setObject:cachedStringObject(view, record->fingerprint) forKey:@"fpr"];
+    [aDict setObject:aKeyID forKey:@"keyid"];
+    [aDict setObject:([aKeyID length] > 8 ? [aKeyID substringFromIndex:[aKeyID length] - 8] : aKeyID) forKey:@"shortkeyid"];
+    [aDict setObject:[NSNumber numberWithInt:record->algorithm] forKey:@"algo"];
+    [aDict setObject:[NSNumber numberWithUnsignedInt:record->length] forKey:@"len"];
+    if(record->creationTime > 0)
+        [aDict setObject:[NSCalendarDate dateWithTimeIntervalSince1970:record->creationTime] forKey:@"created"];
+    if(record->expirationTime != 0)
+        [aDict setObject:[NSCalendarDate dateWithTimeIntervalSince1970:record->expirationTime] forKey:@"expire"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGRevokedFlag)] forKey:@"revoked"];
+    [aDict setObject:[NSNumber numberWithBool:hasExpired] forKey:@"expired"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGDisabledFlag)] forKey:@"disabled"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGInvalidFlag)] forKey:@"invalid"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGSecretFlag)] forKey:@"secret"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGCanEncryptFlag)] forKey:@"canEncrypt"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGCanSignFlag)] forKey:@"canSign"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGCanCertifyFlag)] forKey:@"canCertify"];
+    [aDict setObject:[NSNumber numberWithBool:!!(flags & _GPGCanAuthenticateFlag)] forKey:@"canAuthenticate"];
+    
+    return aDict;
+}
+
+static NSDictionary *keyMetadata(const _GPGCacheView *view, uint32_t keyIndex)
+{
+    const _GPGKeyRecord     *aRecord;
+    const _GPGSubkeyRecord  *aPrimaryRecord;
+    NSMutableDictionary     *aDict;
+    NSMutableArray          *anArray;
+    time_t                  now = time(NULL);
+    uint32_t                i;
+    
+    if(keyIndex >= view->header->keyCount)
+        return nil;
+    aRecord = view->keys + keyIndex;
+    aPrimaryRecord = primarySubkeyRecord(view, aRecord);
+    if(aPrimaryRecord == NULL)
+        return nil;
+    
+    // Key-level values are those of the primary key, except flags
+    aDict = subkeyMetadata(view, aPrimaryRecord, now);
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGRevokedFlag)] forKey:@"revoked"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGExpiredFlag) || [[aDict objectForKey:@"expired"] boolValue]] forKey:@"expired"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGDisabledFlag)] forKey:@"disabled"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGInvalidFlag)] forKey:@"invalid"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGSecretFlag)] forKey:@"secret"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGCanEncryptFlag)] forKey:@"canEncrypt"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGCanSignFlag)] forKey:@"canSign"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGCanCertifyFlag)] forKey:@"canCertify"];
+    [aDict setObject:[NSNumber numberWithBool:!!(aRecord->flags & _GPGCanAuthenticateFlag)] forKey:@"canAuthenticate"];
+    [aDict setObject:[NSNumber numberWithInt:aRecord->ownerTrust] forKey:@"ownertrust"];
+    [aDict setObject:[NSNumber numberWithInt:aRecord->validity] forKey:@"validity"];
+    
+    anArray = [NSMutableArray arrayWithCapacity:aRecord->subkeyCount];
+    for(i = 0; i < aRecord->subkeyCount; i++)
+        [anArray addObject:subkeyMetadata(view, aPrimaryRecord + i, now)];
+    [aDict setObject:anArray forKey:@"subkeys"];
+    
+    anArray = [NSMutableArray arrayWithCapacity:aRecord->userIDCount];
+    if((uint64_t)aRecord->firstUserID + aRecord->userIDCount <= view->header->userIDCount){
+        for(i = 0; i < aRecord->userIDCount; i++){
+            const _GPGUserIDRecord  *aUserIDRecord = view->userIDs + aRecord->firstUserID + i;
+            
+            [anArray addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+                cachedStringObject(view, aUserIDRecord->userID), @"raw",
+                cachedStringObject(view, aUserIDRecord->name), @"name",
+                cachedStringObject(view, aUserIDRecord->email), @"email",
+                cachedStringObject(view, aUserIDRecord->comment), @"comment",
+                [NSNumber numberWithInt:aUserIDRecord->validity], @"validity",
+                [NSNumber numberWithBool:!!(aUserIDRecord->flags & _GPGRevokedFlag)], @"revoked",
+                [NSNumber numberWithBool:!!(aUserIDRecord->flags & _GPGInvalidFlag)], @"invalid",
+                nil]];
+        }
+    }
+    [aDict setObject:anArray forKey:@"userids"];
+    
+    return aDict;
+}
+
+
+@interface GPGKeyMetadataCache(Private)
+- (NSData *) _currentData;
+- (NSData *) _newCacheDataWithStamps:(const _GPGFileStamp *)stamps;
+- (BOOL) _isUsableData:(NSData *)data;
+- (void) _rebuildInBackground:(id)unused;
+@end
+
+
+@implementation GPGKeyMetadataCache
+
++ (NSString *) defaultCachePathForSecretKeys:(BOOL)secretKeys
+{
+    // One file per engine home directory, named after a digest of its path
+    // which, unlike -hash, does not depend on Foundation release
+    NSString    *aHomeDirectory = [[GPGEngine engineForProtocol:GPGOpenPGPProtocol] homeDirectory];
+    const char  *aPath = [[aHomeDirectory stringByStandardizingPath] fileSystemRepresentation];
+    NSArray     *someDirectories = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+    NSString    *aDirectory = ([someDirectories count] > 0 ? [someDirectories objectAtIndex:0] : NSTemporaryDirectory());
+    
+    return [[aDirectory stringByAppendingPathComponent:@"MacGPGME"] stringByAppendingPathComponent:[NSString stringWithFormat:@"KeyMetadata-%016llx-%@.cache", (unsigned long long)addBytesToHash(0, aPath, strlen(aPath)), (secretKeys ? @"secret" : @"public")]];
+}
+
+- (id) init
+{
+    return [self initWithPath:nil secretKeys:NO];
+}
+
+- (id) initWithPath:(NSString *)path secretKeys:(BOOL)secretKeys
+{
+    if(self = [super init]){
+        NSData  *aData;
+        
+        _containsSecretKeys = secretKeys;
+        _homeDirectory = [[[[GPGEngine engineForProtocol:GPGOpenPGPProtocol] homeDirectory] stringByStandardizingPath] copy];
+        if(path != nil)
+            _path = [path copy];
+        else
+            _path = [[[self class] defaultCachePathForSecretKeys:secretKeys] retain];
+        _lock = NSZoneMalloc([self zone], sizeof(pthread_mutex_t));
+        pthread_mutex_init(_mutex, NULL);
+        
+        aData = [[NSData alloc] initWithContentsOfMappedFile:_path];
+        if(aData != nil && [self _isUsableData:aData])
+            _data = aData;
+        else
+            [aData release];
+        
+        if(_data == nil){
+            NS_DURING
+                [self rebuild];
+            NS_HANDLER
+                [self release];
+                [localException raise];
+            NS_ENDHANDLER
+        }
+        else if([self isStale])
+            [self rebuildInBackground];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [_path release];
+    [_homeDirectory release];
+    [_data release];
+    if(_lock != NULL){
+        pthread_mutex_destroy(_mutex);
+        NSZoneFree([self zone], _lock);
+    }
+    
+    [super dealloc];
+}
+
+- (NSString *) path
+{
+    return _path;
+}
+
+- (BOOL) containsSecretKeys
+{
+    return _containsSecretKeys;
+}
+
+- (BOOL) isStale
+{
+    _GPGCacheView   aView;
+    _GPGFileStamp   someStamps[STAMPED_FILE_COUNT];
+    
+    if(!getCacheView([self _currentData], &aView))
+        return YES;
+    getFileStamps(_homeDirectory, someStamps);
+    
+    return memcmp(someStamps, aView.header->stamps, sizeof(someStamps)) != 0;
+}
+
+- (BOOL) isRebuilding
+{
+    BOOL    isRebuilding;
+    
+    pthread_mutex_lock(_mutex);
+    isRebuilding = _isRebuilding;
+    pthread_mutex_unlock(_mutex);
+    
+    return isRebuilding;
+}
+
+- (void) rebuild
+{
+    // Stamps are taken before listing keys: if keyring is modified meanwhile,
+    // the new cache is seen as stale.
+    _GPGFileStamp   someStamps[STAMPED_FILE_COUNT];
+    NSData          *newData;
+    NSString        *aDirectory = [_path stringByDeletingLastPathComponent];
+    NSFileManager   *defaultManager = [NSFileManager defaultManager];
+    BOOL            isDirectory;
+    
+    getFileStamps(_homeDirectory, someStamps);
+    newData = [self _newCacheDataWithStamps:someStamps];
+    
+    if(![defaultManager fileExistsAtPath:aDirectory isDirectory:&isDirectory])
+        (void)[defaultManager createDirectoryAtPath:aDirectory attributes:nil];
+    // File is replaced atomically: other processes having mapped the old file
+    // keep on reading it until they remap.
+    if([newData writeToFile:_path atomically:YES]){
+        NSData  *aMappedData = [[NSData alloc] initWithContentsOfMappedFile:_path];
+        
+        if(aMappedData != nil && [self _isUsableData:aMappedData])
+            newData = aMappedData;
+        else{
+            [aMappedData release];
+            [newData retain];
+        }
+    }
+    else
+        [newData retain];
+    
+    pthread_mutex_lock(_mutex);
+    [_data release];
+    _data = newData;
+    pthread_mutex_unlock(_mutex);
+}
+
+- (void) rebuildInBackground
+{
+    BOOL    shouldStart = NO;
+    
+    pthread_mutex_lock(_mutex);
+    if(!_isRebuilding){
+        _isRebuilding = YES;
+        shouldStart = YES;
+    }
+    pthread_mutex_unlock(_mutex);
+    
+    // Thread retains receiver until done
+    if(shouldStart)
+        [NSThread detachNewThreadSelector:@selector(_rebuildInBackground:) toTarget:self withObject:nil];
+}
+
+- (unsigned) count
+{
+    _GPGCacheView   aView;
+    
+    if(!getCacheView([self _currentData], &aView))
+        return 0;
+    
+    return aView.header->keyCount;
+}
+
+- (NSArray *) fingerprints
+{
+    _GPGCacheView   aView;
+    NSMutableArray  *fingerprints;
+    uint32_t        i;
+    
+    if(!getCacheView([self _currentData], &aView))
+        return [NSArray array];
+    
+    fingerprints = [NSMutableArray arrayWithCapacity:aView.header->keyCount];
+    for(i = 0; i < aView.header->keyCount; i++){
+        const _GPGSubkeyRecord  *aPrimaryRecord = primarySubkeyRecord(&aView, aView.keys + i);
+        
+        if(aPrimaryRecord != NULL)
+            [fingerprints addObject:cachedStringObject(&aView, aPrimaryRecord->fingerprint)];
+    }
+    
+    return fingerprints;
+}
+
+- (NSDictionary *) metadataForKeyWithFingerprint:(NSString *)fingerprint
+{
+    _GPGCacheView   aView;
+    const char      *aFingerprint;
+    uint32_t        low, high;
+    
+    if(fingerprint == nil || !getCacheView([self _currentData], &aView))
+        return nil;
+    
+    aFingerprint = [GPGNormalizedHexString(fingerprint, 0) UTF8String];
+    low = 0;
+    high = aView.header->fingerprintIndexCount;
+    while(low < high){
+        uint32_t    middle = low + (high - low) / 2;
+        int         result = strcmp(cachedString(&aView, aView.fingerprintIndex[middle].string), aFingerprint);
+        
+        if(result == 0)
+            return keyMetadata(&aView, aView.fingerprintIndex[middle].key);
+        else if(result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    
+    return nil;
+}
+
+- (NSArray *) metadataForKeysWithKeyID:(NSString *)keyID
+{
+    _GPGCacheView   aView;
+    NSMutableArray  *someMetadata = [NSMutableArray array];
+    NSMutableSet    *someKeyIndexes;
+    const char      *aKeyID;
+    BOOL            isShortKeyID;
+    uint32_t        low, high;
+    
+    if(keyID == nil || !getCacheView([self _currentData], &aView))
+        return someMetadata;
+    
+    aKeyID = [GPGNormalizedHexString(keyID, 0) UTF8String];
+    isShortKeyID = (strlen(aKeyID) <= 8);
+    // Lower bound of matching entries
+    low = 0;
+    high = aView.header->keyIDIndexCount;
+    while(low < high){
+        uint32_t    middle = low + (high - low) / 2;
+        const char  *anEntryKeyID = cachedString(&aView, aView.keyIDIndex[middle].string);
+        int         result = (isShortKeyID ? strcmp(shortKeyIDSuffix(anEntryKeyID), aKeyID) : compareKeyIDs(anEntryKeyID, aKeyID));
+        
+        if(result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    
+    // A key can match through several subkeys
+    someKeyIndexes = [NSMutableSet set];
+    for(; low < aView.header->keyIDIndexCount; low++){
+        const char  *anEntryKeyID = cachedString(&aView, aView.keyIDIndex[low].string);
+        NSNumber    *aKeyIndex;
+        
+        if(strcmp((isShortKeyID ? shortKeyIDSuffix(anEntryKeyID) : anEntryKeyID), aKeyID) != 0)
+            break;
+        aKeyIndex = [NSNumber numberWithUnsignedInt:aView.keyIDIndex[low].key];
+        if(![someKeyIndexes containsObject:aKeyIndex]){
+            NSDictionary    *aDict = keyMetadata(&aView, aView.keyIDIndex[low].key);
+            
+            [someKeyIndexes addObject:aKeyIndex];
+            if(aDict != nil)
+                [someMetadata addObject:aDict];
+        }
+    }
+    
+    return someMetadata;
+}
+
+@end
+
+
+@implementation GPGKeyMetadataCache(Private)
+
+- (NSData *) _currentData
+{
+    // Returned data stays valid even if a rebuild replaces it
+    NSData  *aData;
+    
+    pthread_mutex_lock(_mutex);
+    aData = [[_data retain] autorelease];
+    pthread_mutex_unlock(_mutex);
+    
+    return aData;
+}
+
+- (BOOL) _isUsableData:(NSData *)data
+{
+    // Stale data is usable; data of another home directory is not
+    _GPGCacheView   aView;
+    
+    if(!getCacheView(data, &aView))
+        return NO;
+    if(!!aView.header->containsSecretKeys != !!_containsSecretKeys)
+        return NO;
+    
+    return strcmp(cachedString(&aView, aView.header->homeDirectory), [_homeDirectory fileSystemRepresentation]) == 0;
+}
+
+- (NSData *) _newCacheDataWithStamps:(const _GPGFileStamp *)stamps
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSMutableData   *keyRecords = [NSMutableData data];
+    NSMutableData   *subkeyRecords = [NSMutableData data];
+    NSMutableData   *userIDRecords = [NSMutableData data];
+    NSMutableData   *fingerprintEntries = [NSMutableData data];
+    NSMutableData   *keyIDEntries = [NSMutableData data];
+    NSMutableData   *strings = [NSMutableData dataWithLength:1]; // Empty string at offset 0
+    NSMutableData   *aData;
+    NSData          *sortedFingerprintEntries;
+    NSData          *sortedKeyIDEntries;
+    _GPGCacheHeader aHeader;
+    uint32_t        aHomeDirectoryOffset;
+    
+    aHomeDirectoryOffset = [strings length];
+    [strings appendBytes:[_homeDirectory fileSystemRepresentation] length:strlen([_homeDirectory fileSystemRepresentation]) + 1];
+    
+    NS_DURING
+        NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:_containsSecretKeys];
+        GPGKey          *aKey;
+        
+        while(YES){
+            NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+            NSEnumerator        *anEnum;
+            GPGSubkey           *aSubkey;
+            GPGUserID           *aUserID;
+            _GPGKeyRecord       aKeyRecord;
+            uint32_t            aKeyIndex = [keyRecords length] / sizeof(_GPGKeyRecord);
+            
+            aKey = [keyEnum nextObject];
+            if(aKey == nil){
+                [localAP release];
+                break;
+            }
+            
+            memset(&aKeyRecord, 0, sizeof(aKeyRecord));
+            aKeyRecord.firstSubkey = [subkeyRecords length] / sizeof(_GPGSubkeyRecord);
+            aKeyRecord.firstUserID = [userIDRecords length] / sizeof(_GPGUserIDRecord);
+            aKeyRecord.ownerTrust = [aKey ownerTrust];
+            aKeyRecord.validity = [aKey validity];
+            aKeyRecord.flags = keyFlags(aKey);
+            
+            anEnum = [[aKey subkeys] objectEnumerator];
+            while((aSubkey = [anEnum nextObject]) != nil){
+                _GPGSubkeyRecord    aSubkeyRecord;
+                _GPGIndexEntry      anEntry;
+                
+                memset(&aSubkeyRecord, 0, sizeof(aSubkeyRecord));
+                aSubkeyRecord.fingerprint = appendString(strings, [[aSubkey fingerprint] uppercaseString]);
+                aSubkeyRecord.keyID = appendString(strings, [[aSubkey keyID] uppercaseString]);
+                aSubkeyRecord.algorithm = [aSubkey algorithm];
+                aSubkeyRecord.length = [aSubkey length];
+                aSubkeyRecord.creationTime = timestampFromDate([aSubkey creationDate]);
+                aSubkeyRecord.expirationTime = timestampFromDate([aSubkey expirationDate]);
+                aSubkeyRecord.flags = subkeyFlags(aSubkey);
+                [subkeyRecords appendBytes:&aSubkeyRecord length:sizeof(aSubkeyRecord)];
+                aKeyRecord.subkeyCount++;
+                
+                anEntry.key = aKeyIndex;
+                if(aSubkeyRecord.fingerprint != 0){
+                    anEntry.string = aSubkeyRecord.fingerprint;
+                    [fingerprintEntries appendBytes:&anEntry length:sizeof(anEntry)];
+                }
+                if(aSubkeyRecord.keyID != 0){
+                    anEntry.string = aSubkeyRecord.keyID;
+                    [keyIDEntries appendBytes:&anEntry length:sizeof(anEntry)];
+                }
+            }
+            
+            anEnum = [[aKey userIDs] objectEnumerator];
+            while((aUserID = [anEnum nextObject]) != nil){
+                _GPGUserIDRecord    aUserIDRecord;
+                
+                memset(&aUserIDRecord, 0, sizeof(aUserIDRecord));
+                aUserIDRecord.userID = appendString(strings, [aUserID userID]);
+                aUserIDRecord.name = appendString(strings, [aUserID name]);
+                aUserIDRecord.email = appendString(strings, [aUserID email]);
+                aUserIDRecord.comment = appendString(strings, [aUserID comment]);
+                aUserIDRecord.validity = [aUserID validity];
+                if([aUserID hasBeenRevoked])
+                    aUserIDRecord.flags |= _GPGRevokedFlag;
+                if([aUserID isInvalid])
+                    aUserIDRecord.flags |= _GPGInvalidFlag;
+                [userIDRecords appendBytes:&aUserIDRecord length:sizeof(aUserIDRecord)];
+                aKeyRecord.userIDCount++;
+            }
+            
+            [keyRecords appendBytes:&aKeyRecord length:sizeof(aKeyRecord)];
+            [localAP release];
+        }
+        [aContext stopKeyEnumeration];
+        [aContext release];
+    NS_HANDLER
+        [aContext stopKeyEnumeration];
+        [aContext release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    sortedFingerprintEntries = sortedIndexData(fingerprintEntries, [strings bytes], compareIndexEntryStrings);
+    sortedKeyIDEntries = sortedIndexData(keyIDEntries, [strings bytes], compareIndexEntryKeyIDs);
+    
+    memset(&aHeader, 0, sizeof(aHeader));
+    aHeader.magic = CACHE_MAGIC;
+    aHeader.version = CACHE_VERSION;
+    aHeader.byteOrderMark = CACHE_BYTE_ORDER_MARK;
+    aHeader.containsSecretKeys = _containsSecretKeys;
+    memcpy(aHeader.stamps, stamps, sizeof(aHeader.stamps));
+    aHeader.homeDirectory = aHomeDirectoryOffset;
+    aHeader.keyCount = [keyRecords length] / sizeof(_GPGKeyRecord);
+    aHeader.subkeyCount = [subkeyRecords length] / sizeof(_GPGSubkeyRecord);
+    aHeader.userIDCount = [userIDRecords length] / sizeof(_GPGUserIDRecord);
+    aHeader.fingerprintIndexCount = [sortedFingerprintEntries length] / sizeof(_GPGIndexEntry);
+    aHeader.keyIDIndexCount = [sortedKeyIDEntries length] / sizeof(_GPGIndexEntry);
+    aHeader.stringsLength = [strings length];
+    
+    aData = [NSMutableData dataWithCapacity:sizeof(aHeader) + [keyRecords length] + [subkeyRecords length] + [userIDRecords length] + [sortedFingerprintEntries length] + [sortedKeyIDEntries length] + [strings length] + 48];
+    [aData appendBytes:&aHeader length:sizeof(aHeader)];
+    appendPadding(aData);
+    aHeader.keysOffset = [aData length];
+    [aData appendData:keyRecords];
+    appendPadding(aData);
+    aHeader.subkeysOffset = [aData length];
+    [aData appendData:subkeyRecords];
+    appendPadding(aData);
+    aHeader.userIDsOffset = [aData length];
+    [aData appendData:userIDRecords];
+    appendPadding(aData);
+    aHeader.fingerprintIndexOffset = [aData length];
+    [aData appendData:sortedFingerprintEntries];
+    appendPadding(aData);
+    aHeader.keyIDIndexOffset = [aData length];
+    [aData appendData:sortedKeyIDEntries];
+    appendPadding(aData);
+    aHeader.stringsOffset = [aData length];
+    [aData appendData:strings];
+    // Header is written again, now with section offsets
+    [aData replaceBytesInRange:NSMakeRange(0, sizeof(aHeader)) withBytes:&aHeader];
+    
+    return aData;
+}
+
+- (void) _rebuildInBackground:(id)unused
+{
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    
+    NS_DURING
+        [self rebuild];
+    NS_HANDLER
+        NSLog(@"### Unable to rebuild key metadata cache '%@': %@", _path, localException);
+    NS_ENDHANDLER
+    
+    pthread_mutex_lock(_mutex);
+    _isRebuilding = NO;
+    pthread_mutex_unlock(_mutex);
+    [localAP release];
+}
+
+@end
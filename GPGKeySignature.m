@@ -37,18 +37,22 @@
 {
     // See GPGKey.m for more information
     [_signedUserID retain];
-    _refCount++;
+    GPGAtomicIncrement32(&_refCount);
 
     return self;
 }
 
 - (oneway void) release
 {
-    // See GPGKey.m for more information
-    if(_refCount > 0){
-        _refCount--;
+    // See GPGKey.m for more information. Internal ref count is modified
+    // atomically, because keys can be shared by threads.
+    int32_t	aCount;
+    
+    do{
+        aCount = _refCount;
+    }while(aCount > 0 && !GPGAtomicCompareAndSwap32(aCount, aCount - 1, &_refCount));
+    if(aCount > 0)
         [_signedUserID release];
-    }
     else{
         if(_refCount < 0)
             NSLog(@"### GPGKeySignature: _refCount < 0! (%d)", _refCount);
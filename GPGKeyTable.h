@@ -0,0 +1,263 @@
+//
+//  GPGKeyTable.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGKEYTABLE_H
+#define GPGKEYTABLE_H
+
+#include <Foundation/Foundation.h>
+#include <MacGPGME/GPGContext.h>
+#include <MacGPGME/GPGKey.h>
+#include <MacGPGME/GPGKeyDefines.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+/*!
+ *  @class      GPGKeyTable
+ *  @abstract   Read-only table of keys, parsed from the colon listing of the
+ *              OpenPGP engine.
+ *  @discussion A <code>GPGKeyTable</code> object is meant for bulk processing
+ *              of very large key rings, where creating a gpgme key and a
+ *              <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code> per key
+ *              is the bottleneck. Engine output is parsed while being read
+ *              from a pipe, and discarded; key attributes are stored in
+ *              parallel arrays (one per attribute) of fixed-width values:
+ *              fingerprints and key IDs are kept in binary form, dates as
+ *              32-bit timestamps. User ID strings are interned in a single
+ *              buffer. A key with one subkey and one user ID takes about 130
+ *              bytes plus its distinct strings, an order of magnitude less
+ *              than a <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>
+ *              with its gpgme key. Objects are created only by accessors.
+ *
+ *              Keys are identified by their index in the table, in key ring
+ *              order. Signatures are not listed. A table can be used by 
+ *              multiple threads concurrently.
+ */
+@interface GPGKeyTable : NSObject
+{
+    void    *_table;
+    BOOL    _containsSecretKeys;
+}
+
+/*!
+ *  @method     keyTableWithContext:searchPatterns:secretKeysOnly:
+ *  @abstract   Lists keys with the OpenPGP engine of <i>context</i>, and 
+ *              returns a table containing them.
+ *  @discussion The engine is launched with the executable path and home 
+ *              directory of <i>context</i>'s engine; <i>context</i> itself is
+ *              not busy. Patterns matching no key are ignored.
+ *  @param      context Context whose engine configuration is used
+ *  @param      searchPatterns Array of pattern strings; nil or empty array
+ *              lists all keys
+ *  @param      secretKeysOnly Lists secret keys only
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception (<code>@link //macgpg/c/econst/GPGErrorUnsupportedProtocol GPGErrorUnsupportedProtocol@/link</code>)
+ *              when <i>context</i>'s protocol is not OpenPGP, or 
+ *              GPGException exception when engine failed.
+ */
++ (id) keyTableWithContext:(GPGContext *)context searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly;
+
+/*!
+ *  @method     initWithFileHandle:secretKeys:
+ *  @abstract   Designated initializer. Reads and parses a colon key listing
+ *              from <i>fileHandle</i>, until end of file.
+ *  @discussion Listing must have been made with <code>--with-colons 
+ *              --fixed-list-mode</code>, and <code>--with-fingerprint</code>
+ *              twice, to get subkey fingerprints.
+ *  @param      fileHandle Handle to read listing from, e.g. a pipe
+ *  @param      secretKeys Listing is of secret keys
+ *  @exception  <code>@link //apple_ref/c/data/NSFileHandleOperationException NSFileHandleOperationException@/link</code>
+ *              exception when reading fails; in this case, a
+ *              <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithFileHandle:(NSFileHandle *)fileHandle secretKeys:(BOOL)secretKeys;
+
+/*!
+ *  @method     containsSecretKeys
+ *  @abstract   Returns <code>YES</code> if table contains secret keys.
+ */
+- (BOOL) containsSecretKeys;
+
+/*!
+ *  @method     count
+ *  @abstract   Returns the number of keys in the table.
+ */
+- (unsigned) count;
+
+/*!
+ *  @method     storageSize
+ *  @abstract   Returns the number of bytes allocated by the table.
+ */
+- (unsigned long long) storageSize;
+
+/*!
+ *  @method     indexOfKeyWithFingerprint:
+ *  @abstract   Returns the index of the key whose primary key fingerprint is
+ *              <i>fingerprint</i>, or <code>NSNotFound</code>.
+ *  @discussion Fingerprint is parsed like by <code>@link //macgpg/c/func/GPGFingerprintFromString GPGFingerprintFromString@/link</code>:
+ *              lookup is case-insensitive, and <i>fingerprint</i> may be 
+ *              prefixed with <code>0x</code> and contain spaces. 
+ *              Fingerprints are hashed once, when listing has been read.
+ *  @param      fingerprint Fingerprint of primary key
+ */
+- (unsigned) indexOfKeyWithFingerprint:(NSString *)fingerprint;
+
+/*!
+ *  @method     fingerprintOfKeyAtIndex:
+ *  @abstract   Returns the fingerprint of the primary key.
+ *  @param      index Index of key
+ */
+- (NSString *) fingerprintOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     keyIDOfKeyAtIndex:
+ *  @abstract   Returns the long key ID of the primary key.
+ *  @param      index Index of key
+ */
+- (NSString *) keyIDOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     algorithmOfKeyAtIndex:
+ *  @abstract   Returns the algorithm of the primary key.
+ *  @param      index Index of key
+ */
+- (GPGPublicKeyAlgorithm) algorithmOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     lengthOfKeyAtIndex:
+ *  @abstract   Returns the length, in bits, of the primary key.
+ *  @param      index Index of key
+ */
+- (unsigned int) lengthOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     creationDateOfKeyAtIndex:
+ *  @abstract   Returns the creation date of the primary key, or nil when 
+ *              unknown.
+ *  @param      index Index of key
+ */
+- (NSCalendarDate *) creationDateOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     expirationDateOfKeyAtIndex:
+ *  @abstract   Returns the expiration date of the primary key, or nil when it
+ *              does not expire.
+ *  @param      index Index of key
+ */
+- (NSCalendarDate *) expirationDateOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     validityOfKeyAtIndex:
+ *  @abstract   Returns the validity of the key.
+ *  @param      index Index of key
+ */
+- (GPGValidity) validityOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     ownerTrustOfKeyAtIndex:
+ *  @abstract   Returns the owner trust of the key.
+ *  @param      index Index of key
+ */
+- (GPGValidity) ownerTrustOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     keyAtIndex:matchesFilterMask:minimumValidity:
+ *  @abstract   Returns <code>YES</code> if key has all capabilities and 
+ *              properties requested by <i>filterMask</i>, and at least
+ *              <i>minimumValidity</i>.
+ *  @discussion Same rules as <code>@link //macgpg/occ/instm/GPGContext(GPGKeyManagement)/keyEnumeratorForSearchPatterns:secretKeysOnly:filterMask:minimumValidity: keyEnumeratorForSearchPatterns:secretKeysOnly:filterMask:minimumValidity:@/link</code>
+ *              (GPGContext), except that key validity is used.
+ *  @param      index Index of key
+ *  @param      filterMask Requested capabilities and properties
+ *  @param      minimumValidity Minimum validity
+ */
+- (BOOL) keyAtIndex:(unsigned)index matchesFilterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity;
+
+/*!
+ *  @method     subkeyCountOfKeyAtIndex:
+ *  @abstract   Returns the number of subkeys, including the primary key.
+ *  @param      index Index of key
+ */
+- (unsigned) subkeyCountOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     userIDCountOfKeyAtIndex:
+ *  @abstract   Returns the number of user IDs of the key.
+ *  @param      index Index of key
+ */
+- (unsigned) userIDCountOfKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     userID:ofKeyAtIndex:
+ *  @abstract   Returns the user ID string at <i>userIDIndex</i>; user ID at
+ *              index 0 is the primary one.
+ *  @param      userIDIndex Index of user ID in key
+ *  @param      index Index of key
+ */
+- (NSString *) userID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     validityOfUserID:ofKeyAtIndex:
+ *  @abstract   Returns the validity of the user ID at <i>userIDIndex</i>.
+ *  @param      userIDIndex Index of user ID in key
+ *  @param      index Index of key
+ */
+- (GPGValidity) validityOfUserID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index;
+
+/*!
+ *  @method     keyAtIndex:
+ *  @abstract   Returns a read-only proxy on the key at <i>index</i>.
+ *  @discussion Proxy retains the table, and reads its attributes from it on
+ *              each invocation; it is not cached. It answers to the 
+ *              attribute, validity and capability methods of 
+ *              <code>@link //macgpg/occ/cl/GPGKey GPGKey@/link</code>, and is
+ *              equal to keys with same fingerprint and secret status. Its
+ *              user IDs, including <code>primaryUserID</code>, are proxies
+ *              too, and <code>name</code>, <code>email</code> and 
+ *              <code>comment</code> are parsed from the table's user ID 
+ *              strings, like gpgme does. It has no subkey objects: 
+ *              <code>subkeys</code> returns nil.
+ *
+ *              Proxy cannot be used in context operations; get the real key 
+ *              with <code>@link //macgpg/occ/instm/GPGContext(GPGKeyManagement)/keyFromFingerprint:secretKey: keyFromFingerprint:secretKey:@/link</code>
+ *              (GPGContext).
+ *  @param      index Index of key
+ */
+- (GPGKey *) keyAtIndex:(unsigned)index;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGKEYTABLE_H */
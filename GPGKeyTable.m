@@ -0,0 +1,1184 @@
+//
+//  GPGKeyTable.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGKeyTable.h>
+#include <MacGPGME/GPGEngine.h>
+#include <MacGPGME/GPGExceptions.h>
+#include <MacGPGME/GPGKey.h>
+#include <MacGPGME/GPGPrettyInfo.h>
+#include <MacGPGME/GPGInternals.h>
+#include "GPGEngineHelper.h"
+#include <Foundation/Foundation.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define _storage	((_GPGKeyTableStorage *)_table)
+
+// Minimum free space in buffer before each read
+#define READ_CHUNK_SIZE     65536
+
+// Widest fingerprint, in bytes; v3 ones use 16, v4 ones 20
+#define FINGERPRINT_COLUMN_WIDTH    GPGFingerprintMaximumLength
+
+
+/*
+ * Keys, subkeys and user IDs are stored as parallel arrays, one per 
+ * attribute, with fixed-width values: fingerprints and key IDs are stored in
+ * binary form, dates as 32-bit timestamps. User ID strings are the only 
+ * variable-length values; they are interned in a single arena, and are not
+ * NUL-terminated. Colon output is read in a small window, which holds only
+ * the lines not yet parsed.
+ */
+typedef struct {
+    uint32_t    offset;
+    uint32_t    length;
+} _GPGStringSlice;
+
+enum {
+    _GPGUserIDNamePart = 0,
+    _GPGUserIDEmailPart,
+    _GPGUserIDCommentPart
+};
+
+enum {
+    _GPGRevokedFlag         = 1 << 0,
+    _GPGExpiredFlag         = 1 << 1,
+    _GPGDisabledFlag        = 1 << 2,
+    _GPGInvalidFlag         = 1 << 3,
+    _GPGSecretFlag          = 1 << 4,
+    _GPGCanEncryptFlag      = 1 << 5,
+    _GPGCanSignFlag         = 1 << 6,
+    _GPGCanCertifyFlag      = 1 << 7,
+    _GPGCanAuthenticateFlag = 1 << 8
+};
+
+typedef struct {
+    char            *buffer;
+    size_t          bufferLength;
+    size_t          bufferCapacity;
+    
+    char            *strings;
+    uint32_t        stringsLength;
+    uint32_t        stringsCapacity;
+    _GPGStringSlice *internedSlots;         // Used only while reading
+    uint32_t        internedSlotCount;
+    uint32_t        internedCount;
+    
+    uint32_t        keyCount;
+    uint32_t        keyCapacity;
+    uint32_t        *keyFirstSubkeys;       // First one is primary key
+    uint32_t        *keyFirstUserIDs;
+    int8_t          *keyValidities;
+    int8_t          *keyOwnerTrusts;
+    uint16_t        *keyFlags;
+    
+    uint32_t        subkeyCount;
+    uint32_t        subkeyCapacity;
+    uint8_t         (*subkeyFingerprints)[FINGERPRINT_COLUMN_WIDTH];
+    uint8_t         *subkeyFingerprintLengths;  // 0 when not listed
+    uint64_t        *subkeyIDs;
+    uint8_t         *subkeyAlgorithms;
+    uint16_t        *subkeyLengths;
+    uint32_t        *subkeyCreationTimes;   // 0 when unknown
+    uint32_t        *subkeyExpirationTimes; // 0 when subkey does not expire
+    uint16_t        *subkeyFlags;
+    
+    uint32_t        userIDCount;
+    uint32_t        userIDCapacity;
+    _GPGStringSlice *userIDs;
+    int8_t          *userIDValidities;
+    uint16_t        *userIDFlags;
+    
+    uint32_t        *fingerprintSlots;      // Key index + 1, 0 when empty
+    uint32_t        fingerprintSlotCount;   // Power of 2
+} _GPGKeyTableStorage;
+
+
+static void *resizedArray(void *array, uint32_t count, size_t elementSize)
+{
+    return NSZoneRealloc(NSDefaultMallocZone(), array, (count > 0 ? count : 1) * elementSize);
+}
+
+static void resizeKeyArrays(_GPGKeyTableStorage *storage, uint32_t capacity)
+{
+    storage->keyFirstSubkeys = resizedArray(storage->keyFirstSubkeys, capacity, sizeof(uint32_t));
+    storage->keyFirstUserIDs = resizedArray(storage->keyFirstUserIDs, capacity, sizeof(uint32_t));
+    storage->keyValidities = resizedArray(storage->keyValidities, capacity, sizeof(int8_t));
+    storage->keyOwnerTrusts = resizedArray(storage->keyOwnerTrusts, capacity, sizeof(int8_t));
+    storage->keyFlags = resizedArray(storage->keyFlags, capacity, sizeof(uint16_t));
+    storage->keyCapacity = capacity;
+}
+
+static void resizeSubkeyArrays(_GPGKeyTableStorage *storage, uint32_t capacity)
+{
+    storage->subkeyFingerprints = resizedArray(storage->subkeyFingerprints, capacity, FINGERPRINT_COLUMN_WIDTH);
+    storage->subkeyFingerprintLengths = resizedArray(storage->subkeyFingerprintLengths, capacity, sizeof(uint8_t));
+    storage->subkeyIDs = resizedArray(storage->subkeyIDs, capacity, sizeof(uint64_t));
+    storage->subkeyAlgorithms = resizedArray(storage->subkeyAlgorithms, capacity, sizeof(uint8_t));
+    storage->subkeyLengths = resizedArray(storage->subkeyLengths, capacity, sizeof(uint16_t));
+    storage->subkeyCreationTimes = resizedArray(storage->subkeyCreationTimes, capacity, sizeof(uint32_t));
+    storage->subkeyExpirationTimes = resizedArray(storage->subkeyExpirationTimes, capacity, sizeof(uint32_t));
+    storage->subkeyFlags = resizedArray(storage->subkeyFlags, capacity, sizeof(uint16_t));
+    storage->subkeyCapacity = capacity;
+}
+
+static void resizeUserIDArrays(_GPGKeyTableStorage *storage, uint32_t capacity)
+{
+    storage->userIDs = resizedArray(storage->userIDs, capacity, sizeof(_GPGStringSlice));
+    storage->userIDValidities = resizedArray(storage->userIDValidities, capacity, sizeof(int8_t));
+    storage->userIDFlags = resizedArray(storage->userIDFlags, capacity, sizeof(uint16_t));
+    storage->userIDCapacity = capacity;
+}
+
+static void freeStorage(_GPGKeyTableStorage *storage)
+{
+    NSZone  *aZone = NSDefaultMallocZone();
+    
+    NSZoneFree(aZone, storage->buffer);
+    NSZoneFree(aZone, storage->strings);
+    NSZoneFree(aZone, storage->internedSlots);
+    NSZoneFree(aZone, storage->keyFirstSubkeys);
+    NSZoneFree(aZone, storage->keyFirstUserIDs);
+    NSZoneFree(aZone, storage->keyValidities);
+    NSZoneFree(aZone, storage->keyOwnerTrusts);
+    NSZoneFree(aZone, storage->keyFlags);
+    NSZoneFree(aZone, storage->subkeyFingerprints);
+    NSZoneFree(aZone, storage->subkeyFingerprintLengths);
+    NSZoneFree(aZone, storage->subkeyIDs);
+    NSZoneFree(aZone, storage->subkeyAlgorithms);
+    NSZoneFree(aZone, storage->subkeyLengths);
+    NSZoneFree(aZone, storage->subkeyCreationTimes);
+    NSZoneFree(aZone, storage->subkeyExpirationTimes);
+    NSZoneFree(aZone, storage->subkeyFlags);
+    NSZoneFree(aZone, storage->userIDs);
+    NSZoneFree(aZone, storage->userIDValidities);
+    NSZoneFree(aZone, storage->userIDFlags);
+    NSZoneFree(aZone, storage->fingerprintSlots);
+    NSZoneFree(aZone, storage);
+}
+
+static size_t storageSize(const _GPGKeyTableStorage *storage)
+{
+    size_t  aKeySize = 2 * sizeof(uint32_t) + 2 * sizeof(int8_t) + sizeof(uint16_t);
+    size_t  aSubkeySize = FINGERPRINT_COLUMN_WIDTH + sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint16_t) + 2 * sizeof(uint32_t) + sizeof(uint16_t);
+    size_t  aUserIDSize = sizeof(_GPGStringSlice) + sizeof(int8_t) + sizeof(uint16_t);
+    
+    return sizeof(_GPGKeyTableStorage) + storage->bufferCapacity + storage->stringsCapacity + storage->internedSlotCount * sizeof(_GPGStringSlice) + storage->keyCapacity * aKeySize + storage->subkeyCapacity * aSubkeySize + storage->userIDCapacity * aUserIDSize + storage->fingerprintSlotCount * sizeof(uint32_t);
+}
+
+static int hexDigitValue(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static GPGValidity validityFromColonField(const char *field, unsigned length)
+{
+    if(length == 0)
+        return GPGValidityUnknown;
+    switch(field[0]){
+        case 'q':
+            return GPGValidityUndefined;
+        case 'n':
+            return GPGValidityNever;
+        case 'm':
+            return GPGValidityMarginal;
+        case 'f':
+            return GPGValidityFull;
+        case 'u':
+            return GPGValidityUltimate;
+        default:
+            return GPGValidityUnknown;
+    }
+}
+
+static uint16_t flagsFromColonFields(const char **fields, const unsigned *lengths, BOOL keyWideCapabilities)
+{
+    // Uppercase capabilities are the key-wide ones
+    const char  *someCapabilities = fields[COLON_CAPABILITIES_FIELD];
+    unsigned    aLength = lengths[COLON_CAPABILITIES_FIELD];
+    uint16_t    flags = 0;
+    
+    if(GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'r'))
+        flags |= _GPGRevokedFlag;
+    if(GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'e'))
+        flags |= _GPGExpiredFlag;
+    if(GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'i'))
+        flags |= _GPGInvalidFlag;
+    if(GPGColonFieldContains(someCapabilities, aLength, 'D'))
+        flags |= _GPGDisabledFlag;
+    if(GPGColonFieldContains(someCapabilities, aLength, (keyWideCapabilities ? 'E' : 'e')))
+        flags |= _GPGCanEncryptFlag;
+    if(GPGColonFieldContains(someCapabilities, aLength, (keyWideCapabilities ? 'S' : 's')))
+        flags |= _GPGCanSignFlag;
+    if(GPGColonFieldContains(someCapabilities, aLength, (keyWideCapabilities ? 'C' : 'c')))
+        flags |= _GPGCanCertifyFlag;
+    if(GPGColonFieldContains(someCapabilities, aLength, (keyWideCapabilities ? 'A' : 'a')))
+        flags |= _GPGCanAuthenticateFlag;
+    
+    return flags;
+}
+
+static uint32_t hashOfBytes(const char *bytes, uint32_t length)
+{
+    // FNV-1a
+    uint32_t    aHash = 2166136261U;
+    uint32_t    i;
+    
+    for(i = 0; i < length; i++)
+        aHash = (aHash ^ (uint8_t)bytes[i]) * 16777619U;
+    
+    return aHash;
+}
+
+static void resizeInternedSlots(_GPGKeyTableStorage *storage, uint32_t slotCount)
+{
+    // Empty slots have offset UINT32_MAX; slotCount is a power of 2
+    _GPGStringSlice *oldSlots = storage->internedSlots;
+    uint32_t        oldSlotCount = storage->internedSlotCount;
+    uint32_t        i;
+    
+    storage->internedSlots = NSZoneMalloc(NSDefaultMallocZone(), slotCount * sizeof(_GPGStringSlice));
+    memset(storage->internedSlots, 0xFF, slotCount * sizeof(_GPGStringSlice));
+    storage->internedSlotCount = slotCount;
+    for(i = 0; i < oldSlotCount; i++){
+        if(oldSlots[i].offset != UINT32_MAX){
+            uint32_t    j = hashOfBytes(storage->strings + oldSlots[i].offset, oldSlots[i].length) & (slotCount - 1);
+            
+            while(storage->internedSlots[j].offset != UINT32_MAX)
+                j = (j + 1) & (slotCount - 1);
+            storage->internedSlots[j] = oldSlots[i];
+        }
+    }
+    NSZoneFree(NSDefaultMallocZone(), oldSlots);
+}
+
+static _GPGStringSlice internedSlice(_GPGKeyTableStorage *storage, const char *bytes, uint32_t length)
+{
+    // Same strings share the same slice of the arena
+    uint32_t        i;
+    _GPGStringSlice aSlice;
+    
+    if(4 * (storage->internedCount + 1) > 3 * storage->internedSlotCount)
+        resizeInternedSlots(storage, 2 * storage->internedSlotCount);
+    i = hashOfBytes(bytes, length) & (storage->internedSlotCount - 1);
+    while(storage->internedSlots[i].offset != UINT32_MAX){
+        aSlice = storage->internedSlots[i];
+        if(aSlice.length == length && memcmp(storage->strings + aSlice.offset, bytes, length) == 0)
+            return aSlice;
+        i = (i + 1) & (storage->internedSlotCount - 1);
+    }
+    
+    if(storage->stringsCapacity - storage->stringsLength < length){
+        storage->stringsCapacity = MAX(2 * storage->stringsCapacity, storage->stringsLength + length);
+        storage->strings = NSZoneRealloc(NSDefaultMallocZone(), storage->strings, storage->stringsCapacity);
+    }
+    memcpy(storage->strings + storage->stringsLength, bytes, length);
+    aSlice.offset = storage->stringsLength;
+    aSlice.length = length;
+    storage->stringsLength += length;
+    storage->internedSlots[i] = aSlice;
+    storage->internedCount++;
+    
+    return aSlice;
+}
+
+static _GPGStringSlice unescapedInternedSlice(_GPGKeyTableStorage *storage, const char *field, unsigned length)
+{
+    // Replaces \xXX sequences in place; result is never longer
+    char        *aString = (char *)field;
+    unsigned    aLength = 0, i;
+    
+    for(i = 0; i < length; i++){
+        if(aString[i] == '\\' && i + 3 < length && aString[i + 1] == 'x' && isxdigit((unsigned char)aString[i + 2]) && isxdigit((unsigned char)aString[i + 3])){
+            aString[aLength++] = (char)(hexDigitValue(aString[i + 2]) << 4 | hexDigitValue(aString[i + 3]));
+            i += 3;
+        }
+        else
+            aString[aLength++] = aString[i];
+    }
+    
+    return internedSlice(storage, aString, aLength);
+}
+
+static void indexFingerprints(_GPGKeyTableStorage *storage)
+{
+    // Primary key fingerprints are hashed in open addressing slots, at most
+    // half full; first key wins, like a scan in key ring order.
+    uint32_t    aSlotCount = 16;
+    uint32_t    i;
+    
+    while(aSlotCount < 2 * storage->keyCount)
+        aSlotCount *= 2;
+    storage->fingerprintSlots = NSZoneCalloc(NSDefaultMallocZone(), aSlotCount, sizeof(uint32_t));
+    storage->fingerprintSlotCount = aSlotCount;
+    for(i = 0; i < storage->keyCount; i++){
+        uint32_t        aSubkeyIndex = storage->keyFirstSubkeys[i];
+        uint8_t         aLength = storage->subkeyFingerprintLengths[aSubkeyIndex];
+        GPGFingerprint  aFingerprint;
+        uint32_t        j;
+        
+        if(aLength == 0)
+            continue;
+        GPGFingerprintFromBytes(storage->subkeyFingerprints[aSubkeyIndex], aLength, &aFingerprint);
+        j = GPGFingerprintHash(&aFingerprint) & (aSlotCount - 1);
+        while(storage->fingerprintSlots[j] != 0){
+            uint32_t    anOtherSubkeyIndex = storage->keyFirstSubkeys[storage->fingerprintSlots[j] - 1];
+            
+            if(storage->subkeyFingerprintLengths[anOtherSubkeyIndex] == aLength && memcmp(storage->subkeyFingerprints[anOtherSubkeyIndex], storage->subkeyFingerprints[aSubkeyIndex], aLength) == 0)
+                break;
+            j = (j + 1) & (aSlotCount - 1);
+        }
+        if(storage->fingerprintSlots[j] == 0)
+            storage->fingerprintSlots[j] = i + 1;
+    }
+}
+
+static unsigned indexOfFingerprint(const _GPGKeyTableStorage *storage, const GPGFingerprint *fingerprint)
+{
+    uint32_t    j = GPGFingerprintHash(fingerprint) & (storage->fingerprintSlotCount - 1);
+    
+    while(storage->fingerprintSlots[j] != 0){
+        uint32_t    aKeyIndex = storage->fingerprintSlots[j] - 1;
+        uint32_t    aSubkeyIndex = storage->keyFirstSubkeys[aKeyIndex];
+        
+        if(storage->subkeyFingerprintLengths[aSubkeyIndex] == fingerprint->length && memcmp(storage->subkeyFingerprints[aSubkeyIndex], fingerprint->bytes, fingerprint->length) == 0)
+            return aKeyIndex;
+        j = (j + 1) & (storage->fingerprintSlotCount - 1);
+    }
+    
+    return NSNotFound;
+}
+
+static void appendSubkey(_GPGKeyTableStorage *storage, const char **fields, const unsigned *lengths, BOOL isSecret)
+{
+    uint32_t        i = storage->subkeyCount;
+    GPGFingerprint  aKeyID;
+    unsigned long   aTime;
+    
+    if(i == storage->subkeyCapacity)
+        resizeSubkeyArrays(storage, storage->subkeyCapacity * 2);
+    storage->subkeyFingerprintLengths[i] = 0; // Set by following fpr record
+    // Long key ID is parsed like a fingerprint of 8 bytes
+    if(GPGFingerprintFromHexChars(fields[COLON_KEYID_FIELD], lengths[COLON_KEYID_FIELD], &aKeyID) && aKeyID.length == 8){
+        unsigned    j;
+        
+        storage->subkeyIDs[i] = 0;
+        for(j = 0; j < aKeyID.length; j++)
+            storage->subkeyIDs[i] = storage->subkeyIDs[i] << 8 | aKeyID.bytes[j];
+    }
+    else
+        storage->subkeyIDs[i] = 0;
+    storage->subkeyAlgorithms[i] = (uint8_t)GPGColonFieldNumber(fields[COLON_ALGORITHM_FIELD], lengths[COLON_ALGORITHM_FIELD]);
+    storage->subkeyLengths[i] = (uint16_t)MIN(GPGColonFieldNumber(fields[COLON_LENGTH_FIELD], lengths[COLON_LENGTH_FIELD]), UINT16_MAX);
+    aTime = GPGColonFieldNumber(fields[COLON_CREATED_FIELD], lengths[COLON_CREATED_FIELD]);
+    storage->subkeyCreationTimes[i] = (uint32_t)MIN(aTime, UINT32_MAX);
+    aTime = GPGColonFieldNumber(fields[COLON_EXPIRES_FIELD], lengths[COLON_EXPIRES_FIELD]);
+    storage->subkeyExpirationTimes[i] = (uint32_t)MIN(aTime, UINT32_MAX);
+    storage->subkeyFlags[i] = flagsFromColonFields(fields, lengths, NO) | (isSecret ? _GPGSecretFlag : 0);
+    storage->subkeyCount++;
+}
+
+static void parseColonRecord(_GPGKeyTableStorage *storage, char *aLine, size_t length, BOOL isSecret)
+{
+    const char  *fields[COLON_FIELD_COUNT];
+    unsigned    lengths[COLON_FIELD_COUNT];
+    
+    if(length > 0 && aLine[length - 1] == '\r')
+        length--;
+    (void)GPGSplitColonRecord(aLine, (unsigned)length, fields, lengths);
+    
+    if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "pub") || GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "sec")){
+        uint32_t    i = storage->keyCount;
+        
+        if(i == storage->keyCapacity)
+            resizeKeyArrays(storage, storage->keyCapacity * 2);
+        storage->keyFirstSubkeys[i] = storage->subkeyCount;
+        storage->keyFirstUserIDs[i] = storage->userIDCount;
+        storage->keyValidities[i] = (int8_t)validityFromColonField(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD]);
+        storage->keyOwnerTrusts[i] = (int8_t)validityFromColonField(fields[COLON_OWNERTRUST_FIELD], lengths[COLON_OWNERTRUST_FIELD]);
+        storage->keyFlags[i] = flagsFromColonFields(fields, lengths, YES) | (isSecret ? _GPGSecretFlag : 0);
+        storage->keyCount++;
+        appendSubkey(storage, fields, lengths, isSecret);
+    }
+    else if(storage->keyCount > 0){
+        if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "sub") || GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "ssb"))
+            appendSubkey(storage, fields, lengths, isSecret);
+        else if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "fpr")){
+            uint32_t        i = storage->subkeyCount - 1;
+            GPGFingerprint  aFingerprint;
+            
+            (void)GPGFingerprintFromHexChars(fields[COLON_USERID_FIELD], lengths[COLON_USERID_FIELD], &aFingerprint);
+            memcpy(storage->subkeyFingerprints[i], aFingerprint.bytes, FINGERPRINT_COLUMN_WIDTH);
+            storage->subkeyFingerprintLengths[i] = aFingerprint.length; // 0 when invalid
+        }
+        else if(GPGColonFieldIs(fields[COLON_TYPE_FIELD], lengths[COLON_TYPE_FIELD], "uid")){
+            uint32_t    i = storage->userIDCount;
+            uint16_t    flags = 0;
+            
+            if(i == storage->userIDCapacity)
+                resizeUserIDArrays(storage, storage->userIDCapacity * 2);
+            if(GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'r'))
+                flags |= _GPGRevokedFlag;
+            if(GPGColonFieldContains(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD], 'i'))
+                flags |= _GPGInvalidFlag;
+            storage->userIDs[i] = unescapedInternedSlice(storage, fields[COLON_USERID_FIELD], lengths[COLON_USERID_FIELD]);
+            storage->userIDValidities[i] = (int8_t)validityFromColonField(fields[COLON_VALIDITY_FIELD], lengths[COLON_VALIDITY_FIELD]);
+            storage->userIDFlags[i] = flags;
+            storage->userIDCount++;
+        }
+        // Other records (tru, rvk, grp, uat...) are ignored
+    }
+}
+
+static _GPGKeyTableStorage *readStorage(int fileDescriptor, BOOL isSecret, int *errorPtr)
+{
+    // Parses each complete line as soon as it has been read, then discards it
+    _GPGKeyTableStorage *storage = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGKeyTableStorage));
+    
+    *errorPtr = 0;
+    resizeKeyArrays(storage, 256);
+    resizeSubkeyArrays(storage, 512);
+    resizeUserIDArrays(storage, 512);
+    resizeInternedSlots(storage, 1024);
+    
+    while(YES){
+        ssize_t     aReadLength;
+        size_t      aParsedLength = 0;
+        const char  *aLineEnd;
+        
+        if(storage->bufferCapacity - storage->bufferLength < READ_CHUNK_SIZE){
+            storage->bufferCapacity = MAX(2 * storage->bufferCapacity, storage->bufferLength + READ_CHUNK_SIZE);
+            storage->buffer = NSZoneRealloc(NSDefaultMallocZone(), storage->buffer, storage->bufferCapacity);
+        }
+        aReadLength = read(fileDescriptor, storage->buffer + storage->bufferLength, storage->bufferCapacity - storage->bufferLength);
+        if(aReadLength < 0 && errno == EINTR)
+            continue;
+        if(aReadLength < 0){
+            *errorPtr = errno;
+            freeStorage(storage);
+            return NULL;
+        }
+        if(aReadLength == 0)
+            break;
+        storage->bufferLength += aReadLength;
+        
+        while((aLineEnd = memchr(storage->buffer + aParsedLength, '\n', storage->bufferLength - aParsedLength)) != NULL){
+            size_t  aLineLength = aLineEnd - (storage->buffer + aParsedLength);
+            
+            parseColonRecord(storage, storage->buffer + aParsedLength, aLineLength, isSecret);
+            aParsedLength += aLineLength + 1;
+        }
+        storage->bufferLength -= aParsedLength;
+        memmove(storage->buffer, storage->buffer + aParsedLength, storage->bufferLength);
+    }
+    if(storage->bufferLength > 0)
+        // Last line, without newline
+        parseColonRecord(storage, storage->buffer, storage->bufferLength, isSecret);
+    
+    // Table is read-only from now on
+    NSZoneFree(NSDefaultMallocZone(), storage->buffer);
+    storage->buffer = NULL;
+    storage->bufferLength = storage->bufferCapacity = 0;
+    NSZoneFree(NSDefaultMallocZone(), storage->internedSlots);
+    storage->internedSlots = NULL;
+    storage->internedSlotCount = 0;
+    storage->strings = NSZoneRealloc(NSDefaultMallocZone(), storage->strings, MAX(storage->stringsLength, 1));
+    storage->stringsCapacity = storage->stringsLength;
+    resizeKeyArrays(storage, storage->keyCount);
+    resizeSubkeyArrays(storage, storage->subkeyCount);
+    resizeUserIDArrays(storage, storage->userIDCount);
+    indexFingerprints(storage);
+    
+    return storage;
+}
+
+static void setUserIDPart(_GPGStringSlice *parts, BOOL *hasParts, int part, const char *strings, const char *start, const char *end)
+{
+    // Trailing blanks are trimmed; only first occurrence of part is kept
+    if(!hasParts[part]){
+        while(end > start && (end[-1] == ' ' || end[-1] == '\t'))
+            end--;
+        parts[part].offset = (uint32_t)(start - strings);
+        parts[part].length = (uint32_t)(end - start);
+        hasParts[part] = YES;
+    }
+}
+
+static _GPGStringSlice userIDPart(const _GPGKeyTableStorage *storage, _GPGStringSlice userID, int part)
+{
+    // Same parsing as gpgme, for "Name (Comment) <email>" user IDs; missing
+    // parts are empty.
+    const char      *strings = storage->strings;
+    const char      *aChar = strings + userID.offset;
+    const char      *anEnd = aChar + userID.length;
+    const char      *aStart = NULL;
+    _GPGStringSlice parts[3];
+    BOOL            hasParts[3] = {NO, NO, NO};
+    BOOL            inName = NO;
+    int             inEmail = 0, inComment = 0;
+    
+    for(; aChar < anEnd && *aChar != '\0'; aChar++){
+        if(inEmail){
+            if(*aChar == '<')
+                inEmail++;
+            else if(*aChar == '>' && --inEmail == 0)
+                setUserIDPart(parts, hasParts, _GPGUserIDEmailPart, strings, aStart, aChar);
+        }
+        else if(inComment){
+            if(*aChar == '(')
+                inComment++;
+            else if(*aChar == ')' && --inComment == 0)
+                setUserIDPart(parts, hasParts, _GPGUserIDCommentPart, strings, aStart, aChar);
+        }
+        else if(*aChar == '<' || *aChar == '('){
+            if(inName){
+                setUserIDPart(parts, hasParts, _GPGUserIDNamePart, strings, aStart, aChar);
+                inName = NO;
+            }
+            if(*aChar == '<')
+                inEmail = 1;
+            else
+                inComment = 1;
+            aStart = aChar + 1;
+        }
+        else if(!inName && *aChar != ' ' && *aChar != '\t'){
+            inName = YES;
+            aStart = aChar;
+        }
+    }
+    if(inName)
+        setUserIDPart(parts, hasParts, _GPGUserIDNamePart, strings, aStart, aChar);
+    
+    if(!hasParts[part]){
+        parts[part].offset = userID.offset;
+        parts[part].length = 0;
+    }
+    
+    return parts[part];
+}
+
+static NSString *stringForSlice(const _GPGKeyTableStorage *storage, _GPGStringSlice slice)
+{
+    // UTF-8, or Latin-1 for old user IDs
+    NSString    *aString = [[NSString alloc] initWithBytes:storage->strings + slice.offset length:slice.length encoding:NSUTF8StringEncoding];
+    
+    if(aString == nil)
+        aString = [[NSString alloc] initWithBytes:storage->strings + slice.offset length:slice.length encoding:NSISOLatin1StringEncoding];
+    
+    return [aString autorelease];
+}
+
+
+@interface GPGKeyTable(Private)
+- (BOOL) _keyAtIndex:(unsigned)index hasFlag:(uint16_t)flag;
+- (void) _getFingerprint:(GPGFingerprint *)fingerprint ofKeyAtIndex:(unsigned)index;
+- (NSString *) _part:(int)part ofUserID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index;
+- (BOOL) _userID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index hasFlag:(uint16_t)flag;
+@end
+
+
+/*
+ * Proxy keys only reference the table and their index; they are not uniqued,
+ * and have no gpgme key.
+ */
+@interface _GPGKeyTableKey : GPGKey
+{
+    GPGKeyTable *_keyTable;
+    unsigned    _index;
+}
+
+- (id) initWithKeyTable:(GPGKeyTable *)keyTable index:(unsigned)index;
+
+@end
+
+
+/*
+ * Proxy user IDs are owned by their proxy key, like GPGUserID objects by
+ * their GPGKey; they only reference the table and their indexes.
+ */
+@interface _GPGKeyTableUserID : GPGUserID
+{
+    GPGKeyTable *_keyTable; // Not retained; retained by key
+    unsigned    _keyIndex;
+    unsigned    _userIDIndex;
+}
+
+- (id) initWithKey:(_GPGKeyTableKey *)key keyTable:(GPGKeyTable *)keyTable keyIndex:(unsigned)keyIndex userIDIndex:(unsigned)userIDIndex;
+
+@end
+
+
+@implementation GPGKeyTable
+
++ (id) keyTableWithContext:(GPGContext *)context searchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
+{
+    NSTask      *aTask;
+    GPGKeyTable *aTable;
+    
+    if([context protocol] != GPGOpenPGPProtocol)
+        [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorUnsupportedProtocol) userInfo:nil] raise];
+    
+    aTask = [GPGEngineHelper launchedKeyListingTaskForEngine:[context engine] searchPatterns:searchPatterns secretKeysOnly:secretKeysOnly fastListMode:NO];
+    NS_DURING
+        aTable = [[self alloc] initWithFileHandle:[[aTask standardOutput] fileHandleForReading] secretKeys:secretKeysOnly];
+    NS_HANDLER
+        [aTask terminate];
+        [aTask waitUntilExit];
+        [localException raise];
+    NS_ENDHANDLER
+    [aTask waitUntilExit];
+    NS_DURING
+        [GPGEngineHelper raiseIfKeyListingTaskFailed:aTask];
+    NS_HANDLER
+        [aTable release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    return [aTable autorelease];
+}
+
+- (id) initWithFileHandle:(NSFileHandle *)fileHandle secretKeys:(BOOL)secretKeys
+{
+    if(self = [self init]){
+        int anError;
+        
+        _containsSecretKeys = secretKeys;
+        _table = readStorage([fileHandle fileDescriptor], secretKeys, &anError);
+        if(_table == NULL){
+            [self release];
+            [NSException raise:NSFileHandleOperationException format:@"Unable to read key listing: %s", strerror(anError)];
+        }
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    if(_table != NULL)
+        freeStorage(_storage);
+    
+    [super dealloc];
+}
+
+- (BOOL) containsSecretKeys
+{
+    return _containsSecretKeys;
+}
+
+- (unsigned) count
+{
+    return _storage->keyCount;
+}
+
+- (unsigned long long) storageSize
+{
+    return storageSize(_storage);
+}
+
+- (unsigned) indexOfKeyWithFingerprint:(NSString *)fingerprint
+{
+    GPGFingerprint  aFingerprint;
+    
+    if(!GPGFingerprintFromString(fingerprint, &aFingerprint))
+        return NSNotFound;
+    
+    return indexOfFingerprint(_storage, &aFingerprint);
+}
+
+- (NSString *) fingerprintOfKeyAtIndex:(unsigned)index
+{
+    GPGFingerprint  aFingerprint;
+    
+    [self _getFingerprint:&aFingerprint ofKeyAtIndex:index];
+    
+    return GPGStringFromFingerprint(&aFingerprint);
+}
+
+- (NSString *) keyIDOfKeyAtIndex:(unsigned)index
+{
+    // Formatted like a fingerprint of 8 bytes
+    uint64_t        aKeyID;
+    uint8_t         someBytes[8];
+    GPGFingerprint  aFingerprint;
+    unsigned        i;
+    
+    NSParameterAssert(index < _storage->keyCount);
+    aKeyID = _storage->subkeyIDs[_storage->keyFirstSubkeys[index]];
+    for(i = 0; i < sizeof(someBytes); i++)
+        someBytes[i] = (uint8_t)(aKeyID >> (56 - 8 * i));
+    GPGFingerprintFromBytes(someBytes, sizeof(someBytes), &aFingerprint);
+    
+    return GPGStringFromFingerprint(&aFingerprint);
+}
+
+- (GPGPublicKeyAlgorithm) algorithmOfKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return _storage->subkeyAlgorithms[_storage->keyFirstSubkeys[index]];
+}
+
+- (unsigned int) lengthOfKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return _storage->subkeyLengths[_storage->keyFirstSubkeys[index]];
+}
+
+- (NSCalendarDate *) creationDateOfKeyAtIndex:(unsigned)index
+{
+    uint32_t    aTime;
+    
+    NSParameterAssert(index < _storage->keyCount);
+    aTime = _storage->subkeyCreationTimes[_storage->keyFirstSubkeys[index]];
+    
+    return (aTime > 0 ? [NSCalendarDate dateWithTimeIntervalSince1970:aTime] : nil);
+}
+
+- (NSCalendarDate *) expirationDateOfKeyAtIndex:(unsigned)index
+{
+    uint32_t    aTime;
+    
+    NSParameterAssert(index < _storage->keyCount);
+    aTime = _storage->subkeyExpirationTimes[_storage->keyFirstSubkeys[index]];
+    
+    return (aTime != 0 ? [NSCalendarDate dateWithTimeIntervalSince1970:aTime] : nil);
+}
+
+- (GPGValidity) validityOfKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return _storage->keyValidities[index];
+}
+
+- (GPGValidity) ownerTrustOfKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return _storage->keyOwnerTrusts[index];
+}
+
+- (BOOL) keyAtIndex:(unsigned)index matchesFilterMask:(GPGKeyFilterMask)filterMask minimumValidity:(GPGValidity)minimumValidity
+{
+    uint16_t    flags;
+    
+    NSParameterAssert(index < _storage->keyCount);
+    flags = _storage->keyFlags[index];
+    if((filterMask & GPGKeyFilterCanEncryptMask) && !(flags & _GPGCanEncryptFlag))
+        return NO;
+    if((filterMask & GPGKeyFilterCanSignMask) && !(flags & _GPGCanSignFlag))
+        return NO;
+    if((filterMask & GPGKeyFilterCanCertifyMask) && !(flags & _GPGCanCertifyFlag))
+        return NO;
+    if((filterMask & GPGKeyFilterCanAuthenticateMask) && !(flags & _GPGCanAuthenticateFlag))
+        return NO;
+    if((filterMask & GPGKeyFilterExcludeRevokedMask) && (flags & _GPGRevokedFlag))
+        return NO;
+    if((filterMask & GPGKeyFilterExcludeDisabledMask) && (flags & _GPGDisabledFlag))
+        return NO;
+    if((filterMask & GPGKeyFilterExcludeInvalidMask) && (flags & _GPGInvalidFlag))
+        return NO;
+    if(filterMask & GPGKeyFilterExcludeExpiredMask){
+        uint32_t    anExpirationTime = _storage->subkeyExpirationTimes[_storage->keyFirstSubkeys[index]];
+        
+        if((flags & _GPGExpiredFlag) || (anExpirationTime > 0 && anExpirationTime < time(NULL)))
+            return NO;
+    }
+    
+    return (minimumValidity == GPGValidityUnknown || _storage->keyValidities[index] >= minimumValidity);
+}
+
+- (unsigned) subkeyCountOfKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return (index + 1 < _storage->keyCount ? _storage->keyFirstSubkeys[index + 1] : _storage->subkeyCount) - _storage->keyFirstSubkeys[index];
+}
+
+- (unsigned) userIDCountOfKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return (index + 1 < _storage->keyCount ? _storage->keyFirstUserIDs[index + 1] : _storage->userIDCount) - _storage->keyFirstUserIDs[index];
+}
+
+- (NSString *) userID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(userIDIndex < [self userIDCountOfKeyAtIndex:index]);
+    
+    return stringForSlice(_storage, _storage->userIDs[_storage->keyFirstUserIDs[index] + userIDIndex]);
+}
+
+- (GPGValidity) validityOfUserID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(userIDIndex < [self userIDCountOfKeyAtIndex:index]);
+    
+    return _storage->userIDValidities[_storage->keyFirstUserIDs[index] + userIDIndex];
+}
+
+- (GPGKey *) keyAtIndex:(unsigned)index
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return [[[_GPGKeyTableKey allocWithZone:[self zone]] initWithKeyTable:self index:index] autorelease];
+}
+
+@end
+
+
+@implementation GPGKeyTable(Private)
+
+- (BOOL) _keyAtIndex:(unsigned)index hasFlag:(uint16_t)flag
+{
+    NSParameterAssert(index < _storage->keyCount);
+    
+    return (_storage->keyFlags[index] & flag) != 0;
+}
+
+- (void) _getFingerprint:(GPGFingerprint *)fingerprint ofKeyAtIndex:(unsigned)index
+{
+    uint32_t    aSubkeyIndex;
+    
+    NSParameterAssert(index < _storage->keyCount);
+    aSubkeyIndex = _storage->keyFirstSubkeys[index];
+    GPGFingerprintFromBytes(_storage->subkeyFingerprints[aSubkeyIndex], _storage->subkeyFingerprintLengths[aSubkeyIndex], fingerprint);
+}
+
+- (NSString *) _part:(int)part ofUserID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index
+{
+    NSParameterAssert(userIDIndex < [self userIDCountOfKeyAtIndex:index]);
+    
+    return stringForSlice(_storage, userIDPart(_storage, _storage->userIDs[_storage->keyFirstUserIDs[index] + userIDIndex], part));
+}
+
+- (BOOL) _userID:(unsigned)userIDIndex ofKeyAtIndex:(unsigned)index hasFlag:(uint16_t)flag
+{
+    NSParameterAssert(userIDIndex < [self userIDCountOfKeyAtIndex:index]);
+    
+    return (_storage->userIDFlags[_storage->keyFirstUserIDs[index] + userIDIndex] & flag) != 0;
+}
+
+@end
+
+
+@implementation _GPGKeyTableKey
+
++ (BOOL) needsPointerUniquing
+{
+    return NO;
+}
+
++ (BOOL) usesReferencesCount
+{
+    return NO;
+}
+
+- (id) initWithKeyTable:(GPGKeyTable *)keyTable index:(unsigned)index
+{
+    if(self = [self initWithInternalRepresentation:NULL]){
+        _keyTable = [keyTable retain];
+        _index = index;
+        [keyTable _getFingerprint:&_packedFingerprint ofKeyAtIndex:index];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [_keyTable release];
+    
+    [super dealloc];
+}
+
+- (gpgme_key_t) gpgmeKey
+{
+    // Proxy cannot be passed to gpgme
+    [[NSException exceptionWithGPGError:gpgme_err_make(GPG_MacGPGMEFrameworkErrorSource, GPGErrorInvalidValue) userInfo:nil] raise];
+    
+    return NULL;
+}
+
+- (NSString *) keyID
+{
+    return [_keyTable keyIDOfKeyAtIndex:_index];
+}
+
+- (NSArray *) subkeys
+{
+    return nil;
+}
+
+- (NSString *) fingerprint
+{
+    return [_keyTable fingerprintOfKeyAtIndex:_index];
+}
+
+- (GPGPublicKeyAlgorithm) algorithm
+{
+    return [_keyTable algorithmOfKeyAtIndex:_index];
+}
+
+- (unsigned int) length
+{
+    return [_keyTable lengthOfKeyAtIndex:_index];
+}
+
+- (NSCalendarDate *) creationDate
+{
+    return [_keyTable creationDateOfKeyAtIndex:_index];
+}
+
+- (NSCalendarDate *) expirationDate
+{
+    return [_keyTable expirationDateOfKeyAtIndex:_index];
+}
+
+- (GPGValidity) ownerTrust
+{
+    return [_keyTable ownerTrustOfKeyAtIndex:_index];
+}
+
+- (NSString *) userID
+{
+    if([_keyTable userIDCountOfKeyAtIndex:_index] > 0)
+        return [_keyTable userID:0 ofKeyAtIndex:_index];
+    else
+        return nil;
+}
+
+- (NSArray *) userIDs
+{
+    // See -[GPGKey userIDs]
+    NSArray *userIDs = _userIDs;
+    
+    if(userIDs == nil){
+        unsigned        aCount = [_keyTable userIDCountOfKeyAtIndex:_index];
+        NSZone          *aZone = [self zone];
+        NSMutableArray  *newUserIDs = [[NSMutableArray allocWithZone:aZone] initWithCapacity:aCount];
+        unsigned        i;
+        
+        for(i = 0; i < aCount; i++){
+            _GPGKeyTableUserID  *newUserID = [[_GPGKeyTableUserID allocWithZone:aZone] initWithKey:self keyTable:_keyTable keyIndex:_index userIDIndex:i];
+            
+            [newUserIDs addObject:newUserID];
+            [newUserID release];
+        }
+        userIDs = GPGPublishLazyObject(&_userIDs, newUserIDs);
+    }
+    
+    return userIDs;
+}
+
+- (NSString *) name
+{
+    // Primary user ID strings are read from table, without user ID objects
+    if([_keyTable userIDCountOfKeyAtIndex:_index] > 0)
+        return [_keyTable _part:_GPGUserIDNamePart ofUserID:0 ofKeyAtIndex:_index];
+    else
+        return nil;
+}
+
+- (NSString *) email
+{
+    if([_keyTable userIDCountOfKeyAtIndex:_index] > 0)
+        return [_keyTable _part:_GPGUserIDEmailPart ofUserID:0 ofKeyAtIndex:_index];
+    else
+        return nil;
+}
+
+- (NSString *) comment
+{
+    if([_keyTable userIDCountOfKeyAtIndex:_index] > 0)
+        return [_keyTable _part:_GPGUserIDCommentPart ofUserID:0 ofKeyAtIndex:_index];
+    else
+        return nil;
+}
+
+- (GPGValidity) validity
+{
+    if([_keyTable userIDCountOfKeyAtIndex:_index] > 0)
+        return [_keyTable validityOfUserID:0 ofKeyAtIndex:_index];
+    else
+        return GPGValidityUnknown;
+}
+
+- (NSString *) validityDescription
+{
+    if([_keyTable userIDCountOfKeyAtIndex:_index] > 0)
+        return GPGValidityDescription([self validity]);
+    else
+        return nil;
+}
+
+- (BOOL) isKeyRevoked
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGRevokedFlag];
+}
+
+- (BOOL) isKeyInvalid
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGInvalidFlag];
+}
+
+- (BOOL) hasKeyExpired
+{
+    return ![_keyTable keyAtIndex:_index matchesFilterMask:GPGKeyFilterExcludeExpiredMask minimumValidity:GPGValidityUnknown];
+}
+
+- (BOOL) isKeyDisabled
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGDisabledFlag];
+}
+
+- (BOOL) isSecret
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGSecretFlag];
+}
+
+- (BOOL) isQualified
+{
+    return NO;
+}
+
+- (BOOL) canEncrypt
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGCanEncryptFlag];
+}
+
+- (BOOL) canSign
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGCanSignFlag];
+}
+
+- (BOOL) canCertify
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGCanCertifyFlag];
+}
+
+- (BOOL) canAuthenticate
+{
+    return [_keyTable _keyAtIndex:_index hasFlag:_GPGCanAuthenticateFlag];
+}
+
+- (NSString *) issuerSerial
+{
+    return nil;
+}
+
+- (NSString *) issuerName
+{
+    return nil;
+}
+
+- (NSString *) chainID
+{
+    return nil;
+}
+
+- (GPGProtocol) supportedProtocol
+{
+    return GPGOpenPGPProtocol;
+}
+
+- (GPGKeyListMode) keyListMode
+{
+    return GPGKeyListModeLocal;
+}
+
+@end
+
+
+@implementation _GPGKeyTableUserID
+
+- (id) initWithKey:(_GPGKeyTableKey *)key keyTable:(GPGKeyTable *)keyTable keyIndex:(unsigned)keyIndex userIDIndex:(unsigned)userIDIndex
+{
+    if(self = [self initWithInternalRepresentation:NULL key:key]){
+        _keyTable = keyTable;
+        _keyIndex = keyIndex;
+        _userIDIndex = userIDIndex;
+    }
+    
+    return self;
+}
+
+- (NSString *) userID
+{
+    return [_keyTable userID:_userIDIndex ofKeyAtIndex:_keyIndex];
+}
+
+- (NSString *) name
+{
+    return [_keyTable _part:_GPGUserIDNamePart ofUserID:_userIDIndex ofKeyAtIndex:_keyIndex];
+}
+
+- (NSString *) email
+{
+    return [_keyTable _part:_GPGUserIDEmailPart ofUserID:_userIDIndex ofKeyAtIndex:_keyIndex];
+}
+
+- (NSString *) comment
+{
+    return [_keyTable _part:_GPGUserIDCommentPart ofUserID:_userIDIndex ofKeyAtIndex:_keyIndex];
+}
+
+- (GPGValidity) validity
+{
+    return [_keyTable validityOfUserID:_userIDIndex ofKeyAtIndex:_keyIndex];
+}
+
+- (BOOL) hasBeenRevoked
+{
+    return [_keyTable _userID:_userIDIndex ofKeyAtIndex:_keyIndex hasFlag:_GPGRevokedFlag];
+}
+
+- (BOOL) isInvalid
+{
+    return [_keyTable _userID:_userIDIndex ofKeyAtIndex:_keyIndex hasFlag:_GPGInvalidFlag];
+}
+
+- (NSArray *) signatures
+{
+    // Signatures are not listed; only loaded ones are available
+    return _signatures;
+}
+
+@end
@@ -0,0 +1,235 @@
+//
+//  GPGKeyring.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGKEYRING_H
+#define GPGKEYRING_H
+
+#include <Foundation/Foundation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+@class GPGKey;
+
+
+/*!
+ *  @class      GPGKeyring
+ *  @abstract   In-memory snapshot of the keys of the default keyring, indexed
+ *              for fast lookups.
+ *  @discussion A <code>GPGKeyring</code> object lists all public keys, or all
+ *              secret keys, once, using a single key listing, and keeps them
+ *              in memory, with indexes by fingerprint, by key ID (long and
+ *              short), by email address, by name, and by trigrams of user
+ *              IDs for substring searches. Lookups do not invoke the
+ *              crypto engine: they take microseconds instead of the tens of
+ *              milliseconds needed by 
+ *              <code>@link //macgpg/occ/instm/GPGContext(GPGSynchronousOperations)/keyFromFingerprint:secretKey: keyFromFingerprint:secretKey:@/link</code>
+ *              (GPGContext) or a key enumeration.
+ *
+ *              Snapshot is kept up to date: when 
+ *              <code>@link //macgpg/c/data/GPGKeyringChangedNotification GPGKeyringChangedNotification@/link</code>
+ *              is posted, locally or by another process, only the changed keys
+ *              are listed again. Changes made by other programs, e.g. by gpg
+ *              invoked from the command-line, are not notified; use
+ *              <code>@link reloadKeys reloadKeys@/link</code> when needed.
+ *
+ *              A keyring can be used by multiple threads concurrently.
+ *              Only OpenPGP keys are supported.
+ */
+@interface GPGKeyring : NSObject
+{
+    BOOL                _containsSecretKeys;
+    void                *_lock;                 // Readers-writer lock
+    NSMapTable          *_keysByFingerprint;    // Primary key and subkey GPGFingerprint -> GPGKey
+    NSMutableDictionary *_keysByKeyID;          // Primary key and subkey long key IDs -> NSMutableArray of GPGKey
+    NSMutableDictionary *_keysByShortKeyID;     // Primary key and subkey short key IDs -> NSMutableArray of GPGKey
+    NSMutableDictionary *_keysByEmail;          // Lowercase email addresses -> NSMutableArray of GPGKey
+    NSMutableArray      *_keys;                 // Keyring order; unindexed keys leave an NSNull until compaction
+    NSMapTable          *_keyIndexes;           // GPGKey -> index in _keys + 1
+    unsigned            _removedKeyCount;       // NSNull placeholders in _keys
+    NSMutableArray      *_nameIndex;            // (lowercase name, GPGKey) pairs, sorted by name
+    void                *_trigramIndex;         // N-grams of user ID names, emails and comments
+    void                *_recipientCompletionTrie;  // Radix trie of names and emails of encryption keys
+}
+
+/*!
+ *  @method     publicKeyring
+ *  @abstract   Returns the shared snapshot of public keys, creating it on
+ *              first invocation.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed.
+ */
++ (GPGKeyring *) publicKeyring;
+
+/*!
+ *  @method     secretKeyring
+ *  @abstract   Returns the shared snapshot of secret keys, creating it on
+ *              first invocation.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed.
+ */
++ (GPGKeyring *) secretKeyring;
+
+/*!
+ *  @method     initWithSecretKeys:
+ *  @abstract   Designated initializer. Lists all secret keys if 
+ *              <i>secretKeys</i> is <code>YES</code>, else all public keys,
+ *              and indexes them.
+ *  @param      secretKeys Lists secret keys instead of public keys
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; in this case, a
+ *              <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) initWithSecretKeys:(BOOL)secretKeys;
+
+/*!
+ *  @method     containsSecretKeys
+ *  @abstract   Returns <code>YES</code> if receiver contains secret keys.
+ */
+- (BOOL) containsSecretKeys;
+
+/*!
+ *  @method     keys
+ *  @abstract   Returns all keys, in keyring order.
+ */
+- (NSArray *) keys;
+
+/*!
+ *  @method     keyWithFingerprint:
+ *  @abstract   Returns the key whose fingerprint, or the fingerprint of one
+ *              of its subkeys, is <i>fingerprint</i>, or nil.
+ *  @discussion Lookup is case-insensitive; <i>fingerprint</i> may be prefixed
+ *              with <code>0x</code>.
+ *  @param      fingerprint Fingerprint of primary key or of a subkey
+ */
+- (GPGKey *) keyWithFingerprint:(NSString *)fingerprint;
+
+/*!
+ *  @method     keysWithKeyID:
+ *  @abstract   Returns keys whose key ID, or the key ID of one of their
+ *              subkeys, is <i>keyID</i>.
+ *  @discussion <i>keyID</i> can be a long (16 hexadecimal digits) or short
+ *              (8 hexadecimal digits) key ID, optionally prefixed with 
+ *              <code>0x</code>. Lookup is case-insensitive. Returns an empty
+ *              array when there is no such key.
+ *  @param      keyID Long or short key ID
+ */
+- (NSArray *) keysWithKeyID:(NSString *)keyID;
+
+/*!
+ *  @method     keysWithEmail:
+ *  @abstract   Returns keys having a user ID with email address <i>email</i>.
+ *  @discussion Lookup is case-insensitive. Returns an empty array when there
+ *              is no such key.
+ *  @param      email Email address
+ */
+- (NSArray *) keysWithEmail:(NSString *)email;
+
+/*!
+ *  @method     keysWithNamePrefix:
+ *  @abstract   Returns keys having a user ID whose name starts with
+ *              <i>prefix</i>, sorted by name.
+ *  @discussion Lookup is case-insensitive, and uses a binary search in the
+ *              sorted name index. Returns an empty array when there is no
+ *              such key.
+ *  @param      prefix Beginning of name
+ */
+- (NSArray *) keysWithNamePrefix:(NSString *)prefix;
+
+/*!
+ *  @method     keysMatchingString:
+ *  @abstract   Returns keys having a user ID whose name, email or comment
+ *              contains <i>string</i>, best matches first.
+ *  @discussion Search is case-insensitive. Candidates are found with a
+ *              trigram index, then checked. Keys matching a whole field rank
+ *              first, then keys with a field starting with <i>string</i>, then
+ *              keys with a word starting with <i>string</i>, then others; for
+ *              a same rank, usable keys (not revoked, expired, disabled nor
+ *              invalid) come first, in keyring order. Strings shorter than 3
+ *              characters are looked up in the index of single characters
+ *              and character pairs. An empty string returns all keys.
+ *  @param      string Substring to search for
+ */
+- (NSArray *) keysMatchingString:(NSString *)string;
+
+/*!
+ *  @method     encryptionKeysWithPrefix:maxCount:
+ *  @abstract   Returns at most <i>maxCount</i> keys usable for encryption, 
+ *              having a user ID whose email, name, or a word of name, starts
+ *              with <i>prefix</i>; meant for recipient autocompletion.
+ *  @discussion Only keys which can encrypt and are not revoked, expired, 
+ *              disabled nor invalid are returned, through user IDs which are
+ *              not revoked, invalid, nor of 
+ *              <code>@link //macgpg/c/econst/GPGValidityNever GPGValidityNever@/link</code>
+ *              validity. Keys with most valid user IDs come first, then in
+ *              keyring order. Search is case-insensitive and 
+ *              diacritic-insensitive.
+ *
+ *              Keys are looked up in a radix trie whose nodes hold their best
+ *              16 keys: query time depends only on <i>prefix</i> length, and
+ *              at most 16 keys are returned.
+ *  @param      prefix Beginning of email or name
+ *  @param      maxCount Maximum number of returned keys
+ */
+- (NSArray *) encryptionKeysWithPrefix:(NSString *)prefix maxCount:(unsigned)maxCount;
+
+/*!
+ *  @method     reloadKeys
+ *  @abstract   Lists again all keys and rebuilds indexes.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; snapshot is left
+ *              unchanged then.
+ */
+- (void) reloadKeys;
+
+/*!
+ *  @method     refreshKeysWithFingerprints:
+ *  @abstract   Lists again keys whose fingerprints are <i>fingerprints</i>
+ *              and updates indexes.
+ *  @discussion Keys which no longer exist are removed, and new keys are added.
+ *              Invoked automatically when 
+ *              <code>@link //macgpg/c/data/GPGKeyringChangedNotification GPGKeyringChangedNotification@/link</code>
+ *              is posted.
+ *  @param      fingerprints Fingerprints of primary keys
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; snapshot is left
+ *              unchanged then.
+ */
+- (void) refreshKeysWithFingerprints:(NSArray *)fingerprints;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGKEYRING_H */
@@ -0,0 +1,1406 @@
+//
+//  GPGKeyring.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGKeyring.h>
+#include <MacGPGME/GPGContext.h>
+#include <MacGPGME/GPGKey.h>
+#include <MacGPGME/GPGSubkey.h>
+#include <MacGPGME/GPGUserID.h>
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define _rwlock	((pthread_rwlock_t *)_lock)
+#define _trigrams	((_GPGTrigramIndex *)_trigramIndex)
+#define _completionTrie	((_GPGCompletionTrie *)_recipientCompletionTrie)
+
+// Refreshing more keys than this uses several gpg processes at once
+#define PARALLEL_LISTING_MINIMUM_KEY_COUNT  256
+
+
+@interface GPGKeyring(Private)
+- (NSArray *) _listKeysWithFingerprints:(NSArray *)fingerprints;
+- (void) _indexKey:(GPGKey *)key;
+- (void) _unindexKey:(GPGKey *)key;
+- (void) _compactKeys;
+- (void) _addNameEntriesOfKey:(GPGKey *)key;
+- (void) _removeNameEntriesOfKey:(GPGKey *)key;
+- (void) _rebuildNameIndex;
+- (void) _rebuildTrigramIndex;
+- (void) keyringDidChange:(NSNotification *)notification;
+@end
+
+
+static GPGKey *keyForFingerprintString(NSMapTable *keysByFingerprint, NSString *fingerprint)
+{
+    GPGFingerprint  aFingerprint;
+    
+    if(!GPGFingerprintFromString(fingerprint, &aFingerprint))
+        return nil;
+    
+    return NSMapGet(keysByFingerprint, &aFingerprint);
+}
+
+static void addKeyToMultiIndex(NSMutableDictionary *index, NSString *indexKey, GPGKey *key)
+{
+    NSMutableArray  *keys;
+    
+    if([indexKey length] == 0)
+        return;
+    keys = [index objectForKey:indexKey];
+    if(keys == nil){
+        keys = [[NSMutableArray alloc] initWithCapacity:1];
+        [index setObject:keys forKey:indexKey];
+        [keys release];
+    }
+    if([keys indexOfObjectIdenticalTo:key] == NSNotFound)
+        [keys addObject:key];
+}
+
+static void removeKeyFromMultiIndex(NSMutableDictionary *index, NSString *indexKey, GPGKey *key)
+{
+    NSMutableArray  *keys;
+    
+    if([indexKey length] == 0)
+        return;
+    keys = [index objectForKey:indexKey];
+    [keys removeObjectIdenticalTo:key];
+    if(keys != nil && [keys count] == 0)
+        [index removeObjectForKey:indexKey];
+}
+
+static NSComparisonResult compareNameEntries(id entry, id otherEntry, void *context)
+{
+    return [(NSString *)[entry objectAtIndex:0] compare:[otherEntry objectAtIndex:0]];
+}
+
+static unsigned nameIndexLowerBound(NSArray *nameIndex, NSString *name)
+{
+    // Binary search of first entry whose name is >= name
+    unsigned    lowIndex = 0;
+    unsigned    highIndex = [nameIndex count];
+    
+    while(lowIndex < highIndex){
+        unsigned    middleIndex = lowIndex + (highIndex - lowIndex) / 2;
+        
+        if([(NSString *)[[nameIndex objectAtIndex:middleIndex] objectAtIndex:0] compare:name] == NSOrderedAscending)
+            lowIndex = middleIndex + 1;
+        else
+            highIndex = middleIndex;
+    }
+    
+    return lowIndex;
+}
+
+
+/*
+ * N-gram index over the name, email and comment of user IDs: all trigrams are
+ * indexed, and also all single characters and bigrams, so that queries shorter
+ * than a trigram get their candidates from a posting list too. Each indexed
+ * key gets a slot number; slot numbers are never reused, so that posting
+ * lists, sorted by slot, are kept sorted by appending. Unindexing a key only
+ * frees its slot: queries skip postings of free slots, until index is rebuilt.
+ * N-grams are hashed on 31 bits: collisions only give more candidates, which
+ * are all checked against the key text.
+ */
+typedef struct {
+    uint32_t    *slots;
+    uint32_t    count;
+    uint32_t    capacity;
+} _GPGPostingList;
+
+typedef struct {
+    NSMapTable  *postingLists;  // N-gram -> _GPGPostingList *
+    NSMapTable  *slotsByKey;    // GPGKey pointer -> slot + 1
+    GPGKey      **keys;         // Slot -> GPGKey, NULL when unindexed; not retained
+    unichar     **texts;        // Slot -> lowercase searchable text, NULL when unindexed
+    uint32_t    *textLengths;   // Slot -> text length
+    uint32_t    slotCount;
+    uint32_t    slotCapacity;
+    uint32_t    liveSlotCount;
+} _GPGTrigramIndex;
+
+typedef struct {
+    uint32_t    slot;
+    int         score;
+} _GPGTrigramMatch;
+
+static _GPGTrigramIndex *newTrigramIndex(void)
+{
+    _GPGTrigramIndex    *anIndex = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGTrigramIndex));
+    
+    anIndex->postingLists = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSNonOwnedPointerMapValueCallBacks, 4096);
+    anIndex->slotsByKey = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSNonOwnedPointerMapValueCallBacks, 1024);
+    
+    return anIndex;
+}
+
+static void freeTrigramIndex(_GPGTrigramIndex *index)
+{
+    NSMapEnumerator anEnum = NSEnumerateMapTable(index->postingLists);
+    void            *aGram;
+    _GPGPostingList *aList;
+    uint32_t        i;
+    
+    while(NSNextMapEnumeratorPair(&anEnum, &aGram, (void **)&aList)){
+        NSZoneFree(NSDefaultMallocZone(), aList->slots);
+        NSZoneFree(NSDefaultMallocZone(), aList);
+    }
+    NSEndMapTableEnumeration(&anEnum);
+    NSFreeMapTable(index->postingLists);
+    NSFreeMapTable(index->slotsByKey);
+    for(i = 0; i < index->slotCount; i++)
+        if(index->texts[i] != NULL)
+            NSZoneFree(NSDefaultMallocZone(), index->texts[i]);
+    if(index->keys != NULL){
+        NSZoneFree(NSDefaultMallocZone(), index->keys);
+        NSZoneFree(NSDefaultMallocZone(), index->texts);
+        NSZoneFree(NSDefaultMallocZone(), index->textLengths);
+    }
+    NSZoneFree(NSDefaultMallocZone(), index);
+}
+
+static inline BOOL isFieldSeparator(unichar character)
+{
+    return character == '\n';
+}
+
+static inline void *gramKey(const unichar *characters, unsigned length)
+{
+    // length is 1 to 3; never NULL, nor NSNotAPointerMapKey
+    uint64_t    packed = ((uint64_t)length << 48) | ((uint64_t)characters[0] << 32);
+    
+    if(length > 1)
+        packed |= (uint64_t)characters[1] << 16;
+    if(length > 2)
+        packed |= characters[2];
+    packed *= 0x9E3779B97F4A7C15ULL;
+    return (void *)(uintptr_t)((uint32_t)(packed >> 32) % 0x7FFFFFFEU + 1);
+}
+
+static NSString *searchableText(GPGKey *key)
+{
+    // Fields are separated by newlines, so that no n-gram spans two fields
+    NSMutableString *aText = [NSMutableString string];
+    NSEnumerator    *anEnum = [[key userIDs] objectEnumerator];
+    GPGUserID       *aUserID;
+    
+    while((aUserID = [anEnum nextObject]) != nil){
+        NSString    *aField;
+        
+        if([aField = [aUserID name] length] > 0)
+            [aText appendFormat:@"%@\n", aField];
+        if([aField = [aUserID email] length] > 0)
+            [aText appendFormat:@"%@\n", aField];
+        if([aField = [aUserID comment] length] > 0)
+            [aText appendFormat:@"%@\n", aField];
+    }
+    
+    return [aText lowercaseString];
+}
+
+static unichar *copyCharacters(NSString *text, unsigned *length)
+{
+    unichar *characters;
+    
+    *length = [text length];
+    characters = NSZoneMalloc(NSDefaultMallocZone(), (*length ? *length : 1) * sizeof(unichar));
+    [text getCharacters:characters];
+    
+    return characters;
+}
+
+static void addTrigramPosting(_GPGTrigramIndex *index, void *gram, uint32_t slot)
+{
+    _GPGPostingList *aList = NSMapGet(index->postingLists, gram);
+    
+    if(aList == NULL){
+        aList = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGPostingList));
+        NSMapInsertKnownAbsent(index->postingLists, gram, aList);
+    }
+    // Slot is the highest one: list stays sorted, and duplicates are adjacent
+    if(aList->count > 0 && aList->slots[aList->count - 1] == slot)
+        return;
+    if(aList->count == aList->capacity){
+        aList->capacity = (aList->capacity ? aList->capacity * 2 : 4);
+        aList->slots = NSZoneRealloc(NSDefaultMallocZone(), aList->slots, aList->capacity * sizeof(uint32_t));
+    }
+    aList->slots[aList->count++] = slot;
+}
+
+static uint32_t lowerBoundOfSlot(const uint32_t *slots, uint32_t low, uint32_t high, uint32_t slot)
+{
+    while(low < high){
+        uint32_t    middle = low + (high - low) / 2;
+        
+        if(slots[middle] < slot)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    
+    return low;
+}
+
+static void indexKeyTrigrams(_GPGTrigramIndex *index, GPGKey *key)
+{
+    unsigned    aLength, i;
+    unichar     *characters;
+    uint32_t    aSlot;
+    
+    if(NSMapGet(index->slotsByKey, key) != NULL)
+        return;
+    if(index->slotCount == index->slotCapacity){
+        index->slotCapacity = (index->slotCapacity ? index->slotCapacity * 2 : 1024);
+        index->keys = NSZoneRealloc(NSDefaultMallocZone(), index->keys, index->slotCapacity * sizeof(GPGKey *));
+        index->texts = NSZoneRealloc(NSDefaultMallocZone(), index->texts, index->slotCapacity * sizeof(unichar *));
+        index->textLengths = NSZoneRealloc(NSDefaultMallocZone(), index->textLengths, index->slotCapacity * sizeof(uint32_t));
+    }
+    characters = copyCharacters(searchableText(key), &aLength);
+    aSlot = index->slotCount++;
+    index->keys[aSlot] = key;
+    index->texts[aSlot] = characters;
+    index->textLengths[aSlot] = aLength;
+    index->liveSlotCount++;
+    NSMapInsertKnownAbsent(index->slotsByKey, key, (void *)(uintptr_t)(aSlot + 1));
+    
+    for(i = 0; i < aLength; i++){
+        if(isFieldSeparator(characters[i]))
+            continue;
+        addTrigramPosting(index, gramKey(characters + i, 1), aSlot);
+        if(i + 1 < aLength && !isFieldSeparator(characters[i + 1])){
+            addTrigramPosting(index, gramKey(characters + i, 2), aSlot);
+            if(i + 2 < aLength && !isFieldSeparator(characters[i + 2]))
+                addTrigramPosting(index, gramKey(characters + i, 3), aSlot);
+        }
+    }
+}
+
+static void unindexKeyTrigrams(_GPGTrigramIndex *index, GPGKey *key)
+{
+    // Postings are left in place; see -refreshKeysWithFingerprints:
+    uintptr_t   aSlotPlusOne = (uintptr_t)NSMapGet(index->slotsByKey, key);
+    uint32_t    aSlot;
+    
+    if(aSlotPlusOne == 0)
+        return;
+    aSlot = aSlotPlusOne - 1;
+    NSMapRemove(index->slotsByKey, key);
+    index->keys[aSlot] = NULL;
+    NSZoneFree(NSDefaultMallocZone(), index->texts[aSlot]);
+    index->texts[aSlot] = NULL;
+    index->liveSlotCount--;
+}
+
+static int matchScore(const unichar *text, uint32_t textLength, const unichar *string, uint32_t length, NSCharacterSet *alphanumerics)
+{
+    // 4: whole field, 3: field prefix, 2: word prefix, 1: elsewhere, 0: no match
+    uint32_t    i;
+    int         aBestScore = 0;
+    
+    for(i = 0; i + length <= textLength && aBestScore < 4; i++){
+        int aScore;
+        
+        if(text[i] != string[0] || memcmp(text + i + 1, string + 1, (length - 1) * sizeof(unichar)) != 0)
+            continue;
+        if(i == 0 || isFieldSeparator(text[i - 1]))
+            aScore = ((i + length == textLength || isFieldSeparator(text[i + length])) ? 4 : 3);
+        else if(![alphanumerics characterIsMember:text[i - 1]])
+            aScore = 2;
+        else
+            aScore = 1;
+        if(aScore > aBestScore)
+            aBestScore = aScore;
+    }
+    
+    return aBestScore;
+}
+
+static int compareTrigramMatches(const void *match, const void *otherMatch)
+{
+    // Best scores first, then keyring order
+    const _GPGTrigramMatch  *aMatch = match;
+    const _GPGTrigramMatch  *anotherMatch = otherMatch;
+    
+    if(aMatch->score != anotherMatch->score)
+        return (aMatch->score > anotherMatch->score ? -1 : 1);
+    return (aMatch->slot < anotherMatch->slot ? -1 : (aMatch->slot > anotherMatch->slot ? 1 : 0));
+}
+
+static int comparePostingListCounts(const void *list, const void *otherList)
+{
+    uint32_t    aCount = (*(const _GPGPostingList **)list)->count;
+    uint32_t    anotherCount = (*(const _GPGPostingList **)otherList)->count;
+    
+    return (aCount < anotherCount ? -1 : (aCount > anotherCount ? 1 : 0));
+}
+
+static NSArray *keysMatchingStringInTrigramIndex(_GPGTrigramIndex *index, NSString *string)
+{
+    // Candidates are the intersection of the posting lists of the trigrams of
+    // string, or the posting list of string when shorter than a trigram; each
+    // live candidate is checked and scored against its text. Intersection
+    // starts from the shortest list, and only walks the others with binary
+    // searches, so that common trigrams cost little when string also has rare
+    // ones.
+    unsigned            aLength, i;
+    unichar             *characters = copyCharacters(string, &aLength);
+    unsigned            aGramLength = MIN(aLength, 3U);
+    unsigned            aListCount = aLength - aGramLength + 1;
+    _GPGPostingList     **lists = NSZoneMalloc(NSDefaultMallocZone(), aListCount * sizeof(_GPGPostingList *));
+    uint32_t            *candidates = NULL;
+    uint32_t            aCandidateCount = 0;
+    _GPGTrigramMatch    *matches;
+    uint32_t            aMatchCount = 0;
+    NSCharacterSet      *alphanumerics = [NSCharacterSet alphanumericCharacterSet];
+    NSMutableArray      *someKeys;
+    BOOL                isMissing = NO;
+    
+    for(i = 0; i < aListCount && !isMissing; i++){
+        lists[i] = NSMapGet(index->postingLists, gramKey(characters + i, aGramLength));
+        isMissing = (lists[i] == NULL);
+    }
+    if(!isMissing){
+        // Shortest list first bounds the work of each following step
+        qsort(lists, aListCount, sizeof(_GPGPostingList *), comparePostingListCounts);
+        candidates = NSZoneMalloc(NSDefaultMallocZone(), lists[0]->count * sizeof(uint32_t));
+        for(i = 0; i < lists[0]->count; i++)
+            if(index->keys[lists[0]->slots[i]] != NULL)
+                candidates[aCandidateCount++] = lists[0]->slots[i];
+        for(i = 1; i < aListCount && aCandidateCount > 0; i++){
+            const _GPGPostingList   *aList = lists[i];
+            uint32_t                aPosition = 0, aKeptCount = 0, j;
+            
+            if(aList == lists[i - 1])
+                continue;
+            for(j = 0; j < aCandidateCount; j++){
+                aPosition = lowerBoundOfSlot(aList->slots, aPosition, aList->count, candidates[j]);
+                if(aPosition == aList->count)
+                    break;
+                if(aList->slots[aPosition] == candidates[j])
+                    candidates[aKeptCount++] = candidates[j];
+            }
+            aCandidateCount = aKeptCount;
+        }
+    }
+    NSZoneFree(NSDefaultMallocZone(), lists);
+    
+    matches = NSZoneMalloc(NSDefaultMallocZone(), (aCandidateCount ? aCandidateCount : 1) * sizeof(_GPGTrigramMatch));
+    for(i = 0; i < aCandidateCount; i++){
+        uint32_t    aSlot = candidates[i];
+        int         aScore = matchScore(index->texts[aSlot], index->textLengths[aSlot], characters, aLength, alphanumerics);
+        
+        if(aScore > 0){
+            GPGKey  *aKey = index->keys[aSlot];
+            
+            // Usable keys rank before unusable ones with same score
+            matches[aMatchCount].slot = aSlot;
+            matches[aMatchCount].score = aScore * 2 + (([aKey isKeyRevoked] || [aKey hasKeyExpired] || [aKey isKeyDisabled] || [aKey isKeyInvalid]) ? 0 : 1);
+            aMatchCount++;
+        }
+    }
+    if(candidates != NULL)
+        NSZoneFree(NSDefaultMallocZone(), candidates);
+    NSZoneFree(NSDefaultMallocZone(), characters);
+    
+    qsort(matches, aMatchCount, sizeof(_GPGTrigramMatch), compareTrigramMatches);
+    someKeys = [NSMutableArray arrayWithCapacity:aMatchCount];
+    for(i = 0; i < aMatchCount; i++)
+        [someKeys addObject:index->keys[matches[i].slot]];
+    NSZoneFree(NSDefaultMallocZone(), matches);
+    
+    return someKeys;
+}
+
+
+/*
+ * Radix trie over normalized names and emails of usable encryption keys, for
+ * recipient autocompletion. Each node keeps the best keys of its subtree, so
+ * that a query only walks the prefix and copies at most
+ * COMPLETION_TOP_KEY_COUNT keys. Trie is updated in place when keys are
+ * indexed or unindexed: only the nodes on the path of each string of the key
+ * are changed, and the best keys of a node are recomputed from its children
+ * only when the removed key was one of them.
+ */
+#define COMPLETION_TOP_KEY_COUNT    16
+
+typedef struct {
+    GPGKey      *key;           // Not retained
+    uint32_t    rank;           // Validity rank, lower is better
+    uint32_t    sequence;       // Keyring order
+} _GPGTrieTopKey;
+
+typedef struct _GPGTrieNode {
+    unichar                 *label;
+    uint32_t                labelLength;
+    struct _GPGTrieNode     **children;     // Sorted by first label character
+    uint32_t                childCount;
+    uint32_t                childCapacity;
+    _GPGTrieTopKey          *entries;       // Keys whose string ends here
+    uint32_t                entryCount;
+    uint32_t                entryCapacity;
+    _GPGTrieTopKey          topKeys[COMPLETION_TOP_KEY_COUNT];  // Best first
+    uint32_t                topKeyCount;
+} _GPGTrieNode;
+
+typedef struct {
+    _GPGTrieNode    *root;
+    NSMapTable      *stringsByKey;  // GPGKey -> NSArray of its indexed strings
+    uint32_t        nextSequence;
+} _GPGCompletionTrie;
+
+static NSString *normalizedCompletionString(NSString *string)
+{
+    // Lowercase, without diacritics
+    NSMutableString *aString = [[[string lowercaseString] decomposedStringWithCanonicalMapping] mutableCopy];
+    NSCharacterSet  *nonBaseCharacters = [NSCharacterSet nonBaseCharacterSet];
+    NSRange         aRange = [aString rangeOfCharacterFromSet:nonBaseCharacters];
+    
+    while(aRange.location != NSNotFound){
+        [aString deleteCharactersInRange:aRange];
+        aRange = [aString rangeOfCharacterFromSet:nonBaseCharacters options:0 range:NSMakeRange(aRange.location, [aString length] - aRange.location)];
+    }
+    
+    return [aString autorelease];
+}
+
+static int completionValidityRank(GPGValidity validity)
+{
+    // Do not rely on GPGValidity values order; -1 for unusable
+    switch(validity){
+        case GPGValidityUltimate:
+            return 0;
+        case GPGValidityFull:
+            return 1;
+        case GPGValidityMarginal:
+            return 2;
+        case GPGValidityNever:
+            return -1;
+        default:
+            return 3;
+    }
+}
+
+static int compareTrieTopKeys(const void *topKey, const void *otherTopKey)
+{
+    const _GPGTrieTopKey    *aTopKey = topKey;
+    const _GPGTrieTopKey    *anotherTopKey = otherTopKey;
+    
+    if(aTopKey->rank != anotherTopKey->rank)
+        return (aTopKey->rank < anotherTopKey->rank ? -1 : 1);
+    return (aTopKey->sequence < anotherTopKey->sequence ? -1 : (aTopKey->sequence > anotherTopKey->sequence ? 1 : 0));
+}
+
+static _GPGTrieNode *newTrieNode(const unichar *label, uint32_t labelLength)
+{
+    _GPGTrieNode    *aNode = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGTrieNode));
+    
+    aNode->label = NSZoneMalloc(NSDefaultMallocZone(), (labelLength ? labelLength : 1) * sizeof(unichar));
+    if(labelLength > 0)
+        memcpy(aNode->label, label, labelLength * sizeof(unichar));
+    aNode->labelLength = labelLength;
+    
+    return aNode;
+}
+
+static void freeTrieNode(_GPGTrieNode *node)
+{
+    uint32_t    i;
+    
+    for(i = 0; i < node->childCount; i++)
+        freeTrieNode(node->children[i]);
+    if(node->children != NULL)
+        NSZoneFree(NSDefaultMallocZone(), node->children);
+    if(node->entries != NULL)
+        NSZoneFree(NSDefaultMallocZone(), node->entries);
+    NSZoneFree(NSDefaultMallocZone(), node->label);
+    NSZoneFree(NSDefaultMallocZone(), node);
+}
+
+static uint32_t trieChildPosition(const _GPGTrieNode *node, unichar character)
+{
+    // Position of child whose label starts with character, or of insertion
+    uint32_t    low = 0, high = node->childCount;
+    
+    while(low < high){
+        uint32_t    middle = low + (high - low) / 2;
+        
+        if(node->children[middle]->label[0] < character)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    
+    return low;
+}
+
+static _GPGTrieNode *trieChild(const _GPGTrieNode *node, unichar character)
+{
+    uint32_t    aPosition = trieChildPosition(node, character);
+    
+    if(aPosition < node->childCount && node->children[aPosition]->label[0] == character)
+        return node->children[aPosition];
+    return NULL;
+}
+
+static void insertTrieChild(_GPGTrieNode *node, _GPGTrieNode *child)
+{
+    uint32_t    aPosition = trieChildPosition(node, child->label[0]);
+    
+    if(node->childCount == node->childCapacity){
+        node->childCapacity = (node->childCapacity ? node->childCapacity * 2 : 2);
+        node->children = NSZoneRealloc(NSDefaultMallocZone(), node->children, node->childCapacity * sizeof(_GPGTrieNode *));
+    }
+    memmove(node->children + aPosition + 1, node->children + aPosition, (node->childCount - aPosition) * sizeof(_GPGTrieNode *));
+    node->children[aPosition] = child;
+    node->childCount++;
+}
+
+static void addTrieTopKey(_GPGTrieNode *node, _GPGTrieTopKey topKey)
+{
+    // A key can be reached by several names and emails; keep its best rank
+    uint32_t    i;
+    
+    for(i = 0; i < node->topKeyCount; i++){
+        if(node->topKeys[i].key == topKey.key){
+            if(compareTrieTopKeys(&topKey, node->topKeys + i) >= 0)
+                return;
+            memmove(node->topKeys + i, node->topKeys + i + 1, (node->topKeyCount - i - 1) * sizeof(_GPGTrieTopKey));
+            node->topKeyCount--;
+            break;
+        }
+    }
+    if(node->topKeyCount == COMPLETION_TOP_KEY_COUNT){
+        if(compareTrieTopKeys(&topKey, node->topKeys + COMPLETION_TOP_KEY_COUNT - 1) >= 0)
+            return;
+        node->topKeyCount--;
+    }
+    for(i = node->topKeyCount; i > 0 && compareTrieTopKeys(&topKey, node->topKeys + i - 1) < 0; i--)
+        node->topKeys[i] = node->topKeys[i - 1];
+    node->topKeys[i] = topKey;
+    node->topKeyCount++;
+}
+
+static BOOL trieTopKeysContainKey(const _GPGTrieNode *node, GPGKey *key)
+{
+    uint32_t    i;
+    
+    for(i = 0; i < node->topKeyCount; i++)
+        if(node->topKeys[i].key == key)
+            return YES;
+    return NO;
+}
+
+static void recomputeTrieTopKeys(_GPGTrieNode *node)
+{
+    // Best keys of subtree: best keys of children, and keys ending here
+    uint32_t    i, j;
+    
+    node->topKeyCount = 0;
+    for(i = 0; i < node->entryCount; i++)
+        addTrieTopKey(node, node->entries[i]);
+    for(i = 0; i < node->childCount; i++)
+        for(j = 0; j < node->children[i]->topKeyCount; j++)
+            addTrieTopKey(node, node->children[i]->topKeys[j]);
+}
+
+static void insertTrieString(_GPGTrieNode *root, const unichar *characters, uint32_t length, _GPGTrieTopKey topKey)
+{
+    // Nodes of path to string get topKey among their best keys
+    _GPGTrieNode    *aNode = root;
+    uint32_t        aPosition = 0;
+    
+    while(YES){
+        _GPGTrieNode    *aChild;
+        uint32_t        aCommonLength;
+        
+        addTrieTopKey(aNode, topKey);
+        if(aPosition == length)
+            break;
+        aChild = trieChild(aNode, characters[aPosition]);
+        if(aChild == NULL){
+            aChild = newTrieNode(characters + aPosition, length - aPosition);
+            insertTrieChild(aNode, aChild);
+            aPosition = length;
+        }
+        else{
+            for(aCommonLength = 1; aCommonLength < aChild->labelLength && aPosition + aCommonLength < length && aChild->label[aCommonLength] == characters[aPosition + aCommonLength]; aCommonLength++)
+                ;
+            if(aCommonLength < aChild->labelLength){
+                // Split child label; new parent has the same subtree
+                _GPGTrieNode    *aParent = newTrieNode(aChild->label, aCommonLength);
+                unichar         *aLabel = NSZoneMalloc(NSDefaultMallocZone(), (aChild->labelLength - aCommonLength) * sizeof(unichar));
+                
+                aNode->children[trieChildPosition(aNode, aChild->label[0])] = aParent;
+                memcpy(aLabel, aChild->label + aCommonLength, (aChild->labelLength - aCommonLength) * sizeof(unichar));
+                NSZoneFree(NSDefaultMallocZone(), aChild->label);
+                aChild->label = aLabel;
+                aChild->labelLength -= aCommonLength;
+                memcpy(aParent->topKeys, aChild->topKeys, aChild->topKeyCount * sizeof(_GPGTrieTopKey));
+                aParent->topKeyCount = aChild->topKeyCount;
+                insertTrieChild(aParent, aChild);
+                aChild = aParent;
+            }
+            aPosition += aCommonLength;
+        }
+        aNode = aChild;
+    }
+    if(aNode->entryCount == aNode->entryCapacity){
+        aNode->entryCapacity = (aNode->entryCapacity ? aNode->entryCapacity * 2 : 1);
+        aNode->entries = NSZoneRealloc(NSDefaultMallocZone(), aNode->entries, aNode->entryCapacity * sizeof(_GPGTrieTopKey));
+    }
+    aNode->entries[aNode->entryCount++] = topKey;
+}
+
+static void removeTrieString(_GPGTrieNode *root, const unichar *characters, uint32_t length, GPGKey *key)
+{
+    // Nodes left without entries nor children are freed; best keys of other
+    // nodes of path are recomputed, bottom-up, when they contained key.
+    _GPGTrieNode    *aPath[256];
+    _GPGTrieNode    **path = aPath;
+    uint32_t        aDepth = 0, aPosition = 0, i;
+    _GPGTrieNode    *aNode = root;
+    
+    if(length + 1 > sizeof(aPath) / sizeof(aPath[0]))
+        path = NSZoneMalloc(NSDefaultMallocZone(), (length + 1) * sizeof(_GPGTrieNode *));
+    path[aDepth++] = aNode;
+    while(aNode != NULL && aPosition < length){
+        aNode = trieChild(aNode, characters[aPosition]);
+        if(aNode != NULL){
+            if(aNode->labelLength > length - aPosition || memcmp(aNode->label, characters + aPosition, aNode->labelLength * sizeof(unichar)) != 0)
+                aNode = NULL;
+            else{
+                aPosition += aNode->labelLength;
+                path[aDepth++] = aNode;
+            }
+        }
+    }
+    if(aNode != NULL){
+        uint32_t    aKeptCount = 0;
+        
+        for(i = 0; i < aNode->entryCount; i++)
+            if(aNode->entries[i].key != key)
+                aNode->entries[aKeptCount++] = aNode->entries[i];
+        aNode->entryCount = aKeptCount;
+        for(i = aDepth; i-- > 0;){
+            aNode = path[i];
+            if(i > 0 && aNode->entryCount == 0 && aNode->childCount == 0){
+                _GPGTrieNode    *aParent = path[i - 1];
+                uint32_t        aChildPosition = trieChildPosition(aParent, aNode->label[0]);
+                
+                memmove(aParent->children + aChildPosition, aParent->children + aChildPosition + 1, (aParent->childCount - aChildPosition - 1) * sizeof(_GPGTrieNode *));
+                aParent->childCount--;
+                freeTrieNode(aNode);
+            }
+            else if(trieTopKeysContainKey(aNode, key))
+                recomputeTrieTopKeys(aNode);
+        }
+    }
+    if(path != aPath)
+        NSZoneFree(NSDefaultMallocZone(), path);
+}
+
+static const _GPGTrieNode *completionTrieNodeForPrefix(const _GPGTrieNode *root, const unichar *prefix, uint32_t prefixLength)
+{
+    const _GPGTrieNode  *aNode = root;
+    uint32_t            aPosition = 0;
+    
+    while(YES){
+        uint32_t    i;
+        
+        for(i = 0; i < aNode->labelLength && aPosition < prefixLength; i++, aPosition++)
+            if(aNode->label[i] != prefix[aPosition])
+                return NULL;
+        if(aPosition == prefixLength)
+            return aNode;
+        aNode = trieChild(aNode, prefix[aPosition]);
+        if(aNode == NULL)
+            return NULL;
+    }
+}
+
+static _GPGCompletionTrie *newCompletionTrie(void)
+{
+    _GPGCompletionTrie  *aTrie = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGCompletionTrie));
+    
+    aTrie->root = newTrieNode(NULL, 0);
+    aTrie->stringsByKey = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSObjectMapValueCallBacks, 1024);
+    
+    return aTrie;
+}
+
+static void freeCompletionTrie(_GPGCompletionTrie *trie)
+{
+    freeTrieNode(trie->root);
+    NSFreeMapTable(trie->stringsByKey);
+    NSZoneFree(NSDefaultMallocZone(), trie);
+}
+
+static void addCompletionString(_GPGCompletionTrie *trie, NSMutableArray *strings, NSString *string, _GPGTrieTopKey topKey)
+{
+    unsigned    aLength = [string length];
+    unichar     aBuffer[64];
+    unichar     *characters = aBuffer;
+    
+    if(aLength == 0)
+        return;
+    if(aLength > sizeof(aBuffer) / sizeof(unichar))
+        characters = NSZoneMalloc(NSDefaultMallocZone(), aLength * sizeof(unichar));
+    [string getCharacters:characters];
+    insertTrieString(trie->root, characters, aLength, topKey);
+    if(characters != aBuffer)
+        NSZoneFree(NSDefaultMallocZone(), characters);
+    if(![strings containsObject:string])
+        [strings addObject:string];
+}
+
+static void addKeyToCompletionTrie(_GPGCompletionTrie *trie, GPGKey *key)
+{
+    // Only keys which can be used for encryption are indexed, by the full
+    // email, the full name and each following word of the name, of their
+    // valid user IDs. Keys indexed later come later in keyring order.
+    NSMutableArray  *strings;
+    NSEnumerator    *anEnum;
+    GPGUserID       *aUserID;
+    _GPGTrieTopKey  aTopKey;
+    
+    if(NSMapGet(trie->stringsByKey, key) != NULL || ![key canEncrypt] || [key isKeyRevoked] || [key hasKeyExpired] || [key isKeyDisabled] || [key isKeyInvalid])
+        return;
+    strings = [[NSMutableArray alloc] init];
+    aTopKey.key = key;
+    aTopKey.sequence = trie->nextSequence++;
+    anEnum = [[key userIDs] objectEnumerator];
+    while((aUserID = [anEnum nextObject]) != nil){
+        int         aValidityRank = completionValidityRank([aUserID validity]);
+        NSString    *aName;
+        NSRange     aRange;
+        
+        if(aValidityRank < 0 || [aUserID hasBeenRevoked] || [aUserID isInvalid])
+            continue;
+        // Best validity first, then keyring order
+        aTopKey.rank = aValidityRank;
+        addCompletionString(trie, strings, normalizedCompletionString([aUserID email]), aTopKey);
+        aName = normalizedCompletionString([aUserID name]);
+        while([aName length] > 0){
+            addCompletionString(trie, strings, aName, aTopKey);
+            aRange = [aName rangeOfString:@" "];
+            if(aRange.location == NSNotFound)
+                break;
+            aName = [aName substringFromIndex:NSMaxRange(aRange)];
+        }
+    }
+    if([strings count] > 0)
+        NSMapInsertKnownAbsent(trie->stringsByKey, key, strings);
+    [strings release];
+}
+
+static void removeKeyFromCompletionTrie(_GPGCompletionTrie *trie, GPGKey *key)
+{
+    NSArray         *strings = NSMapGet(trie->stringsByKey, key);
+    NSEnumerator    *anEnum = [strings objectEnumerator];
+    NSString        *aString;
+    
+    while((aString = [anEnum nextObject]) != nil){
+        unsigned    aLength = [aString length];
+        unichar     aBuffer[64];
+        unichar     *characters = aBuffer;
+        
+        if(aLength > sizeof(aBuffer) / sizeof(unichar))
+            characters = NSZoneMalloc(NSDefaultMallocZone(), aLength * sizeof(unichar));
+        [aString getCharacters:characters];
+        removeTrieString(trie->root, characters, aLength, key);
+        if(characters != aBuffer)
+            NSZoneFree(NSDefaultMallocZone(), characters);
+    }
+    if(strings != nil)
+        NSMapRemove(trie->stringsByKey, key);
+}
+
+
+@implementation GPGKeyring
+
+static pthread_mutex_t  sharedKeyringsLock = PTHREAD_MUTEX_INITIALIZER;
+static GPGKeyring       *sharedPublicKeyring = nil;
+static GPGKeyring       *sharedSecretKeyring = nil;
+
++ (GPGKeyring *) publicKeyring
+{
+    GPGKeyring  *aKeyring;
+    
+    pthread_mutex_lock(&sharedKeyringsLock);
+    NS_DURING
+        if(sharedPublicKeyring == nil)
+            sharedPublicKeyring = [[self alloc] initWithSecretKeys:NO];
+    NS_HANDLER
+        pthread_mutex_unlock(&sharedKeyringsLock);
+        [localException raise];
+    NS_ENDHANDLER
+    aKeyring = sharedPublicKeyring;
+    pthread_mutex_unlock(&sharedKeyringsLock);
+    
+    return aKeyring;
+}
+
++ (GPGKeyring *) secretKeyring
+{
+    GPGKeyring  *aKeyring;
+    
+    pthread_mutex_lock(&sharedKeyringsLock);
+    NS_DURING
+        if(sharedSecretKeyring == nil)
+            sharedSecretKeyring = [[self alloc] initWithSecretKeys:YES];
+    NS_HANDLER
+        pthread_mutex_unlock(&sharedKeyringsLock);
+        [localException raise];
+    NS_ENDHANDLER
+    aKeyring = sharedSecretKeyring;
+    pthread_mutex_unlock(&sharedKeyringsLock);
+    
+    return aKeyring;
+}
+
+- (id) init
+{
+    return [self initWithSecretKeys:NO];
+}
+
+- (id) initWithSecretKeys:(BOOL)secretKeys
+{
+    NSArray *someKeys;
+    
+    _containsSecretKeys = secretKeys;
+    NS_DURING
+        someKeys = [self _listKeysWithFingerprints:nil];
+    NS_HANDLER
+        [self release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    if(self = [self _initWithKeys:someKeys secretKeys:secretKeys]){
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(keyringDidChange:) name:GPGKeyringChangedNotification object:nil];
+        [[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(keyringDidChange:) name:GPGKeyringChangedNotification object:nil];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [[NSDistributedNotificationCenter defaultCenter] removeObserver:self];
+    if(_keysByFingerprint != NULL)
+        NSFreeMapTable(_keysByFingerprint);
+    [_keysByKeyID release];
+    [_keysByShortKeyID release];
+    [_keysByEmail release];
+    [_keys release];
+    if(_keyIndexes != NULL)
+        NSFreeMapTable(_keyIndexes);
+    [_nameIndex release];
+    if(_trigramIndex != NULL)
+        freeTrigramIndex(_trigrams);
+    if(_recipientCompletionTrie != NULL)
+        freeCompletionTrie(_completionTrie);
+    if(_lock != NULL){
+        pthread_rwlock_destroy(_rwlock);
+        NSZoneFree([self zone], _lock);
+    }
+    
+    [super dealloc];
+}
+
+- (BOOL) containsSecretKeys
+{
+    return _containsSecretKeys;
+}
+
+- (NSArray *) keys
+{
+    NSArray *someKeys;
+    
+    pthread_rwlock_rdlock(_rwlock);
+    if(_removedKeyCount == 0)
+        someKeys = [NSArray arrayWithArray:_keys];
+    else{
+        NSMutableArray  *liveKeys = [NSMutableArray arrayWithCapacity:[_keys count] - _removedKeyCount];
+        NSEnumerator    *keyEnum = [_keys objectEnumerator];
+        id              aKey;
+        
+        while((aKey = [keyEnum nextObject]) != nil)
+            if(aKey != (id)[NSNull null])
+                [liveKeys addObject:aKey];
+        someKeys = liveKeys;
+    }
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeys;
+}
+
+- (GPGKey *) keyWithFingerprint:(NSString *)fingerprint
+{
+    GPGKey  *aKey;
+    
+    pthread_rwlock_rdlock(_rwlock);
+    aKey = [keyForFingerprintString(_keysByFingerprint, fingerprint) retain];
+    pthread_rwlock_unlock(_rwlock);
+    
+    return [aKey autorelease];
+}
+
+- (NSArray *) keysWithKeyID:(NSString *)keyID
+{
+    NSArray *someKeys;
+    
+    keyID = GPGNormalizedHexString(keyID, 0);
+    pthread_rwlock_rdlock(_rwlock);
+    someKeys = [([keyID length] == 8 ? _keysByShortKeyID : _keysByKeyID) objectForKey:keyID];
+    someKeys = (someKeys != nil ? [NSArray arrayWithArray:someKeys] : [NSArray array]);
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeys;
+}
+
+- (NSArray *) keysWithEmail:(NSString *)email
+{
+    NSArray *someKeys;
+    
+    email = [email lowercaseString];
+    pthread_rwlock_rdlock(_rwlock);
+    someKeys = [_keysByEmail objectForKey:email];
+    someKeys = (someKeys != nil ? [NSArray arrayWithArray:someKeys] : [NSArray array]);
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeys;
+}
+
+- (NSArray *) keysWithNamePrefix:(NSString *)prefix
+{
+    NSMutableArray  *someKeys = [NSMutableArray array];
+    unsigned        lowIndex, count;
+    
+    prefix = [prefix lowercaseString];
+    pthread_rwlock_rdlock(_rwlock);
+    count = [_nameIndex count];
+    for(lowIndex = nameIndexLowerBound(_nameIndex, prefix); lowIndex < count; lowIndex++){
+        NSArray *anEntry = [_nameIndex objectAtIndex:lowIndex];
+        GPGKey  *aKey;
+        
+        if(![(NSString *)[anEntry objectAtIndex:0] hasPrefix:prefix])
+            break;
+        aKey = [anEntry objectAtIndex:1];
+        if([someKeys indexOfObjectIdenticalTo:aKey] == NSNotFound)
+            [someKeys addObject:aKey];
+    }
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeys;
+}
+
+- (NSArray *) keysMatchingString:(NSString *)string
+{
+    NSArray *someKeys;
+    
+    if([string length] == 0)
+        return [self keys];
+    string = [string lowercaseString];
+    pthread_rwlock_rdlock(_rwlock);
+    someKeys = keysMatchingStringInTrigramIndex(_trigrams, string);
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeys;
+}
+
+- (NSArray *) encryptionKeysWithPrefix:(NSString *)prefix maxCount:(unsigned)maxCount
+{
+    // Only the result array is allocated, besides prefix normalization
+    NSArray             *someKeys = nil;
+    unichar             aBuffer[64];
+    unichar             *characters = aBuffer;
+    unsigned            aLength;
+    const _GPGTrieNode  *aNode;
+    
+    prefix = normalizedCompletionString(prefix != nil ? prefix : @"");
+    aLength = [prefix length];
+    if(aLength > sizeof(aBuffer) / sizeof(unichar))
+        characters = NSZoneMalloc(NSDefaultMallocZone(), aLength * sizeof(unichar));
+    [prefix getCharacters:characters];
+    
+    pthread_rwlock_rdlock(_rwlock);
+    aNode = completionTrieNodeForPrefix(_completionTrie->root, characters, aLength);
+    if(aNode != NULL){
+        unsigned    aCount = MIN(MIN(maxCount, aNode->topKeyCount), COMPLETION_TOP_KEY_COUNT);
+        id          foundKeys[COMPLETION_TOP_KEY_COUNT];
+        unsigned    i;
+        
+        for(i = 0; i < aCount; i++)
+            foundKeys[i] = aNode->topKeys[i].key;
+        someKeys = [NSArray arrayWithObjects:foundKeys count:aCount];
+    }
+    pthread_rwlock_unlock(_rwlock);
+    if(characters != aBuffer)
+        NSZoneFree(NSDefaultMallocZone(), characters);
+    
+    return (someKeys != nil ? someKeys : [NSArray array]);
+}
+
+- (void) reloadKeys
+{
+    // Keys are listed without holding the lock
+    NSArray         *someKeys = [self _listKeysWithFingerprints:nil];
+    NSEnumerator    *keyEnum = [someKeys objectEnumerator];
+    GPGKey          *aKey;
+    
+    pthread_rwlock_wrlock(_rwlock);
+    NSResetMapTable(_keysByFingerprint);
+    [_keysByKeyID removeAllObjects];
+    [_keysByShortKeyID removeAllObjects];
+    [_keysByEmail removeAllObjects];
+    [_keys removeAllObjects];
+    NSResetMapTable(_keyIndexes);
+    _removedKeyCount = 0;
+    freeTrigramIndex(_trigrams);
+    _trigramIndex = newTrigramIndex();
+    freeCompletionTrie(_completionTrie);
+    _recipientCompletionTrie = newCompletionTrie();
+    while((aKey = [keyEnum nextObject]) != nil)
+        [self _indexKey:aKey];
+    [self _rebuildNameIndex];
+    pthread_rwlock_unlock(_rwlock);
+}
+
+- (void) refreshKeysWithFingerprints:(NSArray *)fingerprints
+{
+    // Keys are listed without holding the lock, all in one listing
+    if([fingerprints count] == 0)
+        return;
+    [self _refreshKeysWithFingerprints:fingerprints listedKeys:[self _listKeysWithFingerprints:fingerprints]];
+}
+
+@end
+
+
+@implementation GPGKeyring(GPGInternals)
+
+- (id) _initWithKeys:(NSArray *)keys secretKeys:(BOOL)secretKeys
+{
+    if(self = [super init]){
+        NSEnumerator    *keyEnum;
+        GPGKey          *aKey;
+        
+        _containsSecretKeys = secretKeys;
+        _lock = NSZoneMalloc([self zone], sizeof(pthread_rwlock_t));
+        pthread_rwlock_init(_rwlock, NULL);
+        _keysByFingerprint = NSCreateMapTable(GPGOwnedFingerprintMapKeyCallBacks, NSObjectMapValueCallBacks, 1024);
+        _keysByKeyID = [[NSMutableDictionary alloc] init];
+        _keysByShortKeyID = [[NSMutableDictionary alloc] init];
+        _keysByEmail = [[NSMutableDictionary alloc] init];
+        _keys = [[NSMutableArray alloc] init];
+        _keyIndexes = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSIntegerMapValueCallBacks, 1024);
+        _nameIndex = [[NSMutableArray alloc] init];
+        _trigramIndex = newTrigramIndex();
+        _recipientCompletionTrie = newCompletionTrie();
+        
+        keyEnum = [keys objectEnumerator];
+        while((aKey = [keyEnum nextObject]) != nil)
+            [self _indexKey:aKey];
+        [self _rebuildNameIndex];
+    }
+    
+    return self;
+}
+
+- (void) _refreshKeysWithFingerprints:(NSArray *)fingerprints listedKeys:(NSArray *)keys
+{
+    NSEnumerator    *anEnum;
+    NSString        *aFingerprint;
+    GPGKey          *aKey;
+    
+    pthread_rwlock_wrlock(_rwlock);
+    // Only entries of changed keys are removed from, and inserted into, the
+    // sorted name index
+    anEnum = [fingerprints objectEnumerator];
+    while((aFingerprint = [anEnum nextObject]) != nil){
+        aKey = keyForFingerprintString(_keysByFingerprint, aFingerprint);
+        if(aKey != nil){
+            [self _removeNameEntriesOfKey:aKey];
+            [self _unindexKey:aKey];
+        }
+    }
+    anEnum = [keys objectEnumerator];
+    while((aKey = [anEnum nextObject]) != nil){
+        GPGKey  *anOldKey = NSMapGet(_keysByFingerprint, [aKey packedFingerprint]);
+        
+        if(anOldKey != nil){
+            [self _removeNameEntriesOfKey:anOldKey];
+            [self _unindexKey:anOldKey];
+        }
+        [self _indexKey:aKey];
+        [self _addNameEntriesOfKey:aKey];
+    }
+    [self _compactKeys];
+    // Slots are not reused, and postings of free slots are kept; rebuild
+    // index when most slots are free
+    if(_trigrams->slotCount - _trigrams->liveSlotCount > _trigrams->liveSlotCount + 1024)
+        [self _rebuildTrigramIndex];
+    pthread_rwlock_unlock(_rwlock);
+}
+
+@end
+
+
+@implementation GPGKeyring(Private)
+
+- (NSArray *) _listKeysWithFingerprints:(NSArray *)fingerprints
+{
+    // Lists all keys when fingerprints is nil
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSMutableArray  *someKeys = [NSMutableArray array];
+    NSMutableArray  *patterns = nil;
+    
+    if(fingerprints != nil){
+        NSEnumerator    *anEnum = [fingerprints objectEnumerator];
+        NSString        *aFingerprint;
+        
+        patterns = [NSMutableArray arrayWithCapacity:[fingerprints count]];
+        while((aFingerprint = [anEnum nextObject]) != nil)
+            [patterns addObject:[@"0x" stringByAppendingString:GPGNormalizedHexString(aFingerprint, 0)]];
+    }
+    
+    NS_DURING
+        NSEnumerator    *keyEnum;
+        GPGKey          *aKey;
+        
+        // Long lists of fingerprints, e.g. after a big import, are listed
+        // in parallel
+        if([patterns count] > PARALLEL_LISTING_MINIMUM_KEY_COUNT)
+            keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:_containsSecretKeys contextCount:0 ordered:NO];
+        else
+            keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:_containsSecretKeys];
+        while((aKey = [keyEnum nextObject]) != nil)
+            [someKeys addObject:aKey];
+        [aContext stopKeyEnumeration];
+        [aContext release];
+    NS_HANDLER
+        [aContext stopKeyEnumeration];
+        [aContext release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    return someKeys;
+}
+
+- (void) _indexKey:(GPGKey *)key
+{
+    // Lock must be held, or receiver not yet shared
+    NSEnumerator    *anEnum = [[key subkeys] objectEnumerator];
+    GPGSubkey       *aSubkey;
+    GPGUserID       *aUserID;
+    
+    while((aSubkey = [anEnum nextObject]) != nil){
+        NSString        *aKeyID = [[aSubkey keyID] uppercaseString];
+        GPGFingerprint  aFingerprint;
+        
+        if(GPGFingerprintFromString([aSubkey fingerprint], &aFingerprint)){
+            NSMapRemove(_keysByFingerprint, &aFingerprint);
+            NSMapInsert(_keysByFingerprint, GPGFingerprintCopy(&aFingerprint), key);
+        }
+        addKeyToMultiIndex(_keysByKeyID, aKeyID, key);
+        if([aKeyID length] > 8)
+            addKeyToMultiIndex(_keysByShortKeyID, [aKeyID substringFromIndex:[aKeyID length] - 8], key);
+    }
+    anEnum = [[key userIDs] objectEnumerator];
+    while((aUserID = [anEnum nextObject]) != nil)
+        addKeyToMultiIndex(_keysByEmail, [[aUserID email] lowercaseString], key);
+    if(NSMapGet(_keyIndexes, key) == NULL){
+        [_keys addObject:key];
+        NSMapInsertKnownAbsent(_keyIndexes, key, (void *)(NSUInteger)[_keys count]);
+    }
+    indexKeyTrigrams(_trigrams, key);
+    addKeyToCompletionTrie(_completionTrie, key);
+}
+
+- (void) _unindexKey:(GPGKey *)key
+{
+    // Lock must be held
+    NSEnumerator    *anEnum;
+    GPGSubkey       *aSubkey;
+    GPGUserID       *aUserID;
+    NSUInteger      anIndex;
+    
+    [key retain];
+    anEnum = [[key subkeys] objectEnumerator];
+    while((aSubkey = [anEnum nextObject]) != nil){
+        NSString        *aKeyID = [[aSubkey keyID] uppercaseString];
+        GPGFingerprint  aFingerprint;
+        
+        if(GPGFingerprintFromString([aSubkey fingerprint], &aFingerprint) && NSMapGet(_keysByFingerprint, &aFingerprint) == key)
+            NSMapRemove(_keysByFingerprint, &aFingerprint);
+        removeKeyFromMultiIndex(_keysByKeyID, aKeyID, key);
+        if([aKeyID length] > 8)
+            removeKeyFromMultiIndex(_keysByShortKeyID, [aKeyID substringFromIndex:[aKeyID length] - 8], key);
+    }
+    anEnum = [[key userIDs] objectEnumerator];
+    while((aUserID = [anEnum nextObject]) != nil)
+        removeKeyFromMultiIndex(_keysByEmail, [[aUserID email] lowercaseString], key);
+    unindexKeyTrigrams(_trigrams, key);
+    removeKeyFromCompletionTrie(_completionTrie, key);
+    // Constant time: key is replaced by a placeholder; see -_compactKeys
+    anIndex = (NSUInteger)NSMapGet(_keyIndexes, key);
+    if(anIndex != 0){
+        NSMapRemove(_keyIndexes, key);
+        [_keys replaceObjectAtIndex:anIndex - 1 withObject:[NSNull null]];
+        _removedKeyCount++;
+    }
+    [key release];
+}
+
+- (void) _compactKeys
+{
+    // Lock must be held. Placeholders of unindexed keys are removed once
+    // they are more numerous than keys, so that compaction cost is amortized.
+    NSMutableArray  *liveKeys;
+    NSEnumerator    *keyEnum;
+    id              aKey;
+    
+    if(_removedKeyCount <= [_keys count] - _removedKeyCount)
+        return;
+    liveKeys = [[NSMutableArray alloc] initWithCapacity:[_keys count] - _removedKeyCount];
+    NSResetMapTable(_keyIndexes);
+    keyEnum = [_keys objectEnumerator];
+    while((aKey = [keyEnum nextObject]) != nil){
+        if(aKey != (id)[NSNull null]){
+            [liveKeys addObject:aKey];
+            NSMapInsertKnownAbsent(_keyIndexes, aKey, (void *)(NSUInteger)[liveKeys count]);
+        }
+    }
+    [_keys release];
+    _keys = liveKeys;
+    _removedKeyCount = 0;
+}
+
+- (void) _addNameEntriesOfKey:(GPGKey *)key
+{
+    // Lock must be held
+    NSEnumerator    *userIDEnum = [[key userIDs] objectEnumerator];
+    GPGUserID       *aUserID;
+    
+    while((aUserID = [userIDEnum nextObject]) != nil){
+        NSString    *aName = [[aUserID name] lowercaseString];
+        
+        if([aName length] > 0)
+            [_nameIndex insertObject:[NSArray arrayWithObjects:aName, key, nil] atIndex:nameIndexLowerBound(_nameIndex, aName)];
+    }
+}
+
+- (void) _removeNameEntriesOfKey:(GPGKey *)key
+{
+    // Lock must be held
+    NSEnumerator    *userIDEnum = [[key userIDs] objectEnumerator];
+    GPGUserID       *aUserID;
+    
+    while((aUserID = [userIDEnum nextObject]) != nil){
+        NSString    *aName = [[aUserID name] lowercaseString];
+        unsigned    anIndex, count = [_nameIndex count];
+        
+        if([aName length] == 0)
+            continue;
+        for(anIndex = nameIndexLowerBound(_nameIndex, aName); anIndex < count; anIndex++){
+            NSArray *anEntry = [_nameIndex objectAtIndex:anIndex];
+            
+            if(![(NSString *)[anEntry objectAtIndex:0] isEqualToString:aName])
+                break;
+            if([anEntry objectAtIndex:1] == key){
+                [_nameIndex removeObjectAtIndex:anIndex];
+                break;
+            }
+        }
+    }
+}
+
+- (void) _rebuildNameIndex
+{
+    // Lock must be held, or receiver not yet shared
+    NSMutableArray  *entries = [[NSMutableArray alloc] initWithCapacity:[_keys count]];
+    NSEnumerator    *keyEnum = [_keys objectEnumerator];
+    GPGKey          *aKey;
+    
+    while((aKey = [keyEnum nextObject]) != nil){
+        NSEnumerator    *userIDEnum;
+        GPGUserID       *aUserID;
+        
+        if(aKey == (id)[NSNull null])
+            continue;
+        userIDEnum = [[aKey userIDs] objectEnumerator];
+        while((aUserID = [userIDEnum nextObject]) != nil){
+            NSString    *aName = [aUserID name];
+            
+            if([aName length] > 0)
+                [entries addObject:[NSArray arrayWithObjects:[aName lowercaseString], aKey, nil]];
+        }
+    }
+    [entries sortUsingFunction:compareNameEntries context:NULL];
+    [_nameIndex release];
+    _nameIndex = entries;
+}
+
+- (void) _rebuildTrigramIndex
+{
+    // Lock must be held
+    NSEnumerator    *keyEnum = [_keys objectEnumerator];
+    GPGKey          *aKey;
+    
+    freeTrigramIndex(_trigrams);
+    _trigramIndex = newTrigramIndex();
+    while((aKey = [keyEnum nextObject]) != nil)
+        if(aKey != (id)[NSNull null])
+            indexKeyTrigrams(_trigrams, aKey);
+}
+
+- (void) keyringDidChange:(NSNotification *)notification
+{
+    NSArray *fingerprints;
+    
+    if(GPGNotificationIsFromCurrentProcess(notification))
+        return; // Already notified locally
+    fingerprints = GPGChangedKeyFingerprints(notification);
+    
+    NS_DURING
+        if([fingerprints count] == 0)
+            [self reloadKeys];
+        else
+            [self refreshKeysWithFingerprints:fingerprints];
+    NS_HANDLER
+        // Do not propagate exception to the poster
+        NSLog(@"### GPGKeyring: unable to refresh keys: %@", localException);
+    NS_ENDHANDLER
+}
+
+@end
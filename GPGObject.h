@@ -48,6 +48,7 @@ extern "C" {
 @interface GPGObject : NSObject
 {
     void	*_internalRepresentation; // Pointer to the gpgme internal structure wrapped by this object
+    int		_uniquingRefCount; // Internal ref count of uniqued wrappers, minus the +alloc one
 }
 
 /*!
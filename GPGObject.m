@@ -31,22 +31,56 @@
 #include <Foundation/Foundation.h>
 #include <gpgme.h>
 #include <libintl.h>
+#include <pthread.h>
+#include <stdint.h>
 
 
-@implementation GPGObject
+// Wrappers are uniqued against gpgme pointers in a table split into shards,
+// each one having its own lock and map table, so that threads creating or
+// releasing wrappers of different pointers seldom contend for the same lock.
+#define GPGUniquingShardCount       64  // Power of 2
+#define GPGUniquingShardCountLog2   6
+
+typedef struct {
+    pthread_mutex_t lock;
+    NSMapTable      *mapTable;
+} __attribute__((aligned(64))) GPGUniquingShard; // One shard per cache line
+
+static GPGUniquingShard uniquingShards[GPGUniquingShardCount];
+
+static inline GPGUniquingShard *shardForPointer(void *aPtr)
+{
+    // Fibonacci hashing; upper bits of the product depend on all pointer bits
+    return &uniquingShards[(uint64_t)(uintptr_t)aPtr * 0x9E3779B97F4A7C15ULL >> (64 - GPGUniquingShardCountLog2)];
+}
+
+
+id GPGPublishLazyObject(id *location, id newObject)
+{
+    // Barrier makes sure that newObject is fully initialized before other
+    // threads can see it.
+    if(GPGAtomicCompareAndSwapPtr(nil, newObject, (void * volatile *)location))
+        return newObject;
+    [newObject release];
+    
+    return *location;
+}
 
-static NSMapTable       *mapTable = NULL;
-static NSRecursiveLock	*mapTableLock = nil;
+
+@implementation GPGObject
 
 + (void) initialize
 {
     // Do not call super - see +initialize documentation
-    if(mapTable == NULL){
+    if(uniquingShards[0].mapTable == NULL){
         NSString    *aPath;
         GPGEngine   *openPGPEngine;
+        int         i;
         
-        mapTable = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSNonRetainedObjectMapValueCallBacks, 100);
-        mapTableLock = [[NSRecursiveLock alloc] init];
+        for(i = 0; i < GPGUniquingShardCount; i++){
+            pthread_mutex_init(&uniquingShards[i].lock, NULL);
+            uniquingShards[i].mapTable = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSNonRetainedObjectMapValueCallBacks, 16);
+        }
     
         // gpgme library uses pthreads; to avoid any problems with
         // Foundation's NSThreads, we must ensure that at least
@@ -101,11 +135,6 @@ static NSRecursiveLock	*mapTableLock = nil;
     return NO;
 }
 
-+ (NSRecursiveLock *) pointerUniquingTableLock
-{
-    return mapTableLock;
-}
-
 - (id) initWithInternalRepresentation:(void *)aPtr
 {
     BOOL	needsPointerUniquing = [[self class] needsPointerUniquing];
@@ -116,19 +145,26 @@ static NSRecursiveLock	*mapTableLock = nil;
         id	anExistingObject = nil;
 
         if(needsPointerUniquing){
-            [mapTableLock lock];
-            anExistingObject = NSMapGet(mapTable, aPtr);
-            [mapTableLock unlock];
+            // Lookup and registration are atomic: two threads wrapping the
+            // same pointer get the same object.
+            GPGUniquingShard    *aShard = shardForPointer(aPtr);
+            
+            pthread_mutex_lock(&aShard->lock);
+            anExistingObject = NSMapGet(aShard->mapTable, aPtr);
+            if(anExistingObject != nil)
+                [anExistingObject retain]; // We MUST call -retain, because there was an +alloc, and retainCount must augment
+            else{
+                _internalRepresentation = aPtr;
+                NSMapInsertKnownAbsent(aShard->mapTable, aPtr, self);
+            }
+            pthread_mutex_unlock(&aShard->lock);
         }
+        else
+            _internalRepresentation = aPtr;
 
         if(anExistingObject != nil){
             [self release];
-            self = [anExistingObject retain]; // We MUST call -retain, because there was an +alloc, and retainCount must augment
-        }
-        else{
-            _internalRepresentation = aPtr;
-            if(needsPointerUniquing)
-                [self registerUniquePointer];
+            self = anExistingObject;
         }
     }
 
@@ -137,18 +173,84 @@ static NSRecursiveLock	*mapTableLock = nil;
 
 - (void) registerUniquePointer
 {
+    GPGUniquingShard    *aShard;
+    
     NSAssert(_internalRepresentation != NULL, @"### Unable to register NULL pointer!");
-    [mapTableLock lock];
-    NSMapInsertKnownAbsent(mapTable, _internalRepresentation, self);
-    [mapTableLock unlock];
+    aShard = shardForPointer(_internalRepresentation);
+    pthread_mutex_lock(&aShard->lock);
+    NSMapInsertKnownAbsent(aShard->mapTable, _internalRepresentation, self);
+    pthread_mutex_unlock(&aShard->lock);
 }
 
 - (void) unregisterUniquePointer
 {
+    // Pointer might already be mapped to a new wrapper; see -release
+    GPGUniquingShard    *aShard;
+    
     NSAssert(_internalRepresentation != NULL, @"### Unable to unregister NULL pointer!");
-    [mapTableLock lock];
-    NSMapRemove(mapTable, _internalRepresentation);
-    [mapTableLock unlock];
+    aShard = shardForPointer(_internalRepresentation);
+    pthread_mutex_lock(&aShard->lock);
+    if(NSMapGet(aShard->mapTable, _internalRepresentation) == self)
+        NSMapRemove(aShard->mapTable, _internalRepresentation);
+    pthread_mutex_unlock(&aShard->lock);
+}
+
+// Uniqued wrappers use an internal ref count, like owned objects (see
+// GPGKey.m), so that the last release can decrement the count, find it is
+// the last one, and remove the wrapper from the uniquing table, all under
+// the shard lock: a thread wrapping the same pointer, which looks up and
+// retains the wrapper under that lock, either retains it before the last
+// release takes the lock, or doesn't find it anymore. Releases which are
+// not the last one only need an atomic decrement.
+
+- (id) retain
+{
+    if([[self class] needsPointerUniquing]){
+        GPGAtomicIncrement32(&_uniquingRefCount);
+        
+        return self;
+    }
+    
+    return [super retain];
+}
+
+- (oneway void) release
+{
+    if([[self class] needsPointerUniquing]){
+        int32_t aCount;
+        
+        do{
+            aCount = _uniquingRefCount;
+        }while(aCount > 0 && !GPGAtomicCompareAndSwap32(aCount, aCount - 1, &_uniquingRefCount));
+        if(aCount > 0)
+            return;
+        
+        if(_internalRepresentation != NULL){
+            // Looks like the last release; check again under lock, as the
+            // wrapper may have been looked up and retained meanwhile.
+            GPGUniquingShard    *aShard = shardForPointer(_internalRepresentation);
+            
+            pthread_mutex_lock(&aShard->lock);
+            do{
+                aCount = _uniquingRefCount;
+            }while(aCount > 0 && !GPGAtomicCompareAndSwap32(aCount, aCount - 1, &_uniquingRefCount));
+            if(aCount == 0 && NSMapGet(aShard->mapTable, _internalRepresentation) == self)
+                NSMapRemove(aShard->mapTable, _internalRepresentation);
+            pthread_mutex_unlock(&aShard->lock);
+            if(aCount > 0)
+                return;
+        }
+    }
+    [super release];
+}
+
+#if defined(MAC_OS_X_VERSION_10_5) && (MAC_OS_X_VERSION_MIN_REQUIRED >= MAC_OS_X_VERSION_10_5)
+- (NSUInteger) retainCount
+#else
+- (unsigned) retainCount
+#endif
+{
+    return [super retainCount] + _uniquingRefCount;
 }
 
 - (void) dealloc
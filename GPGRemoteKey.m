@@ -178,10 +178,14 @@
 
 - (NSArray *) userIDs
 {
-    if(_userIDs == nil){
-        int		i = 0;
-        int		max = [_colonFormatStrings count];
-        NSZone	*aZone = [self zone];
+    // See -[GPGKey subkeys]
+    NSArray *userIDs = _userIDs;
+    
+    if(userIDs == nil){
+        int             i = 0;
+        int             max = [_colonFormatStrings count];
+        NSZone          *aZone = [self zone];
+        NSMutableArray  *newUserIDs;
         
         switch(_version){
             case 0:
@@ -192,16 +196,17 @@
                 [NSException raise:NSGenericException format:@"### Unknown version (%d)", _version];
                 return nil; // Never reached
         }
-        _userIDs = [[NSMutableArray allocWithZone:aZone] initWithCapacity:max];
+        newUserIDs = [[NSMutableArray allocWithZone:aZone] initWithCapacity:max];
         for(; i < max; i++){
             GPGRemoteUserID	*aUserID = [[GPGRemoteUserID allocWithZone:aZone] initWithKey:self index:i];
             
-            [(NSMutableArray *)_userIDs addObject:aUserID];
+            [newUserIDs addObject:aUserID];
             [aUserID release];
         }
+        userIDs = GPGPublishLazyObject(&_userIDs, newUserIDs);
     }
     
-    return _userIDs;
+    return userIDs;
 }
 
 
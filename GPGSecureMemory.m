@@ -0,0 +1,200 @@
+//
+//  GPGSecureMemory.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+// Secure blocks are allocated from arenas of locked (non-swappable) memory.
+// Each arena is mapped and locked once, so that allocating a block never
+// costs a system call, unless all arenas are full. Blocks have a fixed size
+// (one page), and are wiped when freed. Fully free arenas are unmapped,
+// except one which is kept for reuse.
+// Blocks are isolated from each other: every block is surrounded by
+// inaccessible guard pages (a guard page is shared by two adjacent blocks),
+// so that an overrun or underrun of a block faults, instead of reading or
+// overwriting the secrets of its neighbour.
+// Arena layout: guard, block 0, guard, block 1, guard, ..., block N-1, guard.
+// Free blocks of an arena are chained; link is stored in the block itself.
+
+#define GPGSecureArenaBlockCount	128
+
+
+typedef struct _GPGSecureArena {
+    struct _GPGSecureArena  *next;
+    char                    *blocks;        // First block, after leading guard page; blocks are 2 pages apart
+    void                    *freeBlocks;    // Free blocks chain
+    unsigned                usedBlockCount;
+    BOOL                    isLocked;
+} GPGSecureArena;
+
+
+static pthread_mutex_t  secureMemoryLock = PTHREAD_MUTEX_INITIALIZER;
+static GPGSecureArena   *secureArenas = NULL;
+static size_t           secureBlockSize = 0;
+
+// Calling memset() through a volatile pointer prevents compiler from
+// optimizing away wiping of memory which is freed right after.
+static void *(* volatile wipeFunction)(void *, int, size_t) = memset;
+
+
+void GPGSecureWipe(void *bytes, size_t length)
+{
+    if(bytes != NULL && length > 0)
+        wipeFunction(bytes, 0, length);
+}
+
+size_t GPGSecureBlockSize(void)
+{
+    if(secureBlockSize == 0)
+        secureBlockSize = (size_t)getpagesize();
+    
+    return secureBlockSize;
+}
+
+static size_t secureArenaLength(void)
+{
+    // Whole mapping, including all guard pages
+    return (2 * GPGSecureArenaBlockCount + 1) * GPGSecureBlockSize();
+}
+
+static GPGSecureArena *newSecureArena(void)
+{
+    size_t          blockSize = GPGSecureBlockSize();
+    char            *region;
+    GPGSecureArena  *anArena;
+    unsigned        i;
+    BOOL            isLocked = YES;
+    
+    // Whole region is mapped inaccessible; only blocks are then made
+    // accessible, and locked, leaving guard pages in-between.
+    region = mmap(NULL, secureArenaLength(), PROT_NONE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(region == MAP_FAILED)
+        return NULL;
+    for(i = 0; i < GPGSecureArenaBlockCount; i++){
+        char    *aBlock = region + (2 * i + 1) * blockSize;
+        
+        if(mprotect(aBlock, blockSize, PROT_READ | PROT_WRITE) != 0){
+            munmap(region, secureArenaLength());
+            return NULL;
+        }
+        if(isLocked && mlock(aBlock, blockSize) != 0){
+            NSLog(@"### Unable to lock secure memory (%s); memory could be swapped", strerror(errno));
+            isLocked = NO;
+        }
+    }
+    
+    anArena = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(GPGSecureArena));
+    anArena->blocks = region + blockSize;
+    anArena->isLocked = isLocked;
+    
+    for(i = GPGSecureArenaBlockCount; i > 0; i--){
+        void	**aBlock = (void **)(anArena->blocks + 2 * (i - 1) * blockSize);
+        
+        *aBlock = anArena->freeBlocks;
+        anArena->freeBlocks = aBlock;
+    }
+    
+    return anArena;
+}
+
+static void freeSecureArena(GPGSecureArena *anArena)
+{
+    // All blocks have already been wiped. Unmapping also unlocks pages
+    // which were locked before a locking failure.
+    munmap(anArena->blocks - GPGSecureBlockSize(), secureArenaLength());
+    NSZoneFree(NSDefaultMallocZone(), anArena);
+}
+
+void *GPGSecureBlockAllocate(void)
+{
+    // Returns a block of GPGSecureBlockSize() bytes, or NULL if no memory could be allocated.
+    GPGSecureArena  *anArena;
+    void            **aBlock = NULL;
+    
+    pthread_mutex_lock(&secureMemoryLock);
+    for(anArena = secureArenas; anArena != NULL && anArena->freeBlocks == NULL; anArena = anArena->next)
+        ;
+    if(anArena == NULL){
+        anArena = newSecureArena();
+        if(anArena != NULL){
+            anArena->next = secureArenas;
+            secureArenas = anArena;
+        }
+    }
+    if(anArena != NULL){
+        aBlock = anArena->freeBlocks;
+        anArena->freeBlocks = *aBlock;
+        anArena->usedBlockCount++;
+        *aBlock = NULL; // Block is now entirely zeroed
+    }
+    pthread_mutex_unlock(&secureMemoryLock);
+    
+    return aBlock;
+}
+
+void GPGSecureBlockFree(void *block)
+{
+    size_t          blocksLength = secureArenaLength() - 2 * GPGSecureBlockSize(); // From first block to end of last one
+    GPGSecureArena  *anArena, *previousArena = NULL;
+    
+    if(block == NULL)
+        return;
+    
+    // Wipe outside of lock; block still belongs to caller
+    GPGSecureWipe(block, GPGSecureBlockSize());
+    
+    pthread_mutex_lock(&secureMemoryLock);
+    for(anArena = secureArenas; anArena != NULL; previousArena = anArena, anArena = anArena->next)
+        if((char *)block >= anArena->blocks && (char *)block < anArena->blocks + blocksLength)
+            break;
+    NSCAssert(anArena != NULL, @"### Block has not been allocated by GPGSecureBlockAllocate()");
+    
+    *(void **)block = anArena->freeBlocks;
+    anArena->freeBlocks = block;
+    anArena->usedBlockCount--;
+    
+    if(anArena->usedBlockCount == 0){
+        // Keep only one free arena
+        GPGSecureArena  *anotherArena;
+        
+        for(anotherArena = secureArenas; anotherArena != NULL; anotherArena = anotherArena->next)
+            if(anotherArena != anArena && anotherArena->usedBlockCount == 0)
+                break;
+        if(anotherArena != NULL){
+            if(previousArena == NULL)
+                secureArenas = anArena->next;
+            else
+                previousArena->next = anArena->next;
+            freeSecureArena(anArena);
+        }
+    }
+    pthread_mutex_unlock(&secureMemoryLock);
+}
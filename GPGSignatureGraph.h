@@ -0,0 +1,192 @@
+//
+//  GPGSignatureGraph.h
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#ifndef GPGSIGNATUREGRAPH_H
+#define GPGSIGNATUREGRAPH_H
+
+#include <Foundation/Foundation.h>
+
+#ifdef __cplusplus
+extern "C" {
+#if 0 /* just to make Emacs auto-indent happy */
+}
+#endif
+#endif
+
+
+/*!
+ *  @class      GPGSignatureGraph
+ *  @abstract   In-memory graph of key certifications (web of trust), for fast
+ *              path queries.
+ *  @discussion A <code>GPGSignatureGraph</code> object lists all public keys
+ *              once, with their signatures, and keeps a compact graph whose 
+ *              vertices are keys, identified by the long key ID of their
+ *              primary key, and whose edges go from a signer key to the key
+ *              it certified. Only valid certifications are kept: not expired,
+ *              not invalid, and not revoked by the signer; self-signatures are
+ *              ignored. Signer keys which are not in the keyring are vertices
+ *              too, without certifications.
+ *
+ *              Edges are stored in compressed sparse rows, outgoing and 
+ *              incoming, so that queries do not invoke the crypto engine;
+ *              after changes, rows are rebuilt once, by the next query.
+ *              Graph can be queried by multiple threads concurrently.
+ *
+ *              Graph is kept up to date: when 
+ *              <code>@link //macgpg/c/data/GPGKeyringChangedNotification GPGKeyringChangedNotification@/link</code>
+ *              is posted, only the certifications of the changed keys are
+ *              listed again; when the notification does not tell which keys
+ *              changed, graph is reloaded by the next query, not by the
+ *              notification poster. Use 
+ *              <code>@link reloadSignatures reloadSignatures@/link</code> for 
+ *              changes which are not notified.
+ *
+ *              Wherever a key ID is expected, a long key ID, optionally 
+ *              prefixed with <code>0x</code>, or a fingerprint, can be used;
+ *              key IDs of subkeys are accepted too. Only OpenPGP keys are
+ *              supported.
+ */
+@interface GPGSignatureGraph : NSObject
+{
+    void                *_lock;                 // Readers-writer lock
+    NSMutableArray      *_keyIDs;               // Vertex -> long key ID of primary key
+    NSMutableDictionary *_verticesByKeyID;      // Long key IDs of primary keys and subkeys -> NSNumber vertex
+    NSMutableArray      *_subkeyIDs;            // Vertex -> subkey IDs mapped to vertex, besides primary key ID
+    void                *_incomingEdges;        // Vertex -> signer vertices; updated incrementally
+    void                *_graph;                // Compressed sparse rows, rebuilt after updates
+    volatile int        _needsReload;           // Changes are unknown; graph is reloaded by next query
+    volatile int        _needsRebuild;          // Incoming edges changed; rows are rebuilt by next query
+}
+
+/*!
+ *  @method     init
+ *  @abstract   Designated initializer. Lists all public keys with their
+ *              signatures, and builds graph.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; in this case, a
+ *              <code>@link //apple_ref/occ/intfm/NSObject/release release@/link</code>
+ *              is sent to self.
+ */
+- (id) init;
+
+/*!
+ *  @method     keyCount
+ *  @abstract   Returns the number of vertices: keys in keyring and unknown
+ *              signer keys.
+ */
+- (unsigned) keyCount;
+
+/*!
+ *  @method     certificationCount
+ *  @abstract   Returns the number of edges.
+ */
+- (unsigned) certificationCount;
+
+/*!
+ *  @method     certificationCountForKeyID:
+ *  @abstract   Returns the number of keys which certified key <i>keyID</i>
+ *              (in-degree).
+ *  @param      keyID Key ID or fingerprint
+ */
+- (unsigned) certificationCountForKeyID:(NSString *)keyID;
+
+/*!
+ *  @method     signerKeyIDsForKeyID:
+ *  @abstract   Returns the long key IDs of the keys which certified key 
+ *              <i>keyID</i>.
+ *  @param      keyID Key ID or fingerprint
+ */
+- (NSArray *) signerKeyIDsForKeyID:(NSString *)keyID;
+
+/*!
+ *  @method     certifiedKeyIDsForKeyID:
+ *  @abstract   Returns the long key IDs of the keys certified by key 
+ *              <i>keyID</i>.
+ *  @param      keyID Key ID or fingerprint
+ */
+- (NSArray *) certifiedKeyIDsForKeyID:(NSString *)keyID;
+
+/*!
+ *  @method     shortestPathFromKeyID:toKeyID:maxLength:
+ *  @abstract   Returns the long key IDs of a shortest certification path 
+ *              from <i>fromKeyID</i> to <i>toKeyID</i>, both included, or nil
+ *              when there is no path of at most <i>maxLength</i> 
+ *              certifications.
+ *  @discussion Each key of the path certified the following one. Search is
+ *              a bidirectional breadth-first search, expanding the smallest
+ *              frontier first.
+ *  @param      fromKeyID Key ID or fingerprint of first key
+ *  @param      toKeyID Key ID or fingerprint of last key
+ *  @param      maxLength Maximum number of certifications; 0 for no limit
+ */
+- (NSArray *) shortestPathFromKeyID:(NSString *)fromKeyID toKeyID:(NSString *)toKeyID maxLength:(unsigned)maxLength;
+
+/*!
+ *  @method     keyIDsReachableFromKeyID:maxLength:
+ *  @abstract   Returns the long key IDs of the keys which can be reached from
+ *              key <i>keyID</i> through at most <i>maxLength</i> 
+ *              certifications.
+ *  @discussion Key <i>keyID</i> is not included, unless it is part of a 
+ *              cycle.
+ *  @param      keyID Key ID or fingerprint of first key
+ *  @param      maxLength Maximum number of certifications; 0 for no limit
+ */
+- (NSSet *) keyIDsReachableFromKeyID:(NSString *)keyID maxLength:(unsigned)maxLength;
+
+/*!
+ *  @method     reloadSignatures
+ *  @abstract   Lists again all keys with their signatures, and rebuilds 
+ *              graph.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; graph is left unchanged
+ *              then.
+ */
+- (void) reloadSignatures;
+
+/*!
+ *  @method     refreshKeysWithFingerprints:
+ *  @abstract   Lists again keys whose fingerprints are <i>fingerprints</i>,
+ *              with their signatures, and replaces their incoming edges.
+ *  @discussion Keys which no longer exist lose their incoming edges and
+ *              their subkey IDs; they remain vertices only while they 
+ *              certify other keys, like unknown signer keys, so that no path
+ *              goes through them. Invoked automatically when 
+ *              <code>@link //macgpg/c/data/GPGKeyringChangedNotification GPGKeyringChangedNotification@/link</code>
+ *              is posted.
+ *  @param      fingerprints Fingerprints of primary keys
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when keys cannot be listed; graph is left unchanged
+ *              then.
+ */
+- (void) refreshKeysWithFingerprints:(NSArray *)fingerprints;
+
+@end
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* GPGSIGNATUREGRAPH_H */
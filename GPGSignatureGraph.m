@@ -0,0 +1,784 @@
+//
+//  GPGSignatureGraph.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+#include <MacGPGME/GPGSignatureGraph.h>
+#include <MacGPGME/GPGContext.h>
+#include <MacGPGME/GPGKey.h>
+#include <MacGPGME/GPGKeySignature.h>
+#include <MacGPGME/GPGSubkey.h>
+#include <MacGPGME/GPGUserID.h>
+#include <MacGPGME/GPGInternals.h>
+#include <Foundation/Foundation.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define _rwlock	((pthread_rwlock_t *)_lock)
+#define _edges	((_GPGIncomingEdges *)_incomingEdges)
+#define _csr	((_GPGCSRGraph *)_graph)
+
+#define NO_VERTEX   UINT32_MAX
+
+
+// Signer vertices of each vertex, sorted, without duplicates
+typedef struct {
+    uint32_t    *sources;
+    uint32_t    count;
+    BOOL        isListed;   // Vertex is a key of the keyring, not only a signer
+} _GPGSourceList;
+
+typedef struct {
+    _GPGSourceList  *lists;
+    uint32_t        vertexCount;
+    uint32_t        capacity;
+} _GPGIncomingEdges;
+
+typedef struct {
+    uint32_t    vertexCount;
+    uint32_t    liveVertexCount;    // Listed keys and signers of listed keys
+    uint32_t    edgeCount;
+    uint32_t    *outOffsets;    // vertexCount + 1
+    uint32_t    *outTargets;
+    uint32_t    *inOffsets;     // vertexCount + 1
+    uint32_t    *inSources;
+} _GPGCSRGraph;
+
+
+@interface GPGSignatureGraph(Private)
+- (NSArray *) _listCertificationsOfKeysWithFingerprints:(NSArray *)fingerprints;
+- (uint32_t) _vertexForKeyID:(NSString *)keyID create:(BOOL)create;
+- (uint32_t) _graphVertexForKeyID:(NSString *)keyID;
+- (void) _unmapSubkeyIDsOfVertex:(uint32_t)vertex;
+- (void) _setCertifications:(NSArray *)certifications;
+- (void) _rebuildGraph;
+- (void) _reloadSignaturesIfNeeded;
+- (void) _lockForReading;
+- (void) keyringDidChange:(NSNotification *)notification;
+@end
+
+
+static int compareVertices(const void *vertex, const void *otherVertex)
+{
+    uint32_t    aVertex = *(const uint32_t *)vertex;
+    uint32_t    anotherVertex = *(const uint32_t *)otherVertex;
+    
+    return (aVertex < anotherVertex ? -1 : (aVertex > anotherVertex ? 1 : 0));
+}
+
+static void ensureIncomingEdgesCapacity(_GPGIncomingEdges *edges, uint32_t vertexCount)
+{
+    if(vertexCount > edges->capacity){
+        uint32_t    aCapacity = MAX(vertexCount, edges->capacity * 2);
+        
+        edges->lists = NSZoneRealloc(NSDefaultMallocZone(), edges->lists, aCapacity * sizeof(_GPGSourceList));
+        memset(edges->lists + edges->capacity, 0, (aCapacity - edges->capacity) * sizeof(_GPGSourceList));
+        edges->capacity = aCapacity;
+    }
+    if(vertexCount > edges->vertexCount)
+        edges->vertexCount = vertexCount;
+}
+
+static void setIncomingEdges(_GPGIncomingEdges *edges, uint32_t vertex, uint32_t *sources, uint32_t count)
+{
+    // Takes ownership of sources
+    _GPGSourceList  *aList = edges->lists + vertex;
+    uint32_t        i, aKeptCount = 0;
+    
+    if(count > 1)
+        qsort(sources, count, sizeof(uint32_t), compareVertices);
+    for(i = 0; i < count; i++)
+        if(sources[i] != vertex && (aKeptCount == 0 || sources[aKeptCount - 1] != sources[i]))
+            sources[aKeptCount++] = sources[i];
+    if(aList->sources != NULL)
+        NSZoneFree(NSDefaultMallocZone(), aList->sources);
+    if(aKeptCount == 0 && sources != NULL){
+        NSZoneFree(NSDefaultMallocZone(), sources);
+        sources = NULL;
+    }
+    aList->sources = sources;
+    aList->count = aKeptCount;
+}
+
+static void freeIncomingEdges(_GPGIncomingEdges *edges)
+{
+    uint32_t    i;
+    
+    for(i = 0; i < edges->vertexCount; i++)
+        if(edges->lists[i].sources != NULL)
+            NSZoneFree(NSDefaultMallocZone(), edges->lists[i].sources);
+    if(edges->lists != NULL)
+        NSZoneFree(NSDefaultMallocZone(), edges->lists);
+    NSZoneFree(NSDefaultMallocZone(), edges);
+}
+
+static void freeCSRGraph(_GPGCSRGraph *graph)
+{
+    NSZoneFree(NSDefaultMallocZone(), graph->outOffsets);
+    NSZoneFree(NSDefaultMallocZone(), graph->outTargets);
+    NSZoneFree(NSDefaultMallocZone(), graph->inOffsets);
+    NSZoneFree(NSDefaultMallocZone(), graph->inSources);
+    NSZoneFree(NSDefaultMallocZone(), graph);
+}
+
+static _GPGCSRGraph *newCSRGraph(const _GPGIncomingEdges *edges)
+{
+    // Incoming rows are the concatenated source lists; outgoing rows are
+    // filled by target order, hence sorted too.
+    _GPGCSRGraph    *aGraph = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGCSRGraph));
+    uint32_t        aVertexCount = edges->vertexCount;
+    uint32_t        *aCursor;
+    uint32_t        i, j;
+    
+    aGraph->vertexCount = aVertexCount;
+    for(i = 0; i < aVertexCount; i++)
+        aGraph->edgeCount += edges->lists[i].count;
+    aGraph->inOffsets = NSZoneMalloc(NSDefaultMallocZone(), (aVertexCount + 1) * sizeof(uint32_t));
+    aGraph->outOffsets = NSZoneCalloc(NSDefaultMallocZone(), aVertexCount + 1, sizeof(uint32_t));
+    aGraph->inSources = NSZoneMalloc(NSDefaultMallocZone(), (aGraph->edgeCount ? aGraph->edgeCount : 1) * sizeof(uint32_t));
+    aGraph->outTargets = NSZoneMalloc(NSDefaultMallocZone(), (aGraph->edgeCount ? aGraph->edgeCount : 1) * sizeof(uint32_t));
+    
+    aGraph->inOffsets[0] = 0;
+    for(i = 0; i < aVertexCount; i++){
+        const _GPGSourceList    *aList = edges->lists + i;
+        
+        if(aList->count > 0)
+            memcpy(aGraph->inSources + aGraph->inOffsets[i], aList->sources, aList->count * sizeof(uint32_t));
+        aGraph->inOffsets[i + 1] = aGraph->inOffsets[i] + aList->count;
+        for(j = 0; j < aList->count; j++)
+            aGraph->outOffsets[aList->sources[j] + 1]++;
+    }
+    for(i = 0; i < aVertexCount; i++){
+        aGraph->outOffsets[i + 1] += aGraph->outOffsets[i];
+        // Keys deleted from keyring are left as vertices without incoming
+        // edges; they are hidden unless they certify keys
+        if(edges->lists[i].isListed || aGraph->outOffsets[i + 1] > aGraph->outOffsets[i])
+            aGraph->liveVertexCount++;
+    }
+    aCursor = NSZoneMalloc(NSDefaultMallocZone(), (aVertexCount ? aVertexCount : 1) * sizeof(uint32_t));
+    memcpy(aCursor, aGraph->outOffsets, aVertexCount * sizeof(uint32_t));
+    for(i = 0; i < aVertexCount; i++)
+        for(j = aGraph->inOffsets[i]; j < aGraph->inOffsets[i + 1]; j++)
+            aGraph->outTargets[aCursor[aGraph->inSources[j]]++] = i;
+    NSZoneFree(NSDefaultMallocZone(), aCursor);
+    
+    return aGraph;
+}
+
+static inline BOOL isLiveVertex(const _GPGCSRGraph *graph, const _GPGIncomingEdges *edges, uint32_t vertex)
+{
+    return vertex < graph->vertexCount && (edges->lists[vertex].isListed || graph->outOffsets[vertex + 1] > graph->outOffsets[vertex]);
+}
+
+static uint32_t breadthFirstSearch(const _GPGCSRGraph *graph, uint32_t origin, uint32_t maxLength, uint32_t *visited)
+{
+    // Fills visited with reached vertices, in BFS order; returns their count.
+    // Uses visited as queue; origin is not included unless in a cycle.
+    uint8_t     *isVisited = NSZoneCalloc(NSDefaultMallocZone(), graph->vertexCount ? graph->vertexCount : 1, sizeof(uint8_t));
+    uint32_t    aCount = 0, aLevelStart = 0, aLevelEnd, aDepth = 0;
+    uint32_t    i, j;
+    
+    // Origin is expanded first, from outside the queue
+    for(j = graph->outOffsets[origin]; j < graph->outOffsets[origin + 1]; j++){
+        uint32_t    aTarget = graph->outTargets[j];
+        
+        if(!isVisited[aTarget]){
+            isVisited[aTarget] = 1;
+            visited[aCount++] = aTarget;
+        }
+    }
+    for(aDepth = 1; aLevelStart < aCount && (maxLength == 0 || aDepth < maxLength); aDepth++){
+        aLevelEnd = aCount;
+        for(i = aLevelStart; i < aLevelEnd; i++){
+            uint32_t    aVertex = visited[i];
+            
+            for(j = graph->outOffsets[aVertex]; j < graph->outOffsets[aVertex + 1]; j++){
+                uint32_t    aTarget = graph->outTargets[j];
+                
+                if(!isVisited[aTarget]){
+                    isVisited[aTarget] = 1;
+                    visited[aCount++] = aTarget;
+                }
+            }
+        }
+        aLevelStart = aLevelEnd;
+    }
+    NSZoneFree(NSDefaultMallocZone(), isVisited);
+    
+    return aCount;
+}
+
+static uint32_t expandSearchLevel(const _GPGCSRGraph *graph, BOOL isForward, uint32_t *queue, uint32_t *levelStart, uint32_t *queueEnd, uint32_t *distances, uint32_t *parents, const uint32_t *otherDistances, uint32_t *meetingVertex, uint32_t *bestLength, uint32_t *meetingParent)
+{
+    // Expands a whole level of one side; records the best meeting with the
+    // other side. Returns number of vertices added.
+    const uint32_t  *offsets = (isForward ? graph->outOffsets : graph->inOffsets);
+    const uint32_t  *neighbours = (isForward ? graph->outTargets : graph->inSources);
+    uint32_t        aLevelEnd = *queueEnd;
+    uint32_t        i, j;
+    
+    for(i = *levelStart; i < aLevelEnd; i++){
+        uint32_t    aVertex = queue[i];
+        
+        for(j = offsets[aVertex]; j < offsets[aVertex + 1]; j++){
+            uint32_t    aNeighbour = neighbours[j];
+            
+            if(otherDistances[aNeighbour] != NO_VERTEX && distances[aVertex] + 1 + otherDistances[aNeighbour] < *bestLength){
+                *bestLength = distances[aVertex] + 1 + otherDistances[aNeighbour];
+                *meetingVertex = aNeighbour;
+                *meetingParent = aVertex;
+            }
+            if(distances[aNeighbour] == NO_VERTEX){
+                distances[aNeighbour] = distances[aVertex] + 1;
+                parents[aNeighbour] = aVertex;
+                queue[(*queueEnd)++] = aNeighbour;
+            }
+        }
+    }
+    *levelStart = aLevelEnd;
+    
+    return *queueEnd - aLevelEnd;
+}
+
+static NSArray *shortestPath(const _GPGCSRGraph *graph, NSArray *keyIDs, uint32_t from, uint32_t to, uint32_t maxLength)
+{
+    // Bidirectional BFS: forward on outgoing edges from origin, backward on
+    // incoming edges from destination; smallest frontier is expanded first.
+    uint32_t        aVertexCount = graph->vertexCount;
+    uint32_t        *buffer;
+    uint32_t        *forwardDistances, *backwardDistances, *forwardParents, *backwardParents, *forwardQueue, *backwardQueue;
+    uint32_t        aForwardStart = 0, aForwardEnd = 1, aBackwardStart = 0, aBackwardEnd = 1;
+    uint32_t        aForwardDepth = 0, aBackwardDepth = 0;
+    uint32_t        aBestLength = UINT32_MAX, aMeetingVertex = NO_VERTEX, aMeetingParent = NO_VERTEX;
+    BOOL            isForwardMeeting = YES;
+    NSMutableArray  *aPath = nil;
+    uint32_t        aVertex;
+    
+    if(from == to)
+        return [NSArray arrayWithObject:[keyIDs objectAtIndex:from]];
+    if(maxLength == 0)
+        maxLength = UINT32_MAX - 1;
+    
+    buffer = NSZoneMalloc(NSDefaultMallocZone(), 6 * aVertexCount * sizeof(uint32_t));
+    forwardDistances = buffer;
+    backwardDistances = buffer + aVertexCount;
+    forwardParents = buffer + 2 * aVertexCount;
+    backwardParents = buffer + 3 * aVertexCount;
+    forwardQueue = buffer + 4 * aVertexCount;
+    backwardQueue = buffer + 5 * aVertexCount;
+    memset(forwardDistances, 0xFF, 2 * aVertexCount * sizeof(uint32_t));
+    forwardDistances[from] = 0;
+    backwardDistances[to] = 0;
+    forwardParents[from] = NO_VERTEX;
+    backwardParents[to] = NO_VERTEX;
+    forwardQueue[0] = from;
+    backwardQueue[0] = to;
+    
+    // Once a meeting is found, no path shorter than the current depths sum
+    // plus one can still be found.
+    while(aForwardStart < aForwardEnd && aBackwardStart < aBackwardEnd && aForwardDepth + aBackwardDepth < maxLength && aBestLength > aForwardDepth + aBackwardDepth + 1){
+        uint32_t    aPreviousBest = aBestLength;
+        
+        if(aForwardEnd - aForwardStart <= aBackwardEnd - aBackwardStart){
+            expandSearchLevel(graph, YES, forwardQueue, &aForwardStart, &aForwardEnd, forwardDistances, forwardParents, backwardDistances, &aMeetingVertex, &aBestLength, &aMeetingParent);
+            aForwardDepth++;
+            if(aBestLength != aPreviousBest)
+                isForwardMeeting = YES;
+        }
+        else{
+            expandSearchLevel(graph, NO, backwardQueue, &aBackwardStart, &aBackwardEnd, backwardDistances, backwardParents, forwardDistances, &aMeetingVertex, &aBestLength, &aMeetingParent);
+            aBackwardDepth++;
+            if(aBestLength != aPreviousBest)
+                isForwardMeeting = NO;
+        }
+    }
+    
+    if(aBestLength <= maxLength){
+        // Meeting edge is (parent -> meeting vertex) when found forward, 
+        // (meeting vertex -> parent) when found backward.
+        uint32_t    aForwardVertex = (isForwardMeeting ? aMeetingParent : aMeetingVertex);
+        uint32_t    aBackwardVertex = (isForwardMeeting ? aMeetingVertex : aMeetingParent);
+        
+        aPath = [NSMutableArray arrayWithCapacity:aBestLength + 1];
+        for(aVertex = aForwardVertex; aVertex != NO_VERTEX; aVertex = forwardParents[aVertex])
+            [aPath insertObject:[keyIDs objectAtIndex:aVertex] atIndex:0];
+        for(aVertex = aBackwardVertex; aVertex != NO_VERTEX; aVertex = backwardParents[aVertex])
+            [aPath addObject:[keyIDs objectAtIndex:aVertex]];
+    }
+    NSZoneFree(NSDefaultMallocZone(), buffer);
+    
+    return aPath;
+}
+
+
+@implementation GPGSignatureGraph
+
+- (id) init
+{
+    NSArray *someCertifications;
+    
+    NS_DURING
+        someCertifications = [self _listCertificationsOfKeysWithFingerprints:nil];
+    NS_HANDLER
+        [self release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    if(self = [self _initWithCertifications:someCertifications]){
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(keyringDidChange:) name:GPGKeyringChangedNotification object:nil];
+        [[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(keyringDidChange:) name:GPGKeyringChangedNotification object:nil];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [[NSDistributedNotificationCenter defaultCenter] removeObserver:self];
+    [_keyIDs release];
+    [_verticesByKeyID release];
+    [_subkeyIDs release];
+    if(_incomingEdges != NULL)
+        freeIncomingEdges(_edges);
+    if(_graph != NULL)
+        freeCSRGraph(_csr);
+    if(_lock != NULL){
+        pthread_rwlock_destroy(_rwlock);
+        NSZoneFree([self zone], _lock);
+    }
+    
+    [super dealloc];
+}
+
+- (unsigned) keyCount
+{
+    unsigned    aCount;
+    
+    [self _lockForReading];
+    aCount = _csr->liveVertexCount;
+    pthread_rwlock_unlock(_rwlock);
+    
+    return aCount;
+}
+
+- (unsigned) certificationCount
+{
+    unsigned    aCount;
+    
+    [self _lockForReading];
+    aCount = _csr->edgeCount;
+    pthread_rwlock_unlock(_rwlock);
+    
+    return aCount;
+}
+
+- (unsigned) certificationCountForKeyID:(NSString *)keyID
+{
+    unsigned    aCount = 0;
+    uint32_t    aVertex;
+    
+    [self _lockForReading];
+    aVertex = [self _graphVertexForKeyID:keyID];
+    if(aVertex != NO_VERTEX)
+        aCount = _csr->inOffsets[aVertex + 1] - _csr->inOffsets[aVertex];
+    pthread_rwlock_unlock(_rwlock);
+    
+    return aCount;
+}
+
+- (NSArray *) signerKeyIDsForKeyID:(NSString *)keyID
+{
+    NSMutableArray  *someKeyIDs = [NSMutableArray array];
+    uint32_t        aVertex, i;
+    
+    [self _lockForReading];
+    aVertex = [self _graphVertexForKeyID:keyID];
+    if(aVertex != NO_VERTEX)
+        for(i = _csr->inOffsets[aVertex]; i < _csr->inOffsets[aVertex + 1]; i++)
+            [someKeyIDs addObject:[_keyIDs objectAtIndex:_csr->inSources[i]]];
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeyIDs;
+}
+
+- (NSArray *) certifiedKeyIDsForKeyID:(NSString *)keyID
+{
+    NSMutableArray  *someKeyIDs = [NSMutableArray array];
+    uint32_t        aVertex, i;
+    
+    [self _lockForReading];
+    aVertex = [self _graphVertexForKeyID:keyID];
+    if(aVertex != NO_VERTEX)
+        for(i = _csr->outOffsets[aVertex]; i < _csr->outOffsets[aVertex + 1]; i++)
+            [someKeyIDs addObject:[_keyIDs objectAtIndex:_csr->outTargets[i]]];
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeyIDs;
+}
+
+- (NSArray *) shortestPathFromKeyID:(NSString *)fromKeyID toKeyID:(NSString *)toKeyID maxLength:(unsigned)maxLength
+{
+    NSArray     *aPath = nil;
+    uint32_t    aFromVertex, aToVertex;
+    
+    [self _lockForReading];
+    aFromVertex = [self _graphVertexForKeyID:fromKeyID];
+    aToVertex = [self _graphVertexForKeyID:toKeyID];
+    if(aFromVertex != NO_VERTEX && aToVertex != NO_VERTEX)
+        aPath = shortestPath(_csr, _keyIDs, aFromVertex, aToVertex, maxLength);
+    pthread_rwlock_unlock(_rwlock);
+    
+    return aPath;
+}
+
+- (NSSet *) keyIDsReachableFromKeyID:(NSString *)keyID maxLength:(unsigned)maxLength
+{
+    NSMutableSet    *someKeyIDs = [NSMutableSet set];
+    uint32_t        aVertex;
+    
+    [self _lockForReading];
+    aVertex = [self _graphVertexForKeyID:keyID];
+    if(aVertex != NO_VERTEX){
+        uint32_t    *visited = NSZoneMalloc(NSDefaultMallocZone(), (_csr->vertexCount ? _csr->vertexCount : 1) * sizeof(uint32_t));
+        uint32_t    aCount = breadthFirstSearch(_csr, aVertex, maxLength, visited);
+        uint32_t    i;
+        
+        for(i = 0; i < aCount; i++)
+            [someKeyIDs addObject:[_keyIDs objectAtIndex:visited[i]]];
+        NSZoneFree(NSDefaultMallocZone(), visited);
+    }
+    pthread_rwlock_unlock(_rwlock);
+    
+    return someKeyIDs;
+}
+
+- (void) reloadSignatures
+{
+    // Keys are listed without holding the lock; changes notified meanwhile
+    // without keys will need another reload
+    NSArray *someCertifications;
+    
+    _needsReload = 0;
+    someCertifications = [self _listCertificationsOfKeysWithFingerprints:nil];
+    
+    pthread_rwlock_wrlock(_rwlock);
+    [_keyIDs removeAllObjects];
+    [_verticesByKeyID removeAllObjects];
+    [_subkeyIDs removeAllObjects];
+    freeIncomingEdges(_edges);
+    _incomingEdges = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGIncomingEdges));
+    [self _setCertifications:someCertifications];
+    [self _rebuildGraph];
+    pthread_rwlock_unlock(_rwlock);
+}
+
+- (void) refreshKeysWithFingerprints:(NSArray *)fingerprints
+{
+    // Keys are listed without holding the lock, all in one listing
+    if([fingerprints count] == 0)
+        return;
+    [self _refreshKeysWithFingerprints:fingerprints certifications:[self _listCertificationsOfKeysWithFingerprints:fingerprints]];
+}
+
+@end
+
+
+@implementation GPGSignatureGraph(GPGInternals)
+
+- (id) _initWithCertifications:(NSArray *)certifications
+{
+    if(self = [super init]){
+        _lock = NSZoneMalloc([self zone], sizeof(pthread_rwlock_t));
+        pthread_rwlock_init(_rwlock, NULL);
+        _keyIDs = [[NSMutableArray alloc] init];
+        _verticesByKeyID = [[NSMutableDictionary alloc] init];
+        _subkeyIDs = [[NSMutableArray alloc] init];
+        _incomingEdges = NSZoneCalloc(NSDefaultMallocZone(), 1, sizeof(_GPGIncomingEdges));
+        [self _setCertifications:certifications];
+        [self _rebuildGraph];
+    }
+    
+    return self;
+}
+
+- (void) _refreshKeysWithFingerprints:(NSArray *)fingerprints certifications:(NSArray *)certifications
+{
+    // Only incoming edges of changed keys are replaced; rows are rebuilt by
+    // next query, once for all changes made until then.
+    NSMutableSet    *listedKeyIDs = [NSMutableSet setWithCapacity:[certifications count]];
+    NSEnumerator    *anEnum = [certifications objectEnumerator];
+    NSArray         *aCertification;
+    NSString        *aFingerprint;
+    
+    while((aCertification = [anEnum nextObject]) != nil)
+        [listedKeyIDs addObject:[aCertification objectAtIndex:0]];
+    
+    pthread_rwlock_wrlock(_rwlock);
+    // Keys which are not listed anymore have been deleted
+    anEnum = [fingerprints objectEnumerator];
+    while((aFingerprint = [anEnum nextObject]) != nil){
+        NSString    *aKeyID = GPGNormalizedHexString(aFingerprint, 16);
+        uint32_t    aVertex;
+        
+        if([listedKeyIDs containsObject:aKeyID])
+            continue;
+        aVertex = [self _vertexForKeyID:aKeyID create:NO];
+        if(aVertex != NO_VERTEX){
+            setIncomingEdges(_edges, aVertex, NULL, 0);
+            _edges->lists[aVertex].isListed = NO;
+            [self _unmapSubkeyIDsOfVertex:aVertex];
+        }
+    }
+    [self _setCertifications:certifications];
+    _needsRebuild = 1;
+    pthread_rwlock_unlock(_rwlock);
+}
+
+@end
+
+
+@implementation GPGSignatureGraph(Private)
+
+- (NSArray *) _listCertificationsOfKeysWithFingerprints:(NSArray *)fingerprints
+{
+    // Lists all keys when fingerprints is nil. Returns, for each key, an
+    // array with its primary key ID, the key IDs of its subkeys, and the set
+    // of key IDs of keys which certified it; keys are not kept, as their
+    // signatures take much memory.
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSMutableArray  *someCertifications = [NSMutableArray array];
+    NSMutableArray  *patterns = nil;
+    
+    if(fingerprints != nil){
+        NSEnumerator    *anEnum = [fingerprints objectEnumerator];
+        NSString        *aFingerprint;
+        
+        patterns = [NSMutableArray arrayWithCapacity:[fingerprints count]];
+        while((aFingerprint = [anEnum nextObject]) != nil)
+            [patterns addObject:[@"0x" stringByAppendingString:GPGNormalizedHexString(aFingerprint, 40)]];
+    }
+    
+    NS_DURING
+        NSEnumerator    *keyEnum;
+        GPGKey          *aKey;
+        
+        [aContext setKeyListMode:GPGKeyListModeLocal | GPGKeyListModeSignatures];
+        keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO];
+        while(YES){
+            NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+            NSMutableSet        *signerKeyIDs;
+            NSEnumerator        *anEnum;
+            GPGUserID           *aUserID;
+            
+            aKey = [keyEnum nextObject];
+            if(aKey == nil){
+                [localAP release];
+                break;
+            }
+            
+            // A signer certifies key if it has a valid certification on a
+            // user ID, which it did not revoke.
+            signerKeyIDs = [NSMutableSet set];
+            anEnum = [[aKey userIDs] objectEnumerator];
+            while((aUserID = [anEnum nextObject]) != nil){
+                NSMutableSet        *certifierKeyIDs = [NSMutableSet set];
+                NSMutableSet        *revokerKeyIDs = [NSMutableSet set];
+                NSEnumerator        *signatureEnum = [[aUserID signatures] objectEnumerator];
+                GPGKeySignature     *aSignature;
+                
+                if([aUserID hasBeenRevoked] || [aUserID isInvalid])
+                    continue;
+                while((aSignature = [signatureEnum nextObject]) != nil){
+                    NSString    *aSignerKeyID = [[aSignature signerKeyID] uppercaseString];
+                    
+                    if(aSignerKeyID == nil)
+                        continue;
+                    if([aSignature isRevocationSignature])
+                        [revokerKeyIDs addObject:aSignerKeyID];
+                    else if(![aSignature hasSignatureExpired] && ![aSignature isSignatureInvalid])
+                        [certifierKeyIDs addObject:aSignerKeyID];
+                }
+                [certifierKeyIDs minusSet:revokerKeyIDs];
+                [signerKeyIDs unionSet:certifierKeyIDs];
+            }
+            [someCertifications addObject:[NSArray arrayWithObjects:[[aKey keyID] uppercaseString], [[[aKey subkeys] valueForKey:@"keyID"] valueForKey:@"uppercaseString"], signerKeyIDs, nil]];
+            [localAP release];
+        }
+        [aContext stopKeyEnumeration];
+        [aContext release];
+    NS_HANDLER
+        [aContext stopKeyEnumeration];
+        [aContext release];
+        [localException raise];
+    NS_ENDHANDLER
+    
+    return someCertifications;
+}
+
+- (uint32_t) _vertexForKeyID:(NSString *)keyID create:(BOOL)create
+{
+    // Lock must be held; for writing when create is YES
+    NSNumber    *aVertex;
+    
+    if(keyID == nil)
+        return NO_VERTEX;
+    keyID = GPGNormalizedHexString(keyID, 16); // Long key ID; last 16 digits of fingerprints
+    aVertex = [_verticesByKeyID objectForKey:keyID];
+    if(aVertex != nil)
+        return [aVertex unsignedIntValue];
+    if(!create)
+        return NO_VERTEX;
+    
+    aVertex = [NSNumber numberWithUnsignedInt:[_keyIDs count]];
+    [_keyIDs addObject:keyID];
+    [_subkeyIDs addObject:[NSArray array]];
+    [_verticesByKeyID setObject:aVertex forKey:keyID];
+    ensureIncomingEdgesCapacity(_edges, [_keyIDs count]);
+    
+    return [aVertex unsignedIntValue];
+}
+
+- (uint32_t) _graphVertexForKeyID:(NSString *)keyID
+{
+    // Lock must be held, graph rows up to date; hidden vertices of deleted
+    // keys are not returned
+    uint32_t    aVertex = [self _vertexForKeyID:keyID create:NO];
+    
+    if(aVertex != NO_VERTEX && !isLiveVertex(_csr, _edges, aVertex))
+        return NO_VERTEX;
+    
+    return aVertex;
+}
+
+- (void) _unmapSubkeyIDsOfVertex:(uint32_t)vertex
+{
+    // Lock must be held for writing, or receiver not yet shared
+    NSEnumerator    *keyIDEnum = [[_subkeyIDs objectAtIndex:vertex] objectEnumerator];
+    NSString        *aKeyID;
+    
+    while((aKeyID = [keyIDEnum nextObject]) != nil)
+        if([[_verticesByKeyID objectForKey:aKeyID] unsignedIntValue] == vertex)
+            [_verticesByKeyID removeObjectForKey:aKeyID];
+    [_subkeyIDs replaceObjectAtIndex:vertex withObject:[NSArray array]];
+}
+
+- (void) _setCertifications:(NSArray *)certifications
+{
+    // Lock must be held for writing, or receiver not yet shared
+    NSEnumerator    *anEnum = [certifications objectEnumerator];
+    NSArray         *aCertification;
+    
+    while((aCertification = [anEnum nextObject]) != nil){
+        uint32_t        aVertex = [self _vertexForKeyID:[aCertification objectAtIndex:0] create:YES];
+        NSEnumerator    *keyIDEnum = [[aCertification objectAtIndex:1] objectEnumerator];
+        NSSet           *signerKeyIDs = [aCertification objectAtIndex:2];
+        NSMutableArray  *mappedKeyIDs = [NSMutableArray array];
+        NSString        *aKeyID;
+        uint32_t        *sources;
+        uint32_t        aSourceCount = 0;
+        
+        // Subkey IDs designate the key too, unless already known as another
+        // vertex (e.g. signer key seen before its key). Subkeys which have
+        // been removed from the key do not designate it anymore.
+        [self _unmapSubkeyIDsOfVertex:aVertex];
+        _edges->lists[aVertex].isListed = YES;
+        while((aKeyID = [keyIDEnum nextObject]) != nil){
+            if([_verticesByKeyID objectForKey:aKeyID] == nil){
+                [_verticesByKeyID setObject:[NSNumber numberWithUnsignedInt:aVertex] forKey:aKeyID];
+                [mappedKeyIDs addObject:aKeyID];
+            }
+        }
+        [_subkeyIDs replaceObjectAtIndex:aVertex withObject:mappedKeyIDs];
+        
+        sources = NSZoneMalloc(NSDefaultMallocZone(), ([signerKeyIDs count] ? [signerKeyIDs count] : 1) * sizeof(uint32_t));
+        keyIDEnum = [signerKeyIDs objectEnumerator];
+        while((aKeyID = [keyIDEnum nextObject]) != nil)
+            sources[aSourceCount++] = [self _vertexForKeyID:aKeyID create:YES];
+        setIncomingEdges(_edges, aVertex, sources, aSourceCount);
+    }
+}
+
+- (void) _rebuildGraph
+{
+    // Lock must be held for writing, or receiver not yet shared
+    if(_graph != NULL)
+        freeCSRGraph(_csr);
+    _graph = newCSRGraph(_edges);
+    _needsRebuild = 0;
+}
+
+- (void) _reloadSignaturesIfNeeded
+{
+    // Only one of concurrent queries reloads; others use current graph.
+    // Errors are not propagated to the query.
+    if(_needsReload == 0 || !GPGAtomicCompareAndSwap32(1, 0, (volatile int32_t *)&_needsReload))
+        return;
+    NS_DURING
+        [self reloadSignatures];
+    NS_HANDLER
+        NSLog(@"### GPGSignatureGraph: unable to reload signatures: %@", localException);
+    NS_ENDHANDLER
+}
+
+- (void) _lockForReading
+{
+    // Returns with lock held for reading, and graph rows up to date
+    [self _reloadSignaturesIfNeeded];
+    pthread_rwlock_rdlock(_rwlock);
+    while(_needsRebuild){
+        pthread_rwlock_unlock(_rwlock);
+        pthread_rwlock_wrlock(_rwlock);
+        if(_needsRebuild)
+            [self _rebuildGraph];
+        pthread_rwlock_unlock(_rwlock);
+        pthread_rwlock_rdlock(_rwlock);
+    }
+}
+
+- (void) keyringDidChange:(NSNotification *)notification
+{
+    // Without changed keys, whole graph must be listed again: this is
+    // deferred to the next query, rather than slowing down the poster.
+    NSArray *fingerprints;
+    
+    if(GPGNotificationIsFromCurrentProcess(notification))
+        return; // Already notified locally
+    fingerprints = GPGChangedKeyFingerprints(notification);
+    
+    NS_DURING
+        if([fingerprints count] == 0)
+            (void)GPGAtomicCompareAndSwap32(0, 1, (volatile int32_t *)&_needsReload);
+        else
+            [self refreshKeysWithFingerprints:fingerprints];
+    NS_HANDLER
+        // Do not propagate exception to the poster
+        NSLog(@"### GPGSignatureGraph: unable to refresh signatures: %@", localException);
+    NS_ENDHANDLER
+}
+
+@end
@@ -69,6 +69,8 @@ extern "C" {
 {
     GPGKey	*_key; // Key owning the subkey; not retained
     int		_refCount;
+    NSString	*_keyID; // Strings are built once, on first access
+    NSString	*_fingerprint;
 }
 
 /*!
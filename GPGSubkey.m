@@ -39,18 +39,22 @@
 {
     // See GPGKey.m for more information
     [_key retain];
-    _refCount++;
+    GPGAtomicIncrement32(&_refCount);
 
     return self;
 }
 
 - (oneway void) release
 {
-    // See GPGKey.m for more information
-    if(_refCount > 0){
-        _refCount--;
+    // See GPGKey.m for more information. Internal ref count is modified
+    // atomically, because keys can be shared by threads.
+    int32_t	aCount;
+    
+    do{
+        aCount = _refCount;
+    }while(aCount > 0 && !GPGAtomicCompareAndSwap32(aCount, aCount - 1, &_refCount));
+    if(aCount > 0)
         [_key release];
-    }
     else{
         if(_refCount < 0)
             NSLog(@"### GPGSubkey: _refCount < 0! (%d)", _refCount);
@@ -58,6 +62,14 @@
     }
 }
 
+- (void) dealloc
+{
+    [_keyID release];
+    [_fingerprint release];
+    
+    [super dealloc];
+}
+
 - (GPGKey *) key
 {
     return _key;
@@ -131,12 +143,12 @@
 
 - (NSString *) keyID
 {
-    return GPGStringFromChars(_subkey->keyid);
+    return GPGCachedStringFromKeyChars(&_keyID, _subkey->keyid, [_key gpgmeKey]);
 }
 
 - (NSString *) fingerprint
 {
-    return GPGStringFromChars(_subkey->fpr);
+    return GPGCachedStringFromKeyChars(&_fingerprint, _subkey->fpr, [_key gpgmeKey]);
 }
 
 - (NSCalendarDate *) creationDate
@@ -281,8 +293,11 @@
 
 - (id) initWithInternalRepresentation:(void *)aPtr key:(GPGKey *)key
 {
-    if(self = [self initWithInternalRepresentation:aPtr])
+    if(self = [self initWithInternalRepresentation:aPtr]){
         ((GPGSubkey *)self)->_key = key; // Not retained
+        if(_subkey->fpr != NULL)
+            (void)GPGFingerprintFromHexChars(_subkey->fpr, strlen(_subkey->fpr), &((GPGSubkey *)self)->_packedFingerprint);
+    }
 
     return self;
 }
@@ -98,17 +98,12 @@
 
 - (void) searchKeysLocally
 {
-    GPGContext	*aContext = [[GPGContext alloc] init];
+    // Keyring snapshot is searched in-process; no keylisting per search
+    GPGKeyring	*aKeyring = ([secretKeySwitch state] ? [GPGKeyring secretKeyring] : [GPGKeyring publicKeyring]);
     
     [keys release];
     keys = nil;
-#if 0
-    keys = [[[aContext keyEnumeratorForSearchPattern:[searchPatternTextField stringValue] secretKeysOnly:[secretKeySwitch state]] allObjects] retain];
-#else
-    keys = [[[aContext keyEnumeratorForSearchPatterns:[NSArray arrayWithObject:[searchPatternTextField stringValue]] secretKeysOnly:[secretKeySwitch state]] allObjects] retain];
-#endif
-    [aContext stopKeyEnumeration];
-    [aContext release];
+    keys = [[aKeyring keysMatchingString:[searchPatternTextField stringValue]] retain];
     [keyTableView noteNumberOfRowsChanged];
     [keyTableView reloadData];
 }
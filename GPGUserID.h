@@ -62,13 +62,18 @@ extern "C" {
  *              available if the key was retrieved via a listing operation with
  *              the <code>@link //macgpg/c/econst/GPGKeyListModeSignatures GPGKeyListModeSignatures@/link</code>
  *              mode enabled, because it is expensive to retrieve all signatures
- *              of a key.
+ *              of a key, or after they have been fetched on demand with
+ *              <code>@link signaturesLoadingIfNeeded signaturesLoadingIfNeeded@/link</code>.
  */
 @interface GPGUserID : GPGObject <NSCopying>
 {     
     GPGKey	*_key; // Key owning the user ID; not retained
     NSArray	*_signatures; // Signatures on the user ID
     int		_refCount;
+    NSString	*_userIDString; // Strings are built once, on first access
+    NSString	*_name;
+    NSString	*_email;
+    NSString	*_comment;
 }
 
 /*!
@@ -178,6 +183,21 @@ extern "C" {
  */
 - (NSArray *) signatures;
 
+/*!
+ *  @method     signaturesLoadingIfNeeded
+ *  @abstract   Returns the signatures on the <i>user ID</i>, fetching them
+ *              first if needed.
+ *  @discussion When signatures have not been fetched, invokes 
+ *              <code>@link //macgpg/occ/instm/GPGKey/loadSignatures loadSignatures@/link</code>
+ *              (GPGKey) on the owning key. To fetch signatures of many keys,
+ *              use <code>@link //macgpg/occ/clm/GPGKey/loadSignaturesOfKeys: loadSignaturesOfKeys:@/link</code>
+ *              (GPGKey) first: keys are then listed by batches. Never returns
+ *              nil.
+ *  @exception  <code>@link //macgpg/c/data/GPGException GPGException@/link</code>
+ *              exception when key cannot be listed.
+ */
+- (NSArray *) signaturesLoadingIfNeeded;
+
 @end
 
 #ifdef __cplusplus
@@ -42,18 +42,22 @@
 {
     // See GPGKey.m for more information
     [_key retain];
-    _refCount++;
+    GPGAtomicIncrement32(&_refCount);
 
     return self;
 }
 
 - (oneway void) release
 {
-    // See GPGKey.m for more information
-    if(_refCount > 0){
-        _refCount--;
+    // See GPGKey.m for more information. Internal ref count is modified
+    // atomically, because keys can be shared by threads.
+    int32_t	aCount;
+    
+    do{
+        aCount = _refCount;
+    }while(aCount > 0 && !GPGAtomicCompareAndSwap32(aCount, aCount - 1, &_refCount));
+    if(aCount > 0)
         [_key release];
-    }
     else{
         if(_refCount < 0)
             NSLog(@"### GPGUserID: _refCount < 0! (%d)", _refCount);
@@ -65,6 +69,10 @@
 {
     if(_signatures != nil)
         [_signatures release];
+    [_userIDString release];
+    [_name release];
+    [_email release];
+    [_comment release];
 
     [super dealloc];
 }
@@ -82,22 +90,22 @@
 
 - (NSString *) userID
 {
-    return GPGStringFromChars(_userID->uid);
+    return GPGCachedStringFromKeyChars(&_userIDString, _userID->uid, [_key gpgmeKey]);
 }
 
 - (NSString *) name
 {
-    return GPGStringFromChars(_userID->name);
+    return GPGCachedStringFromKeyChars(&_name, _userID->name, [_key gpgmeKey]);
 }
 
 - (NSString *) email
 {
-    return GPGStringFromChars(_userID->email);
+    return GPGCachedStringFromKeyChars(&_email, _userID->email, [_key gpgmeKey]);
 }
 
 - (NSString *) comment
 {
-    return GPGStringFromChars(_userID->comment);
+    return GPGCachedStringFromKeyChars(&_comment, _userID->comment, [_key gpgmeKey]);
 }
 
 - (GPGValidity) validity
@@ -125,21 +133,38 @@
     // We cannot force fetch of signatures because when using -refreshKey:
     // we need to return a new GPGKey instance, because userIDs could have changed,
     // thus self (GPGUserID) could even disappear.
-    if(_signatures == nil && _userID->signatures != NULL){
+    // User ID can be shared by threads: array is built without lock, and
+    // published only once.
+    NSArray *signatures = _signatures;
+    
+    if(signatures == nil && _userID->signatures != NULL){
         // Check that there is a signature; keyID is mandatory, AFAIK
         gpgme_key_sig_t	aSignature = _userID->signatures;
+        NSMutableArray  *newSignatures = [[NSMutableArray allocWithZone:[self zone]] init];
 
-        _signatures = [[NSMutableArray allocWithZone:[self zone]] init];
         while(aSignature != NULL){
             GPGKeySignature	*newSignature = [[GPGKeySignature allocWithZone:[self zone]] initWithKeySignature:aSignature userID:self];
 
-            [(NSMutableArray *)_signatures addObject:newSignature];
+            [newSignatures addObject:newSignature];
             [newSignature release];
             aSignature = aSignature->next;
         }
+        signatures = GPGPublishLazyObject(&_signatures, newSignatures);
     }
 
-    return _signatures;
+    return signatures;
+}
+
+- (NSArray *) signaturesLoadingIfNeeded
+{
+    NSArray *signatures = [self signatures];
+    
+    if(signatures == nil){
+        [_key loadSignatures];
+        signatures = [self signatures];
+    }
+    
+    return (signatures != nil ? signatures : [NSArray array]);
 }
 
 - (GPGKey *) key
@@ -206,4 +231,11 @@
     return aDictionary;
 }
 
+- (void) setLoadedSignatures:(NSArray *)signatures
+{
+    // Signatures fetched by +[GPGKey loadSignaturesOfKeys:]; like lazily
+    // built ones, they are published only once.
+    GPGPublishLazyObject(&_signatures, [signatures copyWithZone:[self zone]]);
+}
+
 @end
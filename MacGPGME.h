@@ -33,8 +33,15 @@
 #include <MacGPGME/GPGDefines.h>
 #include <MacGPGME/GPGContext.h>
 #include <MacGPGME/GPGData.h>
+#include <MacGPGME/GPGDataPipe.h>
+#include <MacGPGME/GPGDigestData.h>
+#include <MacGPGME/GPGKeyring.h>
+#include <MacGPGME/GPGKeyMetadataCache.h>
+#include <MacGPGME/GPGSignatureGraph.h>
+#include <MacGPGME/GPGKeyTable.h>
 #include <MacGPGME/GPGEngine.h>
 #include <MacGPGME/GPGExceptions.h>
+#include <MacGPGME/GPGFingerprint.h>
 #include <MacGPGME/GPGKeyDefines.h>
 #include <MacGPGME/GPGKey.h>
 #include <MacGPGME/GPGKeyGroup.h>
@@ -0,0 +1,674 @@
+//
+//  MacGPGMEBenchmarks.m
+//  MacGPGME
+//
+//  Created by the Mac GPG Project on Mon Oct 19 2026.
+//
+//
+//  Copyright (C) 2001-2006 Mac GPG Project.
+//  
+//  This code is free software; you can redistribute it and/or modify it under
+//  the terms of the GNU Lesser General Public License as published by the Free
+//  Software Foundation; either version 2.1 of the License, or (at your option)
+//  any later version.
+//  
+//  This code is distributed in the hope that it will be useful, but WITHOUT ANY
+//  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+//  FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+//  details.
+//  
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with this program; if not, visit <http://www.gnu.org/> or write to the
+//  Free Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, 
+//  MA 02111-1307, USA.
+//  
+//  More info at <http://macgpg.sourceforge.net/>
+//
+
+// Command-line tool measuring MacGPGME performance. These are not unit tests:
+// timings depend on the machine, so nothing is asserted; run the tool on
+// demand, on an idle machine, and compare its output between builds.
+//
+// Usage: MacGPGMEBenchmarks [benchmarkName ...]
+// Names are those of the -benchmark... methods, without the prefix (e.g.
+// Armor); without argument, all benchmarks are run. Each benchmark prints
+// its results on stdout, one measure per line.
+//
+// Built by the MacGPGMEBenchmarks target (Xcode) or tool (GNUmakefile),
+// after the framework; with Xcode, run it with DYLD_FRAMEWORK_PATH set to
+// the build products directory.
+// Benchmarks comparing with gpg use the default OpenPGP engine and home
+// directory.
+
+#import <MacGPGME/MacGPGME.h>
+#import <MacGPGME/GPGInternals.h>
+#import <Foundation/Foundation.h>
+#import <sys/time.h>
+#import <math.h>
+#import <stdio.h>
+#import <stdlib.h>
+#import <pthread.h>
+#import <unistd.h>
+
+
+#define BENCHMARK_RUN_COUNT     5   // Best of
+#define ARMOR_BYTE_COUNT        (16 * 1024 * 1024)
+#define UNIQUING_POINTER_COUNT  256
+#define UNIQUING_ITERATION_COUNT    500000  // Per thread
+#define SYNTHETIC_KEY_COUNT     100000
+#define KEYRING_QUERY_COUNT     100     // Per measure
+
+
+static double currentTime(void)
+{
+    struct timeval  aTime;
+    
+    gettimeofday(&aTime, NULL);
+    
+    return aTime.tv_sec + aTime.tv_usec / 1000000.0;
+}
+
+static NSData *pseudoRandomData(size_t length, unsigned seed)
+{
+    // Same bytes on each run
+    NSMutableData   *someData = [NSMutableData dataWithLength:length];
+    unsigned char   *bytes = [someData mutableBytes];
+    size_t          i;
+    
+    for(i = 0; i < length; i++)
+        bytes[i] = (unsigned char)rand_r(&seed);
+    
+    return someData;
+}
+
+static void printResult(NSString *benchmarkName, NSString *measure, NSString *format, ...)
+{
+    va_list     arguments;
+    NSString    *aValue;
+    
+    va_start(arguments, format);
+    aValue = [[NSString alloc] initWithFormat:format arguments:arguments];
+    va_end(arguments);
+    printf("%s: %s: %s\n", [benchmarkName UTF8String], [measure UTF8String], [aValue UTF8String]);
+    fflush(stdout);
+    [aValue release];
+}
+
+
+// Uniquing of wrappers (GPGObject), compared with a single lock protecting
+// one map table; both wrap fake pointers. Baseline takes the lock on each
+// release, and removes the wrapper when its retain count is 1.
+@interface BenchmarkUniquedObject : GPGObject
+@end
+
+@implementation BenchmarkUniquedObject
+
++ (BOOL) needsPointerUniquing
+{
+    return YES;
+}
+
+@end
+
+@interface BaselineUniquedObject : NSObject
+{
+    void    *pointer;
+}
+
+- (id) initWithPointer:(void *)aPtr;
+
+@end
+
+static pthread_mutex_t  baselineUniquingLock = PTHREAD_MUTEX_INITIALIZER;
+static NSMapTable       *baselineUniquingTable = NULL;
+
+@implementation BaselineUniquedObject
+
+- (id) initWithPointer:(void *)aPtr
+{
+    if((self = [super init]) != nil){
+        id  anExistingObject;
+        
+        pthread_mutex_lock(&baselineUniquingLock);
+        anExistingObject = NSMapGet(baselineUniquingTable, aPtr);
+        if(anExistingObject != nil)
+            [anExistingObject retain];
+        else{
+            pointer = aPtr;
+            NSMapInsertKnownAbsent(baselineUniquingTable, aPtr, self);
+        }
+        pthread_mutex_unlock(&baselineUniquingLock);
+        if(anExistingObject != nil){
+            [self release];
+            self = anExistingObject;
+        }
+    }
+    
+    return self;
+}
+
+- (oneway void) release
+{
+    if(pointer != NULL){
+        pthread_mutex_lock(&baselineUniquingLock);
+        if([self retainCount] == 1)
+            NSMapRemove(baselineUniquingTable, pointer);
+        pthread_mutex_unlock(&baselineUniquingLock);
+    }
+    [super release];
+}
+
+@end
+
+// Keys with a single user ID, to fill GPGKeyring indexes without gpg; they
+// answer only what GPGKeyring asks keys, subkeys and user IDs.
+@interface BenchmarkSyntheticKey : NSObject
+{
+    NSString        *fingerprint;
+    NSString        *name;
+    NSString        *email;
+    GPGFingerprint  packedFingerprint;
+}
+
+- (id) initWithNumber:(unsigned)number name:(NSString *)aName email:(NSString *)anEmail;
+
+@end
+
+@implementation BenchmarkSyntheticKey
+
+- (id) initWithNumber:(unsigned)number name:(NSString *)aName email:(NSString *)anEmail
+{
+    if((self = [super init]) != nil){
+        fingerprint = [[NSString alloc] initWithFormat:@"%032X%08X", 0, number];
+        name = [aName copy];
+        email = [anEmail copy];
+        (void)GPGFingerprintFromString(fingerprint, &packedFingerprint);
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [fingerprint release];
+    [name release];
+    [email release];
+    
+    [super dealloc];
+}
+
+- (NSArray *) subkeys
+{
+    return [NSArray arrayWithObject:self];
+}
+
+- (NSArray *) userIDs
+{
+    return [NSArray arrayWithObject:self];
+}
+
+- (NSString *) fingerprint
+{
+    return fingerprint;
+}
+
+- (const GPGFingerprint *) packedFingerprint
+{
+    return &packedFingerprint;
+}
+
+- (NSString *) keyID
+{
+    return [fingerprint substringFromIndex:24];
+}
+
+- (NSString *) name
+{
+    return name;
+}
+
+- (NSString *) email
+{
+    return email;
+}
+
+- (NSString *) comment
+{
+    return nil;
+}
+
+- (GPGValidity) validity
+{
+    return GPGValidityFull;
+}
+
+- (BOOL) canEncrypt
+{
+    return YES;
+}
+
+- (BOOL) isKeyRevoked
+{
+    return NO;
+}
+
+- (BOOL) hasBeenRevoked
+{
+    return NO;
+}
+
+- (BOOL) hasKeyExpired
+{
+    return NO;
+}
+
+- (BOOL) isKeyDisabled
+{
+    return NO;
+}
+
+- (BOOL) isKeyInvalid
+{
+    return NO;
+}
+
+- (BOOL) isInvalid
+{
+    return NO;
+}
+
+@end
+
+static NSArray *syntheticKeys(unsigned count)
+{
+    // Same keys on each run; names and email domains repeat, numbers do not
+    static NSString *firstNames[] = {@"Alice", @"Bob", @"Carol", @"Dave", @"Eve", @"Frank", @"Grace", @"Heidi", @"Ivan", @"Judy", @"Mallory", @"Oscar", @"Peggy", @"Trent", @"Victor", @"Walter"};
+    static NSString *lastNames[] = {@"Smith", @"Jones", @"Martin", @"Bernard", @"Dubois", @"Rossi", @"Garcia", @"Kowalski", @"Nguyen", @"Schmidt"};
+    NSMutableArray  *someKeys = [NSMutableArray arrayWithCapacity:count];
+    unsigned        aSeed = 42;
+    unsigned        i;
+    
+    for(i = 0; i < count; i++){
+        NSString                *aFirstName = firstNames[rand_r(&aSeed) % 16];
+        NSString                *aLastName = lastNames[rand_r(&aSeed) % 10];
+        NSString                *aName = [NSString stringWithFormat:@"%@ %@", aFirstName, aLastName];
+        NSString                *anEmail = [[NSString stringWithFormat:@"%@.%@%u@example%u.org", aFirstName, aLastName, i, i % 97] lowercaseString];
+        BenchmarkSyntheticKey   *aKey = [[BenchmarkSyntheticKey alloc] initWithNumber:i name:aName email:anEmail];
+        
+        [someKeys addObject:aKey];
+        [aKey release];
+    }
+    
+    return someKeys;
+}
+
+static char                 uniquingPointers[UNIQUING_POINTER_COUNT];
+static BOOL                 usesBaselineUniquing;
+static volatile int32_t     runningUniquingThreadCount;
+
+
+@interface MacGPGMEBenchmarks : NSObject
+{
+    NSString    *temporaryDirectory;
+}
+
++ (NSArray *) benchmarkNames;
+- (void) runBenchmarkNamed:(NSString *)name;
+
+@end
+
+@implementation MacGPGMEBenchmarks
+
++ (NSArray *) benchmarkNames
+{
+    return [NSArray arrayWithObjects:@"Armor", @"PointerUniquing", @"KeyringSearch", @"ParallelKeyListing", @"KeyListing", nil];
+}
+
+- (id) init
+{
+    if((self = [super init]) != nil){
+        temporaryDirectory = [[NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"MacGPGMEBenchmarks-%d", getpid()]] retain];
+        [[NSFileManager defaultManager] createDirectoryAtPath:temporaryDirectory attributes:nil];
+    }
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [[NSFileManager defaultManager] removeFileAtPath:temporaryDirectory handler:nil];
+    [temporaryDirectory release];
+    
+    [super dealloc];
+}
+
+- (void) runBenchmarkNamed:(NSString *)name
+{
+    SEL aSelector = NSSelectorFromString([@"benchmark" stringByAppendingString:name]);
+    
+    if(![self respondsToSelector:aSelector]){
+        fprintf(stderr, "Unknown benchmark: %s\n", [name UTF8String]);
+        exit(1);
+    }
+    [self performSelector:aSelector];
+}
+
+- (NSString *) temporaryFileNamed:(NSString *)name
+{
+    return [temporaryDirectory stringByAppendingPathComponent:name];
+}
+
+- (double) secondsToRunGPGWithArguments:(NSArray *)arguments
+{
+    // Whole run, including process launch; raises if gpg fails
+    NSTask  *aTask = [[NSTask alloc] init];
+    double  startTime;
+    int     aStatus;
+    
+    [aTask setLaunchPath:[[GPGEngine engineForProtocol:GPGOpenPGPProtocol] executablePath]];
+    [aTask setArguments:[[NSArray arrayWithObjects:@"--batch", @"--no-tty", @"--yes", nil] arrayByAddingObjectsFromArray:arguments]];
+    [aTask setStandardOutput:[NSFileHandle fileHandleWithNullDevice]];
+    [aTask setStandardError:[NSFileHandle fileHandleWithNullDevice]];
+    startTime = currentTime();
+    [aTask launch];
+    [aTask waitUntilExit];
+    startTime = currentTime() - startTime;
+    aStatus = [aTask terminationStatus];
+    [aTask release];
+    if(aStatus != 0)
+        [NSException raise:NSGenericException format:@"gpg %@ failed (%d)", [arguments componentsJoinedByString:@" "], aStatus];
+    
+    return startTime;
+}
+
+- (double) bestSecondsToRunGPGWithArguments:(NSArray *)arguments
+{
+    double  bestTime = HUGE_VAL;
+    int     i;
+    
+    for(i = 0; i < BENCHMARK_RUN_COUNT; i++)
+        bestTime = MIN(bestTime, [self secondsToRunGPGWithArguments:arguments]);
+    
+    return bestTime;
+}
+
+- (void) benchmarkArmor
+{
+    // GPGData armoring and dearmoring, against gpg --enarmor and --dearmor
+    // on the same bytes. gpg timings include process launch, which is
+    // measured separately (gpg --version).
+    NSData      *inputData = pseudoRandomData(ARMOR_BYTE_COUNT, 42);
+    NSString    *inputFilename = [self temporaryFileNamed:@"armor.bin"];
+    NSString    *armorFilename = [self temporaryFileNamed:@"armor.asc"];
+    NSString    *outputFilename = [self temporaryFileNamed:@"armor.out"];
+    double      armorTime = HUGE_VAL, dearmorTime = HUGE_VAL;
+    double      megabytes = ARMOR_BYTE_COUNT / (1024.0 * 1024.0);
+    double      launchTime, gpgArmorTime, gpgDearmorTime;
+    int         i;
+    
+    for(i = 0; i < BENCHMARK_RUN_COUNT; i++){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+        GPGData             *data = [[[GPGData alloc] initWithData:inputData] autorelease];
+        GPGData             *armoredData;
+        GPGData             *dearmoredData;
+        double              startTime = currentTime();
+        
+        armoredData = [data armoredData];
+        armorTime = MIN(armorTime, currentTime() - startTime);
+        startTime = currentTime();
+        dearmoredData = [armoredData dearmoredData];
+        dearmorTime = MIN(dearmorTime, currentTime() - startTime);
+        if(![[dearmoredData data] isEqualToData:inputData])
+            [NSException raise:NSInternalInconsistencyException format:@"Dearmored data differ"];
+        [localAP release];
+    }
+    printResult(@"Armor", @"GPGData -armoredData", @"%.1f MB/s", megabytes / armorTime);
+    printResult(@"Armor", @"GPGData -dearmoredData", @"%.1f MB/s", megabytes / dearmorTime);
+    
+    [inputData writeToFile:inputFilename atomically:NO];
+    launchTime = [self bestSecondsToRunGPGWithArguments:[NSArray arrayWithObject:@"--version"]];
+    gpgArmorTime = [self bestSecondsToRunGPGWithArguments:[NSArray arrayWithObjects:@"--enarmor", @"--output", armorFilename, inputFilename, nil]];
+    gpgDearmorTime = [self bestSecondsToRunGPGWithArguments:[NSArray arrayWithObjects:@"--dearmor", @"--output", outputFilename, armorFilename, nil]];
+    printResult(@"Armor", @"gpg launch", @"%.3f s", launchTime);
+    printResult(@"Armor", @"gpg --enarmor", @"%.1f MB/s (%.1f MB/s without launch)", megabytes / gpgArmorTime, megabytes / MAX(gpgArmorTime - launchTime, 1e-6));
+    printResult(@"Armor", @"gpg --dearmor", @"%.1f MB/s (%.1f MB/s without launch)", megabytes / gpgDearmorTime, megabytes / MAX(gpgDearmorTime - launchTime, 1e-6));
+}
+
+- (void) wrapUniquedPointers:(id)seed
+{
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    unsigned            aSeed = [seed unsignedIntValue];
+    int                 i;
+    
+    for(i = 0; i < UNIQUING_ITERATION_COUNT; i++){
+        void    *aPtr = &uniquingPointers[rand_r(&aSeed) % UNIQUING_POINTER_COUNT];
+        id      anObject;
+        
+        if(usesBaselineUniquing)
+            anObject = [[BaselineUniquedObject alloc] initWithPointer:aPtr];
+        else
+            anObject = [[BenchmarkUniquedObject alloc] initWithInternalRepresentation:aPtr];
+        [anObject release];
+    }
+    __sync_sub_and_fetch(&runningUniquingThreadCount, 1);
+    [localAP release];
+}
+
+- (double) secondsToWrapUniquedPointersWithThreadCount:(int)threadCount baseline:(BOOL)baseline
+{
+    // Half of the pointers have a wrapper kept alive, so that lookups find
+    // existing wrappers; other wrappers are created and deallocated.
+    id      keptObjects[UNIQUING_POINTER_COUNT / 2];
+    double  startTime;
+    int     i;
+    
+    usesBaselineUniquing = baseline;
+    for(i = 0; i < UNIQUING_POINTER_COUNT / 2; i++)
+        keptObjects[i] = (baseline ? [[BaselineUniquedObject alloc] initWithPointer:&uniquingPointers[i]] : [[BenchmarkUniquedObject alloc] initWithInternalRepresentation:&uniquingPointers[i]]);
+    runningUniquingThreadCount = threadCount;
+    startTime = currentTime();
+    for(i = 0; i < threadCount; i++)
+        [NSThread detachNewThreadSelector:@selector(wrapUniquedPointers:) toTarget:self withObject:[NSNumber numberWithUnsignedInt:i + 1]];
+    while(runningUniquingThreadCount > 0)
+        usleep(100);
+    startTime = currentTime() - startTime;
+    for(i = 0; i < UNIQUING_POINTER_COUNT / 2; i++)
+        [keptObjects[i] release];
+    
+    return startTime;
+}
+
+- (void) benchmarkPointerUniquing
+{
+    // Sharded uniquing table with internal ref counts (GPGObject), against
+    // a single lock, with 1 to 8 threads wrapping and releasing pointers.
+    int threadCount;
+    
+    if(baselineUniquingTable == NULL)
+        baselineUniquingTable = NSCreateMapTable(NSNonOwnedPointerMapKeyCallBacks, NSNonRetainedObjectMapValueCallBacks, UNIQUING_POINTER_COUNT);
+    for(threadCount = 1; threadCount <= 8; threadCount *= 2){
+        double  shardedTime = HUGE_VAL, baselineTime = HUGE_VAL;
+        double  operationCount = (double)threadCount * UNIQUING_ITERATION_COUNT;
+        int     i;
+        
+        for(i = 0; i < BENCHMARK_RUN_COUNT; i++){
+            shardedTime = MIN(shardedTime, [self secondsToWrapUniquedPointersWithThreadCount:threadCount baseline:NO]);
+            baselineTime = MIN(baselineTime, [self secondsToWrapUniquedPointersWithThreadCount:threadCount baseline:YES]);
+        }
+        printResult(@"PointerUniquing", [NSString stringWithFormat:@"%d thread(s)", threadCount], @"sharded %.2f M wraps/s, single lock %.2f M wraps/s (x%.2f)", operationCount / shardedTime / 1e6, operationCount / baselineTime / 1e6, baselineTime / shardedTime);
+    }
+}
+
+- (void) benchmarkKeyringSearch
+{
+    // GPGKeyring -keysMatchingString: over synthetic keys, against a scan of
+    // all user IDs. Selective strings should take less than 1 ms; strings
+    // matching many keys are bound by the number of returned keys.
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    NSArray             *someKeys = syntheticKeys(SYNTHETIC_KEY_COUNT);
+    NSArray             *queries = [NSArray arrayWithObjects:@"4242@example", @"@example13.", @"grace.ros", @"smith", @"ob", @"z", nil];
+    double              startTime = currentTime();
+    GPGKeyring          *aKeyring = [[GPGKeyring alloc] _initWithKeys:someKeys secretKeys:NO];
+    unsigned            i;
+    
+    printResult(@"KeyringSearch", [NSString stringWithFormat:@"index %u keys", SYNTHETIC_KEY_COUNT], @"%.3f s", currentTime() - startTime);
+    for(i = 0; i < [queries count]; i++){
+        NSString    *aQuery = [queries objectAtIndex:i];
+        unsigned    aMatchCount = [[aKeyring keysMatchingString:aQuery] count];
+        unsigned    aScanCount = 0;
+        double      indexTime = HUGE_VAL, scanTime;
+        int         j, k;
+        
+        for(j = 0; j < BENCHMARK_RUN_COUNT; j++){
+            startTime = currentTime();
+            for(k = 0; k < KEYRING_QUERY_COUNT; k++){
+                NSAutoreleasePool   *queryAP = [[NSAutoreleasePool alloc] init];
+                
+                (void)[aKeyring keysMatchingString:aQuery];
+                [queryAP release];
+            }
+            indexTime = MIN(indexTime, (currentTime() - startTime) / KEYRING_QUERY_COUNT);
+        }
+        startTime = currentTime();
+        for(k = 0; k < SYNTHETIC_KEY_COUNT; k++){
+            BenchmarkSyntheticKey   *aKey = [someKeys objectAtIndex:k];
+            
+            if([[aKey name] rangeOfString:aQuery options:NSCaseInsensitiveSearch].location != NSNotFound || [[aKey email] rangeOfString:aQuery options:NSCaseInsensitiveSearch].location != NSNotFound)
+                aScanCount++;
+        }
+        scanTime = currentTime() - startTime;
+        if(aScanCount != aMatchCount)
+            [NSException raise:NSInternalInconsistencyException format:@"%u keys match \"%@\", %u found", aScanCount, aQuery, aMatchCount];
+        printResult(@"KeyringSearch", [NSString stringWithFormat:@"\"%@\" (%u keys)", aQuery, aMatchCount], @"%.3f ms, scan %.3f ms (x%.0f)", indexTime * 1000, scanTime * 1000, scanTime / MAX(indexTime, 1e-9));
+    }
+    [aKeyring release];
+    [localAP release];
+}
+
+- (double) bestSecondsToListKeysWithPatterns:(NSArray *)patterns contextCount:(unsigned)contextCount ordered:(BOOL)ordered shardSize:(unsigned)shardSize
+{
+    // contextCount 0 lists all patterns with a single key listing operation
+    GPGContext  *aContext = [[GPGContext alloc] init];
+    double      bestTime = HUGE_VAL;
+    int         i;
+    
+    for(i = 0; i < BENCHMARK_RUN_COUNT; i++){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+        double              startTime = currentTime();
+        NSEnumerator        *keyEnum;
+        unsigned            aKeyCount = 0;
+        
+        if(contextCount == 0)
+            keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO];
+        else
+            keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO contextCount:contextCount ordered:ordered shardSize:shardSize];
+        while([keyEnum nextObject] != nil)
+            aKeyCount++;
+        bestTime = MIN(bestTime, currentTime() - startTime);
+        [localAP release];
+        if(aKeyCount != [patterns count])
+            [NSException raise:NSInternalInconsistencyException format:@"%u keys listed for %u fingerprints", aKeyCount, [patterns count]];
+    }
+    [aContext release];
+    
+    return bestTime;
+}
+
+- (void) benchmarkParallelKeyListing
+{
+    // Listing of all keys of the default keyring by fingerprint, by a single
+    // key listing operation, against shards listed by several contexts.
+    // Speedup depends on the number of processors, and on the number of
+    // keys: each shard costs a gpg launch.
+    GPGContext  *aContext = [[GPGContext alloc] init];
+    NSArray     *patterns = [[[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects] valueForKey:@"fingerprint"];
+    unsigned    contextCounts[] = {1, 2, 4, 8};
+    unsigned    shardSizes[] = {16, 64, 256};
+    double      serialTime;
+    unsigned    i, j;
+    
+    [aContext release];
+    if([patterns count] == 0){
+        printResult(@"ParallelKeyListing", @"default keyring", @"no keys");
+        return;
+    }
+    serialTime = [self bestSecondsToListKeysWithPatterns:patterns contextCount:0 ordered:NO shardSize:0];
+    printResult(@"ParallelKeyListing", [NSString stringWithFormat:@"serial, %u keys", [patterns count]], @"%.3f s", serialTime);
+    for(i = 0; i < sizeof(shardSizes) / sizeof(shardSizes[0]); i++){
+        for(j = 0; j < sizeof(contextCounts) / sizeof(contextCounts[0]); j++){
+            double  orderedTime = [self bestSecondsToListKeysWithPatterns:patterns contextCount:contextCounts[j] ordered:YES shardSize:shardSizes[i]];
+            double  unorderedTime = [self bestSecondsToListKeysWithPatterns:patterns contextCount:contextCounts[j] ordered:NO shardSize:shardSizes[i]];
+            
+            printResult(@"ParallelKeyListing", [NSString stringWithFormat:@"%u context(s), shards of %u", contextCounts[j], shardSizes[i]], @"ordered %.3f s (x%.2f), unordered %.3f s (x%.2f)", orderedTime, serialTime / orderedTime, unorderedTime, serialTime / unorderedTime);
+        }
+    }
+}
+
+- (void) benchmarkKeyListing
+{
+    // Listing of all keys of the default keyring by GPGKeyEnumerator, against
+    // fast-list-mode colon listing, which does not compute validity, and 
+    // against GPGKeyTable, which stores all keys in a few buffers.
+    GPGContext          *aContext = [[GPGContext alloc] init];
+    double              normalTime = HUGE_VAL, fastTime = HUGE_VAL, tableTime = HUGE_VAL;
+    unsigned            aKeyCount = 0;
+    unsigned long long  aStorageSize = 0;
+    int                 i;
+    
+    for(i = 0; i < BENCHMARK_RUN_COUNT; i++){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+        double              startTime = currentTime();
+        NSEnumerator        *anEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+        
+        aKeyCount = 0;
+        while([anEnum nextObject] != nil)
+            aKeyCount++;
+        normalTime = MIN(normalTime, currentTime() - startTime);
+        startTime = currentTime();
+        anEnum = [aContext fastKeyMetadataEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+        while([anEnum nextObject] != nil)
+            ;
+        fastTime = MIN(fastTime, currentTime() - startTime);
+        startTime = currentTime();
+        aStorageSize = [[GPGKeyTable keyTableWithContext:aContext searchPatterns:nil secretKeysOnly:NO] storageSize];
+        tableTime = MIN(tableTime, currentTime() - startTime);
+        [localAP release];
+    }
+    printResult(@"KeyListing", [NSString stringWithFormat:@"GPGKeyEnumerator, %u keys", aKeyCount], @"%.3f s (%.0f keys/s)", normalTime, aKeyCount / MAX(normalTime, 1e-9));
+    printResult(@"KeyListing", @"fast-list-mode", @"%.3f s (%.0f keys/s, x%.2f)", fastTime, aKeyCount / MAX(fastTime, 1e-9), normalTime / MAX(fastTime, 1e-9));
+    printResult(@"KeyListing", @"GPGKeyTable", @"%.3f s (%.0f keys/s, x%.2f), %llu bytes", tableTime, aKeyCount / MAX(tableTime, 1e-9), normalTime / MAX(tableTime, 1e-9), aStorageSize);
+    [aContext release];
+}
+
+@end
+
+
+int main(int argc, const char *argv[])
+{
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    MacGPGMEBenchmarks  *benchmarks = [[MacGPGMEBenchmarks alloc] init];
+    NSEnumerator        *nameEnum;
+    NSString            *aName;
+    
+    if(argc > 1){
+        NSMutableArray  *names = [NSMutableArray array];
+        int             i;
+        
+        for(i = 1; i < argc; i++)
+            [names addObject:[NSString stringWithUTF8String:argv[i]]];
+        nameEnum = [names objectEnumerator];
+    }
+    else
+        nameEnum = [[MacGPGMEBenchmarks benchmarkNames] objectEnumerator];
+    
+    while((aName = [nameEnum nextObject]) != nil){
+        NSAutoreleasePool   *benchmarkAP = [[NSAutoreleasePool alloc] init];
+        
+        [benchmarks runBenchmarkNamed:aName];
+        [benchmarkAP release];
+    }
+    [benchmarks release];
+    [localAP release];
+    
+    return 0;
+}
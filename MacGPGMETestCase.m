@@ -28,6 +28,246 @@
 #import "MacGPGMETestCase.h"
 
 #import <MacGPGME/MacGPGME.h>
+#import <MacGPGME/GPGInternals.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <libkern/OSAtomic.h>
+#import <pthread.h>
+#import <sys/stat.h>
+
+
+#define UNIQUING_THREAD_COUNT       8
+#define UNIQUING_ITERATION_COUNT    200000
+#define UNIQUING_POINTER_COUNT      64
+#define SHARED_RELEASE_ROUND_COUNT  500
+
+static volatile int32_t         createdUniquedObjectCount;
+static volatile int32_t         deallocatedUniquedObjectCount;
+
+// Wraps fake pointers, to test uniquing without gpgme structures. Counts
+// wrappers which have been registered, and deallocated.
+@interface MacGPGMEUniquedObject : GPGObject
+@end
+
+@implementation MacGPGMEUniquedObject
+
++ (BOOL) needsPointerUniquing
+{
+    return YES;
+}
+
+- (id) initWithInternalRepresentation:(void *)aPtr
+{
+    id  anObject = [super initWithInternalRepresentation:aPtr];
+    
+    // Else receiver has been deallocated, and an existing wrapper returned
+    if(anObject == self)
+        OSAtomicIncrement32(&createdUniquedObjectCount);
+    
+    return anObject;
+}
+
+- (void) dealloc
+{
+    // Receivers discarded by -initWithInternalRepresentation: have no pointer
+    if(_internalRepresentation != NULL)
+        OSAtomicIncrement32(&deallocatedUniquedObjectCount);
+    
+    [super dealloc];
+}
+
+@end
+
+// Keys with a single user ID, to test GPGKeyring indexes without gpg; they
+// answer only what GPGKeyring asks keys, subkeys and user IDs.
+@interface MacGPGMESyntheticKey : NSObject
+{
+    NSString        *_fingerprint;
+    NSString        *_name;
+    NSString        *_email;
+    BOOL            _isRevoked;
+    GPGFingerprint  _packedFingerprint;
+}
+
++ (id) keyWithNumber:(unsigned)number name:(NSString *)name email:(NSString *)email revoked:(BOOL)isRevoked;
+
+@end
+
+@implementation MacGPGMESyntheticKey
+
++ (id) keyWithNumber:(unsigned)number name:(NSString *)name email:(NSString *)email revoked:(BOOL)isRevoked
+{
+    MacGPGMESyntheticKey    *aKey = [[self alloc] init];
+    
+    aKey->_fingerprint = [[NSString alloc] initWithFormat:@"%032X%08X", 0, number];
+    aKey->_name = [name copy];
+    aKey->_email = [email copy];
+    aKey->_isRevoked = isRevoked;
+    (void)GPGFingerprintFromString(aKey->_fingerprint, &aKey->_packedFingerprint);
+    
+    return [aKey autorelease];
+}
+
+- (void) dealloc
+{
+    [_fingerprint release];
+    [_name release];
+    [_email release];
+    
+    [super dealloc];
+}
+
+- (NSArray *) subkeys
+{
+    return [NSArray arrayWithObject:self];
+}
+
+- (NSArray *) userIDs
+{
+    return [NSArray arrayWithObject:self];
+}
+
+- (NSString *) fingerprint
+{
+    return _fingerprint;
+}
+
+- (const GPGFingerprint *) packedFingerprint
+{
+    return &_packedFingerprint;
+}
+
+- (NSString *) keyID
+{
+    return [_fingerprint substringFromIndex:24];
+}
+
+- (NSString *) name
+{
+    return _name;
+}
+
+- (NSString *) email
+{
+    return _email;
+}
+
+- (NSString *) comment
+{
+    return nil;
+}
+
+- (GPGValidity) validity
+{
+    return GPGValidityFull;
+}
+
+- (BOOL) canEncrypt
+{
+    return YES;
+}
+
+- (BOOL) isKeyRevoked
+{
+    return _isRevoked;
+}
+
+- (BOOL) hasBeenRevoked
+{
+    return _isRevoked;
+}
+
+- (BOOL) hasKeyExpired
+{
+    return NO;
+}
+
+- (BOOL) isKeyDisabled
+{
+    return NO;
+}
+
+- (BOOL) isKeyInvalid
+{
+    return NO;
+}
+
+- (BOOL) isInvalid
+{
+    return NO;
+}
+
+@end
+
+#define FAILING_SHARD_PATTERN      @"MacGPGMEFailingShard"
+
+// Fails listing of key shards containing FAILING_SHARD_PATTERN; copies made
+// by parallel key listing are of the same class.
+@interface MacGPGMEFailingContext : GPGContext
+@end
+
+@implementation MacGPGMEFailingContext
+
+- (GPGKeyEnumerator *) keyEnumeratorForSearchPatterns:(NSArray *)searchPatterns secretKeysOnly:(BOOL)secretKeysOnly
+{
+    if([searchPatterns containsObject:FAILING_SHARD_PATTERN])
+        [[NSException exceptionWithGPGError:GPGMakeError(GPG_MacGPGMEFrameworkErrorSource, GPGErrorGeneralError) userInfo:nil] raise];
+    
+    return [super keyEnumeratorForSearchPatterns:searchPatterns secretKeysOnly:secretKeysOnly];
+}
+
+@end
+
+// Answers passphrases in turn, NSNull standing for cancellation; cancels once
+// all have been answered. Counts passphrase requests.
+@interface MacGPGMEPassphraseDelegate : NSObject
+{
+    NSArray     *_passphrases;
+    unsigned    _requestCount;
+}
+
+- (id) initWithPassphrases:(NSArray *)passphrases;
+- (unsigned) requestCount;
+
+@end
+
+@implementation MacGPGMEPassphraseDelegate
+
+- (id) initWithPassphrases:(NSArray *)passphrases
+{
+    if(self = [self init])
+        _passphrases = [passphrases retain];
+    
+    return self;
+}
+
+- (void) dealloc
+{
+    [_passphrases release];
+    
+    [super dealloc];
+}
+
+- (unsigned) requestCount
+{
+    return _requestCount;
+}
+
+- (NSString *) context:(GPGContext *)context passphraseForKey:(GPGKey *)key again:(BOOL)again
+{
+    id  aPassphrase = (_requestCount < [_passphrases count] ? [_passphrases objectAtIndex:_requestCount] : nil);
+    
+    _requestCount++;
+    
+    return (aPassphrase == [NSNull null] ? nil : aPassphrase);
+}
+
+@end
+
+static char                     uniquingPointers[UNIQUING_POINTER_COUNT];
+static MacGPGMEUniquedObject    *keptUniquedObjects[UNIQUING_POINTER_COUNT / 2];
+static MacGPGMEUniquedObject    *sharedUniquedObjects[UNIQUING_POINTER_COUNT];
+static volatile int32_t         uniquingFailureCount;
+static volatile int32_t         runningUniquingThreadCount;
 
 
 @implementation MacGPGMETestCase
@@ -42,6 +282,1219 @@
     STAssertEqualObjects(testString, outputString, @"Not the same string!");
 }
 
+- (void) testDataCopy
+{
+    NSData      *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    GPGData     *data = [[GPGData alloc] init];
+    GPGData     *dataCopy;
+    gpgme_data_t originalData;
+    
+    [data autorelease];
+    [data writeData:inputData];
+    originalData = [data gpgmeData];
+    dataCopy = [[data copy] autorelease];
+    STAssertEquals([data gpgmeData], originalData, @"Copying replaced gpgme data of original!");
+    STAssertEquals([data seekToFileOffset:0 offsetType:GPGDataCurrentPosition], (off_t)[inputData length], @"Copying moved original!");
+    [data writeData:inputData]; // Original is still written to at its position
+    STAssertEquals([[dataCopy data] length], [inputData length], @"Original write modified copy!");
+    [dataCopy writeData:inputData];
+    STAssertEquals([[data data] length], 2 * [inputData length], @"Original not written!");
+    STAssertEquals([[dataCopy data] length], 2 * [inputData length], @"Copy not written!");
+    STAssertEqualObjects([[[dataCopy copy] autorelease] data], [dataCopy data], @"Copy of copy differs!");
+}
+
+- (void) testSegmentedData
+{
+    NSData      *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString    *filename = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MacGPGMETestSegment"];
+    NSArray     *segments;
+    GPGData     *data;
+    
+    [inputData writeToFile:filename atomically:NO];
+    segments = [NSArray arrayWithObjects:[inputData subdataWithRange:NSMakeRange(0, 4)], [NSDictionary dictionaryWithObjectsAndKeys:filename, GPGDataSegmentPathKey, [NSNumber numberWithInt:4], GPGDataSegmentOffsetKey, [NSNumber numberWithInt:2], GPGDataSegmentLengthKey, nil], [inputData subdataWithRange:NSMakeRange(6, 4)], nil];
+    data = [[GPGData alloc] initWithSegments:segments];
+    [data autorelease];
+    STAssertEqualObjects(inputData, [data data], @"Not the same data!");
+    STAssertEqualObjects(inputData, [[[data copy] autorelease] data], @"Not the same data!");
+    [[NSFileManager defaultManager] removeFileAtPath:filename handler:nil];
+}
+
+- (void) testInputStreamData
+{
+    NSData      *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    GPGData     *data = [[GPGData alloc] initWithInputStream:[NSInputStream inputStreamWithData:inputData]];
+    NSData      *outputData = [data availableData];
+    
+    [data autorelease];
+    STAssertEqualObjects(inputData, outputData, @"Not the same data!");
+}
+
+- (void) testOutputStreamData
+{
+    NSData          *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    NSOutputStream  *outputStream = [NSOutputStream outputStreamToMemory];
+    GPGData         *data = [[GPGData alloc] initWithOutputStream:outputStream];
+    
+    [data autorelease];
+    STAssertEquals([data writeData:inputData], (ssize_t)[inputData length], @"Not all bytes written!");
+    STAssertEqualObjects(inputData, [outputStream propertyForKey:NSStreamDataWrittenToMemoryStreamKey], @"Not the same data!");
+    [outputStream close];
+}
+
+- (void) testSecureMemoryData
+{
+    NSMutableData   *inputData = [NSMutableData dataWithLength:10000];
+    GPGData         *data = [[GPGData alloc] initWithSecureMemory];
+    
+    [data autorelease];
+    memset([inputData mutableBytes], 'x', [inputData length]);
+    STAssertEquals([data writeData:inputData], (ssize_t)[inputData length], @"Not all bytes written!");
+    STAssertEqualObjects(inputData, [data data], @"Not the same data!");
+}
+
+- (void) testDigestData
+{
+    NSData          *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    GPGDigestData   *data = [[GPGDigestData alloc] initWithUnderlyingData:[[[GPGData alloc] initWithData:inputData] autorelease]];
+    unsigned char   digest[CC_SHA256_DIGEST_LENGTH];
+    
+    [data autorelease];
+    STAssertEqualObjects(inputData, [data data], @"Not the same data!");
+    STAssertEqualObjects(inputData, [data data], @"Not the same data!"); // Rewinds; bytes are not hashed twice
+    CC_SHA256([inputData bytes], [inputData length], digest);
+    STAssertEqualObjects([NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH], [data digestForHashAlgorithm:GPG_SHA256HashAlgorithm], @"Not the same digest!");
+}
+
+- (void) testArmor
+{
+    // Same output as gpg --enarmor, without Comment header
+    NSData      *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    NSString    *expectedArmor = @"-----BEGIN PGP ARMORED FILE-----\n\ndGVzdFN0cmluZw==\n=ANqQ\n-----END PGP ARMORED FILE-----\n";
+    GPGData     *data = [[GPGData alloc] initWithData:inputData];
+    GPGData     *armoredData;
+    
+    [data autorelease];
+    armoredData = [data armoredData];
+    STAssertEqualObjects(expectedArmor, [armoredData string], @"Not the same armor!");
+    STAssertEqualObjects(inputData, [[armoredData dearmoredData] data], @"Not the same data!");
+    
+    // Padding is optional; checksum line must not stop decoding of last quantum
+    armoredData = [[[GPGData alloc] initWithString:@"-----BEGIN PGP ARMORED FILE-----\n\ndGVzdFN0cmluZw\n=ANqQ\n-----END PGP ARMORED FILE-----\n"] autorelease];
+    STAssertEqualObjects(inputData, [[armoredData dearmoredData] data], @"Unpadded body followed by checksum not decoded!");
+    armoredData = [[[GPGData alloc] initWithString:@"-----BEGIN PGP ARMORED FILE-----\n\ndGVzdFN0cmluZw\n-----END PGP ARMORED FILE-----\n"] autorelease];
+    STAssertEqualObjects(inputData, [[armoredData dearmoredData] data], @"Unpadded body without checksum not decoded!");
+    armoredData = [[[GPGData alloc] initWithString:@"-----BEGIN PGP ARMORED FILE-----\n\ndGVzdFN0cmluZw\n=ANqQ\ndGVz\n-----END PGP ARMORED FILE-----\n"] autorelease];
+    STAssertThrows([armoredData dearmoredData], @"Data after checksum accepted!");
+}
+
+- (void) createUniquedObjects:(id)dummy
+{
+    // First half of pointers have a wrapper kept alive by the main thread;
+    // second half are created and deallocated concurrently.
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    unsigned            seed = (unsigned)pthread_mach_thread_np(pthread_self());
+    int                 i;
+    
+    for(i = 0; i < UNIQUING_ITERATION_COUNT; i++){
+        int                     anIndex = rand_r(&seed) % UNIQUING_POINTER_COUNT;
+        MacGPGMEUniquedObject   *anObject = [[MacGPGMEUniquedObject alloc] initWithInternalRepresentation:&uniquingPointers[anIndex]];
+        
+        if(anIndex < UNIQUING_POINTER_COUNT / 2 && anObject != keptUniquedObjects[anIndex])
+            OSAtomicIncrement32(&uniquingFailureCount);
+        [anObject release];
+    }
+    OSAtomicDecrement32(&runningUniquingThreadCount);
+    [localAP release];
+}
+
+- (void) testPointerUniquingStress
+{
+    int     i;
+    
+    for(i = 0; i < UNIQUING_POINTER_COUNT / 2; i++)
+        keptUniquedObjects[i] = [[MacGPGMEUniquedObject alloc] initWithInternalRepresentation:&uniquingPointers[i]];
+    uniquingFailureCount = 0;
+    runningUniquingThreadCount = UNIQUING_THREAD_COUNT;
+    for(i = 0; i < UNIQUING_THREAD_COUNT; i++)
+        [NSThread detachNewThreadSelector:@selector(createUniquedObjects:) toTarget:self withObject:nil];
+    while(runningUniquingThreadCount > 0)
+        usleep(1000);
+    for(i = 0; i < UNIQUING_POINTER_COUNT / 2; i++){
+        STAssertEquals([keptUniquedObjects[i] retainCount], (NSUInteger)1, @"Unbalanced retain count!");
+        [keptUniquedObjects[i] release];
+    }
+    STAssertEquals(uniquingFailureCount, (int32_t)0, @"Pointer not uniqued!");
+    STAssertEquals(createdUniquedObjectCount, deallocatedUniquedObjectCount, @"Uniqued objects leaked or over-released!");
+}
+
+- (void) releaseSharedUniquedObjects:(id)threadIndex
+{
+    // Each thread owns one reference to each shared wrapper. It wraps the
+    // pointer again, which must return the shared wrapper, then releases
+    // both references, racing with other threads releasing theirs.
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    int                 anOffset = [threadIndex intValue];
+    int                 i;
+    
+    for(i = 0; i < UNIQUING_POINTER_COUNT; i++){
+        int                     anIndex = (i + anOffset) % UNIQUING_POINTER_COUNT;
+        MacGPGMEUniquedObject   *sharedObject = sharedUniquedObjects[anIndex];
+        MacGPGMEUniquedObject   *anObject = [[MacGPGMEUniquedObject alloc] initWithInternalRepresentation:&uniquingPointers[anIndex]];
+        
+        if(anObject != sharedObject)
+            OSAtomicIncrement32(&uniquingFailureCount);
+        [anObject release];
+        [sharedObject release];
+    }
+    OSAtomicDecrement32(&runningUniquingThreadCount);
+    [localAP release];
+}
+
+- (void) testPointerUniquingSharedRelease
+{
+    // Last releases of shared wrappers happen concurrently with lookups
+    // and with other releases; every wrapper must be deallocated once,
+    // and never be returned after its last release.
+    int round, i, j;
+    
+    uniquingFailureCount = 0;
+    for(round = 0; round < SHARED_RELEASE_ROUND_COUNT; round++){
+        int32_t createdCount = createdUniquedObjectCount;
+        
+        for(i = 0; i < UNIQUING_POINTER_COUNT; i++){
+            sharedUniquedObjects[i] = [[MacGPGMEUniquedObject alloc] initWithInternalRepresentation:&uniquingPointers[i]];
+            for(j = 1; j < UNIQUING_THREAD_COUNT; j++)
+                [sharedUniquedObjects[i] retain];
+        }
+        STAssertEquals(createdUniquedObjectCount - createdCount, (int32_t)UNIQUING_POINTER_COUNT, @"Released wrapper still registered!");
+        runningUniquingThreadCount = UNIQUING_THREAD_COUNT;
+        for(i = 0; i < UNIQUING_THREAD_COUNT; i++)
+            [NSThread detachNewThreadSelector:@selector(releaseSharedUniquedObjects:) toTarget:self withObject:[NSNumber numberWithInt:i]];
+        while(runningUniquingThreadCount > 0)
+            usleep(100);
+        STAssertEquals(createdUniquedObjectCount, deallocatedUniquedObjectCount, @"Uniqued objects leaked or over-released!");
+    }
+    STAssertEquals(uniquingFailureCount, (int32_t)0, @"Pointer not uniqued!");
+}
+
+- (void) testKeyMetadataCache
+{
+    NSString            *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MacGPGMETestKeyMetadata.cache"];
+    GPGKeyMetadataCache *cache;
+    NSEnumerator        *fingerprintEnum;
+    NSString            *fingerprint;
+
+    // Corrupted file must be rebuilt
+    [[NSMutableData dataWithLength:512] writeToFile:path atomically:YES];
+    cache = [[GPGKeyMetadataCache alloc] initWithPath:path secretKeys:NO];
+    STAssertFalse([cache isStale], @"Cache not rebuilt!");
+    STAssertEquals([[cache fingerprints] count], (NSUInteger)[cache count], @"Invalid fingerprint count!");
+    fingerprintEnum = [[cache fingerprints] objectEnumerator];
+    while((fingerprint = [fingerprintEnum nextObject]) != nil){
+        NSDictionary    *metadata = [cache metadataForKeyWithFingerprint:[fingerprint lowercaseString]];
+
+        STAssertEqualObjects([metadata objectForKey:@"fpr"], fingerprint, @"Fingerprint lookup failed!");
+        STAssertTrue([[cache metadataForKeysWithKeyID:[metadata objectForKey:@"shortkeyid"]] containsObject:metadata], @"Key ID lookup failed!");
+    }
+    [cache release];
+    [[NSFileManager defaultManager] removeFileAtPath:path handler:nil];
+}
+
+- (void) testKeyEnumeratorBatches
+{
+    GPGContext          *aContext = [[GPGContext alloc] init];
+    NSArray             *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSMutableArray      *batchedKeys = [NSMutableArray array];
+    GPGKeyEnumerator    *anEnum;
+    NSArray             *someKeys;
+
+    anEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    while([(someKeys = [anEnum nextObjects:7]) count] > 0){
+        STAssertTrue([someKeys count] <= 7, @"Too many keys in batch!");
+        [batchedKeys addObjectsFromArray:someKeys];
+    }
+    STAssertEqualObjects(batchedKeys, allKeys, @"Batched keys differ from listed keys!");
+    [aContext stopKeyEnumeration];
+    [aContext release];
+}
+
+#if defined(MAC_OS_X_VERSION_10_5) && (MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_5)
+- (void) testKeyEnumeratorFastEnumeration
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSArray         *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSMutableArray  *enumeratedKeys = [NSMutableArray array];
+    GPGKey          *aKey;
+
+    for(aKey in [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO])
+        [enumeratedKeys addObject:aKey];
+    STAssertEqualObjects(enumeratedKeys, allKeys, @"Enumerated keys differ from listed keys!");
+    [aContext stopKeyEnumeration];
+    [aContext release];
+}
+
+- (void) testKeyEnumeratorEarlyStop
+{
+    // Leaving enumeration while keys are still prefetched must stop the
+    // prefetching thread, and leave context usable
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSArray         *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    GPGKey          *aKey;
+    GPGKey          *firstKey = nil;
+    int             i;
+
+    for(i = 0; i < 3; i++){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+
+        for(aKey in [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO]){
+            firstKey = aKey;
+            break;
+        }
+        if([allKeys count] > 0)
+            STAssertEqualObjects(firstKey, [allKeys objectAtIndex:0], @"Wrong first key!");
+        STAssertNoThrow([aContext stopKeyEnumeration], @"Unable to stop enumeration!");
+        STAssertEqualObjects([[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects], allKeys, @"Context unusable after early stop!");
+        [localAP release];
+    }
+    
+    // Enumerator is released without stopping enumeration explicitly
+    if([allKeys count] > 0){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+        
+        STAssertEquals([[[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] nextObjects:1] count], (NSUInteger)1, @"No key taken!");
+        [localAP release];
+        STAssertEqualObjects([[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects], allKeys, @"Context unusable after enumerator release!");
+    }
+    [aContext release];
+}
+#endif
+
+- (void) testKeyEnumeratorFilter
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSMutableArray  *expectedKeys = [NSMutableArray array];
+    NSEnumerator    *keyEnum = [[[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects] objectEnumerator];
+    GPGKey          *aKey;
+
+    while((aKey = [keyEnum nextObject]) != nil)
+        if([aKey canEncrypt] && ![aKey isKeyRevoked] && ![aKey isKeyDisabled])
+            [expectedKeys addObject:aKey];
+    keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO filterMask:GPGKeyFilterCanEncryptMask | GPGKeyFilterExcludeRevokedMask | GPGKeyFilterExcludeDisabledMask minimumValidity:GPGValidityUnknown];
+    STAssertEqualObjects([keyEnum allObjects], expectedKeys, @"Filtered keys differ from expected keys!");
+    [aContext release];
+}
+
+- (void) testKeyEnumeratorValidityFilter
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSArray         *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSMutableArray  *validKeys = [NSMutableArray array];
+    NSMutableArray  *marginalKeys = [NSMutableArray array];
+    NSEnumerator    *keyEnum = [allKeys objectEnumerator];
+    GPGKey          *aKey;
+
+    // Unknown and undefined validities rank below never
+    while((aKey = [keyEnum nextObject]) != nil){
+        switch([aKey validity]){
+            case GPGValidityMarginal:
+            case GPGValidityFull:
+            case GPGValidityUltimate:
+                [marginalKeys addObject:aKey];
+                // Fall through
+            case GPGValidityNever:
+                [validKeys addObject:aKey];
+                break;
+            default:
+                break;
+        }
+    }
+    STAssertEqualObjects([[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO filterMask:0 minimumValidity:GPGValidityUnknown] allObjects], allKeys, @"Unknown minimum validity filtered keys!");
+    STAssertEqualObjects([[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO filterMask:0 minimumValidity:GPGValidityNever] allObjects], validKeys, @"Keys of unknown validity not filtered!");
+    STAssertEqualObjects([[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO filterMask:0 minimumValidity:GPGValidityMarginal] allObjects], marginalKeys, @"Keys never valid not filtered!");
+    [aContext release];
+}
+
+- (void) testFastKeyListing
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    GPGContext      *failingContext = [[GPGContext alloc] init];
+    NSMutableSet    *fingerprints = [NSMutableSet set];
+    NSMutableSet    *fastFingerprints = [NSMutableSet set];
+    NSEnumerator    *anEnum;
+    id              anObject;
+    NSArray         *someKeys;
+
+    anEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    while((anObject = [anEnum nextObject]) != nil)
+        [fingerprints addObject:[anObject fingerprint]];
+    anEnum = [aContext fastKeyMetadataEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    while((anObject = [anEnum nextObject]) != nil){
+        STAssertEquals([[anObject objectForKey:@"validity"] intValue], (int)GPGValidityUnknown, @"Validity computed!");
+        [fastFingerprints addObject:[anObject objectForKey:@"fpr"]];
+    }
+    STAssertEqualObjects(fastFingerprints, fingerprints, @"Not the same keys!");
+
+    // Patterns matching no key are not errors
+    STAssertNoThrow(someKeys = [[aContext fastKeyMetadataEnumeratorForSearchPatterns:[NSArray arrayWithObject:@"0x0000000000000000000000000000000000000000"] secretKeysOnly:NO] allObjects], @"Unknown key raised an exception!");
+    STAssertEquals([someKeys count], (NSUInteger)0, @"Unknown key listed!");
+    if([fingerprints count] > 0){
+        NSString    *aFingerprint = [fingerprints anyObject];
+
+        STAssertNoThrow(someKeys = [[aContext fastKeyMetadataEnumeratorForSearchPatterns:[NSArray arrayWithObjects:@"0x0000000000000000000000000000000000000000", aFingerprint, nil] secretKeysOnly:NO] allObjects], @"Unknown key raised an exception!");
+        STAssertEqualObjects([someKeys valueForKey:@"fpr"], [NSArray arrayWithObject:aFingerprint], @"Known key not listed!");
+    }
+
+    // Home directory cannot be created: gpg fails
+    [[failingContext engine] setCustomHomeDirectory:@"/dev/null/MacGPGME"];
+    STAssertThrows([[failingContext fastKeyMetadataEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects], @"Engine failure not reported!");
+    [failingContext release];
+    [aContext release];
+}
+
+- (void) testKeyTable
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    GPGContext      *failingContext = [[GPGContext alloc] init];
+    NSMutableArray  *fingerprints = [NSMutableArray array];
+    NSEnumerator    *keyEnum;
+    GPGKey          *aKey;
+    GPGKeyTable     *aTable;
+    unsigned        i;
+
+    keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    while((aKey = [keyEnum nextObject]) != nil)
+        [fingerprints addObject:[aKey fingerprint]];
+    aTable = [GPGKeyTable keyTableWithContext:aContext searchPatterns:nil secretKeysOnly:NO];
+    STAssertEquals([aTable count], (unsigned)[fingerprints count], @"Not the same key count!");
+    for(i = 0; i < [aTable count]; i++){
+        STAssertEqualObjects([aTable fingerprintOfKeyAtIndex:i], [fingerprints objectAtIndex:i], @"Not the same key!");
+        STAssertEquals([aTable indexOfKeyWithFingerprint:[fingerprints objectAtIndex:i]], i, @"Fingerprint lookup failed!");
+        STAssertEquals([aTable indexOfKeyWithFingerprint:[@"0x" stringByAppendingString:[[fingerprints objectAtIndex:i] lowercaseString]]], i, @"Lowercase fingerprint lookup failed!");
+    }
+    STAssertEquals([aTable indexOfKeyWithFingerprint:@"0000000000000000000000000000000000000000"], (unsigned)NSNotFound, @"Unknown fingerprint found!");
+    STAssertEquals([aTable indexOfKeyWithFingerprint:@"not a fingerprint"], (unsigned)NSNotFound, @"Invalid fingerprint found!");
+
+    // Patterns matching no key are not errors
+    STAssertNoThrow(aTable = [GPGKeyTable keyTableWithContext:aContext searchPatterns:[NSArray arrayWithObject:@"0x0000000000000000000000000000000000000000"] secretKeysOnly:NO], @"Unknown key raised an exception!");
+    STAssertEquals([aTable count], (unsigned)0, @"Unknown key listed!");
+
+    // Home directory cannot be created: gpg fails
+    [[failingContext engine] setCustomHomeDirectory:@"/dev/null/MacGPGME"];
+    STAssertThrows([GPGKeyTable keyTableWithContext:failingContext searchPatterns:nil secretKeysOnly:NO], @"Engine failure not reported!");
+    [failingContext release];
+    [aContext release];
+}
+
+- (void) testPackedFingerprint
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    GPGKey          *aKey;
+    GPGFingerprint  aFingerprint;
+
+    STAssertFalse(GPGFingerprintFromString(@"0123456789ABCDEFG", &aFingerprint), @"Invalid fingerprint parsed!");
+    while((aKey = [keyEnum nextObject]) != nil){
+        STAssertTrue(GPGFingerprintFromString([@"0x" stringByAppendingString:[[aKey fingerprint] lowercaseString]], &aFingerprint), @"Unable to parse fingerprint!");
+        STAssertTrue(GPGFingerprintEqual(&aFingerprint, [aKey packedFingerprint]), @"Not the same fingerprint!");
+        STAssertEquals(GPGFingerprintHash(&aFingerprint), [aKey hash], @"Not the same hash!");
+        STAssertTrue(GPGFingerprintFromString([aKey formattedFingerprint], &aFingerprint) && GPGFingerprintEqual(&aFingerprint, [aKey packedFingerprint]), @"Unable to parse formatted fingerprint!");
+        STAssertEqualObjects(GPGStringFromFingerprint([aKey packedFingerprint]), [aKey fingerprint], @"Not the same string!");
+    }
+    [aContext release];
+}
+
+- (void) testKeyPairing
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSArray         *secretKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:YES] allObjects];
+    NSArray         *publicKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSEnumerator    *keyEnum;
+    GPGKey          *aKey;
+    GPGKey          *cachedKey;
+    GPGKey          *reloadedKey;
+    
+    [aContext release];
+    keyEnum = [secretKeys objectEnumerator];
+    while((aKey = [keyEnum nextObject]) != nil){
+        GPGKey  *publicKey = [aKey publicKey];
+        
+        STAssertNotNil(publicKey, @"No public key for secret key %@!", [aKey fingerprint]);
+        STAssertFalse([publicKey isSecret], @"Public key is secret!");
+        STAssertEqualObjects([publicKey fingerprint], [aKey fingerprint], @"Not the same fingerprint!");
+        STAssertTrue([[publicKey secretKey] isSecret], @"Secret key is not secret!");
+        STAssertEqualObjects([[publicKey secretKey] fingerprint], [aKey fingerprint], @"Not the same fingerprint!");
+        STAssertEquals([aKey secretKey], aKey, @"Secret key is not its own secret key!");
+    }
+    keyEnum = [publicKeys objectEnumerator];
+    while((aKey = [keyEnum nextObject]) != nil){
+        STAssertEquals([aKey publicKey], aKey, @"Public key is not its own public key!");
+        if([[secretKeys valueForKey:@"fingerprint"] containsObject:[aKey fingerprint]])
+            STAssertNotNil([aKey secretKey], @"No secret key for public key %@!", [aKey fingerprint]);
+        else
+            STAssertNil([aKey secretKey], @"Secret key for public key %@!", [aKey fingerprint]);
+    }
+    if([secretKeys count] == 0)
+        return;
+    
+    // Lookups are answered from cache, until keyring changes
+    aKey = [secretKeys objectAtIndex:0];
+    cachedKey = [[aKey publicKey] retain];
+    STAssertEquals([aKey publicKey], cachedKey, @"Public key has been listed again!");
+    [[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:nil];
+    reloadedKey = [aKey publicKey];
+    STAssertTrue(reloadedKey != cachedKey, @"Cache has not been emptied on keyring change!");
+    STAssertEqualObjects(reloadedKey, cachedKey, @"Not the same public key after keyring change!");
+    STAssertEquals([aKey publicKey], reloadedKey, @"Public key has been listed again!");
+    [cachedKey release];
+}
+
+- (void) testKeyStrings
+{
+    // Strings must stay valid after their key has been released
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    GPGContext          *aContext = [[GPGContext alloc] init];
+    GPGKey              *aKey = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] nextObject];
+    NSString            *aUserID = [[aKey userID] retain];
+    NSString            *aFingerprint = [[aKey fingerprint] retain];
+    NSString            *userIDCopy = [[NSString alloc] initWithFormat:@"%@", aUserID];
+
+    STAssertNotNil(aUserID, @"No key with user ID!");
+    [aContext stopKeyEnumeration];
+    [aContext release];
+    [localAP release];
+    STAssertEqualObjects(aUserID, userIDCopy, @"Not the same user ID!");
+    STAssertTrue(strcmp([aUserID UTF8String], [userIDCopy UTF8String]) == 0, @"Not the same UTF-8 bytes!");
+    STAssertEquals([aFingerprint length], (NSUInteger)40, @"Wrong fingerprint length!");
+    [aUserID release];
+    [aFingerprint release];
+    [userIDCopy release];
+}
+
+- (void) testCachedKeyStrings
+{
+    // Strings are built once per user ID and per subkey
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    GPGKey          *aKey;
+
+    while((aKey = [keyEnum nextObject]) != nil){
+        NSEnumerator    *anEnum = [[aKey userIDs] objectEnumerator];
+        GPGUserID       *aUserID;
+        GPGSubkey       *aSubkey;
+
+        while((aUserID = [anEnum nextObject]) != nil){
+            STAssertEquals([aUserID userID], [aUserID userID], @"User ID string has been rebuilt!");
+            STAssertEquals([aUserID name], [aUserID name], @"Name string has been rebuilt!");
+            STAssertEquals([aUserID email], [aUserID email], @"Email string has been rebuilt!");
+            STAssertEquals([aUserID comment], [aUserID comment], @"Comment string has been rebuilt!");
+        }
+        anEnum = [[aKey subkeys] objectEnumerator];
+        while((aSubkey = [anEnum nextObject]) != nil){
+            STAssertEquals([aSubkey keyID], [aSubkey keyID], @"Key ID string has been rebuilt!");
+            STAssertEquals([aSubkey fingerprint], [aSubkey fingerprint], @"Fingerprint string has been rebuilt!");
+        }
+        STAssertEquals([aKey userID], [[aKey primaryUserID] userID], @"Key does not share its primary user ID string!");
+        STAssertEquals([aKey fingerprint], [[[aKey subkeys] objectAtIndex:0] fingerprint], @"Key does not share its subkey fingerprint string!");
+    }
+    [aContext release];
+}
+
+- (void) testKeyTableProxies
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    GPGKeyTable     *aTable = [GPGKeyTable keyTableWithContext:aContext searchPatterns:nil secretKeysOnly:NO];
+    NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO];
+    GPGKey          *aKey;
+    unsigned        i = 0, j;
+
+    while((aKey = [keyEnum nextObject]) != nil){
+        GPGKey  *aProxy = [aTable keyAtIndex:i++];
+
+        STAssertEqualObjects(aProxy, aKey, @"Proxy is not equal to key!");
+        STAssertEqualObjects([aProxy keyID], [aKey keyID], @"Not the same keyID!");
+        STAssertEqualObjects([aProxy userID], [aKey userID], @"Not the same userID!");
+        STAssertEqualObjects([aProxy name], [aKey name], @"Not the same name!");
+        STAssertEqualObjects([aProxy email], [aKey email], @"Not the same email!");
+        STAssertEqualObjects([aProxy comment], [aKey comment], @"Not the same comment!");
+        STAssertEqualObjects([[aProxy primaryUserID] userID], [[aKey primaryUserID] userID], @"Not the same primary user ID!");
+        STAssertEquals([[aProxy userIDs] count], [[aKey userIDs] count], @"Not the same user ID count!");
+        for(j = 0; j < [[aProxy userIDs] count] && j < [[aKey userIDs] count]; j++){
+            GPGUserID   *aProxyUserID = [[aProxy userIDs] objectAtIndex:j];
+            GPGUserID   *aUserID = [[aKey userIDs] objectAtIndex:j];
+
+            STAssertEqualObjects([aProxyUserID userID], [aUserID userID], @"Not the same user ID!");
+            STAssertEqualObjects([aProxyUserID name], [aUserID name], @"Not the same user ID name!");
+            STAssertEqualObjects([aProxyUserID email], [aUserID email], @"Not the same user ID email!");
+            STAssertEqualObjects([aProxyUserID comment], [aUserID comment], @"Not the same user ID comment!");
+            STAssertEquals([aProxyUserID hasBeenRevoked], [aUserID hasBeenRevoked], @"Not the same user ID revocation status!");
+            STAssertEquals([aProxyUserID key], aProxy, @"User ID not owned by proxy!");
+        }
+        STAssertEqualObjects([aProxy creationDate], [aKey creationDate], @"Not the same creation date!");
+        STAssertEquals([aProxy canEncrypt], [aKey canEncrypt], @"Not the same capabilities!");
+        STAssertEquals([aProxy isKeyRevoked], [aKey isKeyRevoked], @"Not the same revocation status!");
+    }
+    STAssertEquals(i, [aTable count], @"Not the same key count!");
+    [aContext release];
+}
+
+- (void) testKeyringLookups
+{
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    GPGKeyring      *aKeyring = [[GPGKeyring alloc] initWithSecretKeys:NO];
+    NSArray         *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSEnumerator    *keyEnum = [allKeys objectEnumerator];
+    GPGKey          *aKey;
+
+    STAssertEqualObjects([NSSet setWithArray:[aKeyring keys]], [NSSet setWithArray:allKeys], @"Not the same keys!");
+    STAssertNil([aKeyring keyWithFingerprint:@"0000000000000000000000000000000000000000"], @"Unknown key found!");
+    STAssertEquals([[aKeyring keysWithKeyID:@"0x00000000"] count], (NSUInteger)0, @"Unknown key ID found!");
+    while((aKey = [keyEnum nextObject]) != nil){
+        NSString    *anEmail = [aKey email];
+        NSString    *aName = [aKey name];
+
+        STAssertEqualObjects([aKeyring keyWithFingerprint:[aKey fingerprint]], aKey, @"Fingerprint lookup failed!");
+        STAssertEqualObjects([aKeyring keyWithFingerprint:[@"0x" stringByAppendingString:[[aKey fingerprint] lowercaseString]]], aKey, @"Case-insensitive fingerprint lookup failed!");
+        STAssertTrue([[aKeyring keysWithKeyID:[aKey keyID]] containsObject:aKey], @"Key ID lookup failed!");
+        STAssertTrue([[aKeyring keysWithKeyID:[aKey shortKeyID]] containsObject:aKey], @"Short key ID lookup failed!");
+        if([anEmail length] > 0)
+            STAssertTrue([[aKeyring keysWithEmail:[anEmail uppercaseString]] containsObject:aKey], @"Email lookup failed!");
+        if([aName length] > 0)
+            STAssertTrue([[aKeyring keysWithNamePrefix:[[aName substringToIndex:1] lowercaseString]] containsObject:aKey], @"Name prefix lookup failed!");
+    }
+    [aKeyring release];
+    [aContext release];
+}
+
+- (void) testKeyringRefresh
+{
+    // Refreshing all keys several times must not lose nor duplicate keys,
+    // including when removed keys are compacted.
+    GPGKeyring      *aKeyring = [[GPGKeyring alloc] initWithSecretKeys:NO];
+    NSArray         *allKeys = [aKeyring keys];
+    NSMutableArray  *fingerprints = [NSMutableArray arrayWithArray:[allKeys valueForKey:@"fingerprint"]];
+    int             i;
+
+    if([allKeys count] == 0){
+        [aKeyring release];
+        return;
+    }
+    for(i = 0; i < 3; i++){
+        [aKeyring refreshKeysWithFingerprints:[fingerprints subarrayWithRange:NSMakeRange(0, ([fingerprints count] + 1) / 2)]];
+        STAssertEquals([[aKeyring keys] count], [allKeys count], @"Not the same key count after partial refresh!");
+        [aKeyring refreshKeysWithFingerprints:fingerprints];
+        STAssertEqualObjects([NSSet setWithArray:[aKeyring keys]], [NSSet setWithArray:allKeys], @"Not the same keys after refresh!");
+        STAssertEquals([[aKeyring keys] count], [allKeys count], @"Not the same key count after refresh!");
+    }
+    STAssertEqualObjects([aKeyring keyWithFingerprint:[fingerprints objectAtIndex:0]], [allKeys objectAtIndex:0], @"Fingerprint lookup failed after refresh!");
+    // Unknown fingerprints are ignored
+    [fingerprints addObject:@"0000000000000000000000000000000000000000"];
+    [aKeyring refreshKeysWithFingerprints:fingerprints];
+    STAssertEquals([[aKeyring keys] count], [allKeys count], @"Unknown key added!");
+    [aKeyring release];
+}
+
+- (void) testKeyringSearchRanking
+{
+    // Whole field, then field prefix, then word prefix, then elsewhere;
+    // usable keys first for a same rank
+    NSArray     *someKeys = [NSArray arrayWithObjects:
+                    [MacGPGMESyntheticKey keyWithNumber:1 name:@"Malice Jones" email:@"mj@example.org" revoked:NO],
+                    [MacGPGMESyntheticKey keyWithNumber:2 name:@"Bob Alice" email:@"bob@example.org" revoked:NO],
+                    [MacGPGMESyntheticKey keyWithNumber:3 name:@"Alice Smith" email:@"as@example.org" revoked:NO],
+                    [MacGPGMESyntheticKey keyWithNumber:4 name:@"Alice" email:@"old@example.org" revoked:YES],
+                    [MacGPGMESyntheticKey keyWithNumber:5 name:@"Alice" email:@"alice@example.org" revoked:NO],
+                    [MacGPGMESyntheticKey keyWithNumber:6 name:@"Bob" email:@"b@example.org" revoked:NO], nil];
+    GPGKeyring  *aKeyring = [[GPGKeyring alloc] _initWithKeys:someKeys secretKeys:NO];
+    NSArray     *expectedKeys = [NSArray arrayWithObjects:[someKeys objectAtIndex:4], [someKeys objectAtIndex:3], [someKeys objectAtIndex:2], [someKeys objectAtIndex:1], [someKeys objectAtIndex:0], nil];
+
+    STAssertEqualObjects([aKeyring keysMatchingString:@"alice"], expectedKeys, @"Wrong ranking!");
+    STAssertEqualObjects([aKeyring keysMatchingString:@"ALICE"], expectedKeys, @"Search is case-sensitive!");
+    STAssertEqualObjects([aKeyring keysMatchingString:@"ice smi"], [NSArray arrayWithObject:[someKeys objectAtIndex:2]], @"Substring spanning words not found!");
+    STAssertEquals([[aKeyring keysMatchingString:@"alice\nbob"] count], (NSUInteger)0, @"Match spans fields!");
+    STAssertEquals([[aKeyring keysMatchingString:@"carol"] count], (NSUInteger)0, @"Unknown string found!");
+    [aKeyring release];
+}
+
+- (void) testKeyringShortSearch
+{
+    // Strings shorter than a trigram are looked up in their own posting
+    // lists; results must be those of a full scan.
+    NSArray         *names = [NSArray arrayWithObjects:@"Alice", @"Bob", @"Carol", @"Dave", @"Eve", [NSString stringWithUTF8String:"Zo\xC3\xAB"], nil];
+    NSMutableArray  *someKeys = [NSMutableArray array];
+    NSArray         *queries = [NSArray arrayWithObjects:@"a", @"E", [NSString stringWithUTF8String:"\xC3\xAB"], @"al", @"ob", @"@e", @"zq", @"q", nil];
+    GPGKeyring      *aKeyring;
+    unsigned        i;
+
+    for(i = 0; i < 60; i++){
+        NSString    *aName = [NSString stringWithFormat:@"%@ %u", [names objectAtIndex:i % [names count]], i];
+        NSString    *anEmail = [NSString stringWithFormat:@"%@%u@example.org", [[names objectAtIndex:(i / 7) % [names count]] lowercaseString], i];
+
+        [someKeys addObject:[MacGPGMESyntheticKey keyWithNumber:i name:aName email:anEmail revoked:NO]];
+    }
+    aKeyring = [[GPGKeyring alloc] _initWithKeys:someKeys secretKeys:NO];
+    for(i = 0; i < [queries count]; i++){
+        NSString                *aQuery = [[queries objectAtIndex:i] lowercaseString];
+        NSMutableSet            *expectedKeys = [NSMutableSet set];
+        NSEnumerator            *keyEnum = [someKeys objectEnumerator];
+        MacGPGMESyntheticKey    *aKey;
+
+        while((aKey = [keyEnum nextObject]) != nil)
+            if([[[aKey name] lowercaseString] rangeOfString:aQuery].location != NSNotFound || [[[aKey email] lowercaseString] rangeOfString:aQuery].location != NSNotFound)
+                [expectedKeys addObject:aKey];
+        STAssertEqualObjects([NSSet setWithArray:[aKeyring keysMatchingString:[queries objectAtIndex:i]]], expectedKeys, @"Wrong keys for %@!", aQuery);
+    }
+    [aKeyring release];
+}
+
+- (void) testKeyringSearchRefresh
+{
+    // Index is updated incrementally, then rebuilt once most slots are free
+    MacGPGMESyntheticKey    *aKey = [MacGPGMESyntheticKey keyWithNumber:1 name:@"Alice" email:@"alice@example.org" revoked:NO];
+    MacGPGMESyntheticKey    *anotherKey = [MacGPGMESyntheticKey keyWithNumber:2 name:@"Bob" email:@"bob@example.org" revoked:NO];
+    GPGKeyring              *aKeyring = [[GPGKeyring alloc] _initWithKeys:[NSArray arrayWithObjects:aKey, anotherKey, nil] secretKeys:NO];
+    MacGPGMESyntheticKey    *aChangedKey = [MacGPGMESyntheticKey keyWithNumber:1 name:@"Alice Zed" email:@"zed@example.org" revoked:NO];
+    unsigned                i;
+
+    [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[aKey fingerprint]] listedKeys:[NSArray arrayWithObject:aChangedKey]];
+    STAssertEqualObjects([aKeyring keysMatchingString:@"alice"], [NSArray arrayWithObject:aChangedKey], @"Changed key not reindexed!");
+    STAssertEqualObjects([aKeyring keysMatchingString:@"zed@"], [NSArray arrayWithObject:aChangedKey], @"New email not indexed!");
+    STAssertEquals([[aKeyring keysMatchingString:@"alice@"] count], (NSUInteger)0, @"Old email still indexed!");
+    STAssertEquals([[aKeyring keys] count], (NSUInteger)2, @"Wrong key count!");
+
+    // Deleted keys are not listed anymore
+    [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[anotherKey fingerprint]] listedKeys:[NSArray array]];
+    STAssertEquals([[aKeyring keysMatchingString:@"b"] count], (NSUInteger)0, @"Deleted key still found!");
+    STAssertEqualObjects([aKeyring keys], [NSArray arrayWithObject:aChangedKey], @"Deleted key still listed!");
+
+    for(i = 0; i < 2100; i++){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+
+        aKey = [MacGPGMESyntheticKey keyWithNumber:1 name:[NSString stringWithFormat:@"Alice %u", i] email:@"alice@example.org" revoked:NO];
+        [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[aKey fingerprint]] listedKeys:[NSArray arrayWithObject:aKey]];
+        [localAP release];
+    }
+    STAssertEqualObjects([aKeyring keysMatchingString:@"alice 2099"], [aKeyring keys], @"Last change not indexed!");
+    STAssertEquals([[aKeyring keysMatchingString:@"alice 2098"] count], (NSUInteger)0, @"Previous change still indexed!");
+    STAssertEquals([[aKeyring keysMatchingString:@"al"] count], (NSUInteger)1, @"Short search returns freed slots!");
+    [aKeyring release];
+}
+
+- (void) testKeyringNamePrefixRefresh
+{
+    // Name entries of changed keys only are moved in the sorted name index
+    MacGPGMESyntheticKey    *aliceKey = [MacGPGMESyntheticKey keyWithNumber:1 name:@"Alice" email:@"alice@example.org" revoked:NO];
+    MacGPGMESyntheticKey    *bobKey = [MacGPGMESyntheticKey keyWithNumber:2 name:@"Bob" email:@"bob@example.org" revoked:NO];
+    MacGPGMESyntheticKey    *carolKey = [MacGPGMESyntheticKey keyWithNumber:3 name:@"Carol" email:@"carol@example.org" revoked:NO];
+    GPGKeyring              *aKeyring = [[GPGKeyring alloc] _initWithKeys:[NSArray arrayWithObjects:aliceKey, bobKey, carolKey, nil] secretKeys:NO];
+    MacGPGMESyntheticKey    *aChangedKey = [MacGPGMESyntheticKey keyWithNumber:1 name:@"Bobby" email:@"bobby@example.org" revoked:NO];
+    MacGPGMESyntheticKey    *aNewKey = [MacGPGMESyntheticKey keyWithNumber:4 name:@"Aaron" email:@"aaron@example.org" revoked:NO];
+    
+    [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObjects:[aliceKey fingerprint], [aNewKey fingerprint], nil] listedKeys:[NSArray arrayWithObjects:aChangedKey, aNewKey, nil]];
+    STAssertEqualObjects([aKeyring keysWithNamePrefix:@"Bob"], ([NSArray arrayWithObjects:bobKey, aChangedKey, nil]), @"Changed key not moved in name index!");
+    STAssertEqualObjects([aKeyring keysWithNamePrefix:@"a"], [NSArray arrayWithObject:aNewKey], @"Old name still indexed, or new key not indexed!");
+    STAssertEqualObjects([aKeyring keysWithNamePrefix:@"c"], [NSArray arrayWithObject:carolKey], @"Unchanged key lost!");
+    
+    [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[bobKey fingerprint]] listedKeys:[NSArray array]];
+    STAssertEqualObjects([aKeyring keysWithNamePrefix:@"bob"], [NSArray arrayWithObject:aChangedKey], @"Deleted key still indexed!");
+    STAssertEquals([[aKeyring keysWithNamePrefix:@""] count], (NSUInteger)3, @"Wrong name entry count!");
+    [aKeyring release];
+}
+
+- (void) testChangedKeyFingerprints
+{
+    NSString        *aFingerprint = @"0123456789ABCDEF0123456789ABCDEF01234567";
+    NSString        *anotherFingerprint = @"89ABCDEF0123456789ABCDEF0123456789ABCDEF";
+    NSDictionary    *changes = [NSDictionary dictionaryWithObjectsAndKeys:[NSDictionary dictionary], [aFingerprint lowercaseString], [NSDictionary dictionary], anotherFingerprint, nil];
+    NSNotification  *aNotification = [NSNotification notificationWithName:GPGKeyringChangedNotification object:nil userInfo:[NSDictionary dictionaryWithObjectsAndKeys:changes, GPGChangesKey, [NSArray arrayWithObject:[@"0x" stringByAppendingString:aFingerprint]], GPGDeletedKeyFingerprintsKey, nil]];
+    
+    STAssertEqualObjects([NSSet setWithArray:GPGChangedKeyFingerprints(aNotification)], ([NSSet setWithObjects:aFingerprint, anotherFingerprint, nil]), @"Wrong changed key fingerprints!");
+    STAssertEquals([GPGChangedKeyFingerprints(aNotification) count], (NSUInteger)2, @"Duplicate fingerprints!");
+    aNotification = [NSNotification notificationWithName:GPGKeyringChangedNotification object:nil userInfo:nil];
+    STAssertEquals([GPGChangedKeyFingerprints(aNotification) count], (NSUInteger)0, @"Changed keys without changes!");
+}
+
+- (void) testKeyringCompletion
+{
+    NSMutableArray  *someKeys = [NSMutableArray array];
+    GPGKeyring      *aKeyring;
+    NSArray         *foundKeys;
+    unsigned        i;
+
+    for(i = 0; i < 40; i++)
+        [someKeys addObject:[MacGPGMESyntheticKey keyWithNumber:i name:[NSString stringWithFormat:@"Test User %u", i] email:[NSString stringWithFormat:@"user%u@example.org", i] revoked:NO]];
+    [someKeys addObject:[MacGPGMESyntheticKey keyWithNumber:40 name:[NSString stringWithUTF8String:"Zo\xC3\xAB \xC3\x89clair"] email:@"zoe@example.org" revoked:NO]];
+    [someKeys addObject:[MacGPGMESyntheticKey keyWithNumber:41 name:@"Revoked Tester" email:@"revoked@example.org" revoked:YES]];
+    aKeyring = [[GPGKeyring alloc] _initWithKeys:someKeys secretKeys:NO];
+
+    // Top keys are the first ones in keyring order, at most 16
+    foundKeys = [aKeyring encryptionKeysWithPrefix:@"TEST" maxCount:5];
+    STAssertEqualObjects(foundKeys, [someKeys subarrayWithRange:NSMakeRange(0, 5)], @"Wrong top keys!");
+    foundKeys = [aKeyring encryptionKeysWithPrefix:@"test" maxCount:100];
+    STAssertEqualObjects(foundKeys, [someKeys subarrayWithRange:NSMakeRange(0, 16)], @"Wrong top keys!");
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"user12@" maxCount:5], [NSArray arrayWithObject:[someKeys objectAtIndex:12]], @"Email prefix not found!");
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"user 39" maxCount:5], [NSArray arrayWithObject:[someKeys objectAtIndex:39]], @"Name word prefix not found!");
+    STAssertEquals([[aKeyring encryptionKeysWithPrefix:@"user 4" maxCount:5] count], (NSUInteger)1, @"Wrong prefix matches!");
+
+    // Diacritics are ignored, in keys and prefixes
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"zoe ec" maxCount:5], [NSArray arrayWithObject:[someKeys objectAtIndex:40]], @"Diacritics not folded!");
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:[NSString stringWithUTF8String:"\xC3\x89CLAIR"] maxCount:5], [NSArray arrayWithObject:[someKeys objectAtIndex:40]], @"Diacritics not folded in prefix!");
+
+    // Unusable keys are not indexed
+    STAssertEquals([[aKeyring encryptionKeysWithPrefix:@"revoked" maxCount:5] count], (NSUInteger)0, @"Revoked key found!");
+    STAssertEquals([[aKeyring encryptionKeysWithPrefix:@"tester" maxCount:5] count], (NSUInteger)0, @"Revoked key found!");
+    STAssertEquals([[aKeyring encryptionKeysWithPrefix:@"nobody" maxCount:5] count], (NSUInteger)0, @"Unknown prefix found!");
+    [aKeyring release];
+}
+
+- (void) testKeyringCompletionRefresh
+{
+    // Trie is updated in place: top keys of a prefix are recomputed when
+    // one of them is removed.
+    NSMutableArray          *someKeys = [NSMutableArray array];
+    GPGKeyring              *aKeyring;
+    MacGPGMESyntheticKey    *aKey;
+    NSMutableArray          *expectedKeys;
+    unsigned                i;
+
+    for(i = 0; i < 20; i++)
+        [someKeys addObject:[MacGPGMESyntheticKey keyWithNumber:i name:[NSString stringWithFormat:@"Test User %u", i] email:[NSString stringWithFormat:@"user%u@example.org", i] revoked:NO]];
+    aKeyring = [[GPGKeyring alloc] _initWithKeys:someKeys secretKeys:NO];
+
+    // Changed key comes last in keyring order
+    aKey = [MacGPGMESyntheticKey keyWithNumber:0 name:@"Renamed Test" email:@"renamed@example.org" revoked:NO];
+    [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[aKey fingerprint]] listedKeys:[NSArray arrayWithObject:aKey]];
+    expectedKeys = [NSMutableArray arrayWithArray:[someKeys subarrayWithRange:NSMakeRange(1, 16)]];
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"test" maxCount:100], expectedKeys, @"Top keys not recomputed!");
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"renamed" maxCount:100], [NSArray arrayWithObject:aKey], @"Changed key not indexed!");
+    STAssertEquals([[aKeyring encryptionKeysWithPrefix:@"user0@" maxCount:100] count], (NSUInteger)0, @"Old email still indexed!");
+
+    // Revoked key is removed
+    aKey = [MacGPGMESyntheticKey keyWithNumber:1 name:@"Test User 1" email:@"user1@example.org" revoked:YES];
+    [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[aKey fingerprint]] listedKeys:[NSArray arrayWithObject:aKey]];
+    [expectedKeys removeObjectAtIndex:0];
+    [expectedKeys addObject:[someKeys objectAtIndex:17]];
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"test" maxCount:100], expectedKeys, @"Revoked key still indexed!");
+
+    // Deleted keys are removed
+    for(i = 2; i < 20; i++)
+        [aKeyring _refreshKeysWithFingerprints:[NSArray arrayWithObject:[[someKeys objectAtIndex:i] fingerprint]] listedKeys:[NSArray array]];
+    STAssertEqualObjects([aKeyring encryptionKeysWithPrefix:@"test" maxCount:100], [aKeyring encryptionKeysWithPrefix:@"renamed" maxCount:100], @"Deleted keys still indexed!");
+    STAssertEquals([[aKeyring encryptionKeysWithPrefix:@"user" maxCount:100] count], (NSUInteger)0, @"Deleted keys still indexed!");
+    [aKeyring release];
+}
+
+- (void) testSignatureGraphPaths
+{
+    // G -> A -> B -> C -> D, A -> E, F alone; G is an unknown signer,
+    // B has a subkey
+    NSString            *a = @"000000000000000A", *b = @"000000000000000B", *c = @"000000000000000C", *d = @"000000000000000D", *e = @"000000000000000E", *f = @"000000000000000F", *g = @"0000000000000010";
+    NSArray             *certifications = [NSArray arrayWithObjects:
+                            [NSArray arrayWithObjects:b, [NSArray arrayWithObjects:b, @"00000000000000BB", nil], [NSSet setWithObject:a], nil],
+                            [NSArray arrayWithObjects:c, [NSArray arrayWithObject:c], [NSSet setWithObject:b], nil],
+                            [NSArray arrayWithObjects:d, [NSArray arrayWithObject:d], [NSSet setWithObject:c], nil],
+                            [NSArray arrayWithObjects:e, [NSArray arrayWithObject:e], [NSSet setWithObject:a], nil],
+                            [NSArray arrayWithObjects:a, [NSArray arrayWithObject:a], [NSSet setWithObject:g], nil],
+                            [NSArray arrayWithObjects:f, [NSArray arrayWithObject:f], [NSSet set], nil], nil];
+    GPGSignatureGraph   *aGraph = [[GPGSignatureGraph alloc] _initWithCertifications:certifications];
+    NSArray             *aPath;
+
+    STAssertEquals([aGraph keyCount], 7U, @"Wrong vertex count!");
+    STAssertEquals([aGraph certificationCount], 5U, @"Wrong edge count!");
+    STAssertEquals([aGraph certificationCountForKeyID:b], 1U, @"Wrong in-degree!");
+    STAssertEquals([aGraph certificationCountForKeyID:@"00000000000000bb"], 1U, @"Subkey ID not resolved!");
+    STAssertEquals([aGraph certificationCountForKeyID:f], 0U, @"Wrong in-degree!");
+    STAssertEquals([aGraph certificationCountForKeyID:g], 0U, @"Wrong in-degree!");
+    STAssertEqualObjects([aGraph signerKeyIDsForKeyID:[@"0x" stringByAppendingString:b]], [NSArray arrayWithObject:a], @"Wrong signers!");
+    STAssertEqualObjects([NSSet setWithArray:[aGraph certifiedKeyIDsForKeyID:a]], ([NSSet setWithObjects:b, e, nil]), @"Wrong certified keys!");
+
+    // Direct edge, longer path and length bound
+    STAssertEqualObjects([aGraph shortestPathFromKeyID:a toKeyID:b maxLength:1], ([NSArray arrayWithObjects:a, b, nil]), @"Direct certification not found!");
+    aPath = [NSArray arrayWithObjects:g, a, b, c, d, nil];
+    STAssertEqualObjects([aGraph shortestPathFromKeyID:g toKeyID:[@"00000000000000000000000000000000" stringByAppendingString:d] maxLength:0], aPath, @"Path not found!");
+    STAssertEqualObjects([aGraph shortestPathFromKeyID:g toKeyID:d maxLength:4], aPath, @"Path not found with bound!");
+    STAssertNil([aGraph shortestPathFromKeyID:g toKeyID:d maxLength:3], @"Path longer than bound!");
+
+    // No path
+    STAssertNil([aGraph shortestPathFromKeyID:d toKeyID:a maxLength:0], @"Path against certifications!");
+    STAssertNil([aGraph shortestPathFromKeyID:f toKeyID:a maxLength:0], @"Path from isolated key!");
+    STAssertNil([aGraph shortestPathFromKeyID:a toKeyID:@"0000000000000099" maxLength:0], @"Path to unknown key!");
+
+    // Reachability
+    STAssertEqualObjects([aGraph keyIDsReachableFromKeyID:a maxLength:0], ([NSSet setWithObjects:b, c, d, e, nil]), @"Wrong reachable keys!");
+    STAssertEqualObjects([aGraph keyIDsReachableFromKeyID:a maxLength:1], ([NSSet setWithObjects:b, e, nil]), @"Wrong reachable keys with bound!");
+    STAssertEqualObjects([aGraph keyIDsReachableFromKeyID:f maxLength:0], [NSSet set], @"Isolated key reaches keys!");
+    [aGraph release];
+}
+
+- (void) testSignatureGraphRefresh
+{
+    // G -> A -> B -> C, A -> E, F alone; B has a subkey. B and F are deleted,
+    // then E is refreshed and certified by C, then B is imported again.
+    NSString            *a = @"000000000000000A", *b = @"000000000000000B", *c = @"000000000000000C", *e = @"000000000000000E", *f = @"000000000000000F", *g = @"0000000000000010";
+    NSArray             *bCertification = [NSArray arrayWithObjects:b, [NSArray arrayWithObjects:b, @"00000000000000BB", nil], [NSSet setWithObject:a], nil];
+    NSArray             *certifications = [NSArray arrayWithObjects:
+                            bCertification,
+                            [NSArray arrayWithObjects:c, [NSArray arrayWithObject:c], [NSSet setWithObject:b], nil],
+                            [NSArray arrayWithObjects:e, [NSArray arrayWithObject:e], [NSSet setWithObject:a], nil],
+                            [NSArray arrayWithObjects:a, [NSArray arrayWithObject:a], [NSSet setWithObject:g], nil],
+                            [NSArray arrayWithObjects:f, [NSArray arrayWithObject:f], [NSSet set], nil], nil];
+    GPGSignatureGraph   *aGraph = [[GPGSignatureGraph alloc] _initWithCertifications:certifications];
+    
+    STAssertEqualObjects([aGraph shortestPathFromKeyID:g toKeyID:c maxLength:0], ([NSArray arrayWithObjects:g, a, b, c, nil]), @"Path not found!");
+    STAssertEqualObjects(GPGNormalizedHexString(@" 0x0000 0000 0000 0000 0000  0000 0000 0000 0000 000b", 40), @"000000000000000000000000000000000000000B", @"Formatted fingerprint not normalized!");
+    [aGraph _refreshKeysWithFingerprints:[NSArray arrayWithObjects:@"0000 0000 0000 0000 0000  0000 0000 0000 0000 000b", f, nil] certifications:[NSArray array]];
+    
+    // Deleted B still certifies C, like an unknown signer, but no path goes
+    // through it; deleted F is gone
+    STAssertNil([aGraph shortestPathFromKeyID:g toKeyID:c maxLength:0], @"Path through deleted key!");
+    STAssertNil([aGraph shortestPathFromKeyID:a toKeyID:b maxLength:0], @"Path to deleted key!");
+    STAssertEqualObjects([aGraph keyIDsReachableFromKeyID:a maxLength:0], [NSSet setWithObject:e], @"Deleted key reachable!");
+    STAssertEqualObjects([aGraph certifiedKeyIDsForKeyID:b], [NSArray arrayWithObject:c], @"Certification by deleted key lost!");
+    STAssertEquals([aGraph certificationCountForKeyID:b], 0U, @"Deleted key still certified!");
+    STAssertEquals([aGraph certificationCountForKeyID:@"00000000000000BB"], 0U, @"Subkey ID of deleted key still resolved!");
+    STAssertEqualObjects([aGraph certifiedKeyIDsForKeyID:@"00000000000000BB"], [NSArray array], @"Subkey ID of deleted key still resolved!");
+    STAssertEqualObjects([aGraph keyIDsReachableFromKeyID:f maxLength:0], [NSSet set], @"Deleted key found!");
+    STAssertEquals([aGraph keyCount], 5U, @"Wrong vertex count after deletion!");
+    STAssertEquals([aGraph certificationCount], 3U, @"Wrong edge count after deletion!");
+    
+    // Several refreshes before next query
+    [aGraph _refreshKeysWithFingerprints:[NSArray arrayWithObject:e] certifications:[NSArray arrayWithObject:[NSArray arrayWithObjects:e, [NSArray arrayWithObject:e], [NSSet setWithObjects:a, c, nil], nil]]];
+    [aGraph _refreshKeysWithFingerprints:[NSArray arrayWithObject:b] certifications:[NSArray arrayWithObject:bCertification]];
+    STAssertEqualObjects([aGraph shortestPathFromKeyID:g toKeyID:c maxLength:0], ([NSArray arrayWithObjects:g, a, b, c, nil]), @"Path not found after import!");
+    STAssertEquals([aGraph certificationCountForKeyID:@"00000000000000BB"], 1U, @"Subkey ID not resolved after import!");
+    STAssertEquals([aGraph certificationCountForKeyID:e], 2U, @"Refreshed certifications not used!");
+    STAssertEquals([aGraph keyCount], 6U, @"Wrong vertex count after import!");
+    [aGraph release];
+}
+
+- (void) testSignatureGraph
+{
+    // Graph must be consistent with itself on the default keyring, also
+    // after a change notified without keys, which reloads it lazily.
+    GPGSignatureGraph   *aGraph = [[GPGSignatureGraph alloc] init];
+    GPGContext          *aContext = [[GPGContext alloc] init];
+    NSArray             *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSEnumerator        *keyEnum = [allKeys objectEnumerator];
+    GPGKey              *aKey;
+    unsigned            aCertificationCount = [aGraph certificationCount];
+
+    STAssertTrue([aGraph keyCount] >= [allKeys count], @"Missing keys!");
+    while((aKey = [keyEnum nextObject]) != nil){
+        NSString        *aKeyID = [aKey keyID];
+        NSArray         *signerKeyIDs = [aGraph signerKeyIDsForKeyID:[aKey fingerprint]];
+        NSEnumerator    *signerEnum = [signerKeyIDs objectEnumerator];
+        NSString        *aSignerKeyID;
+
+        STAssertEquals([aGraph certificationCountForKeyID:aKeyID], (unsigned)[signerKeyIDs count], @"Wrong in-degree!");
+        while((aSignerKeyID = [signerEnum nextObject]) != nil){
+            STAssertTrue([[aGraph certifiedKeyIDsForKeyID:aSignerKeyID] containsObject:aKeyID], @"Edge missing in outgoing edges!");
+            STAssertTrue([[aGraph keyIDsReachableFromKeyID:aSignerKeyID maxLength:1] containsObject:aKeyID], @"Certified key not reachable!");
+            if(![aSignerKeyID isEqualToString:aKeyID])
+                STAssertEqualObjects([aGraph shortestPathFromKeyID:aSignerKeyID toKeyID:aKeyID maxLength:1], ([NSArray arrayWithObjects:aSignerKeyID, aKeyID, nil]), @"Direct certification not found!");
+        }
+        if([allKeys count] > 0){
+            NSString    *anOriginKeyID = [[allKeys objectAtIndex:0] keyID];
+            NSArray     *aPath = [aGraph shortestPathFromKeyID:anOriginKeyID toKeyID:aKeyID maxLength:0];
+            unsigned    i;
+
+            STAssertEquals(aPath != nil, [[aGraph keyIDsReachableFromKeyID:anOriginKeyID maxLength:0] containsObject:aKeyID] || [anOriginKeyID isEqualToString:aKeyID], @"Path and reachability differ!");
+            for(i = 1; i < [aPath count]; i++)
+                STAssertTrue([[aGraph certifiedKeyIDsForKeyID:[aPath objectAtIndex:i - 1]] containsObject:[aPath objectAtIndex:i]], @"Path is not made of certifications!");
+        }
+    }
+    [[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyringChangedNotification object:nil userInfo:nil];
+    STAssertEquals([aGraph certificationCount], aCertificationCount, @"Graph changed after reload!");
+    [aContext release];
+    [aGraph release];
+}
+
+- (void) testLoadSignatures
+{
+    // Signatures loaded on keys listed in default mode must be the same as
+    // the ones of keys listed in signature mode. A user ID which changed
+    // since its key was listed (simulated by pointing it to another string)
+    // must get no signatures.
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSArray         *keys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSArray         *signatureKeys;
+    NSMutableArray  *signatureKeyFingerprints;
+    NSEnumerator    *keyEnum;
+    GPGKey          *aKey;
+    GPGKey          *changedKey = nil;
+    gpgme_user_id_t changedUserID = NULL;
+    char            *originalUserIDChars = NULL;
+    NSArray         *someSignatures;
+
+    [aContext stopKeyEnumeration];
+    keyEnum = [keys objectEnumerator];
+    while(changedKey == nil && (aKey = [keyEnum nextObject]) != nil)
+        if([aKey gpgmeKey]->uids != NULL && [aKey gpgmeKey]->uids->next != NULL)
+            changedKey = aKey;
+    if(changedKey == nil){
+        [aContext release];
+        return;
+    }
+    changedUserID = [changedKey gpgmeKey]->uids;
+    originalUserIDChars = changedUserID->uid;
+    changedUserID->uid = "MacGPGME Changed User ID <changed@example.com>";
+    NS_DURING
+        [GPGKey loadSignaturesOfKeys:keys];
+    NS_HANDLER
+        changedUserID->uid = originalUserIDChars;
+        [aContext release];
+        [localException raise];
+    NS_ENDHANDLER
+    STAssertNotNil([[[changedKey userIDs] objectAtIndex:0] signatures], @"Changed user ID has no signatures array!");
+    STAssertEquals([[[[changedKey userIDs] objectAtIndex:0] signatures] count], (unsigned)0, @"Changed user ID got signatures!");
+    changedUserID->uid = originalUserIDChars;
+
+    [aContext setKeyListMode:GPGKeyListModeLocal | GPGKeyListModeSignatures];
+    signatureKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    [aContext stopKeyEnumeration];
+    signatureKeyFingerprints = [NSMutableArray arrayWithCapacity:[signatureKeys count]];
+    keyEnum = [signatureKeys objectEnumerator];
+    while((aKey = [keyEnum nextObject]) != nil)
+        [signatureKeyFingerprints addObject:[aKey fingerprint]];
+    STAssertEquals([signatureKeys count], [keys count], @"Keyring changed during test!");
+
+    keyEnum = [keys objectEnumerator];
+    while((aKey = [keyEnum nextObject]) != nil){
+        unsigned    aKeyIndex = [signatureKeyFingerprints indexOfObject:[aKey fingerprint]];
+        NSArray     *userIDs = [aKey userIDs];
+        NSArray     *signatureUserIDs;
+        unsigned    i;
+
+        STAssertTrue(aKeyIndex != NSNotFound, @"Key %@ not listed in signature mode!", [aKey fingerprint]);
+        if(aKeyIndex == NSNotFound)
+            continue;
+        signatureUserIDs = [[signatureKeys objectAtIndex:aKeyIndex] userIDs];
+        STAssertEquals([userIDs count], [signatureUserIDs count], @"User ID count differs for %@!", [aKey fingerprint]);
+        for(i = (aKey == changedKey ? 1 : 0); i < [userIDs count] && i < [signatureUserIDs count]; i++){
+            NSArray *loadedSignatures = [[userIDs objectAtIndex:i] signatures];
+            NSArray *listedSignatures = [[signatureUserIDs objectAtIndex:i] signatures];
+
+            STAssertNotNil(loadedSignatures, @"No signatures loaded for %@!", [[userIDs objectAtIndex:i] userID]);
+            STAssertEqualObjects([loadedSignatures valueForKey:@"signerKeyID"], (listedSignatures != nil ? [listedSignatures valueForKey:@"signerKeyID"] : [NSArray array]), @"Signers differ for %@!", [[userIDs objectAtIndex:i] userID]);
+            STAssertEqualObjects([loadedSignatures valueForKey:@"creationDate"], (listedSignatures != nil ? [listedSignatures valueForKey:@"creationDate"] : [NSArray array]), @"Signature dates differ for %@!", [[userIDs objectAtIndex:i] userID]);
+            STAssertEqualObjects([loadedSignatures valueForKey:@"isRevocationSignature"], (listedSignatures != nil ? [listedSignatures valueForKey:@"isRevocationSignature"] : [NSArray array]), @"Revocations differ for %@!", [[userIDs objectAtIndex:i] userID]);
+            if([loadedSignatures count] > 0)
+                STAssertEquals([[loadedSignatures objectAtIndex:0] signedUserID], [userIDs objectAtIndex:i], @"Signature not attached to original user ID!");
+        }
+    }
+
+    // Loading again is a no-op
+    someSignatures = [[[[keys lastObject] userIDs] lastObject] signatures];
+    [GPGKey loadSignaturesOfKeys:keys];
+    if(someSignatures != nil)
+        STAssertEquals([[[[keys lastObject] userIDs] lastObject] signatures], someSignatures, @"Signatures loaded twice!");
+    [aContext release];
+}
+
+- (NSArray *) parallelListingPatterns
+{
+    // Fingerprints of all keys, followed by fingerprints of the first keys
+    // again, which must not be returned twice.
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSArray         *allKeys = [[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects];
+    NSMutableArray  *patterns = [NSMutableArray arrayWithCapacity:[allKeys count] + 3];
+    unsigned        i;
+
+    for(i = 0; i < [allKeys count]; i++)
+        [patterns addObject:[[allKeys objectAtIndex:i] fingerprint]];
+    for(i = 0; i < 3 && i < [allKeys count]; i++)
+        [patterns addObject:[[allKeys objectAtIndex:i] fingerprint]];
+    [aContext release];
+
+    return patterns;
+}
+
+- (NSArray *) seriallyListedFingerprintsForPatterns:(NSArray *)patterns shardSize:(unsigned)shardSize
+{
+    // Keys of each shard, in shard order, each key once
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSMutableArray  *fingerprints = [NSMutableArray array];
+    unsigned        i;
+
+    for(i = 0; i < [patterns count]; i += shardSize){
+        NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPatterns:[patterns subarrayWithRange:NSMakeRange(i, MIN(shardSize, [patterns count] - i))] secretKeysOnly:NO];
+        GPGKey          *aKey;
+
+        while((aKey = [keyEnum nextObject]) != nil)
+            if(![fingerprints containsObject:[aKey fingerprint]])
+                [fingerprints addObject:[aKey fingerprint]];
+    }
+    [aContext release];
+
+    return fingerprints;
+}
+
+- (void) testParallelKeyListingOrdered
+{
+    NSArray         *patterns = [self parallelListingPatterns];
+    NSArray         *expectedFingerprints;
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    unsigned        aShardSize;
+
+    if([patterns count] == 0){
+        [aContext release];
+        return;
+    }
+    for(aShardSize = 1; aShardSize <= 4; aShardSize++){
+        NSEnumerator    *keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO contextCount:3 ordered:YES shardSize:aShardSize];
+
+        expectedFingerprints = [self seriallyListedFingerprintsForPatterns:patterns shardSize:aShardSize];
+        STAssertEqualObjects([[keyEnum allObjects] valueForKey:@"fingerprint"], expectedFingerprints, @"Ordered keys differ from serially listed keys, with shards of %u patterns!", aShardSize);
+    }
+    [aContext release];
+}
+
+- (void) testParallelKeyListingUnordered
+{
+    NSArray         *patterns = [self parallelListingPatterns];
+    NSArray         *expectedFingerprints;
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    unsigned        aShardSize;
+
+    for(aShardSize = 1; aShardSize <= 4; aShardSize++){
+        NSArray *fingerprints = [[[aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO contextCount:3 ordered:NO shardSize:aShardSize] allObjects] valueForKey:@"fingerprint"];
+
+        expectedFingerprints = [self seriallyListedFingerprintsForPatterns:patterns shardSize:aShardSize];
+        STAssertEquals([fingerprints count], [expectedFingerprints count], @"Key returned twice, or missing, with shards of %u patterns!", aShardSize);
+        STAssertEqualObjects([NSSet setWithArray:fingerprints], [NSSet setWithArray:expectedFingerprints], @"Unordered keys differ from serially listed keys, with shards of %u patterns!", aShardSize);
+    }
+    // No pattern: a single shard lists all keys
+    STAssertEqualObjects([NSSet setWithArray:[[[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO contextCount:3 ordered:NO shardSize:1] allObjects] valueForKey:@"fingerprint"]], [NSSet setWithArray:[[[aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:NO] allObjects] valueForKey:@"fingerprint"]], @"Not all keys listed!");
+    [aContext release];
+}
+
+- (void) testParallelKeyListingShardError
+{
+    // Error in one shard must be raised by enumerator, in both modes, and
+    // stop other workers.
+    NSMutableArray  *patterns = [NSMutableArray arrayWithArray:[self parallelListingPatterns]];
+    GPGContext      *aContext = [[MacGPGMEFailingContext alloc] init];
+    int             anOrderedMode;
+
+    [patterns insertObject:FAILING_SHARD_PATTERN atIndex:[patterns count] / 2];
+    for(anOrderedMode = 0; anOrderedMode < 2; anOrderedMode++){
+        NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+        NSEnumerator        *keyEnum = [aContext keyEnumeratorForSearchPatterns:patterns secretKeysOnly:NO contextCount:3 ordered:(anOrderedMode != 0) shardSize:2];
+        NSException         *anException = nil;
+
+        NS_DURING
+            while([keyEnum nextObject] != nil)
+                ;
+        NS_HANDLER
+            anException = localException;
+        NS_ENDHANDLER
+        STAssertNotNil(anException, @"Shard error not raised!");
+        STAssertEquals(GPGErrorCodeFromError([[[anException userInfo] objectForKey:GPGErrorKey] unsignedIntValue]), GPGErrorGeneralError, @"Not the shard error!");
+        STAssertNil([keyEnum nextObject], @"Enumeration goes on after shard error!");
+        [localAP release];
+    }
+    [aContext release];
+}
+
+- (void) writeToPipe:(GPGDataPipe *)pipe
+{
+    NSAutoreleasePool   *localAP = [[NSAutoreleasePool alloc] init];
+    NSData              *chunk = [NSMutableData dataWithLength:1000];
+    int                 i;
+    
+    for(i = 0; i < 100; i++)
+        [[pipe dataForWriting] writeData:chunk];
+    [pipe closeDataForWriting];
+    [localAP release];
+}
+
+- (void) testCancelledPassphrase
+{
+    // Empty and cancelled passphrases are written as a lone newline; engine
+    // must neither get garbage nor wait for more
+    GPGContext                  *aContext = [[GPGContext alloc] init];
+    MacGPGMEPassphraseDelegate  *aDelegate = [[MacGPGMEPassphraseDelegate alloc] initWithPassphrases:[NSArray arrayWithObject:@"MacGPGME"]];
+    GPGData                     *inputData = [[GPGData alloc] initWithData:[@"testString" dataUsingEncoding:NSUTF8StringEncoding]];
+    GPGData                     *cipherData = nil;
+    
+    [aContext autorelease];
+    [aDelegate autorelease];
+    [inputData autorelease];
+    [aContext setPassphraseDelegate:aDelegate];
+    STAssertNoThrow(cipherData = [aContext encryptedData:inputData], @"Unable to encrypt symmetrically");
+    STAssertNotNil(cipherData, @"No cipher data!");
+    
+    aDelegate = [[MacGPGMEPassphraseDelegate alloc] initWithPassphrases:[NSArray arrayWithObjects:@"", [NSNull null], nil]];
+    [aDelegate autorelease];
+    [aContext setPassphraseDelegate:aDelegate];
+    STAssertThrows([aContext decryptedData:cipherData], @"Decrypted with empty passphrase!");
+    STAssertTrue([aDelegate requestCount] >= 1, @"Passphrase not requested!");
+    
+    aDelegate = [[MacGPGMEPassphraseDelegate alloc] initWithPassphrases:[NSArray array]];
+    [aDelegate autorelease];
+    [aContext setPassphraseDelegate:aDelegate];
+    STAssertThrows([aContext decryptedData:cipherData], @"Decrypted with cancelled passphrase!");
+    STAssertEquals([aDelegate requestCount], 1U, @"Passphrase requested again after cancellation!");
+    
+    // Context is still usable
+    aDelegate = [[MacGPGMEPassphraseDelegate alloc] initWithPassphrases:[NSArray arrayWithObject:@"MacGPGME"]];
+    [aDelegate autorelease];
+    [aContext setPassphraseDelegate:aDelegate];
+    STAssertEqualObjects([[aContext decryptedData:cipherData] data], [inputData data], @"Not the same data!");
+}
+
+- (void) testFileEncryptionRoundTrip
+{
+    // Needs a secret key which can encrypt, without passphrase
+    GPGContext      *aContext = [[GPGContext alloc] init];
+    NSFileManager   *aManager = [NSFileManager defaultManager];
+    NSString        *aDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MacGPGMETestFiles"];
+    NSString        *plainPath = [aDirectory stringByAppendingPathComponent:@"plain"];
+    NSString        *cipherPath = [aDirectory stringByAppendingPathComponent:@"cipher"];
+    NSString        *decryptedPath = [aDirectory stringByAppendingPathComponent:@"decrypted"];
+    NSData          *inputData = [@"testString" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData          *existingData = [@"existing" dataUsingEncoding:NSUTF8StringEncoding];
+    NSEnumerator    *keyEnum;
+    GPGKey          *aKey;
+    struct stat     aStat;
+    
+    [aContext autorelease];
+    keyEnum = [aContext keyEnumeratorForSearchPatterns:nil secretKeysOnly:YES];
+    while((aKey = [keyEnum nextObject]) != nil && ![[aKey publicKey] canEncrypt])
+        ;
+    [aContext stopKeyEnumeration];
+    if(aKey == nil)
+        return;
+    
+    [aManager removeFileAtPath:aDirectory handler:nil];
+    [aManager createDirectoryAtPath:aDirectory attributes:nil];
+    [inputData writeToFile:plainPath atomically:NO];
+    STAssertNoThrow([aContext encryptFileAtPath:plainPath toPath:cipherPath withKeys:[NSArray arrayWithObject:[aKey publicKey]]], @"Unable to encrypt file");
+    
+    // Existing world-readable output file is replaced by a user-only one
+    [existingData writeToFile:decryptedPath atomically:NO];
+    chmod([decryptedPath fileSystemRepresentation], 0644);
+    STAssertNoThrow([aContext decryptFileAtPath:cipherPath toPath:decryptedPath], @"Unable to decrypt file");
+    STAssertEqualObjects([NSData dataWithContentsOfFile:decryptedPath], inputData, @"Not the same data!");
+    STAssertEquals(stat([decryptedPath fileSystemRepresentation], &aStat), 0, @"No decrypted file!");
+    STAssertEquals((int)(aStat.st_mode & 0777), 0600, @"Decrypted file readable by others!");
+    
+    // On failure, existing output file is untouched and no temporary file remains
+    [existingData writeToFile:decryptedPath atomically:NO];
+    STAssertThrows([aContext decryptFileAtPath:plainPath toPath:decryptedPath], @"Plain file decrypted!");
+    STAssertEqualObjects([NSData dataWithContentsOfFile:decryptedPath], existingData, @"Existing file modified on failure!");
+    STAssertEquals([[aManager directoryContentsAtPath:aDirectory] count], (NSUInteger)3, @"Temporary file left!");
+    [aManager removeFileAtPath:aDirectory handler:nil];
+}
+
+- (void) testDataPipe
+{
+    GPGDataPipe *pipe = [[GPGDataPipe alloc] initWithCapacity:4096];
+    
+    [pipe autorelease];
+    [NSThread detachNewThreadSelector:@selector(writeToPipe:) toTarget:self withObject:pipe];
+    STAssertEquals([[[pipe dataForReading] availableData] length], (NSUInteger)100000, @"Not all bytes read!");
+}
+
 /* TODO: pass correct arguments to dictionary; currently incomplete
 - (void) testKeyCreation
 {